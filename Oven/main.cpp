@@ -11,6 +11,9 @@
 #include <d3d12shader.h>
 
 #include <EASTL/bitset.h>
+#include <EASTL/sort.h>
+#include <chrono>
+#include <float.h>
 
 #include "Common.h"
 #include "AllDeclarations.h"
@@ -19,8 +22,13 @@
 
 #include "Assets/Shader.generated.h"
 #include "Assets/Mesh.generated.h"
+#include "Assets/MeshOptimizer.generated.h"
+#include "Assets/Meshlet.generated.h"
 #include "Assets/TextureDescription.generated.h"
+#include "Assets/TextureEncoder.generated.h"
+#include "Assets/TextureMips.generated.h"
 
+#include "Assets/CookCache.generated.h"
 #include "Assets/Pak.h"
 #include "Assets/Scene.h"
 
@@ -29,7 +37,12 @@
 #include "Util/Util.h"
 
 #include "Threading/Worker.h"
+#include "Threading/JobGraph.h"
 
+// bump whenever cooking code changes its output, invalidates everything in the cook cache
+#define OVEN_COOK_VERSION 9
+#define OVEN_SCENE_IMPORT_FLAGS (aiProcess_GenBoundingBoxes | aiProcess_ConvertToLeftHanded | aiProcessPreset_TargetRealtime_MaxQuality)
+#define OVEN_SHARED_TEXTURES_PATH "./cooked/textures.pak"
 
 void MaterialSetTextureType(MaterialDescription& Material, aiTextureType TextureType, u16 Index)
 {
@@ -77,48 +90,28 @@ void MaterialSetTextureType(MaterialDescription& Material, aiTextureType Texture
 	}
 }
 
-bool CanPackPosition(aiMesh* Mesh)
+// "no_quantize", "position_error <units>" and "uv_error <uv units>" on the command line, part of the scenes' cook keys
+struct QuantizationSettings
 {
-	return false;
-
-	Vec3 Min = Vec3{
-		Mesh->mAABB.mMin.x,
-		Mesh->mAABB.mMin.y,
-		Mesh->mAABB.mMin.z,
-	};
-	Vec3 Max = Vec3{
-		Mesh->mAABB.mMax.x,
-		Mesh->mAABB.mMax.y,
-		Mesh->mAABB.mMax.z,
-	};
+	u32   Enabled = 1;
+	float PositionError = 0.001f;   // how far a packed position may end up from the original
+	float UVError = 1.f / 8192.f;   // a quarter of a texel of a 2048 texture
+};
 
-	Vec3 Extent = Vec3{
-		std::abs(Mesh->mAABB.mMax.x - Mesh->mAABB.mMin.x),
-		std::abs(Mesh->mAABB.mMax.y - Mesh->mAABB.mMin.y),
-		std::abs(Mesh->mAABB.mMax.z - Mesh->mAABB.mMin.z),
-	};
+// unorm16 within the box, worst case is half a step on every axis at once
+float GetPackedPositionError(const MeshDescription& Description)
+{
+	Vec3 Extent = Description.BoxMax - Description.BoxMin;
+	return 0.5f * sqrtf(Dot(Extent, Extent)) / float(UINT16_MAX);
+}
 
-	float Scale = (1.0f / float(INT16_MAX));
-	Vec3 ScaleVector = Vec3{Extent.x * Scale, Extent.y * Scale, Extent.z * Scale};
-	for (unsigned i = 0; i < Mesh->mNumVertices; ++i)
+u16 QuantizeUnorm16(float Value, float Min, float Extent)
+{
+	if (Extent <= 0.f)
 	{
-		aiVector3D Position = Mesh->mVertices[i];
-
-		Vec4 Normalized{
-			(Mesh->mVertices[i].x - Min.x) / (Extent.x),
-			(Mesh->mVertices[i].y - Min.y) / (Extent.y),
-			(Mesh->mVertices[i].z - Min.z) / (Extent.z),
-			1.f
-		};
-		Vec4PackShorts Packed(Normalized);
-		Vec4 Unpacked = Packed;
-		float d = DistanceSquared(Normalized, Unpacked);
-		if (d > (1.0/1024.0)*(1.0/1024.0))
-		{
-			return false;
-		}
+		return 0;
 	}
-	return true;
+	return (u16)Clamp(lroundf((Value - Min) / Extent * UINT16_MAX), 0l, (long)UINT16_MAX);
 }
 
 bool ColorHasUsefulInfo(aiMesh* Mesh)
@@ -139,27 +132,61 @@ bool ColorHasUsefulInfo(aiMesh* Mesh)
 	return false;
 }
 
-MeshDescription ExtractMeshDescription(aiMesh* Mesh)
+MeshDescription ExtractMeshDescription(aiMesh* Mesh, bool NeedsTangents, const QuantizationSettings& Settings)
 {
-	bool bPositionPacked = CanPackPosition(Mesh);
-
 	MeshDescription Result;
-	Result.Flags = bPositionPacked ? MeshFlags::PositionPacked : 0;
 
 	CHECK(Mesh->HasFaces(), "Mesh without faces?");
 
-	u16 VertexSize = bPositionPacked ? sizeof(Vec4PackShorts) : sizeof(Vec3);
+	Result.BoxMin = Vec3{
+		Mesh->mAABB.mMin.x,
+		Mesh->mAABB.mMin.y,
+		Mesh->mAABB.mMin.z,
+	};
+	Result.BoxMax = Vec3{
+		Mesh->mAABB.mMax.x,
+		Mesh->mAABB.mMax.y,
+		Mesh->mAABB.mMax.z,
+	};
+
+	bool bPositionPacked = Settings.Enabled && GetPackedPositionError(Result) <= Settings.PositionError;
+	Result.Flags = bPositionPacked ? MeshFlags::PositionPacked : 0;
+
+	u16 VertexSize = bPositionPacked ? sizeof(u16) * 4 : sizeof(Vec3);
 
 	if (Mesh->HasNormals())
 	{
 		Result.Flags |= MeshFlags::HasNormals;
-		VertexSize += sizeof(Vec4PackUnorm);
+		VertexSize += sizeof(u32);
+	}
+
+	if (NeedsTangents && Mesh->HasNormals() && Mesh->HasTangentsAndBitangents())
+	{
+		Result.Flags |= MeshFlags::HasTangents;
+		VertexSize += sizeof(u32);
 	}
 
 	if (Mesh->HasTextureCoords(0))
 	{
 		Result.Flags |= MeshFlags::HasUV0;
 		VertexSize += sizeof(Vec2h);
+
+		Vec2 Min{ FLT_MAX, FLT_MAX };
+		Vec2 Max{ -FLT_MAX, -FLT_MAX };
+		for (unsigned i = 0; i < Mesh->mNumVertices; ++i)
+		{
+			const aiVector3D& UV = Mesh->mTextureCoords[0][i];
+			Min = Vec2{ fminf(Min.x, UV.x), fminf(Min.y, UV.y) };
+			Max = Vec2{ fmaxf(Max.x, UV.x), fmaxf(Max.y, UV.y) };
+		}
+		Result.UVMin = Min;
+		Result.UVScale = Vec2{ Max.x - Min.x, Max.y - Min.y };
+
+		float UVError = 0.5f * fmaxf(Result.UVScale.x, Result.UVScale.y) / float(UINT16_MAX);
+		if (Settings.Enabled && UVError <= Settings.UVError)
+		{
+			Result.Flags |= MeshFlags::UVPacked;
+		}
 	}
 
 	if (ColorHasUsefulInfo(Mesh))
@@ -174,124 +201,1123 @@ MeshDescription ExtractMeshDescription(aiMesh* Mesh)
 	CHECK(VertexSize <= 255);
 	Result.VertexSize = (u8)VertexSize;
 
-	Result.BoxMin = Vec3{
-		Mesh->mAABB.mMin.x,
-		Mesh->mAABB.mMin.y,
-		Mesh->mAABB.mMin.z,
-	};
-	Result.BoxMax = Vec3{
-		Mesh->mAABB.mMax.x,
-		Mesh->mAABB.mMax.y,
-		Mesh->mAABB.mMax.z,
-	};
+	return Result;
+}
+
+// Triangles and vertex order after the vertex cache, overdraw and vertex fetch passes
+struct OptimizedMesh
+{
+	TArray<u32> Indices;
+	TArray<u32> VertexOrder; // source vertex of every output vertex
+	VertexCacheStats Before;
+	VertexCacheStats After;
+};
+
+OptimizedMesh OptimizeMesh(aiMesh* Mesh)
+{
+	ZoneScoped;
+
+	OptimizedMesh Result;
+	Result.Indices.reserve(Mesh->mNumFaces * 3);
+	for (UINT i = 0; i < Mesh->mNumFaces; ++i)
+	{
+		CHECK(Mesh->mFaces[i].mNumIndices == 3, "Not triangles?");
+		Result.Indices.insert(Result.Indices.end(), Mesh->mFaces[i].mIndices, Mesh->mFaces[i].mIndices + 3);
+	}
+
+	u32* Indices = Result.Indices.data();
+	u64 IndexCount = Result.Indices.size();
+	Result.Before = AnalyzeVertexCache(Indices, IndexCount, Mesh->mNumVertices);
+
+	OptimizeVertexCache(Indices, IndexCount, Mesh->mNumVertices);
+	static_assert(sizeof(aiVector3D) == sizeof(Vec3));
+	OptimizeOverdraw(Indices, IndexCount, (const Vec3*)Mesh->mVertices, Mesh->mNumVertices);
+	u32 VertexCount = OptimizeVertexFetch(Indices, IndexCount, Mesh->mNumVertices, Result.VertexOrder);
+
+	Result.After = AnalyzeVertexCache(Indices, IndexCount, VertexCount);
+	return Result;
+}
+
+// "texture_quality fast|normal|best", "texture_bc7" and "mip_filter box|kaiser|lanczos" on the command line, part of the scenes' cook keys
+struct TextureSettings
+{
+	u32 Quality = TextureQualityNormal;
+	u32 UseBC7 = 0; // embedded textures go to BC7 instead of BC1, or BC3 when they have alpha
+	u32 MipFilter = MipFilterKaiser;
+};
+
+// Pak item cooked on a worker, kept until the job that owns the pak inserts it
+struct StagedPakItem
+{
+	String Name;
+	String Data;
+	u32    PrivateFlags;
+	bool   UseDirectStorage;
+};
+
+void StageIntoPak(TArray<StagedPakItem>& Staged, StringView Name, RawDataView Data, u32 PrivateFlags, bool UseDirectStorage)
+{
+	StagedPakItem& Item = Staged.push_back();
+	Item.Name = String(Name);
+	Item.Data.assign((const char*)Data.data(), Data.size());
+	Item.PrivateFlags = PrivateFlags;
+	Item.UseDirectStorage = UseDirectStorage;
+}
+
+// Colors authored in sRGB, everything else is data and filtered as is
+bool IsColorTexture(aiTextureType TextureType)
+{
+	return TextureType == aiTextureType_DIFFUSE
+		|| TextureType == aiTextureType_BASE_COLOR
+		|| TextureType == aiTextureType_EMISSIVE
+		|| TextureType == aiTextureType_EMISSION_COLOR;
+}
+
+// Chain is a full mip chain with levels back to back, the way DDS files and EncodeMipChain lay it out.
+// Mips of 64KB and up become their own GetTextureMipItemName items that TickStreaming brings in one by one,
+// the small ones are packed into GetTextureItemName with the pitch and placement alignment the upload expects.
+void InsertTextureMips(TArray<StagedPakItem>& Staged, u64 ContentHash, TextureDescription TexDesc, const u8* Chain)
+{
+	u64 NumMips = (TexDesc.Value >> 8) & 0xf;
+	u64 Log2OfSize = (TexDesc.Value >> 4) & 0xf;
+	CHECK(NumMips == Log2OfSize + 1);
+
+	u32 Size = GetTextureSize(TexDesc);
+
+	u32 BytesPerBlock = BitsPerPixel((DXGI_FORMAT)GetTextureFormat(TexDesc)) * 2;
+
+	u32 NumBlocks = std::max<u32>(Size / 4, 1);
+	u64 Pitch = NumBlocks * BytesPerBlock;
+	Pitch = AlignUp(Pitch, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+
+	// every mip under the placement alignment is padded up to it, which outgrows the rest for tiny textures
+	String WorkingMemory(NumBlocks * Pitch * 3 + NumMips * D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, '\0');
+
+	const u8* Src = Chain;
+	u64 Offset = 0;
+	bool InsertSeparateMip = true;
+	u64 PackedMipsBytes = 0;
+
+	u8* Dest = (u8*)WorkingMemory.data();
+	for (int Mip = 0; Mip < NumMips; ++Mip)
+	{
+		NumBlocks = std::max<u32>(Size / 4, 1);
+		Pitch = NumBlocks * BytesPerBlock;
+
+		if (InsertSeparateMip && NumBlocks * Pitch < 64_kb)
+		{
+			InsertSeparateMip = false;
+			Dest = (u8*)WorkingMemory.data();
+		}
+
+		if (Pitch >= D3D12_TEXTURE_DATA_PITCH_ALIGNMENT)
+		{
+			if (InsertSeparateMip)
+			{
+				StageIntoPak(
+					Staged,
+					GetTextureMipItemName(ContentHash, Mip),
+					RawDataView(Src, NumBlocks * Pitch),
+					TexDesc.Value,
+					true
+				);
+			}
+			else
+			{
+				memcpy(Dest, Src, NumBlocks * Pitch);
+				Dest += NumBlocks * Pitch;
+				PackedMipsBytes += NumBlocks * Pitch;
+			}
+
+			Size /= 2;
+			Src += NumBlocks * Pitch;
+			Offset += NumBlocks * Pitch;
+
+			continue;
+		}
+
+		Pitch = AlignUp(Pitch, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+
+		for (int Line = 0; Line < NumBlocks; Line++)
+		{
+			memcpy(Dest, Src, NumBlocks * BytesPerBlock);
+			Src += NumBlocks * BytesPerBlock;
+			Dest += Pitch;
+		}
+
+		if (InsertSeparateMip)
+		{
+			StageIntoPak(
+				Staged,
+				GetTextureMipItemName(ContentHash, Mip),
+				RawDataView((u8*)WorkingMemory.data(), Dest - (u8*)WorkingMemory.data()),
+				TexDesc.Value,
+				true
+			);
+			if (Pitch * NumBlocks < 64_kb)
+			{
+				InsertSeparateMip = false;
+				Dest = (u8 *)WorkingMemory.data();
+			}
+		}
+		else
+		{
+			PackedMipsBytes += Pitch * NumBlocks;
+		}
+
+		Offset += Pitch * NumBlocks;
+		if (Pitch * NumBlocks < D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT && Mip != NumMips - 1)
+		{
+			Dest += D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - Pitch * NumBlocks;
+			Offset += Pitch;
+		}
+		Size /= 2;
+	}
+
+	CHECK(Size == 0);
+
+	StageIntoPak(
+		Staged,
+		GetTextureItemName(ContentHash),
+		RawDataView((u8*)WorkingMemory.data(), Dest - (u8*)WorkingMemory.data()),
+		TexDesc.Value,
+		true
+	);
+}
+
+// Encoded image file to a square power of two mip chain in block compressed format
+void CookTextureImage(TArray<StagedPakItem>& Staged, u64 ContentHash, RawDataView Image, const TextureSettings& Settings, bool SRGB)
+{
+	ZoneScoped;
+	int Channels = 0, w = 0, h = 0;
+	u8* Data = stbi_load_from_memory(Image.data(), int(Image.size()), &w, &h, &Channels, 4);
+	CHECK(Data, "Couldn't decode a texture");
+
+	// descriptions only have room for square power of two sizes, anything else is resampled up to one
+	u32 Size = eastl::max(w, h);
+	u32 Log2OfSize = Size > 1 ? 32 - _lzcnt_u32(Size - 1) : 0;
+	CHECK(Log2OfSize < 15, "Mip count has to fit the description");
+	Size = 1 << Log2OfSize;
+
+	const u8* Pixels = Data;
+	String Resampled;
+	if (u32(w) != Size || u32(h) != Size)
+	{
+		Resampled.resize(u64(Size) * Size * 4);
+		stbir_resize_uint8(Data, w, h, 0, (u8*)Resampled.data(), Size, Size, 0, 4);
+		Pixels = (const u8*)Resampled.data();
+	}
+
+	u8 Format = TextureEncodeBC1;
+	if (Settings.UseBC7)
+	{
+		Format = TextureEncodeBC7;
+	}
+	else if (!IsImageOpaque(Pixels, u64(Size) * Size))
+	{
+		Format = TextureEncodeBC3;
+	}
+
+	// materials only ever repeat their textures, so filters wrap around the edges
+	u32 MipCount = Log2OfSize + 1;
+	String Mips(GetMipChainSize(Size, Size, MipCount), '\0');
+	GenerateMipChain((u8*)Mips.data(), Pixels, Size, Size, MipCount, (u8)Settings.MipFilter, SRGB, true);
+	stbi_image_free(Data);
+
+	String CompressedData(GetEncodedMipChainSize(Format, Size, Size, MipCount), '\0');
+	EncodeMipChain((u8*)CompressedData.data(), (const u8*)Mips.data(), Size, Size, MipCount, Format, (u8)Settings.Quality);
+
+	TextureDescription Desc;
+	Desc.Value = Format; // encode formats share the description's format values
+	Desc.Value |= Log2OfSize << 4; // size
+	Desc.Value |= MipCount << 8; // mip count
+	InsertTextureMips(Staged, ContentHash, Desc, (const u8*)CompressedData.data());
+}
+
+// "lods <count>" and "lod_reduction <ratio>" on the command line, part of the scenes' cook keys
+struct LodSettings
+{
+	u32   Count = 4;
+	float Reduction = 0.5f; // share of the previous LOD's triangles the next one aims for
+};
+
+// Appends the LODs to Indices, each one simplified from the full mesh so errors don't pile up.
+// The chain ends early once simplification can't get meaningfully further.
+void GenerateLods(TArray<u32>& Indices, MeshDescription& Description, const Vec3* Positions, const LodSettings& Settings)
+{
+	ZoneScoped;
+
+	u32 FullIndexCount = Description.IndexCount;
+	Description.LodCount = 1;
+	Description.Lods[0] = MeshLod{ 0, FullIndexCount, 0.f };
+
+	TArray<u32> Simplified(FullIndexCount);
+	u32 LodCount = eastl::min<u32>(Settings.Count, MESH_MAX_LODS);
+	for (u32 Lod = 1; Lod < LodCount; ++Lod)
+	{
+		const MeshLod& Previous = Description.Lods[Lod - 1];
+		u64 TargetIndexCount = u64(Previous.IndexCount * Settings.Reduction) / 3 * 3;
+
+		float Error = 0.f;
+		u64 IndexCount = SimplifyMesh(Simplified.data(), Indices.data(), FullIndexCount, Positions, Description.VertexCount, TargetIndexCount, Error);
+		if (IndexCount == 0 || IndexCount > Previous.IndexCount * 0.9f)
+		{
+			break;
+		}
+		OptimizeVertexCache(Simplified.data(), IndexCount, Description.VertexCount);
+
+		MeshLod& Result = Description.Lods[Description.LodCount++];
+		Result = MeshLod{ u32(Indices.size()), u32(IndexCount), eastl::max(Error, Previous.Error) };
+		Indices.insert(Indices.end(), Simplified.begin(), Simplified.begin() + IndexCount);
+	}
+}
+
+void UploadIndexData(u8* CpuPtr, const TArray<u32>& Indices, const MeshDescription& Description)
+{
+	bool b16BitIndeces = HasShortIndices(Description);
+	if (b16BitIndeces)
+	{
+		for (u32 Index : Indices)
+		{
+			WriteAndAdvance(CpuPtr, (uint16_t)Index);
+		}
+	}
+	else
+	{
+		for (u32 Index : Indices)
+		{
+			WriteAndAdvance(CpuPtr, Index);
+		}
+	}
+}
+
+namespace
+{
+	Color4 AiColorToColor(aiColor4D In)
+	{
+		return Color4{
+			(u8)(In.r * UINT8_MAX),
+			(u8)(In.g * UINT8_MAX),
+			(u8)(In.b * UINT8_MAX),
+			(u8)(In.a * UINT8_MAX),
+		};
+	}
+}
+
+// largest difference between what was written and the source data, measured by decoding it back
+struct QuantizationError
+{
+	float Position;
+	float NormalDegrees;
+	float TangentDegrees;
+	float UV;
+};
+
+// atan2 of the cross and dot products, acos loses everything under a few hundredths of a degree
+float AngleInDegrees(Vec3 Decoded, const aiVector3D& Original)
+{
+	aiVector3D Cross = aiVector3D(Decoded.x, Decoded.y, Decoded.z) ^ Original;
+	float Cosine = Decoded.x * Original.x + Decoded.y * Original.y + Decoded.z * Original.z;
+	return atan2f(Cross.Length(), Cosine) * (180.f / 3.14159265f);
+}
+
+QuantizationError UploadMeshData(u8* CpuPtr, aiMesh* Mesh, const TArray<u32>& VertexOrder, const MeshDescription& Description)
+{
+	ZoneScoped;
+
+	QuantizationError Error{};
+
+	Vec3 Min = Description.BoxMin;
+	Vec3 Extent = Description.BoxMax - Description.BoxMin;
+	Vec2 UVMin = Description.UVMin;
+	Vec2 UVScale = Description.UVScale;
+
+	bool PositionPacked = Description.Flags & MeshFlags::PositionPacked;
+	bool UVPacked = Description.Flags & MeshFlags::UVPacked;
+
+	for (UINT i : VertexOrder)
+	{
+		const aiVector3D& Position = Mesh->mVertices[i];
+		if (PositionPacked)
+		{
+			u16 Packed[4] = {
+				QuantizeUnorm16(Position.x, Min.x, Extent.x),
+				QuantizeUnorm16(Position.y, Min.y, Extent.y),
+				QuantizeUnorm16(Position.z, Min.z, Extent.z),
+				UINT16_MAX,
+			};
+			WriteAndAdvance(CpuPtr, Packed);
+
+			Vec3 Difference{
+				Min.x + Packed[0] * Extent.x / UINT16_MAX - Position.x,
+				Min.y + Packed[1] * Extent.y / UINT16_MAX - Position.y,
+				Min.z + Packed[2] * Extent.z / UINT16_MAX - Position.z,
+			};
+			Error.Position = fmaxf(Error.Position, sqrtf(Dot(Difference, Difference)));
+		}
+		else
+		{
+			WriteAndAdvance(CpuPtr, Position);
+		}
+
+		if (Description.Flags & MeshFlags::HasNormals)
+		{
+			const aiVector3D& Normal = Mesh->mNormals[i];
+			if (PositionPacked)
+			{
+				u32 Packed = EncodeOctahedral(Vec3{ Normal.x, Normal.y, Normal.z });
+				WriteAndAdvance(CpuPtr, Packed);
+				Error.NormalDegrees = fmaxf(Error.NormalDegrees, AngleInDegrees(DecodeOctahedral(Packed), Normal));
+			}
+			else
+			{
+				WriteAndAdvance(CpuPtr,
+					Vec4PackUnorm(
+						Clamp(Normal.x * 0.5f + 0.5f, 0.f, 1.f),
+						Clamp(Normal.y * 0.5f + 0.5f, 0.f, 1.f),
+						Clamp(Normal.z * 0.5f + 0.5f, 0.f, 1.f),
+						1.0f
+					)
+				);
+			}
+		}
+
+		if (Description.Flags & MeshFlags::HasTangents)
+		{
+			const aiVector3D& Normal = Mesh->mNormals[i];
+			const aiVector3D& Tangent = Mesh->mTangents[i];
+
+			// handedness goes into the lowest bit, a rounding step the angle error below includes
+			u32 Packed = EncodeOctahedral(Vec3{ Tangent.x, Tangent.y, Tangent.z });
+			u32 Handedness = ((Tangent ^ Normal) * Mesh->mBitangents[i]) > 0.f ? 1 : 0;
+			Packed = (Packed & ~(1u << 16)) | (Handedness << 16);
+			WriteAndAdvance(CpuPtr, Packed);
+			Error.TangentDegrees = fmaxf(Error.TangentDegrees, AngleInDegrees(DecodeOctahedral(Packed), Tangent));
+		}
+
+		if (Description.Flags & MeshFlags::HasUV0)
+		{
+			const aiVector3D& UV = Mesh->mTextureCoords[0][i];
+			Vec2 Decoded;
+			if (UVPacked)
+			{
+				u16 Packed[2] = {
+					QuantizeUnorm16(UV.x, UVMin.x, UVScale.x),
+					QuantizeUnorm16(UV.y, UVMin.y, UVScale.y),
+				};
+				WriteAndAdvance(CpuPtr, Packed);
+				Decoded = Vec2{ UVMin.x + Packed[0] * UVScale.x / UINT16_MAX, UVMin.y + Packed[1] * UVScale.y / UINT16_MAX };
+			}
+			else
+			{
+				Vec2h Packed{ half(UV.x), half(UV.y) };
+				WriteAndAdvance(CpuPtr, Packed);
+				Decoded = Vec2{ float(Packed.x), float(Packed.y) };
+			}
+			Error.UV = fmaxf(Error.UV, fmaxf(fabsf(Decoded.x - UV.x), fabsf(Decoded.y - UV.y)));
+		}
+
+		if (Description.Flags & MeshFlags::HasVertexColor)
+		{
+			WriteAndAdvance(CpuPtr, AiColorToColor(Mesh->mColors[0][i]));
+		}
+	}
+	return Error;
+}
+
+// "cook_memory_budget <MB>" on the command line. Only as many scenes and textures cook at once as their
+// estimates fit in the budget, scenes write their meshes out a batch at a time to files next to the pak and
+// cooked textures wait for textures.pak in small paks of their own. Output is the same, so it's no part of any key.
+struct StreamingSettings
+{
+	u64 Budget = 0;              // 0 keeps everything in memory until it's committed
+	u64 BatchBytes = UINT64_MAX; // estimated cooked mesh bytes a scene holds at once, twice that at most
+};
+
+// Texture a scene references, Index is the embedded texture's or the external file's number in the scene
+struct SceneTexture
+{
+	u32    Index;
+	bool   Embedded;
+	String Image;       // copy of the embedded image file, the scene can be gone by the time it's cooked
+	String Path;        // external file
+	bool   SRGB;
+	u64    ContentHash; // GetTextureContentHash, names its items in textures.pak
+};
+
+// Textures of every scene in the cook, stored once in textures.pak no matter how many scenes use them.
+// The first scene to ask for a hash cooks it, a texture the last textures.pak has is copied over instead.
+struct SharedTexture
+{
+	JobID                 Job = InvalidJob; // cooks it, InvalidJob when it's copied from the last textures.pak
+	u32                   Users = 0;        // scenes that reference it
+	TArray<StagedPakItem> Items;
+	String                SpillPath;        // streaming cooks keep the items in a pak of their own instead
+	TArray<String>        ItemNames;
+	u64                   SpilledBytes = 0;
+};
+
+struct SharedTextureStore
+{
+	MovableMutex              Lock;
+	TMap<u64, TArray<String>> Previous; // item names of every texture the last textures.pak has
+	TMap<u64, SharedTexture>  Textures; // everything a scene of this cook uses, map nodes don't move
+};
+
+// Everything a mesh's job produces, kept until its batch is written into the scene's buffers
+struct CookedMesh
+{
+	MeshDescription   Description;
+	OptimizedMesh     Optimized;
+	SceneMeshlets     Meshlets;
+	String            Vertices;
+	String            Indices;
+	QuantizationError Error;
+	u64               UnpackedVertexBytes;
+	String            Report;
+};
+
+// Scene's vertex and index buffers, meshes are appended in order as their batches get written.
+// Streaming cooks append to files next to the pak, the commit maps them. PakCodecGeometry streams
+// are encoded a mesh at a time on the way.
+struct SceneGeometry
+{
+	MeshBufferOffsets         Offset{ 0,0 };  // where the next mesh goes
+	TArray<MeshBufferOffsets> BufferOffsets;
+	TArray<MeshDescription>   MeshDatas;
+	SceneMeshlets             Meshlets;
+
+	String                    Vertices;
+	String                    Indices;
+	FILE*                     VerticesFile = nullptr;
+	FILE*                     IndicesFile = nullptr;
+	String                    EncodedVertices;
+	String                    EncodedIndices;
+	u64                       EncodedVerticesEnd = 0; // end of the last mesh in the encoded streams
+	u64                       EncodedIndicesEnd = 0;
+
+	eastl::bitset<256>        CombinationsPresent;
+	QuantizationError         Error{};
+	u64                       UnpackedVertexBytes = 0;
+	double                    MissesBefore = 0, MissesAfter = 0, Triangles = 0;
+	String                    Report;
+};
+
+// One scene's cook, shared by its jobs: import -> batches of mesh jobs, each written out by a job of its own -> commit into the pak
+struct SceneCook
+{
+	String               PakPath;
+	u64                  CookSalt;
+	TArray<String>       Dependencies;
+
+	bool                 MeshReport;
+	LodSettings          Lods;
+	QuantizationSettings Quantization;
+	u32                  GeometryCodec;
+	TextureSettings      Textures;
+	StreamingSettings    Streaming;
+	u64                  ReservedBytes; // job graph memory the scene holds until it's committed
+
+	Assimp::Importer     Importer;
+	const aiScene*       Scene;
+	PakFileWriter        Pak;
+
+	TArray<SceneTexture> SceneTextures;
+	TArray<CookedMesh>   Meshes;
+	SceneGeometry        Geometry;
+};
+
+// Source bytes, settings and color space, textures that hash the same cook to the same thing in every scene
+u64 GetTextureContentHash(const SceneTexture& Texture, const TextureSettings& Settings)
+{
+	u64 Source = 0;
+	if (Texture.Embedded)
+	{
+		Source = HashData64(Texture.Image.data(), Texture.Image.size(), 0);
+	}
+	else
+	{
+		Source = HashFileForCook(Texture.Path);
+	}
+
+	u64 Result = HashData64(&Source, sizeof(Source), OVEN_COOK_VERSION);
+	Result = HashData64(&Settings, sizeof(Settings), Result);
+	return HashData64(&Texture.SRGB, sizeof(Texture.SRGB), Result);
+}
+
+void CookSceneTexture(const SceneTexture& Texture, const TextureSettings& Settings, TArray<StagedPakItem>& Items)
+{
+	ZoneScoped;
+	if (Texture.Embedded)
+	{
+		CookTextureImage(Items, Texture.ContentHash, RawDataView((const u8*)Texture.Image.data(), Texture.Image.size()), Settings, Texture.SRGB);
+		return;
+	}
+
+	FileMapping File = MapFile(Texture.Path);
+	RawDataView View = GetView(File);
+	if (View.empty())
+	{
+		DEBUG_BREAK();
+		return;
+	}
+
+	// DDS files come with their own chain, any other image gets one cooked like the embedded ones
+	if (View.size() >= 4 && memcmp(View.data(), "DDS ", 4) == 0)
+	{
+		const u8* Data = View.data();
+		TextureDescription TexDesc = AdvanceToDataAndGetDescription(Data);
+		InsertTextureMips(Items, Texture.ContentHash, TexDesc, Data);
+	}
+	else
+	{
+		CookTextureImage(Items, Texture.ContentHash, View, Settings, Texture.SRGB);
+	}
+	UnmapFile(File);
+}
+
+// Decoded image, its mips in float and the encoded chain, roughly. DDS files only get copied around.
+u64 EstimateTextureCookBytes(const SceneTexture& Texture)
+{
+	int w = 0, h = 0, Channels = 0;
+	if (Texture.Embedded)
+	{
+		stbi_info_from_memory((const u8*)Texture.Image.data(), int(Texture.Image.size()), &w, &h, &Channels);
+	}
+	else
+	{
+		std::error_code Error;
+		u64 FileSize = std::filesystem::file_size(Texture.Path.c_str(), Error);
+		if (Error || !stbi_info(Texture.Path.c_str(), &w, &h, &Channels))
+		{
+			return Error ? 0 : FileSize * 2;
+		}
+	}
+	u64 Size = eastl::max(w, h);
+	return Size * Size * 48;
+}
+
+// Cooked items go to a pak of their own right away, the commit copies them into textures.pak as stored
+void SpillSharedTexture(SharedTexture& Texture, u64 ContentHash)
+{
+	ZoneScoped;
+	Texture.SpillPath = StringFromFormat("%s.%016llx.tmp", OVEN_SHARED_TEXTURES_PATH, ContentHash);
+	PakFileWriter Pak = CreatePak(Texture.SpillPath, true);
+	for (const StagedPakItem& Item : Texture.Items)
+	{
+		InsertIntoPak(Pak, Item.Name, Item.Data, Item.PrivateFlags, Item.UseDirectStorage);
+		Texture.ItemNames.push_back(Item.Name);
+		Texture.SpilledBytes += Item.Data.size();
+	}
+	FinalizePak(Pak);
+	Texture.Items = TArray<StagedPakItem>();
+}
+
+// Job that cooks the texture, InvalidJob if an earlier scene asked for it already or the last textures.pak has it.
+// Streaming cooks make it wait for its estimate to fit in the budget, given back once it's spilled.
+JobID RequestSharedTexture(JobGraph& Graph, SharedTextureStore& Store, const SceneTexture& Texture, const TextureSettings& Settings, const StreamingSettings& Streaming, StringView JobName)
+{
+	ScopedMovableLock AutoLock(Store.Lock);
+	bool Requested = Store.Textures.find(Texture.ContentHash) != Store.Textures.end();
+	SharedTexture& Shared = Store.Textures[Texture.ContentHash];
+	Shared.Users++;
+	if (Requested || Store.Previous.find(Texture.ContentHash) != Store.Previous.end())
+	{
+		return InvalidJob;
+	}
+
+	SharedTexture* Result = &Shared;
+	if (Streaming.Budget == 0)
+	{
+		Shared.Job = AddJob(Graph, JobName, [Texture, Settings, Result]() { CookSceneTexture(Texture, Settings, Result->Items); });
+		return Shared.Job;
+	}
+
+	u64 Cost = EstimateTextureCookBytes(Texture);
+	JobGraph* Jobs = &Graph;
+	Shared.Job = AddJob(Graph, JobName, [Texture, Settings, Result, Jobs, Cost]() {
+		CookSceneTexture(Texture, Settings, Result->Items);
+		SpillSharedTexture(*Result, Texture.ContentHash);
+		ReleaseJobMemory(*Jobs, Cost);
+	}, {}, Cost);
+	return Shared.Job;
+}
+
+// Scene that is up to date keeps its textures in the new textures.pak, false if the last one lost any of them
+bool KeepSharedTextures(SharedTextureStore& Store, StringView ScenePakPath)
+{
+	ZoneScoped;
+	PakFileReader ScenePak = OpenPak(ScenePakPath, MapFileSequential);
+	const PakItem* Item = FindItem(ScenePak, "___SceneTextures");
+	TArray<u64> Hashes = Item ? GetFileDataTypedArray<u64>(ScenePak, *Item) : TArray<u64>();
+	ClosePak(ScenePak);
+	if (!Item)
+	{
+		return false;
+	}
+
+	ScopedMovableLock AutoLock(Store.Lock);
+	for (u64 Hash : Hashes)
+	{
+		if (Hash && Store.Previous.find(Hash) == Store.Previous.end())
+		{
+			return false;
+		}
+	}
+	for (u64 Hash : Hashes)
+	{
+		if (Hash)
+		{
+			Store.Textures[Hash].Users++;
+		}
+	}
+	return true;
+}
+
+// Hashes and item names of what the last cook put in textures.pak
+void LoadPreviousSharedTextures(SharedTextureStore& Store)
+{
+	ZoneScoped;
+	std::error_code Error;
+	if (!std::filesystem::exists(OVEN_SHARED_TEXTURES_PATH, Error))
+	{
+		return;
+	}
+
+	PakFileReader Pak = OpenPak(OVEN_SHARED_TEXTURES_PATH, MapFileSequential);
+	for (const PakItem& Item : GetItems(Pak))
+	{
+		String Name(GetFileName(Pak, Item));
+		u64 Hash = 0;
+		if (sscanf(Name.c_str(), "___Texture_%16llx", &Hash) == 1)
+		{
+			Store.Previous[Hash].push_back(Name);
+		}
+	}
+	ClosePak(Pak);
+}
+
+// Last job of the cook: textures nobody uses anymore are dropped, the rest is copied or inserted sorted by hash,
+// so the file doesn't depend on which scene got to a texture first. Written next to the old one and renamed over it.
+void CommitSharedTextures(SharedTextureStore& Store)
+{
+	ZoneScoped;
+	TArray<String> Copied;
+	TArray<SharedTexture*> Cooked;
+	u64 References = 0;
+	for (auto& [Hash, Texture] : Store.Textures)
+	{
+		References += Texture.Users;
+		if (Texture.Job == InvalidJob)
+		{
+			const TArray<String>& Names = Store.Previous[Hash];
+			Copied.insert(Copied.end(), Names.begin(), Names.end());
+		}
+		else
+		{
+			Cooked.push_back(&Texture);
+		}
+	}
+
+	std::error_code Error;
+	if (Cooked.empty() && Store.Textures.size() == Store.Previous.size() && std::filesystem::exists(OVEN_SHARED_TEXTURES_PATH, Error))
+	{
+		return;
+	}
+
+	String TempPath = OVEN_SHARED_TEXTURES_PATH ".tmp";
+	PakFileWriter Pak = CreatePak(TempPath, true);
+	CopyPakItems(Pak, OVEN_SHARED_TEXTURES_PATH, Copied);
+	u64 CookedBytes = 0;
+	for (SharedTexture* Texture : Cooked)
+	{
+		if (!Texture->SpillPath.empty())
+		{
+			CookedBytes += Texture->SpilledBytes;
+			CopyPakItems(Pak, Texture->SpillPath, Texture->ItemNames);
+			std::filesystem::remove(Texture->SpillPath.c_str(), Error);
+			std::filesystem::remove((Texture->SpillPath + "ds").c_str(), Error);
+			continue;
+		}
+		for (const StagedPakItem& Item : Texture->Items)
+		{
+			CookedBytes += Item.Data.size();
+			InsertIntoPak(Pak, Item.Name, Item.Data, Item.PrivateFlags, Item.UseDirectStorage);
+		}
+		Texture->Items = TArray<StagedPakItem>();
+	}
+	FinalizePak(Pak);
+
+	std::filesystem::rename(TempPath.c_str(), OVEN_SHARED_TEXTURES_PATH, Error);
+	CHECK(!Error, "Couldn't replace textures.pak");
+	std::filesystem::rename((TempPath + "ds").c_str(), OVEN_SHARED_TEXTURES_PATH "ds", Error);
+	CHECK(!Error, "Couldn't replace textures.pakds");
+
+	printf("%s: %llu textures for %llu scene references, %llu cooked (%.1f MB), %llu kept from the last cook\n",
+		OVEN_SHARED_TEXTURES_PATH, (u64)Store.Textures.size(), References,
+		(u64)Cooked.size(), CookedBytes / (1024.0 * 1024.0), (u64)(Store.Textures.size() - Cooked.size()));
+}
+
+// Optimized, split into meshlets, LODs appended and written out in the mesh's vertex format
+void CookSceneMesh(SceneCook& Cook, u64 MeshIndex)
+{
+	ZoneScoped;
+	aiMesh* Mesh = Cook.Scene->mMeshes[MeshIndex];
+	CookedMesh& Result = Cook.Meshes[MeshIndex];
+	MeshDescription& Description = Result.Description;
+
+	// tangents only matter to materials that have a normal map
+	aiMaterial* Material = Cook.Scene->mMaterials[Mesh->mMaterialIndex];
+	bool NeedsTangents = Material->GetTextureCount(aiTextureType_NORMALS) + Material->GetTextureCount(aiTextureType_NORMAL_CAMERA) > 0;
+	Description = ExtractMeshDescription(Mesh, NeedsTangents, Cook.Quantization);
+
+	Result.Optimized = OptimizeMesh(Mesh);
+	Description.VertexCount = (u32)Result.Optimized.VertexOrder.size();
+
+	// meshlets index the optimized vertices, same numbering as the vertex buffer
+	TArray<Vec3> Positions(Description.VertexCount);
+	for (u32 v = 0; v < Description.VertexCount; ++v)
+	{
+		const aiVector3D& Position = Mesh->mVertices[Result.Optimized.VertexOrder[v]];
+		Positions[v] = Vec3{ Position.x, Position.y, Position.z };
+	}
+	BuildMeshlets(Result.Meshlets, Result.Optimized.Indices.data(), Result.Optimized.Indices.size(), Positions.data(), Description.VertexCount);
+	GenerateLods(Result.Optimized.Indices, Description, Positions.data(), Cook.Lods);
+
+	Result.Vertices.resize(GetVertexBufferSize(Description));
+	Result.Indices.resize(GetIndexBufferSize(Description));
+	Result.Error = UploadMeshData((u8*)Result.Vertices.data(), Mesh, Result.Optimized.VertexOrder, Description);
+	UploadIndexData((u8*)Result.Indices.data(), Result.Optimized.Indices, Description);
+
+	QuantizationSettings Unpacked;
+	Unpacked.Enabled = 0;
+	Result.UnpackedVertexBytes = u64(ExtractMeshDescription(Mesh, Description.Flags & MeshFlags::HasTangents, Unpacked).VertexSize) * Description.VertexCount;
+
+	if (Cook.MeshReport)
+	{
+		Result.Report += StringFromFormat("    %-40s %8u tris  ACMR %.3f -> %.3f  ATVR %.3f -> %.3f\n",
+			Mesh->mName.C_Str(), Mesh->mNumFaces,
+			Result.Optimized.Before.ACMR, Result.Optimized.After.ACMR,
+			Result.Optimized.Before.ATVR, Result.Optimized.After.ATVR);
+		for (u32 Lod = 1; Lod < Description.LodCount; ++Lod)
+		{
+			Result.Report += StringFromFormat("        LOD%u %8u tris  error %g\n",
+				Lod, Description.Lods[Lod].IndexCount / 3, Description.Lods[Lod].Error);
+		}
+		Result.Report += StringFromFormat("        %2u bytes/vertex%s%s  error: position %g, normal %.3f deg, tangent %.3f deg, uv %g\n",
+			Description.VertexSize,
+			(Description.Flags & MeshFlags::PositionPacked) ? " packed" : "",
+			(Description.Flags & MeshFlags::UVPacked) ? " packed_uv" : "",
+			Result.Error.Position, Result.Error.NormalDegrees, Result.Error.TangentDegrees, Result.Error.UV);
+	}
+}
+
+// Bytes Assimp holds for the scene's meshes and embedded textures, most of what an imported scene keeps in memory
+u64 GetImportedSceneBytes(const aiScene* Scene)
+{
+	u64 Result = 0;
+	for (u32 i = 0; i < Scene->mNumMeshes; ++i)
+	{
+		const aiMesh* Mesh = Scene->mMeshes[i];
+		u64 VertexBytes = sizeof(aiVector3D) * (1 + Mesh->HasNormals() + 2 * Mesh->HasTangentsAndBitangents());
+		VertexBytes += sizeof(aiColor4D) * Mesh->GetNumColorChannels() + sizeof(aiVector3D) * Mesh->GetNumUVChannels();
+		Result += VertexBytes * Mesh->mNumVertices + (sizeof(aiFace) + 3 * sizeof(u32)) * u64(Mesh->mNumFaces);
+	}
+	for (u32 i = 0; i < Scene->mNumTextures; ++i)
+	{
+		const aiTexture* Texture = Scene->mTextures[i];
+		Result += Texture->mHeight ? u64(Texture->mWidth) * Texture->mHeight * sizeof(aiTexel) : Texture->mWidth;
+	}
+	return Result;
+}
+
+// Vertices, indices with their LODs, meshlets and what the optimizer works with, roughly
+u64 EstimateCookedMeshBytes(const aiMesh* Mesh)
+{
+	return u64(Mesh->mNumVertices) * 64 + u64(Mesh->mNumFaces) * 48;
+}
+
+// Once a mesh is written out the scene only needs its name and face count
+void FreeMeshSourceData(aiMesh* Mesh)
+{
+	delete[] Mesh->mVertices;
+	delete[] Mesh->mNormals;
+	delete[] Mesh->mTangents;
+	delete[] Mesh->mBitangents;
+	delete[] Mesh->mFaces;
+	Mesh->mVertices = Mesh->mNormals = Mesh->mTangents = Mesh->mBitangents = nullptr;
+	Mesh->mFaces = nullptr;
+	for (u32 i = 0; i < AI_MAX_NUMBER_OF_COLOR_SETS; ++i)
+	{
+		delete[] Mesh->mColors[i];
+		Mesh->mColors[i] = nullptr;
+	}
+	for (u32 i = 0; i < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++i)
+	{
+		delete[] Mesh->mTextureCoords[i];
+		Mesh->mTextureCoords[i] = nullptr;
+	}
+}
+
+// PakCodecGeometry streams for ___Scene_Vertices and ___Scene_Indeces grow a mesh at a time: a raw chunk for
+// the padding since the previous mesh, then a chunk for the mesh. Triangles are rotated in place to the order
+// they decode in, so the indices that get written are byte for byte what the item decodes to.
+void EncodeSceneMesh(SceneGeometry& Geometry, const MeshDescription& Description, const MeshBufferOffsets& Offset, const String& Vertices, String& Indices)
+{
+	static const u8 Padding[4] = {};
+
+	EncodeRawGeometry(Geometry.EncodedVertices, RawDataView(Padding, Offset.VBufferOffset - Geometry.EncodedVerticesEnd));
+	EncodeVertexBuffer(Geometry.EncodedVertices, Vertices.data(), Description.VertexCount, Description.VertexSize);
+	Geometry.EncodedVerticesEnd = Offset.VBufferOffset + Vertices.size();
+
+	u32 IndexSize = HasShortIndices(Description) ? sizeof(u16) : sizeof(u32);
+	EncodeRawGeometry(Geometry.EncodedIndices, RawDataView(Padding, Offset.IBufferOffset - Geometry.EncodedIndicesEnd));
+	EncodeIndexBuffer(Geometry.EncodedIndices, Indices.data(), Indices.size() / IndexSize, IndexSize);
+	Geometry.EncodedIndicesEnd = Offset.IBufferOffset + Indices.size();
+}
+
+void AppendToSceneBuffer(String& Buffer, FILE* File, RawDataView Data)
+{
+	if (File)
+	{
+		size_t Written = fwrite(Data.data(), 1, Data.size(), File);
+		CHECK(Written == Data.size(), "Failed to stream out scene geometry");
+	}
+	else
+	{
+		Buffer.append((const char*)Data.data(), Data.size());
+	}
+}
+
+// Meshes [Begin, End) into the scene's buffers, right after the ones written before them.
+// Their cooked data and Assimp's copy of the source are freed, only descriptions and stats stay.
+void WriteSceneMeshes(SceneCook& Cook, u64 Begin, u64 End)
+{
+	ZoneScoped;
+	static const u8 Padding[4] = {};
+	SceneGeometry& Geometry = Cook.Geometry;
+	for (u64 i = Begin; i < End; ++i)
+	{
+		aiMesh* Mesh = Cook.Scene->mMeshes[i];
+		CookedMesh& Cooked = Cook.Meshes[i];
+		const MeshDescription& Description = Cooked.Description;
+
+		Geometry.MeshDatas.push_back(Description);
+		Geometry.BufferOffsets.push_back(Geometry.Offset);
+		AppendMeshlets(Geometry.Meshlets, Cooked.Meshlets);
+		CHECK(Cooked.Vertices.size() == GetVertexBufferSize(Description) && Cooked.Indices.size() == GetIndexBufferSize(Description));
 
-	return Result;
+		if (Cook.GeometryCodec)
+		{
+			EncodeSceneMesh(Geometry, Description, Geometry.Offset, Cooked.Vertices, Cooked.Indices);
+		}
+
+		// index buffers start 4 byte aligned
+		u32 IndicesEnd = Geometry.Offset.IBufferOffset + GetIndexBufferSize(Description);
+		u32 PaddingSize = AlignUp<u32>(IndicesEnd, 4) - IndicesEnd;
+		AppendToSceneBuffer(Geometry.Vertices, Geometry.VerticesFile, RawDataView((const u8*)Cooked.Vertices.data(), Cooked.Vertices.size()));
+		AppendToSceneBuffer(Geometry.Indices, Geometry.IndicesFile, RawDataView((const u8*)Cooked.Indices.data(), Cooked.Indices.size()));
+		AppendToSceneBuffer(Geometry.Indices, Geometry.IndicesFile, RawDataView(Padding, PaddingSize));
+		Geometry.Offset.VBufferOffset += GetVertexBufferSize(Description);
+		Geometry.Offset.IBufferOffset = IndicesEnd + PaddingSize;
+
+		Geometry.CombinationsPresent.set(Description.Flags, 1);
+		Geometry.MissesBefore += Cooked.Optimized.Before.ACMR * Mesh->mNumFaces;
+		Geometry.MissesAfter += Cooked.Optimized.After.ACMR * Mesh->mNumFaces;
+		Geometry.Triangles += Mesh->mNumFaces;
+		Geometry.UnpackedVertexBytes += Cooked.UnpackedVertexBytes;
+		Geometry.Error.Position = fmaxf(Geometry.Error.Position, Cooked.Error.Position);
+		Geometry.Error.NormalDegrees = fmaxf(Geometry.Error.NormalDegrees, Cooked.Error.NormalDegrees);
+		Geometry.Error.TangentDegrees = fmaxf(Geometry.Error.TangentDegrees, Cooked.Error.TangentDegrees);
+		Geometry.Error.UV = fmaxf(Geometry.Error.UV, Cooked.Error.UV);
+		Geometry.Report += Cooked.Report;
+
+		Cooked = CookedMesh();
+		FreeMeshSourceData(Mesh);
+	}
 }
 
-void UploadIndexData(u8* CpuPtr, aiMesh* Mesh)
+// Streamed buffers are read back through a mapping, empty ones don't have anything to map
+RawDataView GetSceneBuffer(const String& Buffer, FILE*& File, const String& Path, FileMapping& Mapping)
 {
-	bool b16BitIndeces = Mesh->mNumVertices <= UINT16_MAX;
-	if (b16BitIndeces)
+	if (!File)
 	{
-		for (UINT i = 0; i < Mesh->mNumFaces; ++i)
-		{
-			CHECK(Mesh->mFaces[i].mNumIndices == 3, "Not triangles?");
-			IVec3 Triangle = *(IVec3*)Mesh->mFaces[i].mIndices;
-			WriteAndAdvance(CpuPtr, (uint16_t)Triangle.x);
-			WriteAndAdvance(CpuPtr, (uint16_t)Triangle.y);
-			WriteAndAdvance(CpuPtr, (uint16_t)Triangle.z);
-		}
+		return RawDataView((const u8*)Buffer.data(), Buffer.size());
+	}
+	fclose(File);
+	File = nullptr;
+
+	std::error_code Error;
+	if (std::filesystem::file_size(Path.c_str(), Error) == 0 || Error)
+	{
+		return RawDataView(nullptr, 0);
+	}
+	Mapping = MapFile(Path, MapFileSequential);
+	CHECK(IsValid(Mapping), "Couldn't map streamed scene geometry");
+	return GetView(Mapping);
+}
+
+// Last job of a scene, its meshes are written already, the rest goes into the pak in scene order
+void CommitScene(SceneCook& Cook)
+{
+	ZoneScoped;
+	PakFileWriter& Pak = Cook.Pak;
+	SceneGeometry& Geometry = Cook.Geometry;
+	Cook.Meshes = TArray<CookedMesh>();
+
+	InsertIntoPak(Pak, "___Scene_BufferOffsets", ContainerToView(Geometry.BufferOffsets));
+
+	String VerticesPath = Cook.PakPath + ".vertices.tmp";
+	String IndicesPath = Cook.PakPath + ".indices.tmp";
+	FileMapping VerticesMapping{}, IndicesMapping{};
+	RawDataView Vertices = GetSceneBuffer(Geometry.Vertices, Geometry.VerticesFile, VerticesPath, VerticesMapping);
+	RawDataView Indices = GetSceneBuffer(Geometry.Indices, Geometry.IndicesFile, IndicesPath, IndicesMapping);
+	CHECK(Vertices.size() == Geometry.Offset.VBufferOffset && Indices.size() == Geometry.Offset.IBufferOffset);
+
+	// one printf per scene, scenes cook in parallel
+	double Triangles = Geometry.Triangles;
+	printf("%s: %.0f tris, ACMR %.3f -> %.3f, %llu meshlets\n"
+		"    vertices %.1f KB (%.1f KB unpacked), max error: position %g, normal %.3f deg, tangent %.3f deg, uv %g\n%s",
+		Cook.PakPath.c_str(), Triangles,
+		Triangles ? Geometry.MissesBefore / Triangles : 0.0,
+		Triangles ? Geometry.MissesAfter / Triangles : 0.0,
+		(u64)Geometry.Meshlets.Meshlets.size(),
+		Vertices.size() / 1024.0, Geometry.UnpackedVertexBytes / 1024.0,
+		Geometry.Error.Position, Geometry.Error.NormalDegrees, Geometry.Error.TangentDegrees, Geometry.Error.UV,
+		Geometry.Report.c_str());
+	InsertIntoPak(Pak, "___Scene_MeshDatas", ContainerToView(Geometry.MeshDatas));
+
+	if (Cook.GeometryCodec)
+	{
+		static const u8 Padding[4] = {};
+		EncodeRawGeometry(Geometry.EncodedVertices, RawDataView(Padding, Vertices.size() - Geometry.EncodedVerticesEnd));
+		EncodeRawGeometry(Geometry.EncodedIndices, RawDataView(Padding, Indices.size() - Geometry.EncodedIndicesEnd));
+		InsertEncodedIntoPak(Pak, "___Scene_Vertices", Vertices, Geometry.EncodedVertices, PakCodecGeometry);
+		InsertEncodedIntoPak(Pak, "___Scene_Indeces", Indices, Geometry.EncodedIndices, PakCodecGeometry);
 	}
 	else
 	{
-		for (UINT i = 0; i < Mesh->mNumFaces; ++i)
-		{
-			CHECK(Mesh->mFaces[i].mNumIndices == 3, "Not triangles?");
-			WriteAndAdvance(CpuPtr, *(IVec3*)Mesh->mFaces[i].mIndices);
-		}
+		InsertIntoPak(Pak, "___Scene_Vertices", Vertices, 0, true);
+		InsertIntoPak(Pak, "___Scene_Indeces", Indices, 0, true);
+	}
+
+	SceneMeshlets& Meshlets = Geometry.Meshlets;
+	InsertIntoPak(Pak, "___Scene_MeshletRanges", ContainerToView(Meshlets.Ranges));
+	InsertIntoPak(Pak, "___Scene_Meshlets", ContainerToView(Meshlets.Meshlets));
+	InsertIntoPak(Pak, "___Scene_MeshletBounds", ContainerToView(Meshlets.Bounds));
+	InsertIntoPak(Pak, "___Scene_MeshletVertices", ContainerToView(Meshlets.Vertices));
+	InsertIntoPak(Pak, "___Scene_MeshletTriangles", ContainerToView(Meshlets.Triangles));
+
+	RawDataView TmpMemory((const u8*)Geometry.CombinationsPresent.data(), Geometry.CombinationsPresent.size() / 8);
+	InsertIntoPak(Pak, "___VertexCombinationsMask", TmpMemory);
+
+	FinalizePak(Pak);
+	Cook.Importer.FreeScene();
+
+	if (Cook.Streaming.Budget != 0)
+	{
+		std::error_code Error;
+		UnmapFile(VerticesMapping);
+		UnmapFile(IndicesMapping);
+		std::filesystem::remove(VerticesPath.c_str(), Error);
+		std::filesystem::remove(IndicesPath.c_str(), Error);
 	}
+
+	RecordCook(Cook.PakPath, ComputeCookKey(Cook.Dependencies, Cook.CookSalt), Cook.Dependencies);
 }
 
-void UploadMeshData(u8* CpuPtr, aiMesh* Mesh, bool PositionPacked)
+// Shader compiled by its own job, the commit job inserts them in source order
+struct CompiledShader
 {
-	Vec3 Min = Vec3{
-		Mesh->mAABB.mMin.x,
-		Mesh->mAABB.mMin.y,
-		Mesh->mAABB.mMin.z,
-	};
-	Vec3 Max = Vec3{
-		Mesh->mAABB.mMax.x,
-		Mesh->mAABB.mMax.y,
-		Mesh->mAABB.mMax.z,
-	};
+	String Name;
+	String Data;
+	u32    Flags;
+};
 
-	Vec3 Extent = Max - Min;
+// Shaders that compile at once, sources and results live until the shaders pak is committed
+struct ShaderCook
+{
+	TArray<String>         Sources;
+	TArray<String>         Dependencies;
+	u64                    Key;
+	TArray<CompiledShader> Compiled;
+};
 
-	float Scale = (1.0f / float(INT16_MAX));
-	Vec3 ScaleVector = Vec3{Extent.x * Scale, Extent.y * Scale, Extent.z * Scale};
+// Bytecode comes from the cook cache as long as neither the shader nor any include changed
+void CompileShaderForPak(const String& FilePath, u64 IncludesKey, CompiledShader& Result)
+{
+	ZoneScoped;
+	StringView Name = FilePath;
+	Name.remove_prefix(Name.find_last_of("\\/") + 1);
+	Name.remove_suffix(5); // ".hlsl"
+	Result.Name = String(Name);
+
+	// compiled blob is the u32 pak flags followed by the bytecode
+	u64 ShaderKey = ComputeCookKey(TArray<String>{ FilePath }, IncludesKey);
+	String Cached;
+	if (LoadCookBlob(ShaderKey, Cached) && Cached.size() > sizeof(u32))
+	{
+		memcpy(&Result.Flags, Cached.data(), sizeof(u32));
+		Result.Data.assign(Cached.data() + sizeof(u32), Cached.size() - sizeof(u32));
+		return;
+	}
 
-	bool HasUsefulNormalData = Mesh->HasNormals();
-	bool HasUsefulColorData = ColorHasUsefulInfo(Mesh);
-	bool HasUsefulUVData = Mesh->HasTextureCoords(0);
+	String& Data = Result.Data;
+	u32& Flags = Result.Flags;
+	Flags = 0;
 
-	for (UINT i = 0; i < Mesh->mNumVertices; ++i)
+	TComPtr<ID3D12ShaderReflection> CSReflection;
+	TComPtr<IDxcBlob> CS = CompileShader(FilePath, "MainCS", CSReflection.GetAddressOf());
+	if (CS)
 	{
-		if (PositionPacked)
+		Data.assign((const char*)CS->GetBufferPointer(), CS->GetBufferSize());
+		Flags = 1u << 31;
+	}
+	else
+	{
+		TComPtr<ID3D12ShaderReflection> Reflections[2];
+		TComPtr<IDxcBlob> VS = CompileShader(FilePath, "MainVS", Reflections[0].GetAddressOf());
+		TComPtr<IDxcBlob> PS = CompileShader(FilePath, "MainPS", Reflections[1].GetAddressOf());
+
+		CHECK(VS && PS);
+		CHECK(VS->GetBufferSize() <= INT16_MAX);
+		CHECK(PS->GetBufferSize() <= UINT16_MAX);
+
+		ShaderReflectionData ReflectionData{};
+
+		for (int i = 0; i < 2; ++i)
 		{
-			u16 PackedColor = 0;
+			ID3D12ShaderReflection *R = Reflections[i].Get();
 
-			if (HasUsefulColorData)
+			D3D12_SHADER_DESC Desc;
+			R->GetDesc(&Desc);
+
+			ReflectionData.NumCBVs = Desc.ConstantBuffers;
+			for (int j = 0; j < Desc.BoundResources; ++j)
 			{
-				PackedColor = RGBto565(Mesh->mColors[0][i].r, Mesh->mColors[0][i].g, Mesh->mColors[0][i].b);
-			}
+				D3D12_SHADER_INPUT_BIND_DESC ResourceDesc;
+				R->GetResourceBindingDesc(j, &ResourceDesc);
 
-			Vec4 Normalized{
-				(Mesh->mVertices[i].x - Min.x) * ScaleVector.x,
-				(Mesh->mVertices[i].y - Min.y) * ScaleVector.y,
-				(Mesh->mVertices[i].z - Min.z) * ScaleVector.z,
-				0.f
-			};
-			Vec4PackShorts Packed = Vec4PackShorts(&Normalized.x);
-			Packed.w = i16(PackedColor);
-			WriteAndAdvance(CpuPtr, Packed);
-		}
-		else
-		{
-			WriteAndAdvance(CpuPtr, Mesh->mVertices[i]);
+				if (ResourceDesc.Type == D3D_SIT_CBUFFER)
+				{
+					D3D12_SHADER_BUFFER_DESC CBDesc{};
+					ID3D12ShaderReflectionConstantBuffer* CB = R->GetConstantBufferByIndex(ResourceDesc.BindPoint);
+					CB->GetDesc(&CBDesc);
+				}
+			}
 		}
 
-		if (HasUsefulNormalData)
-		{
-			WriteAndAdvance(CpuPtr,
-				Vec4PackUnorm(
-					Mesh->mNormals[i].x * 0.5f + 0.5f,
-					Mesh->mNormals[i].y * 0.5f + 0.5f,
-					Mesh->mNormals[i].z * 0.5f + 0.5f,
-					1.0f
-				)
-			);
-		}
+		Data.resize(VS->GetBufferSize() + PS->GetBufferSize());
 
-		if (HasUsefulUVData)
-		{
-			WriteAndAdvance(CpuPtr, Vec2h{
-				half(Mesh->mTextureCoords[0][i].x),
-				half(Mesh->mTextureCoords[0][i].y),
-			});
-		}
-	}
-}
-namespace
-{
-	Color4 AiColorToColor(aiColor4D In)
-	{
-		return Color4{
-			(u8)(In.r * UINT8_MAX),
-			(u8)(In.g * UINT8_MAX),
-			(u8)(In.b * UINT8_MAX),
-			(u8)(In.a * UINT8_MAX),
-		};
+		memcpy((u8*)Data.data(), VS->GetBufferPointer(), VS->GetBufferSize());
+		memcpy((u8*)Data.data() + VS->GetBufferSize(), PS->GetBufferPointer(), PS->GetBufferSize());
+
+		Flags = u32((VS->GetBufferSize() << 16) | PS->GetBufferSize());
 	}
+
+	String Blob((const char*)&Flags, sizeof(u32));
+	Blob.append(Data);
+	StoreCookBlob(ShaderKey, Blob);
 }
 
 struct ParsedArgs
@@ -316,6 +1342,32 @@ struct ParsedArgs
 		return false;
 	}
 
+	// value following the argument, "oven benchmark_codecs <file>"
+	StringView After(StringView Arg)
+	{
+		for (u64 i = 0; i + 1 < Text.size(); ++i)
+		{
+			if (Text[i] == Arg)
+			{
+				return Text[i + 1];
+			}
+		}
+		return StringView();
+	}
+
+	// every value following the argument, "oven verify <pak> <pak>"
+	TArray<StringView> AllAfter(StringView Arg)
+	{
+		for (u64 i = 0; i < Text.size(); ++i)
+		{
+			if (Text[i] == Arg)
+			{
+				return TArray<StringView>(Text.begin() + i + 1, Text.end());
+			}
+		}
+		return TArray<StringView>();
+	}
+
 	bool Empty()
 	{
 		return Text.empty();
@@ -331,17 +1383,79 @@ int main(int Argc, const char* Argv[])
 	StartWorkerThreads();
 
 	using recursive_directory_iterator = std::filesystem::recursive_directory_iterator;
-	TArray<TicketCPU> Tickets;
+	// cooking runs on the workers while the main thread goes through the rest of the commands
+	JobGraph Graph;
 
 	InitShaderCompiler();
 
 	InitDirectStorage();
 
+	if (!Args.Includes("no_cache"))
+	{
+		LoadCookCache("./cooked/.cache");
+	}
+
 	FrameMark;
 
 	if (Args.Empty() || Args.Includes("cook_content"))
 	{
 		ZoneScopedN("cook_content kickoff");
+		// ACMR/ATVR of every mesh before and after optimization, otherwise only the scene totals
+		bool MeshReport = Args.Includes("mesh_report");
+
+		LodSettings Lods;
+		if (StringView Count = Args.After("lods"); !Count.empty())
+		{
+			Lods.Count = (u32)strtoul(String(Count).c_str(), nullptr, 10);
+		}
+		if (StringView Reduction = Args.After("lod_reduction"); !Reduction.empty())
+		{
+			Lods.Reduction = strtof(String(Reduction).c_str(), nullptr);
+		}
+		CHECK(Lods.Count >= 1 && Lods.Reduction > 0.f && Lods.Reduction < 1.f, "lods has to be at least 1, lod_reduction between 0 and 1");
+
+		QuantizationSettings Quantization;
+		Quantization.Enabled = !Args.Includes("no_quantize");
+		if (StringView PositionError = Args.After("position_error"); !PositionError.empty())
+		{
+			Quantization.PositionError = strtof(String(PositionError).c_str(), nullptr);
+		}
+		if (StringView UVError = Args.After("uv_error"); !UVError.empty())
+		{
+			Quantization.UVError = strtof(String(UVError).c_str(), nullptr);
+		}
+		// "no_geometry_codec" keeps vertices and indices on GDeflate, so DirectStorage can decode them on the GPU
+		u32 GeometryCodec = !Args.Includes("no_geometry_codec");
+
+		TextureSettings Textures;
+		Textures.UseBC7 = Args.Includes("texture_bc7");
+		if (StringView Quality = Args.After("texture_quality"); !Quality.empty())
+		{
+			Textures.Quality = Quality == "fast" ? TextureQualityFast : Quality == "best" ? TextureQualityBest : TextureQualityNormal;
+		}
+		if (StringView Filter = Args.After("mip_filter"); !Filter.empty())
+		{
+			Textures.MipFilter = Filter == "box" ? MipFilterBox : Filter == "lanczos" ? MipFilterLanczos : MipFilterKaiser;
+		}
+
+		StreamingSettings Streaming;
+		if (StringView Budget = Args.After("cook_memory_budget"); !Budget.empty())
+		{
+			Streaming.Budget = strtoull(String(Budget).c_str(), nullptr, 10) * 1_mb;
+			CHECK(Streaming.Budget != 0, "cook_memory_budget is in MB and can't be 0");
+			// a scene holds two batches of cooked meshes, so a few scenes fit next to each other
+			Streaming.BatchBytes = eastl::max<u64>(Streaming.Budget / 8, 16_mb);
+			Graph.MemoryBudget = Streaming.Budget;
+		}
+
+		// freed by the textures.pak commit, the last job of the cook
+		SharedTextureStore* Store = new SharedTextureStore();
+		if (IsCookCacheEnabled())
+		{
+			LoadPreviousSharedTextures(*Store);
+		}
+
+		TArray<JobID> ImportJobs;
 		for (const auto& DirEntry : recursive_directory_iterator("./content/"))
 		{
 			if (!DirEntry.is_directory())
@@ -349,24 +1463,17 @@ int main(int Argc, const char* Argv[])
 				std::filesystem::path Extension = DirEntry.path().extension();
 				if (Extension == ".fbx" || Extension == ".glb")
 				{
-					Tickets.push_back() = EnqueueToWorkerWithTicket([DirEntry]()
+					// the import holds the scene until it's committed, a guess from the file size until the scene is parsed
+					u64 ImportBytes = 0;
+					if (Streaming.Budget != 0)
 					{
-						std::string FilePath = DirEntry.path().string();
-
-						Assimp::Importer Importer;
-
-						const aiScene* Scene = nullptr;
-						{
-							ZoneScopedN("Scene file parsing");
-							Scene = Importer.ReadFile(
-								FilePath.c_str(),
-								(unsigned int)(aiProcess_GenBoundingBoxes | aiProcess_ConvertToLeftHanded | aiProcessPreset_TargetRealtime_MaxQuality)
-							);
-							CHECK(Scene != nullptr, "Load failed");
+						ImportBytes = DirEntry.file_size() * 4 + Streaming.BatchBytes * 2;
+					}
 
-							if (!Scene)
-								return;
-						}
+					String JobName = StringFromFormat("Import %s", DirEntry.path().filename().string().c_str());
+					ImportJobs.push_back(AddJob(Graph, JobName, [&Graph, Store, DirEntry, MeshReport, Lods, Quantization, GeometryCodec, Textures, Streaming, ImportBytes]()
+					{
+						std::string FilePath = DirEntry.path().string();
 
 						String NewPath = String(FilePath.c_str());
 						{
@@ -378,6 +1485,7 @@ int main(int Argc, const char* Argv[])
 							}
 						}
 
+						String SourcePath = NewPath;
 						{
 							StringView BasePath = "content/";
 							auto It = NewPath.find(BasePath.data());
@@ -386,7 +1494,72 @@ int main(int Argc, const char* Argv[])
 							NewPath += "pak";
 						}
 
-						PakFileWriter Pak = CreatePak(NewPath);
+						// scene file first, then every external texture it referenced last time
+						TArray<String> Dependencies = GetCookDependencies(NewPath);
+						u64 CookSalt = ((u64)OVEN_COOK_VERSION << 32) | (u64)OVEN_SCENE_IMPORT_FLAGS;
+						CookSalt = HashData64(&Lods, sizeof(Lods), CookSalt);
+						CookSalt = HashData64(&Quantization, sizeof(Quantization), CookSalt);
+						CookSalt = HashData64(&GeometryCodec, sizeof(GeometryCodec), CookSalt);
+						CookSalt = HashData64(&Textures, sizeof(Textures), CookSalt);
+						if (!Dependencies.empty() && IsCookUpToDate(NewPath, ComputeCookKey(Dependencies, CookSalt)) && KeepSharedTextures(*Store, NewPath))
+						{
+							ReleaseJobMemory(Graph, ImportBytes);
+							return;
+						}
+						Dependencies.clear();
+						Dependencies.push_back(SourcePath);
+
+						// freed by the scene's commit job
+						SceneCook* Cook = new SceneCook();
+						Cook->PakPath = NewPath;
+						Cook->CookSalt = CookSalt;
+						Cook->MeshReport = MeshReport;
+						Cook->Lods = Lods;
+						Cook->Quantization = Quantization;
+						Cook->GeometryCodec = GeometryCodec;
+						Cook->Textures = Textures;
+						Cook->Streaming = Streaming;
+						Cook->ReservedBytes = ImportBytes;
+
+						const aiScene* Scene = nullptr;
+						{
+							ZoneScopedN("Scene file parsing");
+							Scene = Cook->Importer.ReadFile(
+								FilePath.c_str(),
+								(unsigned int)OVEN_SCENE_IMPORT_FLAGS
+							);
+							CHECK(Scene != nullptr, "Load failed");
+
+							if (!Scene)
+							{
+								ReleaseJobMemory(Graph, ImportBytes);
+								delete Cook;
+								return;
+							}
+						}
+						Cook->Scene = Scene;
+
+						if (Streaming.Budget != 0)
+						{
+							// what the scene really holds, any difference to the guess is given back or taken
+							u64 SceneBytes = GetImportedSceneBytes(Scene) + Streaming.BatchBytes * 2;
+							if (SceneBytes > ImportBytes)
+							{
+								ClaimJobMemory(Graph, SceneBytes - ImportBytes);
+							}
+							else
+							{
+								ReleaseJobMemory(Graph, ImportBytes - SceneBytes);
+							}
+							Cook->ReservedBytes = SceneBytes;
+
+							Cook->Geometry.VerticesFile = fopen((NewPath + ".vertices.tmp").c_str(), "wb");
+							Cook->Geometry.IndicesFile = fopen((NewPath + ".indices.tmp").c_str(), "wb");
+							CHECK(Cook->Geometry.VerticesFile && Cook->Geometry.IndicesFile, "Couldn't open files to stream scene geometry to");
+						}
+
+						Cook->Pak = CreatePak(NewPath, true);
+						PakFileWriter& Pak = Cook->Pak;
 
 						TMap<String, u64> NodeNameToIndex;
 						{
@@ -696,31 +1869,21 @@ int main(int Argc, const char* Argv[])
 												u32 Index = atoi(TexPath.C_Str() + 1);
 												Material.DiffuseTexture = u16(Index);
 
-												aiTexture* Texture = Scene->mTextures[Index];
-
-												int Channels = 0, w = 0, h = 0;
-												u8* Data = stbi_load_from_memory(
-													(u8*)Texture->pcData,
-													Texture->mWidth,
-													&w, &h, &Channels, 4
-												);
-												CHECK(w == h);
-												CHECK(_mm_popcnt_u32(w) == 1);
-												u32 Log2OfSize = _tzcnt_u32(w);
-												CHECK((1 << Log2OfSize) == w);
-
-												u32 CompressedSize = w * h / 2;
-
-												String CompressedData(CompressedSize, '\0');
-
-												CompressImageDxt1FromRGBA8(Data, (u8*)CompressedData.data(), w, h);
-
-												stbi_image_free(Data);
-												TextureDescription Desc;
-												Desc.Value = 0; // bc1 format
-												Desc.Value |= Log2OfSize << 4; // size
-												Desc.Value |= 1 << 8; // mip count
-												InsertIntoPak(Pak, StringFromFormat("___Texture_%d", Index), CompressedData, Desc.Value, true);
+												// materials can share embedded textures, each one is cooked once
+												auto Cooked = eastl::find_if(Cook->SceneTextures.begin(), Cook->SceneTextures.end(),
+													[Index](const SceneTexture& Texture) { return Texture.Embedded && Texture.Index == Index; });
+												if (Cooked == Cook->SceneTextures.end())
+												{
+													const aiTexture* Embedded = Scene->mTextures[Index];
+													// mHeight is only set for uncompressed texels, compressed images are mWidth bytes
+													u64 Size = Embedded->mHeight ? u64(Embedded->mWidth) * Embedded->mHeight * sizeof(aiTexel) : Embedded->mWidth;
+
+													SceneTexture& Texture = Cook->SceneTextures.push_back();
+													Texture.Index = Index;
+													Texture.Embedded = true;
+													Texture.Image.assign((const char*)Embedded->pcData, Size);
+													Texture.SRGB = IsColorTexture(TextureType);
+												}
 											}
 											else
 											{
@@ -751,123 +1914,13 @@ int main(int Argc, const char* Argv[])
 													}
 												}
 
-												FileMapping File = MapFile(Path);
-												RawDataView View = GetView(File);
-
-												if (!View.empty())
-												{
-													const u8* Data = View.data();
-													TextureDescription TexDesc = AdvanceToDataAndGetDescription(Data);
-													u64 NumMips = (TexDesc.Value >> 8) & 0xf;
-													u64 Log2OfSize = (TexDesc.Value >> 4) & 0xf;
-													CHECK(NumMips == Log2OfSize + 1);
-
-													u32 Size = GetTextureSize(TexDesc);
-
-													u32 BytesPerBlock = BitsPerPixel((DXGI_FORMAT)GetTextureFormat(TexDesc)) * 2;
-
-													u32 NumBlocks = std::max<u32>(Size / 4, 1);
-													u64 Pitch = NumBlocks * BytesPerBlock;
-													Pitch = AlignUp(Pitch, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
-
-													String WorkingMemory(NumBlocks * Pitch * 3, '\0');
-
-													const u8* Src = Data;
-													u64 Offset = 0;
-													bool InsertSeparateMip = true;
-													u64 PackedMipsBytes = 0;
+												Dependencies.push_back(Path);
 
-													u8* Dest = (u8*)WorkingMemory.data();
-													for (int Mip = 0; Mip < NumMips; ++Mip)
-													{
-														NumBlocks = std::max<u32>(Size / 4, 1);
-														Pitch = NumBlocks * BytesPerBlock;
-
-														if (InsertSeparateMip && NumBlocks * Pitch < 64_kb)
-														{
-															InsertSeparateMip = false;
-															Dest = (u8*)WorkingMemory.data();
-														}
-
-														if (Pitch >= D3D12_TEXTURE_DATA_PITCH_ALIGNMENT)
-														{
-															if (InsertSeparateMip)
-															{
-																InsertIntoPak(
-																	Pak,
-																	StringFromFormat("___Texture_%d_%d", Index, Mip),
-																	RawDataView(Src, NumBlocks * Pitch),
-																	TexDesc.Value,
-																	true
-																);
-															}
-															else
-															{
-																memcpy(Dest, Src, NumBlocks * Pitch);
-																Dest += NumBlocks * Pitch;
-																PackedMipsBytes += NumBlocks * Pitch;
-															}
-
-															Size /= 2;
-															Src += NumBlocks * Pitch;
-															Offset += NumBlocks * Pitch;
-
-															continue;
-														}
-
-														Pitch = AlignUp(Pitch, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
-
-														for (int Line = 0; Line < NumBlocks; Line++)
-														{
-															memcpy(Dest, Src, NumBlocks * BytesPerBlock);
-															Src += NumBlocks * BytesPerBlock;
-															Dest += Pitch;
-														}
-
-														if (InsertSeparateMip)
-														{
-															InsertIntoPak(
-																Pak,
-																StringFromFormat("___Texture_%d_%d", Index, Mip),
-																RawDataView((u8*)WorkingMemory.data(), Dest - (u8*)WorkingMemory.data()),
-																TexDesc.Value,
-																true
-															);
-															if (Pitch * NumBlocks < 64_kb)
-															{
-																InsertSeparateMip = false;
-																Dest = (u8 *)WorkingMemory.data();
-															}
-														}
-														else
-														{
-															PackedMipsBytes += Pitch * NumBlocks;
-														}
-
-														Offset += Pitch * NumBlocks;
-														if (Pitch * NumBlocks < D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT && Mip != NumMips - 1)
-														{
-															Dest += D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - Pitch * NumBlocks;
-															Offset += Pitch;
-														}
-														Size /= 2;
-													}
-
-													CHECK(Size == 0);
-
-													InsertIntoPak(
-														Pak,
-														StringFromFormat("___Texture_%d", Index),
-														RawDataView((u8*)WorkingMemory.data(), Dest - (u8*)WorkingMemory.data()),
-														TexDesc.Value,
-														true
-													);
-													UnmapFile(File);
-												}
-												else
-												{
-													DEBUG_BREAK();
-												}
+												SceneTexture& Texture = Cook->SceneTextures.push_back();
+												Texture.Index = u32(Index);
+												Texture.Embedded = false;
+												Texture.Path = Path;
+												Texture.SRGB = IsColorTexture(TextureType);
 											}
 										}
 									}
@@ -876,64 +1929,108 @@ int main(int Argc, const char* Argv[])
 							InsertIntoPak(Pak, "___Materials", ContainerToView(Materials));
 						}
 
-						{
-							ZoneScopedN("Upload mesh data");
-
-							MeshBufferOffsets RunningOffset{ 0,0 };
-							TArray<MeshBufferOffsets> BufferOffsets;
-							TArray<MeshDescription> MeshDatas;
+						Cook->Dependencies = MOVE(Dependencies);
 
-							for (u64 i = 0; i < Scene->mNumMeshes; ++i)
+						// textures go to textures.pak and cook on their own, the scene only needs their hashes
+						String SceneName = String(DirEntry.path().filename().string().c_str());
+						TArray<u64> TextureHashes;
+						for (SceneTexture& Texture : Cook->SceneTextures)
+						{
+							// materials number external textures after the embedded ones
+							u32 Slot = Texture.Embedded ? Texture.Index : Texture.Index + Scene->mNumTextures;
+							if (TextureHashes.size() <= Slot)
 							{
-								aiMesh* Mesh = Scene->mMeshes[i];
-								MeshDescription& Description = MeshDatas.push_back();
-								Description = ExtractMeshDescription(Mesh);
-
-								BufferOffsets.push_back() = RunningOffset;
-								RunningOffset.VBufferOffset += GetVertexBufferSize(Description);
-								RunningOffset.IBufferOffset += GetIndexBufferSize(Description);
-
-								RunningOffset.IBufferOffset = AlignUp<u32>(RunningOffset.IBufferOffset, 4);
+								TextureHashes.resize(Slot + 1, 0);
 							}
-							InsertIntoPak(Pak, "___Scene_BufferOffsets", ContainerToView(BufferOffsets));
+							Texture.ContentHash = GetTextureContentHash(Texture, Textures);
+							TextureHashes[Slot] = Texture.ContentHash;
 
-							String GlobalVBuffer(RunningOffset.VBufferOffset, '\0');
-							String GlobalIBuffer(RunningOffset.IBufferOffset, '\0');
-							eastl::bitset<256> CombinationsPresent;
-							for (u64 i = 0; i < Scene->mNumMeshes; ++i)
+							String TextureName = StringFromFormat("%s texture %u", SceneName.c_str(), Slot);
+							RequestSharedTexture(Graph, *Store, Texture, Textures, Streaming, TextureName);
+						}
+						InsertIntoPak(Pak, "___SceneTextures", ContainerToView(TextureHashes));
+						Cook->SceneTextures = TArray<SceneTexture>();
+
+						// meshes cook in batches, each written out by a job of its own in scene order.
+						// A batch starts once the one two before it is written, so at most two are held at once
+						Cook->Meshes.resize(Scene->mNumMeshes);
+						TArray<JobID> Written;
+						for (u64 Begin = 0, End = 0; Begin < Scene->mNumMeshes; Begin = End)
+						{
+							u64 BatchBytes = EstimateCookedMeshBytes(Scene->mMeshes[Begin]);
+							for (End = Begin + 1; End < Scene->mNumMeshes; ++End)
 							{
-								aiMesh* Mesh = Scene->mMeshes[i];
-
-								MeshDescription& Description = MeshDatas[i];
-								CombinationsPresent.set(Description.Flags, 1);
-
-								UploadMeshData ((u8*)GlobalVBuffer.data() + BufferOffsets[i].VBufferOffset, Mesh, Description.Flags & MeshFlags::PositionPacked);
-								UploadIndexData((u8*)GlobalIBuffer.data() + BufferOffsets[i].IBufferOffset, Mesh);
+								u64 MeshBytes = EstimateCookedMeshBytes(Scene->mMeshes[End]);
+								if (BatchBytes + MeshBytes > Streaming.BatchBytes)
+								{
+									break;
+								}
+								BatchBytes += MeshBytes;
 							}
-							InsertIntoPak(Pak, "___Scene_MeshDatas", ContainerToView(MeshDatas));
 
-							InsertIntoPak(Pak, "___Scene_Vertices", GlobalVBuffer, 0, true);
-							InsertIntoPak(Pak, "___Scene_Indeces", GlobalIBuffer, 0, true);
-
-							RawDataView TmpMemory((const u8*)CombinationsPresent.data(), CombinationsPresent.size() / 8);
-							InsertIntoPak(Pak, "___VertexCombinationsMask", TmpMemory);
+							TArray<JobID> Before;
+							if (Written.size() >= 2)
+							{
+								Before.push_back(Written[Written.size() - 2]);
+							}
+							TArray<JobID> Batch;
+							for (u64 i = Begin; i < End; ++i)
+							{
+								String MeshName = StringFromFormat("%s mesh %s", SceneName.c_str(), Scene->mMeshes[i]->mName.C_Str());
+								Batch.push_back(AddJob(Graph, MeshName, [Cook, i]() { CookSceneMesh(*Cook, i); }, Before));
+							}
+							if (!Written.empty())
+							{
+								Batch.push_back(Written.back());
+							}
+							String WriteName = StringFromFormat("%s write meshes %llu-%llu", SceneName.c_str(), Begin, End - 1);
+							Written.push_back(AddJob(Graph, WriteName, [Cook, Begin, End]() { WriteSceneMeshes(*Cook, Begin, End); }, Batch));
 						}
 
-						FinalizePak(Pak);
-						Importer.FreeScene();
-					});
+						TArray<JobID> Commit;
+						if (!Written.empty())
+						{
+							Commit.push_back(Written.back());
+						}
+						AddJob(Graph, StringFromFormat("%s commit", SceneName.c_str()), [&Graph, Cook]() {
+							CommitScene(*Cook);
+							ReleaseJobMemory(Graph, Cook->ReservedBytes);
+							delete Cook;
+						}, Commit);
+					}, {}, ImportBytes));
 				}
 			}
 		}
+
+		// once every import has said which textures it uses, textures.pak waits for the ones being cooked
+		AddJob(Graph, "Gather shared textures", [&Graph, Store]() {
+			TArray<JobID> TextureJobs;
+			{
+				ScopedMovableLock AutoLock(Store->Lock);
+				for (auto& [Hash, Texture] : Store->Textures)
+				{
+					if (Texture.Job != InvalidJob)
+					{
+						TextureJobs.push_back(Texture.Job);
+					}
+				}
+			}
+			AddJob(Graph, "Commit textures.pak", [Store]() {
+				CommitSharedTextures(*Store);
+				delete Store;
+			}, TextureJobs);
+		}, ImportJobs);
 	}
 
 	if (Args.Empty() || Args.Includes("compile_shaders"))
 	{
 		ZoneScopedN("compile_shaders kickoff");
-		PakFileWriter ShadersPak = CreatePak("./cooked/shaders.pak");
+		// anything that isn't a shader can be included by every shader
+		TArray<String> ShaderSources;
+		TArray<String> ShaderIncludes;
 		for (const auto& DirEntry : recursive_directory_iterator("./content/shaders"))
 		{
-			if (!DirEntry.is_directory() && DirEntry.path().extension().compare(".hlsl") == 0)
+			if (!DirEntry.is_directory())
 			{
 				String FilePath = String(DirEntry.path().string().c_str());
 
@@ -946,66 +2043,189 @@ int main(int Argc, const char* Argv[])
 					}
 				}
 
-				StringView Name = FilePath;
-				Name.remove_prefix(Name.find_last_of("\\/") + 1);
-				Name.remove_suffix(5); // ".hlsl"
-
-				TComPtr<ID3D12ShaderReflection> CSReflection;
-				TComPtr<IDxcBlob> CS = CompileShader(FilePath, "MainCS", CSReflection.GetAddressOf());
-				if (CS)
+				if (DirEntry.path().extension().compare(".hlsl") == 0)
 				{
-					InsertIntoPak(ShadersPak, Name, RawDataView((u8*)CS->GetBufferPointer(), CS->GetBufferSize()), 1 << 31);
+					ShaderSources.push_back(FilePath);
 				}
 				else
 				{
-					TComPtr<ID3D12ShaderReflection> Reflections[2];
-					TComPtr<IDxcBlob> VS = CompileShader(FilePath, "MainVS", Reflections[0].GetAddressOf());
-					TComPtr<IDxcBlob> PS = CompileShader(FilePath, "MainPS", Reflections[1].GetAddressOf());
+					ShaderIncludes.push_back(FilePath);
+				}
+			}
+		}
+		eastl::sort(ShaderSources.begin(), ShaderSources.end());
+		eastl::sort(ShaderIncludes.begin(), ShaderIncludes.end());
 
-					CHECK(VS && PS);
-					CHECK(VS->GetBufferSize() <= INT16_MAX);
-					CHECK(PS->GetBufferSize() <= UINT16_MAX);
+		TArray<String> Dependencies = ShaderIncludes;
+		Dependencies.insert(Dependencies.end(), ShaderSources.begin(), ShaderSources.end());
+		u64 ShadersKey = ComputeCookKey(Dependencies, OVEN_COOK_VERSION);
 
-					ShaderReflectionData ReflectionData{};
+		if (!IsCookUpToDate("./cooked/shaders.pak", ShadersKey))
+		{
+			u64 IncludesKey = ComputeCookKey(ShaderIncludes, OVEN_COOK_VERSION);
 
-					for (int i = 0; i < 2; ++i)
-					{
-						ID3D12ShaderReflection *R = Reflections[i].Get();
+			// freed by the commit job
+			ShaderCook* Cook = new ShaderCook();
+			Cook->Sources = MOVE(ShaderSources);
+			Cook->Dependencies = MOVE(Dependencies);
+			Cook->Key = ShadersKey;
+			Cook->Compiled.resize(Cook->Sources.size());
 
-						D3D12_SHADER_DESC Desc;
-						R->GetDesc(&Desc);
+			TArray<JobID> ShaderJobs;
+			for (u64 i = 0; i < Cook->Sources.size(); ++i)
+			{
+				String JobName = StringFromFormat("Compile %s", Cook->Sources[i].c_str());
+				ShaderJobs.push_back(AddJob(Graph, JobName, [Cook, i, IncludesKey]() { CompileShaderForPak(Cook->Sources[i], IncludesKey, Cook->Compiled[i]); }));
+			}
+			AddJob(Graph, "Commit shaders.pak", [Cook]() {
+				PakFileWriter ShadersPak = CreatePak("./cooked/shaders.pak", true);
+				for (const CompiledShader& Shader : Cook->Compiled)
+				{
+					InsertIntoPak(ShadersPak, Shader.Name, Shader.Data, Shader.Flags);
+				}
+				FinalizePak(ShadersPak);
 
-						ReflectionData.NumCBVs = Desc.ConstantBuffers;
-						for (int j = 0; j < Desc.BoundResources; ++j)
-						{
-							D3D12_SHADER_INPUT_BIND_DESC ResourceDesc;
-							R->GetResourceBindingDesc(j, &ResourceDesc);
+				RecordCook("./cooked/shaders.pak", Cook->Key, Cook->Dependencies);
+				delete Cook;
+			}, ShaderJobs);
+		}
+	}
 
-							if (ResourceDesc.Type == D3D_SIT_CBUFFER)
-							{
-								D3D12_SHADER_BUFFER_DESC CBDesc{};
-								ID3D12ShaderReflectionConstantBuffer* CB = R->GetConstantBufferByIndex(ResourceDesc.BindPoint);
-								CB->GetDesc(&CBDesc);
-							}
-						}
-					}
+	if (Args.Includes("benchmark_codecs"))
+	{
+		StringView SamplePath = Args.After("benchmark_codecs");
+		CHECK(!SamplePath.empty(), "Usage: Oven benchmark_codecs <file>");
+
+		String SamplePathString(SamplePath);
+		FileMapping Sample = MapFile(SamplePathString, MapFilePopulate);
+		CHECK(IsValid(Sample), "Couldn't open sample file");
 
-					String Data(VS->GetBufferSize() + PS->GetBufferSize(), 0);
+		printf("%.*s, %llu bytes\n", VIEW_PRINT(SamplePath), Sample.FileSize);
+		BenchmarkCodecs(RawDataView((const u8*)Sample.BasePtr, Sample.FileSize), 10);
+		UnmapFile(Sample);
+	}
 
-					memcpy((u8*)Data.data(), VS->GetBufferPointer(), VS->GetBufferSize());
-					memcpy((u8*)Data.data() + VS->GetBufferSize(), PS->GetBufferPointer(), PS->GetBufferSize());
+	// "oven benchmark_meshlets <scene pak>", CPU culling of the scene's meshlets from random cameras
+	if (Args.Includes("benchmark_meshlets"))
+	{
+		StringView ScenePath = Args.After("benchmark_meshlets");
+		CHECK(!ScenePath.empty(), "Usage: Oven benchmark_meshlets <scene pak>");
 
-					InsertIntoPak(ShadersPak, Name, Data, (VS->GetBufferSize() << 16) | PS->GetBufferSize());
-				}
-			}
-		}
-		FinalizePak(ShadersPak);
+		PakFileReader ScenePak = OpenPak(ScenePath);
+		const PakItem* BoundsItem = FindItem(ScenePak, "___Scene_MeshletBounds");
+		CHECK(BoundsItem, "No meshlets in the pak, cooked by an older Oven?");
+
+		TArray<MeshletBounds> Bounds = GetFileDataTypedArray<MeshletBounds>(ScenePak, *BoundsItem);
+		printf("%.*s\n", VIEW_PRINT(ScenePath));
+		BenchmarkMeshletCulling(Bounds.data(), Bounds.size(), 1000);
+		ClosePak(ScenePak);
+	}
+
+	// "oven benchmark_geometry <scene pak>", the scene's vertices and indices through every codec and the per mesh geometry codec
+	if (Args.Includes("benchmark_geometry"))
+	{
+		using Clock = std::chrono::high_resolution_clock;
+
+		StringView ScenePath = Args.After("benchmark_geometry");
+		CHECK(!ScenePath.empty(), "Usage: Oven benchmark_geometry <scene pak>");
+
+		PakFileReader ScenePak = OpenPak(ScenePath);
+		const PakItem* MeshDatasItem = FindItem(ScenePak, "___Scene_MeshDatas");
+		const PakItem* OffsetsItem = FindItem(ScenePak, "___Scene_BufferOffsets");
+		const PakItem* VerticesItem = FindItem(ScenePak, "___Scene_Vertices");
+		const PakItem* IndicesItem = FindItem(ScenePak, "___Scene_Indeces");
+		CHECK(MeshDatasItem && OffsetsItem && VerticesItem && IndicesItem, "Not a scene pak");
+
+		TArray<MeshDescription> MeshDatas = GetFileDataTypedArray<MeshDescription>(ScenePak, *MeshDatasItem);
+		TArray<MeshBufferOffsets> Offsets = GetFileDataTypedArray<MeshBufferOffsets>(ScenePak, *OffsetsItem);
+		String Vertices(abs(VerticesItem->UncompressedDataSize), '\0');
+		String Indices(abs(IndicesItem->UncompressedDataSize), '\0');
+		FillBuffer(ScenePak, *VerticesItem, Vertices.data());
+		FillBuffer(ScenePak, *IndicesItem, Indices.data());
+		ClosePak(ScenePak);
+
+		String EncodedVertices;
+		auto VerticesStart = Clock::now();
+		EncodeSceneVertices(EncodedVertices, Vertices, MeshDatas, Offsets);
+		double VerticesSeconds = std::chrono::duration<double>(Clock::now() - VerticesStart).count();
+
+		String EncodedIndices;
+		auto IndicesStart = Clock::now();
+		EncodeSceneIndices(EncodedIndices, Indices, MeshDatas, Offsets);
+		double IndicesSeconds = std::chrono::duration<double>(Clock::now() - IndicesStart).count();
+
+		printf("%.*s vertices, %llu bytes\n", VIEW_PRINT(ScenePath), (u64)Vertices.size());
+		BenchmarkGeometryCodec(RawDataView((const u8*)Vertices.data(), Vertices.size()), RawDataView((const u8*)EncodedVertices.data(), EncodedVertices.size()), VerticesSeconds, 10);
+		printf("%.*s indices, %llu bytes\n", VIEW_PRINT(ScenePath), (u64)Indices.size());
+		BenchmarkGeometryCodec(RawDataView((const u8*)Indices.data(), Indices.size()), RawDataView((const u8*)EncodedIndices.data(), EncodedIndices.size()), IndicesSeconds, 10);
+	}
+
+	// "oven benchmark_textures <image>", every encode format and quality preset, speed and PSNR against the source
+	if (Args.Includes("benchmark_textures"))
+	{
+		StringView ImagePath = Args.After("benchmark_textures");
+		CHECK(!ImagePath.empty(), "Usage: Oven benchmark_textures <image>");
+
+		int Channels = 0, w = 0, h = 0;
+		u8* Data = stbi_load(String(ImagePath).c_str(), &w, &h, &Channels, 4);
+		CHECK(Data, "Couldn't load the image");
+
+		printf("%.*s\n", VIEW_PRINT(ImagePath));
+		BenchmarkTextureEncoders(Data, w, h, 3);
+		stbi_image_free(Data);
+	}
+
+	// "oven benchmark_workers [<tasks>]", empty tasks through the worker pool at every worker count, needs the pool to itself
+	if (Args.Includes("benchmark_workers"))
+	{
+		StringView Tasks = Args.After("benchmark_workers");
+		WaitForJobGraph(Graph);
+		BenchmarkWorkers(Tasks.empty() ? 1000000 : strtoull(String(Tasks).c_str(), nullptr, 10));
+	}
+
+	// "oven benchmark_parallel_for [<items>]", static against adaptive ParallelFor on skewed work
+	if (Args.Includes("benchmark_parallel_for"))
+	{
+		StringView Items = Args.After("benchmark_parallel_for");
+		WaitForJobGraph(Graph);
+		BenchmarkParallelFor(Items.empty() ? 100000 : strtoull(String(Items).c_str(), nullptr, 10));
+	}
+
+	// "oven diff_pak <base> <new> [<delta>]", delta defaults to "<base>delta" so OpenPak on the base picks it up
+	if (Args.Includes("diff_pak"))
+	{
+		StringView BasePath = Args.After("diff_pak");
+		StringView NewPath = Args.After(BasePath);
+		CHECK(!BasePath.empty() && !NewPath.empty(), "Usage: Oven diff_pak <base> <new> [<delta>]");
+
+		StringView DeltaPath = Args.After(NewPath);
+		String DeltaPathString = DeltaPath.empty() ? String(BasePath) + "delta" : String(DeltaPath);
+		WritePakDelta(String(BasePath), String(NewPath), DeltaPathString);
 	}
 
-	for (TicketCPU T : Tickets)
+	int ExitCode = 0;
+
+	// "oven verify <pak> [<pak>...]", deltas are separate files and are verified when passed explicitly
+	if (Args.Includes("verify"))
 	{
-		WaitForCompletion(T);
+		TArray<StringView> Paths = Args.AllAfter("verify");
+		CHECK(!Paths.empty(), "Usage: Oven verify <pak> [<pak>...]");
+
+		for (StringView Path : Paths)
+		{
+			if (!VerifyPak(String(Path)))
+			{
+				ExitCode = 1;
+			}
+		}
 	}
 
+	WaitForJobGraph(Graph);
+	// critical path of the cook, "job_timings" adds every job
+	PrintJobGraphTimings(Graph, Args.Includes("job_timings"));
+
+	SaveCookCache();
+
 	StopWorkerThreads();
+	return ExitCode;
 }
@@ -7,15 +7,24 @@
 #include "Containers/Private/String.cpp"
 #include "Containers/Private/RingBuffer.cpp"
 
+#include "Assets/Private/Codec.cpp"
+#include "Assets/Private/CookCache.cpp"
 #include "Assets/Private/DDS.cpp"
 #include "Assets/Private/DirectStorage.cpp"
 #include "Assets/Private/File.cpp"
+#include "Assets/Private/GeometryCodec.cpp"
 #include "Assets/Private/Mesh.cpp"
+#include "Assets/Private/MeshOptimizer.cpp"
+#include "Assets/Private/Meshlet.cpp"
 #include "Assets/Private/Pak.cpp"
+#include "Assets/Private/PakVFS.cpp"
 #include "Assets/Private/Shader.cpp"
 #include "Assets/Private/TextureDescription.cpp"
+#include "Assets/Private/TextureEncoder.cpp"
+#include "Assets/Private/TextureMips.cpp"
 
 #include "Threading/Private/DedicatedThread.cpp"
+#include "Threading/Private/JobGraph.cpp"
 #include "Threading/Private/MainThread.cpp"
 #include "Threading/Private/Worker.cpp"
 
@@ -5,6 +5,7 @@ set CommonIncludes=/I .\thirdparty\Tracy\public\ %CommonIncludes%
 set CommonIncludes=/I .\thirdparty\EASTL\include\ %CommonIncludes%
 set CommonIncludes=/I .\thirdparty\directstorage\native\include\ %CommonIncludes%
 set CommonIncludes=/I .\thirdparty\minilzo\ %CommonIncludes%
+set CommonIncludes=/I .\thirdparty\zlib\include\ %CommonIncludes%
 set CommonIncludes=/I .\thirdparty\winpixeventruntime\include\ %CommonIncludes%
 set CommonIncludes=/I .\thirdparty\imgui\ %CommonIncludes%
 set CommonIncludes=/I .\thirdparty\imnodes\ %CommonIncludes%
@@ -13,9 +14,10 @@ set CommonIncludes=/I .\thirdparty\external\ %CommonIncludes%
 set CommonLibs=Winmm.lib onecore.lib dxcompiler.lib
 set CommonLibs=.\thirdparty\directstorage\native\lib\x64\dstorage.lib %CommonLibs%
 set CommonLibs=.\thirdparty\EASTL\EASTL.lib %CommonLibs%
+set CommonLibs=.\thirdparty\zlib\libz-static.lib %CommonLibs%
 set CommonLibs=.\thirdparty\lib\ThirdParty.lib %CommonLibs%
 
-set CommonFlags=-std:c++17 -MD -Od -nologo -fp:fast -fp:except- -Gm- -GR- -EHa- -Zo -Oi -WX -Z7 -GS-
+set CommonFlags=-std:c++20 -MD -Od -nologo -fp:fast -fp:except- -Gm- -GR- -EHa- -Zo -Oi -WX -Z7 -GS-
 rem set CommonFlags=-DTRACY_ENABLE=1 %CommonFlags%
 set CommonFlags=-DEASTL_CUSTOM_FLOAT_CONSTANTS_REQUIRED %CommonFlags%
 set CommonFlags=-D_HAS_EXCEPTIONS=0 %CommonFlags%
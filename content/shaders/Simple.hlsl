@@ -11,6 +11,7 @@ cbuffer PushConstants : register(b0)
 	float lodClampIndex;
 	uint mouseX;
 	uint mouseY;
+	float4 uvTransform; // offset in xy, scale in zw, unpacks quantized UVs
 };
 
 VertexShaderOutput MainVS(
@@ -22,7 +23,7 @@ VertexShaderOutput MainVS(
 	VertexShaderOutput output;
 
 	output.Position = mul(MVP, position);
-	output.UV = uv;
+	output.UV = uvTransform.xy + uv * uvTransform.zw;
 
 	return output;
 }
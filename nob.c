@@ -17,7 +17,7 @@ int main(int argc, char **argv)
     //nob_minimal_log_level = NOB_WARNING;
 
 #if _WIN32
-    #define SYSTEM_INCLUDES "-Ithirdparty/directstorage/native/include"
+    #define SYSTEM_INCLUDES "-Ithirdparty/directstorage/native/include", "-Ithirdparty/zlib/include"
 #else
     #define SYSTEM_INCLUDES 
 #endif
@@ -37,9 +37,9 @@ int main(int argc, char **argv)
     );
 
 #if _WIN32
-    #define SYSTEM_LIBS "Winmm.lib", "onecore.lib", "dxcompiler.lib", "thirdparty/directstorage/native/lib/x64/dstorage.lib"
+    #define SYSTEM_LIBS "Winmm.lib", "onecore.lib", "dxcompiler.lib", "thirdparty/directstorage/native/lib/x64/dstorage.lib", "thirdparty/zlib/libz-static.lib"
 #else
-    #define SYSTEM_LIBS
+    #define SYSTEM_LIBS "-lz"
 #endif
 
     Nob_Cmd CommonLibs = {0};
@@ -51,7 +51,7 @@ int main(int argc, char **argv)
 
     Nob_Cmd CommonFlagsCmd = {0};
     nob_cmd_append(&CommonFlagsCmd,
-        "-std:c++17", "-MD", "-Od",
+        "-std:c++20", "-MD", "-Od",
         "-nologo", "-fp:fast",
         "-fp:except-",
         "-Gm-", "-GR-", "-EHa-", "-Zo", "-Oi", "-WX", "-Z7", "-GS-",
@@ -8,6 +8,7 @@
 
 #include "Assets/TextureDescription.generated.h"
 #include "Assets/Pak.generated.h"
+#include "Assets/PakVFS.generated.h"
 #include "Containers/Map.generated.h"
 #include "Render/CommandListPool.generated.h"
 #include "Render/RenderThread.generated.h"
@@ -34,8 +35,11 @@ TracyD3D12Ctx	gComputeProfilingCtx;
 
 Scene gScene;
 Camera MainCamera;
+float LodPixelError = 1.f; // how many pixels a mesh LOD's error may cover on screen
 
 TMap<u32, Shader> gMeshShaders;
+PakVFS gAssets; // shaders and the scene, mounted once and looked up by name
+
 void DrawDebugInfoMain()
 {
 	ImGui::ShowDemoWindow();
@@ -48,6 +52,10 @@ void DrawDebugInfoMain()
 
 	for (int i = 0; i < Textures.size(); ++i)
 	{
+		if (Textures[i].TexData.SRV == UINT16_MAX)
+		{
+			continue;
+		}
 		Generated::ToUI(&Textures[i]);
 		ImGui::Text("Desired mip from feedback:%f", float(gScene.DesiredMips[Textures[i].TexData.SRV]) / 1024.f);
 
@@ -157,7 +165,7 @@ void TickStreaming()
 			i32 NextMip = (i32)T.NumStreamedMips - (i32)T.NumStreamedIn - 1;
 			CHECK(NextMip >= 0);
 
-			const PakItem* TextureItem = FindItem(gScene.FileReader, StringFromFormat("___Texture_%d_%d", i, NextMip));
+			const PakItem* TextureItem = FindItem(gAssets, gScene.StreamedMipHashes[i * 8 + NextMip]);
 			CHECK(TextureItem);
 			CHECK(TextureItem->UncompressedDataSize < 0);
 
@@ -177,10 +185,10 @@ void TickStreaming()
 					T,
 					NextMip,
 					-TextureItem->UncompressedDataSize,
-					gScene.FileReader.FileDS,
+					GetItemPak(gAssets, *TextureItem).FileDS,
 					TextureItem->DataOffset,
 					TextureItem->CompressedDataSize,
-					GetFileName(gScene.FileReader, *TextureItem).data()
+					GetFileName(gAssets, *TextureItem).data()
 				);
 
 				EnqueueDelayedWork([Index, NextMip] {
@@ -228,244 +236,261 @@ void StartSceneLoading(String FilePath)
 		gScene.DesiredMips[i] = 16384;
 	}
 
-	EnqueueToWorker([FilePath]() {
-		TArray<TicketCPU> Tickets;
-
-		Tickets.push_back() = EnqueueToWorkerWithTicket([FilePath]()
+	EnqueueToWorker([FilePath]()
+	{
+		ZoneScopedN("SceneLoading");
+		gScene.PakMount = MountPak(gAssets, FilePath);
+
+		// scene description is read and decoded in the background while shader combinations compile
+		const PakItem* NodesItem = FindItem(gAssets, "___Scene_StaticGeometry");
+		CHECK(NodesItem);
+		const PakItem* MaterialsItem = FindItem(gAssets, "___Materials");
+		CHECK(MaterialsItem);
+		const PakItem* MeshDatas = FindItem(gAssets, "___Scene_MeshDatas");
+		CHECK(MeshDatas);
+		const PakItem* BufferOffsetsItem = FindItem(gAssets, "___Scene_BufferOffsets");
+		CHECK(BufferOffsetsItem);
+		const PakItem* CamerasItem = FindItem(gAssets, "___Cameras");
+
+		TArray<Node> Nodes(NodesItem->UncompressedDataSize / sizeof(Node));
+		TArray<MaterialDescription> Materials(MaterialsItem->UncompressedDataSize / sizeof(MaterialDescription));
+		TArray<MeshDescription> Datas(MeshDatas->UncompressedDataSize / sizeof(MeshDescription));
+		TArray<MeshBufferOffsets> BufferOffests(BufferOffsetsItem->UncompressedDataSize / sizeof(MeshBufferOffsets));
+		TArray<Camera> Cameras(CamerasItem ? CamerasItem->UncompressedDataSize / sizeof(Camera) : 0);
+
+		TArray<PakReadRequest> SceneReads;
+		SceneReads.push_back() = { NodesItem, Nodes.data() };
+		SceneReads.push_back() = { MaterialsItem, Materials.data() };
+		SceneReads.push_back() = { MeshDatas, Datas.data() };
+		SceneReads.push_back() = { BufferOffsetsItem, BufferOffests.data() };
+		if (CamerasItem)
 		{
-			ZoneScopedN("SceneLoading");
-			PakFileReader& SceneReader = gScene.FileReader = OpenPak(FilePath);
-
-			const PakItem* CombinationsItem = FindItem(SceneReader, "___VertexCombinationsMask");
-
-			auto Combinations = GetFileDataTyped<eastl::bitset<256>>(SceneReader, *CombinationsItem);
-			//CHECK(Combinations.size() == 1);
+			SceneReads.push_back() = { CamerasItem, Cameras.data() };
+		}
+		TicketCPU SceneReadsDone = EnqueuePakReads(gAssets, SceneReads.data(), SceneReads.size());
 
-			PakFileReader Shaders = OpenPak("./cooked/shaders.pak");
-			const PakItem* SimpleShaderItem = FindItem(Shaders, "Simple");
-			CHECK(SimpleShaderItem);
-			String SimpleShaders = GetFileData(Shaders, *SimpleShaderItem);
+		const PakItem* CombinationsItem = FindItem(gAssets, "___VertexCombinationsMask");
 
-			CHECK((SimpleShaderItem->PrivateFlags & (1 << 31)) == 0);
-			u32 VSShaderSize = (SimpleShaderItem->PrivateFlags >> 16) & 0xffff;
-			u32 PSShaderSize = SimpleShaderItem->PrivateFlags & 0xffff;
-			ClosePak(Shaders);
+		auto Combinations = GetFileDataTyped<eastl::bitset<256>>(gAssets, *CombinationsItem);
+		//CHECK(Combinations.size() == 1);
 
-			CHECK(SimpleShaders.size() == PSShaderSize + VSShaderSize);
+		const PakItem* SimpleShaderItem = FindItem(gAssets, "Simple");
+		CHECK(SimpleShaderItem);
+		String SimpleShaders = GetFileData(gAssets, *SimpleShaderItem);
 
-			RawDataView VSShader((u8*)SimpleShaders.data(), VSShaderSize);
-			RawDataView PSShader((u8*)SimpleShaders.data() + VSShaderSize, PSShaderSize);
+		CHECK((SimpleShaderItem->PrivateFlags & (1 << 31)) == 0);
+		u32 VSShaderSize = (SimpleShaderItem->PrivateFlags >> 16) & 0xffff;
+		u32 PSShaderSize = SimpleShaderItem->PrivateFlags & 0xffff;
 
-			size_t SetBit = Combinations.find_first();
-			while (SetBit != Combinations.size())
-			{
-				u32 RenderTargetFormat = SCENE_COLOR_FORMAT;
-				Shader MeshShader = CreateShaderCombinationGraphics(
-					(u8)SetBit,
-					VSShader,
-					PSShader,
-					&RenderTargetFormat,
-					DEPTH_FORMAT
-				);
+		CHECK(SimpleShaders.size() == PSShaderSize + VSShaderSize);
 
-				EnqueueToRenderThread([SetBit, S = MOVE(MeshShader)]() mutable {
-					gMeshShaders[SetBit] = MOVE(S);
-				});
-				
-				SetBit = Combinations.find_next(SetBit);
-			}
+		RawDataView VSShader((u8*)SimpleShaders.data(), VSShaderSize);
+		RawDataView PSShader((u8*)SimpleShaders.data() + VSShaderSize, PSShaderSize);
 
-			const PakItem* NodesItem = FindItem(SceneReader, "___Scene_StaticGeometry");
-			CHECK(NodesItem);
+		size_t SetBit = Combinations.find_first();
+		while (SetBit != Combinations.size())
+		{
+			u32 RenderTargetFormat = SCENE_COLOR_FORMAT;
+			Shader MeshShader = CreateShaderCombinationGraphics(
+				(u8)SetBit,
+				VSShader,
+				PSShader,
+				&RenderTargetFormat,
+				DEPTH_FORMAT
+			);
 
-			EnqueueToRenderThread([Nodes = GetFileDataTypedArray<Node>(SceneReader, *NodesItem)]() mutable {
-				gScene.StaticGeometry = MOVE(Nodes);
+			EnqueueToRenderThread([SetBit, S = MOVE(MeshShader)]() mutable {
+				gMeshShaders[SetBit] = MOVE(S);
 			});
+			
+			SetBit = Combinations.find_next(SetBit);
+		}
 
-			const PakItem* MaterialsItem = FindItem(SceneReader, "___Materials");
-			CHECK(MaterialsItem);
-			auto Materials = GetFileDataTypedArray<MaterialDescription>(SceneReader, *MaterialsItem);
-
-			u64 NumTextures = 0;
-			for (u64 i = 0; i < Materials.size(); ++i)
-			{
-				NumTextures = std::max((u64)Materials[i].DiffuseTexture, NumTextures);
-			}
-			TArray<VirtualTexture> Textures;
-
-			Textures.reserve(NumTextures);
-			TicketGPU Res {0};
-			for (u64 i = 0; true ; ++i)
-			{
-				const PakItem* TextureItem = FindItem(SceneReader, StringFromFormat("___Texture_%d", i));
-				if (TextureItem == nullptr)
-				{
-					break;
-				}
-
-				TextureDescription Desc{TextureItem->PrivateFlags};
-
-				u32 Index = Textures.size();
-				VirtualTexture& VTex = Textures.push_back();
-				TextureData& Tex = VTex.TexData;
-				Tex.Width   = GetTextureSize(Desc);
-				Tex.Height  = GetTextureSize(Desc);
-				Tex.Format  = GetTextureFormat(Desc);
-				Tex.NumMips = GetMipCount(Desc);
-				VTex.StreamingInProgress = 1;
+		WaitForCompletion(SceneReadsDone);
 
-				TicketGPU MemoryAlreadyMapped = CreateVirtualResourceForTexture(VTex, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
-				CreateSRV(Tex, false);
+		EnqueueToRenderThread([Nodes = MOVE(Nodes)]() mutable {
+			gScene.StaticGeometry = MOVE(Nodes);
+		});
 
-				if (TextureItem->UncompressedDataSize < 0)
-				{
-					EnqueueDelayedWork([VTex, TextureItem]() mutable {
-						TicketGPU UploadDone = UploadTextureDirectStorage(
-							GetTextureResource(VTex.TexData.ID),
-							VTex,
-							-TextureItem->UncompressedDataSize,
-							VTex.TexData.NumMips,
-							gScene.FileReader.FileDS,
-							TextureItem->DataOffset,
-							TextureItem->CompressedDataSize,
-							GetFileName(gScene.FileReader, *TextureItem).data()
-						);
+		u64 NumTextures = 0;
+		for (u64 i = 0; i < Materials.size(); ++i)
+		{
+			NumTextures = std::max((u64)Materials[i].DiffuseTexture, NumTextures);
+		}
+		TArray<VirtualTexture> Textures;
+		TArray<u32> StreamedMipHashes;
 
-						EnqueueDelayedWork([ID = VTex.TexData.ID] {
-							auto CL = GetCommandList(D3D12_COMMAND_LIST_TYPE_DIRECT, L"Texture barriers");
+		// the scene only has content hashes, the textures themselves are shared through textures.pak
+		const PakItem* SceneTexturesItem = FindItem(gAssets, "___SceneTextures");
+		TArray<u64> TextureHashes = SceneTexturesItem ? GetFileDataTypedArray<u64>(gAssets, *SceneTexturesItem) : TArray<u64>();
 
-							D3D12_RESOURCE_BARRIER Barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-								GetTextureResource(ID),
-								D3D12_RESOURCE_STATE_COPY_DEST,
-								D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-								D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES
-							);
-							CL->ResourceBarrier(1, &Barrier);
-							Submit(CL);
-							StreamingStopped(ID);
-						}, UploadDone);
-					}, MemoryAlreadyMapped);
-				}
-				else if (TextureItem->UncompressedDataSize > 0)
-				{
-					String TexData(TextureItem->UncompressedDataSize, '\0');
-					FillBuffer(SceneReader, *TextureItem, TexData.data());
-					UploadTextureData(Tex, (u8*)TexData.data(), TextureItem->UncompressedDataSize);
-				}
-				else
-				{
-					UploadTextureData(Tex, (u8*)SceneReader.Mapping.BasePtr + TextureItem->DataOffset, TextureItem->UncompressedDataSize);
-				}
+		Textures.reserve(NumTextures);
+		TicketGPU Res {0};
+		for (u64 i = 0; i < TextureHashes.size(); ++i)
+		{
+			// materials index textures by slot, a slot Oven had nothing to cook for (an unused embedded image)
+			// keeps its place with a texture that has no SRV, drawn with the default texture
+			const PakItem* TextureItem = TextureHashes[i] ? FindItem(gAssets, GetTextureItemName(TextureHashes[i])) : nullptr;
+			if (TextureItem == nullptr)
+			{
+				Textures.push_back();
+				StreamedMipHashes.resize(StreamedMipHashes.size() + 8, 0);
+				continue;
 			}
 
-			gScene.Textures = MOVE(Textures);
-			gScene.Materials = MOVE(Materials);
+			TextureDescription Desc{TextureItem->PrivateFlags};
 
-			const PakItem* CamerasItem = FindItem(SceneReader, "___Cameras");
-			if (CamerasItem)
+			for (u32 Mip = 0; Mip < 8; ++Mip)
 			{
-				auto Cameras = GetFileDataTypedArray<Camera>(SceneReader, *CamerasItem);
-				CHECK(Cameras.size() == 1);
-				EnqueueToRenderThread([Camera = Cameras[0]]() mutable {
-					MainCamera = Camera;
-				});
+				StreamedMipHashes.push_back(HashString32(GetTextureMipItemName(TextureHashes[i], Mip)));
 			}
 
-			const PakItem* VData = FindItem(SceneReader, "___Scene_Vertices");
-			CHECK(VData);
-			const PakItem* IData = FindItem(SceneReader, "___Scene_Indeces");
-			CHECK(IData);
+			VirtualTexture& VTex = Textures.push_back();
+			TextureData& Tex = VTex.TexData;
+			Tex.Width   = GetTextureSize(Desc);
+			Tex.Height  = GetTextureSize(Desc);
+			Tex.Format  = GetTextureFormat(Desc);
+			Tex.NumMips = GetMipCount(Desc);
+			VTex.StreamingInProgress = 1;
 
-			TComPtr<ID3D12Resource> VResource;
-			TComPtr<ID3D12Resource> IResource;
-			TicketGPU DSDone = TicketGPU{};
+			TicketGPU MemoryAlreadyMapped = CreateVirtualResourceForTexture(VTex, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+			CreateSRV(Tex, false);
 
-			if (VData->UncompressedDataSize > 0)
+			if (TextureItem->UncompressedDataSize < 0)
 			{
-				CHECK(IData->UncompressedDataSize > 0);
-				VResource = CreateBuffer(VData->UncompressedDataSize, BUFFER_GENERIC);
-				IResource = CreateBuffer(IData->UncompressedDataSize, BUFFER_GENERIC);
-				UploadBufferData(VResource.Get(), VData->UncompressedDataSize, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
-					[&](void* GPUAddress, u64) {
-						FillBuffer(SceneReader, *VData, GPUAddress);
-					}
-				);
-				UploadBufferData(IResource.Get(), IData->UncompressedDataSize, D3D12_RESOURCE_STATE_INDEX_BUFFER,
-					[&](void* GPUAddress, u64) {
-						FillBuffer(SceneReader, *IData, GPUAddress);
-					}
-				);
+				EnqueueDelayedWork([VTex, TextureItem]() mutable {
+					TicketGPU UploadDone = UploadTextureDirectStorage(
+						GetTextureResource(VTex.TexData.ID),
+						VTex,
+						-TextureItem->UncompressedDataSize,
+						VTex.TexData.NumMips,
+						GetItemPak(gAssets, *TextureItem).FileDS,
+						TextureItem->DataOffset,
+						TextureItem->CompressedDataSize,
+						GetFileName(gAssets, *TextureItem).data()
+					);
+
+					EnqueueDelayedWork([ID = VTex.TexData.ID] {
+						auto CL = GetCommandList(D3D12_COMMAND_LIST_TYPE_DIRECT, L"Texture barriers");
+
+						D3D12_RESOURCE_BARRIER Barrier = CD3DX12_RESOURCE_BARRIER::Transition(
+							GetTextureResource(ID),
+							D3D12_RESOURCE_STATE_COPY_DEST,
+							D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+							D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES
+						);
+						CL->ResourceBarrier(1, &Barrier);
+						Submit(CL);
+						StreamingStopped(ID);
+					}, UploadDone);
+				}, MemoryAlreadyMapped);
+			}
+			else if (TextureItem->UncompressedDataSize > 0)
+			{
+				String TexData(TextureItem->UncompressedDataSize, '\0');
+				FillBuffer(gAssets, *TextureItem, TexData.data());
+				UploadTextureData(Tex, (u8*)TexData.data(), TextureItem->UncompressedDataSize);
 			}
 			else
 			{
-				CHECK(IData->UncompressedDataSize < 0);
-				VResource = CreateBuffer(-VData->UncompressedDataSize, BUFFER_GENERIC);
-				IResource = CreateBuffer(-IData->UncompressedDataSize, BUFFER_GENERIC);
-				UploadBufferDirectStorage(VResource.Get(), -VData->UncompressedDataSize, SceneReader.FileDS, VData->DataOffset, VData->CompressedDataSize);
-				DSDone = UploadBufferDirectStorage(IResource.Get(), -IData->UncompressedDataSize, SceneReader.FileDS, IData->DataOffset, IData->CompressedDataSize);
+				UploadTextureData(Tex, (u8*)GetItemPak(gAssets, *TextureItem).Mapping.BasePtr + TextureItem->DataOffset, TextureItem->UncompressedDataSize);
 			}
-			EnqueueToRenderThread([V = MOVE(VResource), I = MOVE(IResource)]() mutable {
-				gScene.VertexBuffer = MOVE(V);
-				gScene.IndexBuffer = MOVE(I);
-				FlushUpload();
-			});
+		}
 
-			const PakItem* MeshDatas = FindItem(SceneReader, "___Scene_MeshDatas");
-			CHECK(MeshDatas);
+		gScene.Textures = MOVE(Textures);
+		gScene.StreamedMipHashes = MOVE(StreamedMipHashes);
+		gScene.Materials = MOVE(Materials);
 
-			{
-				const PakItem* BufferOffsetsItem = FindItem(SceneReader, "___Scene_BufferOffsets");
-				CHECK(BufferOffsetsItem);
-				auto BufferOffests = GetFileDataTypedArray<MeshBufferOffsets>(SceneReader, *BufferOffsetsItem);
+		if (CamerasItem)
+		{
+			CHECK(Cameras.size() == 1);
+			EnqueueToRenderThread([Camera = Cameras[0]]() mutable {
+				MainCamera = Camera;
+			});
+		}
 
-				ZoneScopedN("Upload mesh data");
-				auto Datas = GetFileDataTypedArray<MeshDescription>(SceneReader, *MeshDatas);
+		const PakItem* VData = FindItem(gAssets, "___Scene_Vertices");
+		CHECK(VData);
+		const PakItem* IData = FindItem(gAssets, "___Scene_Indeces");
+		CHECK(IData);
 
-				TArray<APIMesh> Meshes;
-				Meshes.reserve(Datas.size());
-				for (u64 i = 0; i < Datas.size(); ++i)
-				{
-					APIMesh& Tmp = Meshes.push_back();
-					Tmp.Description = Datas[i];
-					MeshBufferOffsets Offsets = BufferOffests[i];
-					Tmp.VertexBufferCachedPtr = Offsets.VBufferOffset;
-					Tmp.IndexBufferCachedPtr  = Offsets.IBufferOffset;
+		TComPtr<ID3D12Resource> VResource;
+		TComPtr<ID3D12Resource> IResource;
+		TicketGPU DSDone = TicketGPU{};
+
+		if (VData->UncompressedDataSize > 0)
+		{
+			CHECK(IData->UncompressedDataSize > 0);
+			VResource = CreateBuffer(VData->UncompressedDataSize, BUFFER_GENERIC);
+			IResource = CreateBuffer(IData->UncompressedDataSize, BUFFER_GENERIC);
+			UploadBufferData(VResource.Get(), VData->UncompressedDataSize, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
+				[&](void* GPUAddress, u64) {
+					FillBuffer(gAssets, *VData, GPUAddress);
 				}
-				EnqueueDelayedWork([SceneReader, M = MOVE(Meshes)]() mutable {
-#if 0
-					D3D12CmdList CmdList = GetCommandList(D3D12_COMMAND_LIST_TYPE_DIRECT, L"After DS List");
-					CD3DX12_RESOURCE_BARRIER barriers[] = {
-						CD3DX12_RESOURCE_BARRIER::Transition(
-							gScene.VertexBuffer.Get(),
-							D3D12_RESOURCE_STATE_COMMON,
-							D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
-						),
-						CD3DX12_RESOURCE_BARRIER::Transition(
-							gScene.IndexBuffer.Get(),
-							D3D12_RESOURCE_STATE_COMMON,
-							D3D12_RESOURCE_STATE_INDEX_BUFFER
-						),
-					};
-					CmdList->ResourceBarrier(ArrayCount(barriers), barriers);
-					Submit(CmdList);
-#endif
-					u64 NewSize = gScene.MeshDatas.size() + M.size();
-					gScene.MeshDatas.resize(NewSize);
-					auto VBAddress = gScene.VertexBuffer->GetGPUVirtualAddress();
-					auto IBAddress = gScene.IndexBuffer->GetGPUVirtualAddress();
-					for (int i = 0; i < M.size(); ++i)
-					{
-						M[i].VertexBufferCachedPtr += VBAddress;
-						M[i].IndexBufferCachedPtr  += IBAddress;
-						M[i].PSO = gMeshShaders[M[i].Description.Flags].PSO.Get();
-						gScene.MeshDatas[i + NewSize - M.size()] = MOVE(M[i]);
-					}
-				}, DSDone);
-			}
+			);
+			UploadBufferData(IResource.Get(), IData->UncompressedDataSize, D3D12_RESOURCE_STATE_INDEX_BUFFER,
+				[&](void* GPUAddress, u64) {
+					FillBuffer(gAssets, *IData, GPUAddress);
+				}
+			);
+		}
+		else
+		{
+			CHECK(IData->UncompressedDataSize < 0);
+			VResource = CreateBuffer(-VData->UncompressedDataSize, BUFFER_GENERIC);
+			IResource = CreateBuffer(-IData->UncompressedDataSize, BUFFER_GENERIC);
+			UploadBufferDirectStorage(VResource.Get(), -VData->UncompressedDataSize, GetItemPak(gAssets, *VData).FileDS, VData->DataOffset, VData->CompressedDataSize);
+			DSDone = UploadBufferDirectStorage(IResource.Get(), -IData->UncompressedDataSize, GetItemPak(gAssets, *IData).FileDS, IData->DataOffset, IData->CompressedDataSize);
+		}
+		EnqueueToRenderThread([V = MOVE(VResource), I = MOVE(IResource)]() mutable {
+			gScene.VertexBuffer = MOVE(V);
+			gScene.IndexBuffer = MOVE(I);
+			FlushUpload();
 		});
-		for (TicketCPU T : Tickets)
+
 		{
-			WaitForCompletion(T);
+			ZoneScopedN("Upload mesh data");
+
+			TArray<APIMesh> Meshes;
+			Meshes.reserve(Datas.size());
+			for (u64 i = 0; i < Datas.size(); ++i)
+			{
+				APIMesh& Tmp = Meshes.push_back();
+				Tmp.Description = Datas[i];
+				MeshBufferOffsets Offsets = BufferOffests[i];
+				Tmp.VertexBufferCachedPtr = Offsets.VBufferOffset;
+				Tmp.IndexBufferCachedPtr  = Offsets.IBufferOffset;
+			}
+			EnqueueDelayedWork([M = MOVE(Meshes)]() mutable {
+#if 0
+				D3D12CmdList CmdList = GetCommandList(D3D12_COMMAND_LIST_TYPE_DIRECT, L"After DS List");
+				CD3DX12_RESOURCE_BARRIER barriers[] = {
+					CD3DX12_RESOURCE_BARRIER::Transition(
+						gScene.VertexBuffer.Get(),
+						D3D12_RESOURCE_STATE_COMMON,
+						D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER
+					),
+					CD3DX12_RESOURCE_BARRIER::Transition(
+						gScene.IndexBuffer.Get(),
+						D3D12_RESOURCE_STATE_COMMON,
+						D3D12_RESOURCE_STATE_INDEX_BUFFER
+					),
+				};
+				CmdList->ResourceBarrier(ArrayCount(barriers), barriers);
+				Submit(CmdList);
+#endif
+				u64 NewSize = gScene.MeshDatas.size() + M.size();
+				gScene.MeshDatas.resize(NewSize);
+				auto VBAddress = gScene.VertexBuffer->GetGPUVirtualAddress();
+				auto IBAddress = gScene.IndexBuffer->GetGPUVirtualAddress();
+				for (int i = 0; i < M.size(); ++i)
+				{
+					M[i].VertexBufferCachedPtr += VBAddress;
+					M[i].IndexBufferCachedPtr  += IBAddress;
+					M[i].PSO = gMeshShaders[M[i].Description.Flags].PSO.Get();
+					gScene.MeshDatas[i + NewSize - M.size()] = MOVE(M[i]);
+				}
+			}, DSDone);
 		}
 	});
 }
@@ -487,6 +512,7 @@ int main(void)
 	InitDirectStorage();
 	InitRender(Window);
 	StartRenderThread();
+	StartPakReadThread();
 
 	StartWorkerThreads();
 
@@ -505,23 +531,29 @@ int main(void)
 	String FilePath = "cooked/EmeraldSquare/EmeraldSquare_Day.fbxpak";
 #endif
 
+#if !defined(RELEASE) && !defined(PROFILE)
+	SetPakReadVerification(true);
+#endif
+
+	// mounted before the scene starts loading, scene loading looks up its shaders and textures here too
+	MountPak(gAssets, "./cooked/shaders.pak");
+	MountPak(gAssets, "./cooked/textures.pak");
 	StartSceneLoading(FilePath);
 
-	PakFileReader ShaderReader = OpenPak("./cooked/shaders.pak");
-	const PakItem* SpdItem = FindItem(ShaderReader, "FfxSpd");
-	String FfxSpdCode = GetFileData(ShaderReader, *SpdItem);
+	const PakItem* SpdItem = FindItem(gAssets, "FfxSpd");
+	String FfxSpdCode = GetFileData(gAssets, *SpdItem);
 
 	Shader FfxSpd = CreateShaderCombinationCompute(FfxSpdCode);
 
-	const PakItem* ClearBufferItem = FindItem(ShaderReader, "ClearBuffer");
-	String ClearBufferCode = GetFileData(ShaderReader, *ClearBufferItem);
+	const PakItem* ClearBufferItem = FindItem(gAssets, "ClearBuffer");
+	String ClearBufferCode = GetFileData(gAssets, *ClearBufferItem);
 	Shader ClearBuffer = CreateShaderCombinationCompute(ClearBufferCode);
 
 	Shader BlitShader;
 	{
-		const PakItem* ShaderItem = FindItem(ShaderReader, "Blit");
+		const PakItem* ShaderItem = FindItem(gAssets, "Blit");
 
-		String GUIShaders = GetFileData(ShaderReader, *ShaderItem);
+		String GUIShaders = GetFileData(gAssets, *ShaderItem);
 
 		CHECK((ShaderItem->PrivateFlags & (1 << 31)) == 0);
 		u32 VSShaderSize = (ShaderItem->PrivateFlags >> 16) & 0xffff;
@@ -544,9 +576,9 @@ int main(void)
 
 	Shader GuiShader;
 	{
-		const PakItem* ShaderItem = FindItem(ShaderReader, "GUI");
+		const PakItem* ShaderItem = FindItem(gAssets, "GUI");
 
-		String GUIShaders = GetFileData(ShaderReader, *ShaderItem);
+		String GUIShaders = GetFileData(gAssets, *ShaderItem);
 
 		CHECK((ShaderItem->PrivateFlags & (1 << 31)) == 0);
 		u32 VSShaderSize = (ShaderItem->PrivateFlags >> 16) & 0xffff;
@@ -566,7 +598,6 @@ int main(void)
 			DXGI_FORMAT_UNKNOWN
 		);
 	}
-	ClosePak(ShaderReader);
 
 	TextureData DefaultTexture;
 	{
@@ -1021,6 +1052,7 @@ int main(void)
 				ImGui::SliderAngle("X", &MainCamera.Angles.x);
 				ImGui::SliderAngle("Y", &MainCamera.Angles.y);
 				ImGui::DragFloat("Camera speed", &CamSpeed);
+				ImGui::SliderFloat("LOD error (px)", &LodPixelError, 0.f, 16.f);
 
 				if (Window.mMouseButtons[GLFW_MOUSE_BUTTON_2])
 				{
@@ -1148,6 +1180,8 @@ int main(void)
 						//Matrix4 View = InverseAffine(Scene.StaticGeometry[MainCamera.NodeID].Transform);
 						Matrix4 View = CreateViewMatrix(MainCamera.Position, -MainCamera.Angles);
 						Matrix4 VP = View * Projection;
+						float LodProjectionScale = GetLodProjectionScale(Fov, (float)SceneColor.Height);
+						Vec3 CameraPosition = MainCamera.Position;
 
 						CommandLists.push_back(MOVE(CommandList));
 						CommandLists.resize(DrawingThreads);
@@ -1156,7 +1190,7 @@ int main(void)
 							*It = GetCommandList(D3D12_COMMAND_LIST_TYPE_DIRECT, L"Worker thread drawing meshes");
 						}
 
-						ParallelFor(
+						ParallelForSlices(
 							[
 								MouseX, MouseY,
 								&Scene,
@@ -1164,7 +1198,8 @@ int main(void)
 								&DefaultTexture,
 								&VP, &SceneColor, &DepthBuffer,
 								&ClearBuffer,
-								DeltaTime
+								DeltaTime,
+								LodProjectionScale, CameraPosition
 							](u64 Index, u64 Begin, u64 End)
 							{
 								D3D12CmdList& CmdList = CommandLists[Index];
@@ -1215,17 +1250,21 @@ int main(void)
 										Matrix4 Combined = Mesh.Transform * VP;
 										if (Desc.Flags & MeshFlags::PositionPacked)
 										{
-											//Vec3 Scale = Desc.BoxMax - Desc.BoxMax;
-											//Matrix4 ScaleM = CreateScaleMatrix(Scale);
-											//Matrix4 TranslationM = CreateTranslationMatrix(Desc.BoxMin);
-											//Combined = ScaleM * TranslationM * Combined;
+											// positions come in as 0..1 within the mesh's box
+											Vec3 Scale = Desc.BoxMax - Desc.BoxMin;
+											Matrix4 ScaleM = CreateScaleMatrix(Scale);
+											Matrix4 TranslationM = CreateTranslationMatrix(Desc.BoxMin);
+											Combined = ScaleM * TranslationM * Combined;
 										}
+										Vec4 UVTransform = (Desc.Flags & MeshFlags::UVPacked)
+											? Vec4{ Desc.UVMin.x, Desc.UVMin.y, Desc.UVScale.x, Desc.UVScale.y }
+											: Vec4{ 0.f, 0.f, 1.f, 1.f };
 
 										u32 MatIndex = Desc.MaterialIndex;
 										u32 TexIndex = Scene.Materials[MatIndex].DiffuseTexture;
 										u32 SRV = DefaultTexture.SRV;
 										float LodClampIndex = 0;
-										if (TexIndex < Scene.Textures.size())
+										if (TexIndex < Scene.Textures.size() && Scene.Textures[TexIndex].TexData.SRV != UINT16_MAX)
 										{
 											auto& T = Scene.Textures[TexIndex];
 											SRV = T.TexData.SRV;
@@ -1238,6 +1277,7 @@ int main(void)
 
 										CommandList->SetGraphicsRoot32BitConstants(3, 1, &MouseX, 18);
 										CommandList->SetGraphicsRoot32BitConstants(3, 1, &MouseY, 19);
+										CommandList->SetGraphicsRoot32BitConstants(3, 4, &UVTransform, 20);
 
 										if (MeshData.PSO != CurrentPSO)
 										{
@@ -1255,14 +1295,22 @@ int main(void)
 										IndexBufferView.BufferLocation = MeshData.IndexBufferCachedPtr;
 										IndexBufferView.SizeInBytes = GetIndexBufferSize(Desc);
 
-										if (Desc.VertexCount <= UINT16_MAX)
+										if (HasShortIndices(Desc))
 											IndexBufferView.Format = DXGI_FORMAT_R16_UINT;
 										else
 											IndexBufferView.Format = DXGI_FORMAT_R32_UINT;
 
 										CommandList->IASetIndexBuffer(&IndexBufferView);
 
-										CommandList->DrawIndexedInstanced(Desc.IndexCount, 1, 0, 0, 0);
+										u32 Lod = SelectMeshLod(Desc, Mesh.Transform, CameraPosition, LodProjectionScale, LodPixelError);
+										if (Desc.LodCount > 0)
+										{
+											CommandList->DrawIndexedInstanced(Desc.Lods[Lod].IndexCount, 1, Desc.Lods[Lod].FirstIndex, 0, 0);
+										}
+										else
+										{
+											CommandList->DrawIndexedInstanced(Desc.IndexCount, 1, 0, 0, 0);
+										}
 									}
 								}
 							}, Scene.StaticGeometry.size(), DrawingThreads
@@ -1755,6 +1803,8 @@ int main(void)
 		TracyD3D12Destroy(gGraphicsProfilingCtx);
 		TracyD3D12Destroy(gComputeProfilingCtx);
 	});
+	UnmountAllPaks(gAssets);
+	StopPakReadThread();
 	StopRenderThread();
 	StopWorkerThreads();
 }
@@ -80,6 +80,7 @@ end
         "./thirdparty/dxc/lib/x64",
         "./thirdparty/winpixeventruntime/bin/x64",
         "./thirdparty/directstorage/native/lib/x64",
+        "./thirdparty/zlib",
     }
 
     files {
@@ -103,6 +104,7 @@ end
         "dxcompiler",
         -- thirdparty
         "CityHash",
+        "libz-static",
         "imgui",
         "glfw3",
         "WinPixEventRuntime",
@@ -112,6 +114,7 @@ end
         "./src/",
         "./thirdparty/glfw/include",
         "./thirdparty/minilzo",
+        "./thirdparty/zlib/include",
         "./thirdparty/imgui",
         "./thirdparty/imnodes",
         "./thirdparty/CityHash/src",
@@ -220,6 +223,7 @@ project "Oven"
         "./thirdparty/dxc/lib/x64",
         "./thirdparty/winpixeventruntime/bin/x64",
         "./thirdparty/directstorage/native/lib/x64",
+        "./thirdparty/zlib",
     }
 
     files {
@@ -244,6 +248,7 @@ project "Oven"
         -- thirdparty
         "irrxml",
         "CityHash",
+        "libz-static",
         "meshoptimizer",
     }
 
@@ -251,6 +256,7 @@ project "Oven"
         "./src/",
         "./thirdparty/glfw/include",
         "./thirdparty/minilzo",
+        "./thirdparty/zlib/include",
         "./thirdparty/tracy/public/tracy",
         "./thirdparty/tracy/public/client",
         "./thirdparty/assimp/include",
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Common.h"
+#include "Containers/StringView.h"
+
+// Stored per pak item, values are part of the file format.
+enum PakCodec : u8
+{
+	PakCodecNone     = 0,
+	PakCodecGDeflate = 1, // DirectStorage, Windows only. The only codec DirectStorage requests can decode
+	PakCodecLZO      = 2, // minilzo, LZO1X-1
+	PakCodecZlib     = 3, // best ratio, slowest to decode
+	PakCodecLZ4      = 4, // LZ4 block format, fastest to decode
+	PakCodecGeometry = 5, // vertex and index buffers, see GeometryCodec.h
+	PakCodecCount,
+
+	PakCodecDefault  = 0xff, // GDeflate for DirectStorage items, LZ4 for everything else
+};
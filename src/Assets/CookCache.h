@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Common.h"
+#include "Containers/Array.h"
+#include "Containers/String.h"
+#include "Containers/StringView.h"
+
+/*
+	COOK CACHE
+
+	Lets Oven skip work whose inputs didn't change since the last run.
+	-- Every cooked output remembers the key it was built with and the files it read
+	-- Keys are content hashes of those files, mixed with the cooker version and flags
+	-- File hashes are reused while size and modification time stay the same
+	-- Intermediate results (compressed payloads, compiled shaders) are stored as blobs addressed by key
+
+	Everything is a no-op until LoadCookCache is called, so the runtime never touches it.
+*/
+
+// One line per record in the manifest, the path is always last so it can contain spaces.
+//   F <size> <mtime> <hash> <path>   file stamp
+//   O <key> <path>                   cooked output
+//   D <path>                         dependency of the preceding output
+struct CookFileStamp
+{
+	u64 Size;
+	u64 ModifiedTime;
+	u64 Hash;
+};
@@ -15,10 +15,31 @@ RawDataView ContainerToView(const T& Container)
 	return RawDataView((const u8*)Container.data(), Size);
 }
 
+// Access pattern hints for MapFile, can be combined.
+// Platforms ignore whatever they can't honour.
+enum MapFileFlags : u32
+{
+	MapFileDefault    = 0,
+	MapFilePopulate   = 1 << 0, // fault every page in up front (MAP_POPULATE / PrefetchVirtualMemory)
+	MapFileSequential = 1 << 1, // aggressive read-ahead, pages are dropped soon after use
+	MapFileWillNeed   = 1 << 2, // asynchronous read-ahead of the whole file
+	MapFileHugePages  = 1 << 3, // 2MB aligned view backed by transparent huge pages where possible
+};
+
 struct FileMapping
 {
-	void* File;
+	void* File;    // HANDLE on Windows, file descriptor on POSIX
 	void* Mapping;
 	void* BasePtr;
 	u64   FileSize;
 };
+
+// One positional read for ReadFileRanges, goes through the file handle instead of faulting the mapping in.
+struct FileReadRange
+{
+	u64   Offset;
+	void* Dest;
+	u64   Size;
+};
+
+FileMapping MapFile(StringView FilePath, u32 Flags = MapFileDefault);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Common.h"
+#include "Containers/String.h"
+
+/*
+	GEOMETRY CODEC
+
+	PakCodecGeometry, made for ___Scene_Vertices and ___Scene_Indeces. Oven encodes every mesh on its own,
+	the stream is a sequence of chunks, each one a GeometryChunkHeader followed by its encoded bytes.
+	Chunks decode back to back, so the layout of the buffer is whatever the chunks add up to.
+	-- Vertices: blocks of up to 256 vertices, every byte of the vertex is its own stream within the block.
+	   A stream holds deltas to the previous vertex, zigzagged and packed in groups of 16 with 0, 2, 4 or 8 bits
+	   per delta, 2 bit group headers up front. Decoder unpacks four streams at a time and transposes them
+	   back into vertices with SSE2, so the stride has to be a multiple of 4.
+	-- Indices: one code byte per triangle. A triangle sharing an edge with one of the last 15 triangles
+	   references that edge, its third vertex is either the next never seen vertex, one of the 14 most recent ones,
+	   or a zigzagged varint delta to the last explicit vertex. Other triangles code all three vertices that way.
+	   Encoder rotates triangles in place to the order they come out of the decoder, winding stays the same.
+	-- Raw: bytes as they are, padding between meshes.
+*/
+
+enum GeometryChunkKind : u8
+{
+	GeometryChunkRaw      = 0,
+	GeometryChunkVertices = 1,
+	GeometryChunkIndices  = 2,
+};
+
+struct GeometryChunkHeader
+{
+	u8  Kind;        // GeometryChunkKind
+	u8  ElementSize; // vertex stride, 2 or 4 for indices, 1 for raw bytes
+	u16 Unused;
+	u32 Count;       // vertices, indices or bytes
+	u32 EncodedSize; // bytes that follow the header
+};
+
+static_assert(sizeof(GeometryChunkHeader) == 12, "Baked into paks");
@@ -2,22 +2,50 @@
 #include "Common.h"
 #include "Util/Math.generated.h"
 
+/*
+	Vertex layout, attributes in this order, the flags pick the formats:
+	-- POSITION  PositionPacked ? 4 x unorm16 within BoxMin..BoxMax, w = 1 : 3 x float
+	-- NORMAL    PositionPacked ? octahedral 2 x snorm16 : unorm 10:10:10:2 of N * 0.5 + 0.5
+	-- TANGENT   HasTangents, octahedral 2 x snorm16, lowest bit of y is 1 when the bitangent is cross(T, N)
+	-- TEXCOORD  UVPacked ? 2 x unorm16 within UVMin..UVMin + UVScale : 2 x half
+	-- COLOR     HasVertexColor, 4 x unorm8
+	Packed attributes are chosen per mesh by Oven when their quantization error is under its bounds.
+*/
 enum MeshFlags : u8 {
 	PositionPacked   = 1 << 0,
 	HasNormals       = 1 << 1,
 	HasVertexColor   = 1 << 2,
 	HasUV0           = 1 << 3,
 	GUI              = 1 << 4,
+	UVPacked         = 1 << 5,
+	HasTangents      = 1 << 6,
+};
+
+#define MESH_MAX_LODS 8
+
+// Indices of a LOD follow the ones before it in the mesh's index buffer, all of them use the same vertices
+struct MeshLod
+{
+	u32   FirstIndex;
+	u32   IndexCount;
+	float Error; // how far the simplified surface can be from the original, in the mesh's units
 };
 
 struct MeshDescription
 {
 	Vec3 BoxMin;
 	Vec3 BoxMax;
+	Vec2 UVMin;
+	Vec2 UVScale;
 
 	u32 VertexCount{};
 	u32 IndexCount{};
 	u32 MaterialIndex{};
 	u8 VertexSize{};
 	u8 Flags{};
+	u8 LodCount{};
+
+	MeshLod Lods[MESH_MAX_LODS]{};
 };
+
+u32 SelectMeshLod(const MeshDescription& Description, const Matrix4& Transform, Vec3 CameraPosition, float ProjectionScale, float MaxPixelError = 1.f);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Common.h"
+#include "Containers/Array.h"
+#include "Util/Math.h"
+
+/*
+	MESH OPTIMIZER
+
+	Cook time reordering of triangles and vertices, what ends up on screen stays the same.
+	-- Vertex cache: triangles reordered so vertices that were just transformed get reused (Forsyth's scoring over an LRU cache)
+	-- Overdraw: cache friendly clusters of triangles sorted so the outward facing ones are drawn first,
+	   as long as the cache efficiency doesn't drop by more than a threshold
+	-- Vertex fetch: vertices renumbered in order of first use, unused ones are dropped
+	-- Simplification: quadric error edge collapses for LODs, borders and attribute seams stay where they are
+
+	ACMR is vertex shader invocations per triangle (3 is the worst, ~0.5 for a regular grid),
+	ATVR is invocations per unique vertex (1 is ideal). Both come from a FIFO cache simulation.
+*/
+
+struct VertexCacheStats
+{
+	float ACMR;
+	float ATVR;
+};
+
+VertexCacheStats AnalyzeVertexCache(const u32* Indices, u64 IndexCount, u32 VertexCount, u32 CacheSize = 16);
+void             OptimizeOverdraw(u32* Indices, u64 IndexCount, const Vec3* Positions, u32 VertexCount, float Threshold = 1.05f);
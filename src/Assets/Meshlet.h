@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Common.h"
+#include "Containers/Array.h"
+#include "Util/Math.h"
+
+/*
+	MESHLETS
+
+	Every mesh is split into small clusters of triangles that can be culled on their own.
+	Scene pak items, all of them little endian arrays of the structs below, meshes back to back:
+	-- ___Scene_MeshletRanges     MeshletRange per mesh, same order as ___Scene_MeshDatas
+	-- ___Scene_Meshlets          Meshlet
+	-- ___Scene_MeshletBounds     MeshletBounds, one per meshlet
+	-- ___Scene_MeshletVertices   u32 per meshlet vertex, index into the mesh's vertices
+	-- ___Scene_MeshletTriangles  3 u8 per triangle, index into the meshlet's vertices, every meshlet padded to 4 bytes
+
+	Bounds are in the mesh's space. Cone culling assumes the renderer's winding,
+	triangle normal is cross(B - A, C - A) and points away from what gets back face culled.
+*/
+
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+struct MeshletRange
+{
+	u32 First;
+	u32 Count;
+};
+
+struct Meshlet
+{
+	u32 VertexOffset;   // first entry in ___Scene_MeshletVertices
+	u32 TriangleOffset; // first byte in ___Scene_MeshletTriangles
+	u32 VertexCount;
+	u32 TriangleCount;
+};
+
+struct MeshletBounds
+{
+	Vec3  Center;
+	float Radius;
+	Vec3  ConeAxis;   // average facing direction
+	float ConeCutoff; // sin of the cone's half angle, 1 when the normals are too spread out to ever cull
+};
+
+static_assert(sizeof(MeshletRange) == 8 && sizeof(Meshlet) == 16 && sizeof(MeshletBounds) == 32, "Baked into paks");
+
+struct SceneMeshlets
+{
+	TArray<MeshletRange>  Ranges;
+	TArray<Meshlet>       Meshlets;
+	TArray<MeshletBounds> Bounds;
+	TArray<u32>           Vertices;
+	TArray<u8>            Triangles;
+};
+
+// Planes point inside, xyz normalized, a point is inside when dot(xyz, P) + w >= 0.
+struct MeshletCullView
+{
+	Vec4 Planes[6];
+	Vec3 CameraPosition;
+};
@@ -7,6 +7,7 @@
 #include "Containers/String.h"
 #include "Containers/Map.h"
 #include "Assets/File.h"
+#include "Assets/Codec.h"
 #include "Render/RenderForwardDeclarations.h"
 
 #include <stdio.h>
@@ -17,15 +18,25 @@
 	PakHeader
 	-- Magic
 	-- Items offset in bytes (from start of file)
+	-- CRC32C of everything from the hashes to the end of the file
 	Data (N number of files, sometimes compressed)
-	Extra data (small and uncompressed, like strings etc.)
-	Hashes
-	Items. Data description (N number of items)
+	Hashes (in perfect hash slot order)
+	Items. Data description (N number of items, same order as hashes)
 	-- Pointer to file name
 	-- Pointer to file data
 	-- Uncompressed data size in bytes
 	-- Compressed data size in bytes
 	-- Flags
+	-- Codec
+	-- Block size (large items are compressed as independent blocks, data starts with a block table)
+	-- CRC32C of the stored (possibly compressed) bytes
+	Bucket seeds for the perfect hash lookup
+	Extra data (small and uncompressed, like strings etc.)
+
+	DELTA PAK
+	Same format, holds only the items that changed or were added since the base,
+	plus tombstone items for the ones that were removed. "___PakDelta" item ties it to its base.
+	OpenPak mounts "<pak>delta" on top of the base if it's there, lookups see the newest version.
 */
 
 struct PakHeader
@@ -35,6 +46,10 @@ struct PakHeader
 	u64 ItemsOffset;
 	u64 NumberOfItems;
 	u64 ExtraDataOffset;
+	u64 SeedsOffset;
+	u64 NumberOfBuckets;
+	u32 MetadataChecksum;
+	u32 Unused;
 };
 
 struct PakItem
@@ -44,8 +59,21 @@ struct PakItem
 	u32 CompressedDataSize;
 	u32 PrivateFlags;
 	u32 FileNameOffsetAndSize;
+	u16 Codec;         // PakCodec, only meaningful when CompressedDataSize != 0
+	u16 BlockSizeLog2; // 0 for a single stream, otherwise data starts with a table of compressed block ends
+	u32 PakFlags;      // PakItemFlags
+	u32 Checksum;      // Crc32C of the bytes in the file, checked before anything is decoded
+	u32 Unused;
+};
+
+// Pak's own per item flags, PrivateFlags belong to whoever inserted the item.
+enum PakItemFlags : u32
+{
+	PakItemTombstone = 1 << 0, // delta paks only, item was removed from the base and has no data
 };
 
+struct PakPendingItem;
+
 struct PakFileWriter
 {
 	FILE* File;
@@ -53,15 +81,32 @@ struct PakFileWriter
 	String         ExtraData;
 	TMap<u32,u64>   HashToItem;
 	TParallelArray<u32, PakItem> Items;
+
+	// pipelined mode: items are compressed on workers and committed to the file in insertion order
+	bool                    Pipelined;
+	u64                     PendingBytes;
+	TDeque<PakPendingItem*> Pending;
 };
 
 struct PakFileReader
 {
 	FileMapping Mapping;
 	IDStorageFile* FileDS;
+	PakFileReader* Overlay; // newer delta mounted on top of this one, lookups try it first
+};
+
+// Destination has to hold the whole uncompressed item and stay alive until the read's ticket is done.
+struct PakReadRequest
+{
+	const PakItem* Item;
+	void*          Dest;
 };
 
-void          InsertIntoPak(PakFileWriter& Pak, StringView FileName, RawDataView Data, u32 PrivateFlags = 0x0, bool UseDirectStorage = false, bool bCompress = true);
+PakFileWriter CreatePak(StringView FilePath, bool Pipelined = false);
+PakFileReader OpenPak(StringView FilePath, u32 MapFlags = MapFileDefault);
+bool          MountPakDelta(PakFileReader& Pak, StringView DeltaPath, u32 MapFlags = MapFileDefault);
+void          InsertIntoPak(PakFileWriter& Pak, StringView FileName, RawDataView Data, u32 PrivateFlags = 0x0, bool UseDirectStorage = false, u8 Codec = PakCodecDefault);
+void          InsertEncodedIntoPak(PakFileWriter& Pak, StringView FileName, RawDataView Data, RawDataView Encoded, u8 Codec, u32 PrivateFlags = 0x0);
 
 template<typename T>
 T GetFileDataTyped(const PakFileReader& Pak, const PakItem& Item)
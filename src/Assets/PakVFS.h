@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Common.h"
+#include "Assets/Pak.h"
+#include "Threading/Mutex.h"
+
+/*
+	PAK VFS
+
+	Several paks mounted as one set of files, like base content + DLC + patches.
+	-- Mounts with higher priority hide items with the same name in lower ones, equal priority goes to the latest mount
+	-- One merged open addressing index over every mount, rebuilt on mount/unmount, lookups never walk the mounts
+	-- Mount and unmount can happen while other threads look things up and read
+	-- Items found through a mount stay valid until it is unmounted, unmount waits for its async reads
+*/
+
+struct PakVFSMount;
+
+struct PakVFSEntry
+{
+	const PakItem* Item; // nullptr for an empty slot
+	u32            Hash;
+	u32            Mount; // index into PakVFS::Mounts
+};
+
+struct PakVFS
+{
+	TArray<PakVFSMount*> Mounts; // highest priority first
+	TArray<PakVFSEntry>  Index;  // power of two size, linear probing
+	u32                  NextMountId;
+
+	TracyLockable(Mutex, MountLock);         // serializes mount and unmount
+	TracySharedLockable(RWLock, IndexLock); // held shared by lookups, exclusively while the index is swapped
+};
+
+u32 MountPak(PakVFS& VFS, StringView FilePath, i32 Priority = 0, u32 MapFlags = MapFileDefault);
+
+template<typename T>
+T GetFileDataTyped(PakVFS& VFS, const PakItem& Item)
+{
+	T Result;
+	CHECK(Item.UncompressedDataSize == sizeof(T));
+
+	FillBuffer(VFS, Item, &Result);
+	return Result;
+}
+
+template<typename T>
+TArray<T> GetFileDataTypedArray(PakVFS& VFS, const PakItem& Item)
+{
+	TArray<T> Result;
+	CHECK(Item.UncompressedDataSize % sizeof(T) == 0);
+	Result.resize(Item.UncompressedDataSize / sizeof(T));
+
+	FillBuffer(VFS, Item, Result.data());
+	return Result;
+}
@@ -0,0 +1,451 @@
+#include "Assets/Codec.generated.h"
+#include "Assets/File.h"
+#include "Assets/Private/GeometryCodec.Declarations.h"
+#include "Containers/String.h"
+#include "Containers/StringView.h"
+#include "Util/Debug.h"
+#include "Util/Util.h"
+
+#include <minilzo.h>
+#include <zlib.h>
+#include <string.h>
+#include <chrono>
+#include <tracy/Tracy.hpp>
+
+#if _WIN32
+#include <dstorage.h>
+#include "Util/Semaphore.generated.h"
+
+static IDStorageCompressionCodec* gDirectStorageCompressionCodecs[8];
+static Semaphore gDirectStorageSemaphore{8};
+#endif
+
+// LZ4 block format, see https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+namespace {
+namespace LZ4
+{
+	const u32 MinMatch     = 4;
+	const u32 LastLiterals = 5;
+	const u32 MatchFind    = 12; // last match has to start at least this far from the end
+	const u32 HashLog      = 14;
+	const u32 MaxOffset    = 65535;
+
+	u32 Read32(const u8* P) { u32 Result; memcpy(&Result, P, 4); return Result; }
+	u32 Hash(u32 Sequence) { return (Sequence * 2654435761U) >> (32 - HashLog); }
+
+	u64 Bound(u64 Size)
+	{
+		return Size + Size / 255 + 16;
+	}
+
+	u8* WriteLength(u8* Out, u64 Length)
+	{
+		while (Length >= 255)
+		{
+			*Out++ = 255;
+			Length -= 255;
+		}
+		*Out++ = (u8)Length;
+		return Out;
+	}
+
+	u8* WriteSequence(u8* Out, const u8* Literals, u64 LiteralCount, u32 Offset, u64 MatchLength)
+	{
+		u8* Token = Out++;
+		*Token = (u8)(std::min<u64>(LiteralCount, 15) << 4);
+		if (LiteralCount >= 15)
+		{
+			Out = WriteLength(Out, LiteralCount - 15);
+		}
+		memcpy(Out, Literals, LiteralCount);
+		Out += LiteralCount;
+
+		if (MatchLength == 0) // last sequence, literals only
+		{
+			return Out;
+		}
+
+		*Out++ = (u8)(Offset & 0xff);
+		*Out++ = (u8)(Offset >> 8);
+
+		MatchLength -= MinMatch;
+		*Token |= (u8)std::min<u64>(MatchLength, 15);
+		if (MatchLength >= 15)
+		{
+			Out = WriteLength(Out, MatchLength - 15);
+		}
+		return Out;
+	}
+
+	u64 Compress(const u8* Src, u64 SrcSize, u8* Dst, u64 DstCapacity)
+	{
+		if (DstCapacity < Bound(SrcSize))
+		{
+			return 0;
+		}
+
+		static thread_local u32 Table[1 << HashLog];
+		memset(Table, 0xff, sizeof(Table));
+
+		const u8* End = Src + SrcSize;
+		const u8* Anchor = Src;
+		const u8* It = Src;
+		u8* Out = Dst;
+
+		if (SrcSize > MatchFind)
+		{
+			const u8* MatchFindLimit = End - MatchFind;
+			const u8* MatchLimit = End - LastLiterals;
+			u32 Step = 1 << 6; // skip faster through data that doesn't compress
+
+			while (It < MatchFindLimit)
+			{
+				u32 Sequence = Read32(It);
+				u32 H = Hash(Sequence);
+				u32 Candidate = Table[H];
+				Table[H] = u32(It - Src);
+
+				if (Candidate == ~0U || u64(It - Src) - Candidate > MaxOffset || Read32(Src + Candidate) != Sequence)
+				{
+					It += Step >> 6;
+					Step++;
+					continue;
+				}
+				Step = 1 << 6;
+
+				const u8* Match = Src + Candidate;
+				while (It > Anchor && Match > Src && It[-1] == Match[-1])
+				{
+					It--;
+					Match--;
+				}
+
+				const u8* MatchEnd = It + MinMatch;
+				const u8* Ref = Match + MinMatch;
+				while (MatchEnd < MatchLimit && *MatchEnd == *Ref)
+				{
+					MatchEnd++;
+					Ref++;
+				}
+
+				Out = WriteSequence(Out, Anchor, It - Anchor, u32(It - Match), MatchEnd - It);
+				It = MatchEnd;
+				Anchor = It;
+
+				if (It < MatchFindLimit)
+				{
+					Table[Hash(Read32(It - 2))] = u32(It - 2 - Src);
+				}
+			}
+		}
+
+		Out = WriteSequence(Out, Anchor, End - Anchor, 0, 0);
+		return Out - Dst;
+	}
+
+	bool Decompress(const u8* Src, u64 SrcSize, u8* Dst, u64 DstSize)
+	{
+		const u8* In = Src;
+		const u8* InEnd = Src + SrcSize;
+		u8* Out = Dst;
+		u8* OutEnd = Dst + DstSize;
+
+		while (In < InEnd)
+		{
+			u8 Token = *In++;
+
+			u64 LiteralCount = Token >> 4;
+			if (LiteralCount == 15)
+			{
+				u8 Byte;
+				do
+				{
+					if (In >= InEnd) return false;
+					Byte = *In++;
+					LiteralCount += Byte;
+				} while (Byte == 255);
+			}
+
+			if (LiteralCount > u64(InEnd - In) || LiteralCount > u64(OutEnd - Out))
+			{
+				return false;
+			}
+			memcpy(Out, In, LiteralCount);
+			Out += LiteralCount;
+			In += LiteralCount;
+
+			if (In == InEnd)
+			{
+				break;
+			}
+
+			if (InEnd - In < 2)
+			{
+				return false;
+			}
+			u32 Offset = In[0] | (u32(In[1]) << 8);
+			In += 2;
+			if (Offset == 0 || Offset > u64(Out - Dst))
+			{
+				return false;
+			}
+
+			u64 MatchLength = Token & 15;
+			if (MatchLength == 15)
+			{
+				u8 Byte;
+				do
+				{
+					if (In >= InEnd) return false;
+					Byte = *In++;
+					MatchLength += Byte;
+				} while (Byte == 255);
+			}
+			MatchLength += MinMatch;
+
+			if (MatchLength > u64(OutEnd - Out))
+			{
+				return false;
+			}
+
+			const u8* Match = Out - Offset;
+			if (Offset >= MatchLength)
+			{
+				memcpy(Out, Match, MatchLength);
+				Out += MatchLength;
+			}
+			else if (Offset >= 8)
+			{
+				u8* MatchOutEnd = Out + MatchLength;
+				while (Out + 8 <= MatchOutEnd)
+				{
+					memcpy(Out, Match, 8);
+					Out += 8;
+					Match += 8;
+				}
+				while (Out < MatchOutEnd)
+				{
+					*Out++ = *Match++;
+				}
+			}
+			else
+			{
+				for (u64 i = 0; i < MatchLength; ++i)
+				{
+					*Out++ = *Match++;
+				}
+			}
+		}
+
+		return Out == OutEnd;
+	}
+}
+}
+
+void InitCodecs()
+{
+	int LZOResult = lzo_init();
+	CHECK(LZOResult == LZO_E_OK);
+
+#if _WIN32
+	for (int i = 0; i < ArrayCount(gDirectStorageCompressionCodecs); ++i)
+	{
+		DStorageCreateCompressionCodec(DSTORAGE_COMPRESSION_FORMAT_GDEFLATE, 0, IID_PPV_ARGS(&gDirectStorageCompressionCodecs[i]));
+	}
+#endif
+}
+
+StringView GetCodecName(u8 Codec)
+{
+	switch (Codec)
+	{
+	case PakCodecNone:     return "None";
+	case PakCodecGDeflate: return "GDeflate";
+	case PakCodecLZO:      return "LZO";
+	case PakCodecZlib:     return "Zlib";
+	case PakCodecLZ4:      return "LZ4";
+	case PakCodecGeometry: return "Geometry";
+	}
+	return "Unknown";
+}
+
+bool IsCodecAvailable(u8 Codec)
+{
+#if _WIN32
+	return Codec < PakCodecCount;
+#else
+	return Codec < PakCodecCount && Codec != PakCodecGDeflate;
+#endif
+}
+
+u8 ResolveCodec(u8 Codec, bool UseDirectStorage)
+{
+	if (UseDirectStorage)
+	{
+		CHECK(Codec == PakCodecDefault || Codec == PakCodecGDeflate || Codec == PakCodecNone, "DirectStorage can only decode GDeflate");
+		Codec = Codec == PakCodecNone ? PakCodecNone : PakCodecGDeflate;
+	}
+	else if (Codec == PakCodecDefault)
+	{
+		Codec = PakCodecLZ4;
+	}
+
+	return IsCodecAvailable(Codec) ? Codec : PakCodecNone;
+}
+
+u64 CompressBound(u8 Codec, u64 Size)
+{
+	switch (Codec)
+	{
+#if _WIN32
+	case PakCodecGDeflate: return gDirectStorageCompressionCodecs[0]->CompressBufferBound((u32)Size);
+#endif
+	case PakCodecLZO:      return COMPRESSED_MAX_SIZE(Size);
+	case PakCodecZlib:     return compressBound((uLong)Size);
+	case PakCodecLZ4:      return LZ4::Bound(Size);
+	case PakCodecGeometry: return GetGeometryEncodeBound(Size);
+	}
+	return Size;
+}
+
+// Returns the compressed size, 0 if the codec failed or Dst is too small.
+u64 CompressBuffer(u8 Codec, RawDataView Src, u8* Dst, u64 DstCapacity)
+{
+	ZoneScoped;
+
+	switch (Codec)
+	{
+#if _WIN32
+	case PakCodecGDeflate:
+	{
+		size_t DstLen = 0;
+		auto* DSCodec = gDirectStorageCompressionCodecs[gDirectStorageSemaphore.Aquire()];
+		HRESULT Result = DSCodec->CompressBuffer(
+			(const void*)Src.data(),
+			Src.size(),
+			DSTORAGE_COMPRESSION_BEST_RATIO,
+			Dst,
+			DstCapacity,
+			&DstLen
+		);
+		gDirectStorageSemaphore.Release();
+		return SUCCEEDED(Result) ? DstLen : 0;
+	}
+#endif
+	case PakCodecLZO:
+	{
+		static thread_local lzo_align_t WorkMemory[(LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t)];
+
+		CHECK(DstCapacity >= COMPRESSED_MAX_SIZE(Src.size()));
+		lzo_uint DstLen = (lzo_uint)DstCapacity;
+		int Result = lzo1x_1_compress(Src.data(), (lzo_uint)Src.size(), Dst, &DstLen, WorkMemory);
+		return Result == LZO_E_OK ? DstLen : 0;
+	}
+	case PakCodecZlib:
+	{
+		uLongf DstLen = (uLongf)DstCapacity;
+		int Result = compress2(Dst, &DstLen, Src.data(), (uLong)Src.size(), Z_BEST_COMPRESSION);
+		return Result == Z_OK ? DstLen : 0;
+	}
+	case PakCodecLZ4:
+		return LZ4::Compress(Src.data(), Src.size(), Dst, DstCapacity);
+	case PakCodecGeometry:
+		return EncodeGeometry(Src, Dst, DstCapacity);
+	}
+	return 0;
+}
+
+bool DecompressBuffer(u8 Codec, RawDataView Src, u8* Dst, u64 DstSize)
+{
+	ZoneScoped;
+
+	switch (Codec)
+	{
+	case PakCodecNone:
+		if (Src.size() != DstSize) return false;
+		memcpy(Dst, Src.data(), DstSize);
+		return true;
+#if _WIN32
+	case PakCodecGDeflate:
+	{
+		size_t UncompressedOut = 0;
+		auto* DSCodec = gDirectStorageCompressionCodecs[gDirectStorageSemaphore.Aquire()];
+		HRESULT Result = DSCodec->DecompressBuffer(Src.data(), Src.size(), Dst, DstSize, &UncompressedOut);
+		gDirectStorageSemaphore.Release();
+		return SUCCEEDED(Result) && UncompressedOut == DstSize;
+	}
+#endif
+	case PakCodecLZO:
+	{
+		lzo_uint DstLen = (lzo_uint)DstSize;
+		int Result = lzo1x_decompress_safe(Src.data(), (lzo_uint)Src.size(), Dst, &DstLen, nullptr);
+		return Result == LZO_E_OK && DstLen == DstSize;
+	}
+	case PakCodecZlib:
+	{
+		uLongf DstLen = (uLongf)DstSize;
+		int Result = uncompress(Dst, &DstLen, Src.data(), (uLong)Src.size());
+		return Result == Z_OK && DstLen == DstSize;
+	}
+	case PakCodecLZ4:
+		return LZ4::Decompress(Src.data(), Src.size(), Dst, DstSize);
+	case PakCodecGeometry:
+		return DecodeGeometry(Src, Dst, DstSize);
+	}
+
+	CHECK(false, "Codec not available on this platform");
+	return false;
+}
+
+// Prints ratio, compression speed and single threaded decode speed of every available codec.
+void BenchmarkCodecs(RawDataView Sample, u32 Repeats)
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	if (Sample.empty())
+	{
+		return;
+	}
+
+	String Decoded(Sample.size(), '\0');
+	printf("%-10s %10s %14s %14s\n", "codec", "ratio", "encode MB/s", "decode GB/s");
+	for (u8 Codec = PakCodecNone + 1; Codec < PakCodecCount; ++Codec)
+	{
+		if (!IsCodecAvailable(Codec))
+		{
+			continue;
+		}
+
+		String Compressed(CompressBound(Codec, Sample.size()), '\0');
+
+		auto EncodeStart = Clock::now();
+		u64 CompressedSize = CompressBuffer(Codec, Sample, (u8*)Compressed.data(), Compressed.size());
+		double EncodeSeconds = std::chrono::duration<double>(Clock::now() - EncodeStart).count();
+
+		if (CompressedSize == 0)
+		{
+			printf("%-10.*s failed to compress\n", VIEW_PRINT(GetCodecName(Codec)));
+			continue;
+		}
+
+		RawDataView CompressedView((const u8*)Compressed.data(), CompressedSize);
+		bool Valid = true;
+		auto DecodeStart = Clock::now();
+		for (u32 i = 0; i < Repeats; ++i)
+		{
+			Valid &= DecompressBuffer(Codec, CompressedView, (u8*)Decoded.data(), Decoded.size());
+		}
+		double DecodeSeconds = std::chrono::duration<double>(Clock::now() - DecodeStart).count();
+
+		Valid &= memcmp(Decoded.data(), Sample.data(), Sample.size()) == 0;
+		CHECK(Valid);
+
+		printf("%-10.*s %10.3f %14.1f %14.2f%s\n",
+			VIEW_PRINT(GetCodecName(Codec)),
+			double(Sample.size()) / double(CompressedSize),
+			double(Sample.size()) / EncodeSeconds / 1_mb,
+			double(Sample.size()) * Repeats / DecodeSeconds / 1_gb,
+			Valid ? "" : " MISMATCH"
+		);
+	}
+}
@@ -0,0 +1,330 @@
+#include "Assets/CookCache.generated.h"
+#include "Assets/File.generated.h"
+#include "Assets/Private/File.Declarations.h"
+#include "Containers/Map.h"
+#include "Containers/String.generated.h"
+#include "Containers/Private/String.Declarations.h"
+#include "Threading/Mutex.h"
+#include "Util/Debug.h"
+#include "Util/Util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <stdio.h>
+#include <tracy/Tracy.hpp>
+
+#define COOK_KEY_SEED 0x4F56454E434F4F4Bull // "OVENCOOK"
+
+struct CookOutput
+{
+	u64            Key;
+	TArray<String> Dependencies;
+};
+
+static String gCookCacheManifestPath; // empty while the cache is disabled
+static String gCookCacheBlobsPath;
+static TMap<String, CookFileStamp> gCookFiles;
+static TMap<String, CookOutput>    gCookOutputs;
+static std::atomic<u64>            gCookBlobTempCounter;
+static TracyLockable(Mutex, gCookCacheLock);
+
+namespace {
+	bool StatFile(const String& Path, u64& Size, u64& ModifiedTime)
+	{
+		std::error_code Error;
+		Size = std::filesystem::file_size(Path, Error);
+		if (Error)
+		{
+			return false;
+		}
+		ModifiedTime = (u64)std::filesystem::last_write_time(Path, Error).time_since_epoch().count();
+		return !Error;
+	}
+
+	String GetCookBlobPath(u64 Key)
+	{
+		return StringFromFormat("%s%016llx", gCookCacheBlobsPath.c_str(), Key);
+	}
+
+	void ParseCookManifest(StringView Text)
+	{
+		CookOutput* CurrentOutput = nullptr;
+		while (!Text.empty())
+		{
+			u64 LineEnd = Text.find('\n');
+			if (LineEnd == StringView::npos)
+			{
+				LineEnd = Text.size();
+			}
+			String Line(Text.data(), LineEnd);
+			Text.remove_prefix(std::min<u64>(LineEnd + 1, Text.size()));
+
+			if (!Line.empty() && Line.back() == '\r')
+			{
+				Line.pop_back();
+			}
+			if (Line.size() < 3)
+			{
+				continue;
+			}
+
+			int PathStart = 0;
+			if (Line[0] == 'F')
+			{
+				CookFileStamp Stamp{};
+				if (sscanf(Line.c_str(), "F %llu %llu %llx %n", &Stamp.Size, &Stamp.ModifiedTime, &Stamp.Hash, &PathStart) >= 3 && PathStart > 0)
+				{
+					gCookFiles[Line.substr(PathStart)] = Stamp;
+				}
+			}
+			else if (Line[0] == 'O')
+			{
+				u64 Key = 0;
+				CurrentOutput = nullptr;
+				if (sscanf(Line.c_str(), "O %llx %n", &Key, &PathStart) >= 1 && PathStart > 0)
+				{
+					CurrentOutput = &gCookOutputs[Line.substr(PathStart)];
+					CurrentOutput->Key = Key;
+					CurrentOutput->Dependencies.clear();
+				}
+			}
+			else if (Line[0] == 'D' && CurrentOutput)
+			{
+				CurrentOutput->Dependencies.push_back(Line.substr(2));
+			}
+		}
+	}
+}
+
+bool IsCookCacheEnabled()
+{
+	return !gCookCacheManifestPath.empty();
+}
+
+void LoadCookCache(StringView Directory)
+{
+	ZoneScoped;
+	ScopedLock AutoLock(gCookCacheLock);
+
+	String Dir(Directory);
+	gCookCacheManifestPath = Dir + "/manifest.txt";
+	gCookCacheBlobsPath = Dir + "/blobs/";
+
+	std::error_code Error;
+	std::filesystem::create_directories(gCookCacheBlobsPath, Error);
+	CHECK(!Error, "Couldn't create cook cache directory");
+
+	gCookFiles.clear();
+	gCookOutputs.clear();
+
+	if (!std::filesystem::exists(gCookCacheManifestPath, Error))
+	{
+		return;
+	}
+
+	FileMapping Manifest = MapFile(gCookCacheManifestPath);
+	if (IsValid(Manifest))
+	{
+		ParseCookManifest(GetAsStringView(Manifest));
+		UnmapFile(Manifest);
+	}
+}
+
+void SaveCookCache()
+{
+	ZoneScoped;
+	if (!IsCookCacheEnabled())
+	{
+		return;
+	}
+
+	ScopedLock AutoLock(gCookCacheLock);
+
+	// written next to the old one and swapped in, a crash mid-write keeps the previous manifest
+	String TempPath = gCookCacheManifestPath + ".tmp";
+	FILE* File = fopen(TempPath.c_str(), "wb");
+	CHECK(File, "Couldn't write cook cache manifest");
+	if (!File)
+	{
+		return;
+	}
+
+	for (auto& [Path, Stamp] : gCookFiles)
+	{
+		fprintf(File, "F %llu %llu %016llx %s\n", Stamp.Size, Stamp.ModifiedTime, Stamp.Hash, Path.c_str());
+	}
+	for (auto& [Path, Output] : gCookOutputs)
+	{
+		fprintf(File, "O %016llx %s\n", Output.Key, Path.c_str());
+		for (const String& Dependency : Output.Dependencies)
+		{
+			fprintf(File, "D %s\n", Dependency.c_str());
+		}
+	}
+	fclose(File);
+
+	std::error_code Error;
+	std::filesystem::rename(TempPath, gCookCacheManifestPath, Error);
+	CHECK(!Error, "Couldn't replace cook cache manifest");
+}
+
+// Content hash of a file, 0 if it doesn't exist.
+// Hashes are reused as long as size and modification time match the recorded stamp.
+u64 HashFileForCook(StringView Path)
+{
+	ZoneScoped;
+	String PathString(Path);
+
+	u64 Size = 0;
+	u64 ModifiedTime = 0;
+	if (!StatFile(PathString, Size, ModifiedTime))
+	{
+		return 0;
+	}
+
+	{
+		ScopedLock AutoLock(gCookCacheLock);
+		auto It = gCookFiles.find(PathString);
+		if (It != gCookFiles.end() && It->second.Size == Size && It->second.ModifiedTime == ModifiedTime)
+		{
+			return It->second.Hash;
+		}
+	}
+
+	CookFileStamp Stamp{ Size, ModifiedTime, HashData64(nullptr, 0, COOK_KEY_SEED) };
+	if (Size != 0)
+	{
+		FileMapping File = MapFile(PathString, MapFileSequential);
+		if (!IsValid(File))
+		{
+			return 0;
+		}
+		Stamp.Hash = HashData64(File.BasePtr, File.FileSize, COOK_KEY_SEED);
+		UnmapFile(File);
+	}
+
+	if (IsCookCacheEnabled())
+	{
+		ScopedLock AutoLock(gCookCacheLock);
+		gCookFiles[PathString] = Stamp;
+	}
+	return Stamp.Hash;
+}
+
+// Key for an output built from Inputs, Salt carries the cooker version and anything else that changes the result.
+u64 ComputeCookKey(const TArray<String>& Inputs, u64 Salt)
+{
+	ZoneScoped;
+	u64 Key = HashData64(&Salt, sizeof(Salt), COOK_KEY_SEED);
+	for (const String& Input : Inputs)
+	{
+		u64 FileHash = HashFileForCook(Input);
+		Key = HashData64(Input.data(), Input.size(), Key);
+		Key = HashData64(&FileHash, sizeof(FileHash), Key);
+	}
+	return Key;
+}
+
+// Inputs recorded by the last cook of Output, empty if it was never cooked.
+TArray<String> GetCookDependencies(StringView Output)
+{
+	ScopedLock AutoLock(gCookCacheLock);
+	auto It = gCookOutputs.find(String(Output));
+	if (It == gCookOutputs.end())
+	{
+		return TArray<String>();
+	}
+	return It->second.Dependencies;
+}
+
+bool IsCookUpToDate(StringView Output, u64 Key)
+{
+	if (!IsCookCacheEnabled())
+	{
+		return false;
+	}
+
+	String OutputString(Output);
+	{
+		ScopedLock AutoLock(gCookCacheLock);
+		auto It = gCookOutputs.find(OutputString);
+		if (It == gCookOutputs.end() || It->second.Key != Key)
+		{
+			return false;
+		}
+	}
+
+	std::error_code Error;
+	return std::filesystem::exists(OutputString, Error);
+}
+
+void RecordCook(StringView Output, u64 Key, const TArray<String>& Dependencies)
+{
+	if (!IsCookCacheEnabled())
+	{
+		return;
+	}
+
+	ScopedLock AutoLock(gCookCacheLock);
+	CookOutput& Record = gCookOutputs[String(Output)];
+	Record.Key = Key;
+	Record.Dependencies = Dependencies;
+}
+
+bool LoadCookBlob(u64 Key, String& Out)
+{
+	ZoneScoped;
+	if (!IsCookCacheEnabled())
+	{
+		return false;
+	}
+
+	// a miss is the common case, check before MapFile complains about it
+	String Path = GetCookBlobPath(Key);
+	std::error_code Error;
+	if (!std::filesystem::exists(Path, Error))
+	{
+		return false;
+	}
+
+	FileMapping Blob = MapFile(Path);
+	if (!IsValid(Blob))
+	{
+		return false;
+	}
+	Out.assign((const char*)Blob.BasePtr, Blob.FileSize);
+	UnmapFile(Blob);
+	return true;
+}
+
+void StoreCookBlob(u64 Key, RawDataView Data)
+{
+	ZoneScoped;
+	if (!IsCookCacheEnabled())
+	{
+		return;
+	}
+
+	// several workers can produce the same blob, each writes its own temp file and the last rename wins
+	String Path = GetCookBlobPath(Key);
+	String TempPath = StringFromFormat("%s.%llu.tmp", Path.c_str(), gCookBlobTempCounter++);
+
+	FILE* File = fopen(TempPath.c_str(), "wb");
+	if (!File)
+	{
+		return;
+	}
+	u64 Written = fwrite(Data.data(), 1, Data.size(), File);
+	fclose(File);
+
+	std::error_code Error;
+	if (Written == Data.size())
+	{
+		std::filesystem::rename(TempPath, Path, Error);
+	}
+	else
+	{
+		std::filesystem::remove(TempPath, Error);
+	}
+}
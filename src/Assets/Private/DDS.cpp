@@ -1,4 +1,3 @@
-#include <stb/stb_dxt.h>
 #include "Common.h"
 #include "Util/Debug.generated.h"
 #include "Assets/TextureDescription.generated.h"
@@ -545,28 +544,6 @@ static DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf)
     return DXGI_FORMAT_UNKNOWN;
 }
 
-void CompressImageDxt1FromRGBA8(u8* In, u8* Out, u32 Width, u32 Height)
-{
-	u32* InPixels = (u32*)In;
-	CHECK(Width % 4 == 0 && Height % 4 == 0);
-	for (u32 y = 0; y < Height; y += 4)
-	{
-		for (u32 x = 0; x < Width; x += 4)
-		{
-			u32 Block[16];
-			u64 Index = 0;
-			for (int iy = 0; iy < 4; ++iy)
-			for (int ix = 0; ix < 4; ++ix)
-			{
-				Block[Index] = InPixels[(y + iy) * Width + x + ix];
-				Index++;
-			}
-			stb_compress_dxt_block(Out, (u8*)Block, 0, 0);
-			Out += 8;
-		}
-	}
-}
-
 enum D3D11_RESOURCE_DIMENSION {
   D3D11_RESOURCE_DIMENSION_UNKNOWN = 0,
   D3D11_RESOURCE_DIMENSION_BUFFER = 1,
@@ -701,6 +678,7 @@ TextureDescription AdvanceToDataAndGetDescription(const u8*& DDSFile)
     case DXGI_FORMAT_BC3_UNORM: Result = 2; break;
     case DXGI_FORMAT_BC4_UNORM: Result = 3; break;
     case DXGI_FORMAT_BC5_UNORM: Result = 4; break;
+    case DXGI_FORMAT_BC7_UNORM: Result = 5; break;
     default: CHECK(false);
     }
 
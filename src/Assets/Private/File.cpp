@@ -1,28 +1,58 @@
 #include "Assets/File.generated.h"
+#include "Containers/String.h"
+#include "Util/Math.h"
+#include "Util/Util.h"
+
+#include <stdio.h>
+
+#if _WIN32
 #include "System/Win32.generated.h"
+#else
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#define MAP_FILE_OPEN_RETRIES 50
+#define READ_MAX_IOVECS 64
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
 
-FileMapping MapFile(StringView FilePath)
+#if _WIN32
+FileMapping MapFile(StringView FilePath, u32 Flags)
 {
 	ZoneScoped;
 
-	FileMapping Result;
+	FileMapping Result{};
+
+	DWORD FileFlags = FILE_ATTRIBUTE_NORMAL;
+	if (Flags & MapFileSequential)
+	{
+		FileFlags |= FILE_FLAG_SEQUENTIAL_SCAN;
+	}
 
-	i32 Tries = 0;
-	while (true)
+	// the file can be briefly locked by whoever is still writing it,
+	// anything else is not going to fix itself by waiting
+	for (i32 Tries = 0; ; ++Tries)
 	{
 		Result.File = CreateFileA(FilePath.data(), GENERIC_READ,
-			FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+			FILE_SHARE_READ, NULL, OPEN_EXISTING, FileFlags, 0);
 
 		if (Result.File != INVALID_HANDLE_VALUE)
 		{
 			break;
 		}
-		else if (++Tries > 500)
+
+		DWORD Error = GetLastError();
+		if (Error != ERROR_SHARING_VIOLATION || Tries >= MAP_FILE_OPEN_RETRIES)
 		{
-			const char* err = strerror(GetLastError());
-			printf("%s\n", err);
-			Sleep(100);
+			printf("Failed to open %.*s (error %lu)\n", VIEW_PRINT(FilePath), Error);
+			Result.File = nullptr;
+			return Result;
 		}
+		Sleep(100);
 	}
 
 	LARGE_INTEGER liFileSize;
@@ -31,6 +61,7 @@ FileMapping MapFile(StringView FilePath)
 	if (!Success || liFileSize.QuadPart == 0)
 	{
 		CloseHandle(Result.File);
+		Result.File = nullptr;
 		return Result;
 	}
 
@@ -40,6 +71,7 @@ FileMapping MapFile(StringView FilePath)
 	if (Result.Mapping == 0)
 	{
 		CloseHandle(Result.File);
+		Result.File = nullptr;
 		return Result;
 	}
 
@@ -50,12 +82,135 @@ FileMapping MapFile(StringView FilePath)
 	{
 		CloseHandle(Result.Mapping);
 		CloseHandle(Result.File);
+		Result.Mapping = nullptr;
+		Result.File = nullptr;
 		return Result;
 	}
 
 	Result.FileSize = liFileSize.QuadPart;
+
+	// large pages can only back pagefile sections, so MapFileHugePages is ignored here
+	if (Flags & (MapFilePopulate | MapFileWillNeed))
+	{
+		WIN32_MEMORY_RANGE_ENTRY Range;
+		Range.VirtualAddress = Result.BasePtr;
+		Range.NumberOfBytes = (SIZE_T)Result.FileSize;
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &Range, 0);
+	}
+
+	return Result;
+}
+#else
+namespace
+{
+	void* MapFileHugePageAligned(int Descriptor, u64 Size, int MapFlags)
+	{
+		// reserve enough address space to find a 2MB aligned spot, then map the file over it
+		u64 ReserveSize = Size + HUGE_PAGE_SIZE;
+		u8* Reserved = (u8*)mmap(nullptr, ReserveSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (Reserved == MAP_FAILED)
+		{
+			return MAP_FAILED;
+		}
+
+		u8* Aligned = (u8*)AlignUp((uintptr_t)Reserved, HUGE_PAGE_SIZE);
+		void* Result = mmap(Aligned, Size, PROT_READ, MapFlags | MAP_FIXED, Descriptor, 0);
+		if (Result == MAP_FAILED)
+		{
+			munmap(Reserved, ReserveSize);
+			return MAP_FAILED;
+		}
+
+		u64 PageSize = (u64)sysconf(_SC_PAGESIZE);
+		u8* MappedEnd = Aligned + AlignUp(Size, PageSize);
+		if (Aligned > Reserved)
+		{
+			munmap(Reserved, Aligned - Reserved);
+		}
+		if (MappedEnd < Reserved + ReserveSize)
+		{
+			munmap(MappedEnd, Reserved + ReserveSize - MappedEnd);
+		}
+
+#ifdef MADV_HUGEPAGE
+		madvise(Result, Size, MADV_HUGEPAGE);
+#endif
+		return Result;
+	}
+}
+
+FileMapping MapFile(StringView FilePath, u32 Flags)
+{
+	ZoneScoped;
+
+	FileMapping Result{};
+
+	String NullTerminatedPath(FilePath);
+	int Descriptor = -1;
+	for (i32 Tries = 0; ; ++Tries)
+	{
+		Descriptor = open(NullTerminatedPath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (Descriptor >= 0)
+		{
+			break;
+		}
+
+		if ((errno != EINTR && errno != EAGAIN) || Tries >= MAP_FILE_OPEN_RETRIES)
+		{
+			printf("Failed to open %.*s (%s)\n", VIEW_PRINT(FilePath), strerror(errno));
+			return Result;
+		}
+	}
+
+	struct stat FileStat;
+	if (fstat(Descriptor, &FileStat) != 0 || FileStat.st_size == 0)
+	{
+		close(Descriptor);
+		return Result;
+	}
+
+	u64 Size = (u64)FileStat.st_size;
+
+	int MapFlags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+	if (Flags & MapFilePopulate)
+	{
+		MapFlags |= MAP_POPULATE;
+	}
+#endif
+
+	void* BasePtr = MAP_FAILED;
+	if ((Flags & MapFileHugePages) && Size >= HUGE_PAGE_SIZE)
+	{
+		BasePtr = MapFileHugePageAligned(Descriptor, Size, MapFlags);
+	}
+	if (BasePtr == MAP_FAILED)
+	{
+		BasePtr = mmap(nullptr, Size, PROT_READ, MapFlags, Descriptor, 0);
+	}
+
+	CHECK(BasePtr != MAP_FAILED);
+	if (BasePtr == MAP_FAILED)
+	{
+		close(Descriptor);
+		return Result;
+	}
+
+	if (Flags & MapFileSequential)
+	{
+		madvise(BasePtr, Size, MADV_SEQUENTIAL);
+	}
+	if (Flags & MapFileWillNeed)
+	{
+		madvise(BasePtr, Size, MADV_WILLNEED);
+	}
+
+	Result.File     = (void*)(intptr_t)Descriptor;
+	Result.BasePtr  = BasePtr;
+	Result.FileSize = Size;
 	return Result;
 }
+#endif
 
 RawDataView GetView(const FileMapping& Mapping)
 {
@@ -72,18 +227,117 @@ bool IsValid(const FileMapping& Mapping)
 	return Mapping.BasePtr;
 }
 
+// Blocking positional reads, Ranges have to be sorted by offset.
+// Ranges that follow each other in the file are read with a single preadv on POSIX.
+bool ReadFileRanges(const FileMapping& Mapping, const FileReadRange* Ranges, u64 Count)
+{
+	ZoneScoped;
+
+#if _WIN32
+	for (u64 i = 0; i < Count; ++i)
+	{
+		CHECK(Ranges[i].Offset + Ranges[i].Size <= Mapping.FileSize);
+		if (Mapping.File == INVALID_HANDLE_VALUE)
+		{
+			memcpy(Ranges[i].Dest, (u8*)Mapping.BasePtr + Ranges[i].Offset, Ranges[i].Size);
+			continue;
+		}
+
+		u64 Done = 0;
+		while (Done < Ranges[i].Size)
+		{
+			OVERLAPPED Overlapped{};
+			u64 Offset = Ranges[i].Offset + Done;
+			Overlapped.Offset = (DWORD)Offset;
+			Overlapped.OffsetHigh = (DWORD)(Offset >> 32);
+
+			DWORD ToRead = (DWORD)std::min<u64>(Ranges[i].Size - Done, 1_gb);
+			DWORD Read = 0;
+			if (!ReadFile(Mapping.File, (u8*)Ranges[i].Dest + Done, ToRead, &Read, &Overlapped) || Read == 0)
+			{
+				return false;
+			}
+			Done += Read;
+		}
+	}
+	return true;
+#else
+	int Descriptor = (int)(intptr_t)Mapping.File;
+
+	u64 i = 0;
+	while (i < Count)
+	{
+		// gather the run of ranges that are back to back in the file
+		iovec Vectors[READ_MAX_IOVECS];
+		u64 RunOffset = Ranges[i].Offset;
+		u64 RunSize = 0;
+		int NumVectors = 0;
+		while (i + NumVectors < Count && NumVectors < READ_MAX_IOVECS && Ranges[i + NumVectors].Offset == RunOffset + RunSize)
+		{
+			const FileReadRange& Range = Ranges[i + NumVectors];
+			CHECK(Range.Offset + Range.Size <= Mapping.FileSize);
+			Vectors[NumVectors].iov_base = Range.Dest;
+			Vectors[NumVectors].iov_len = Range.Size;
+			RunSize += Range.Size;
+			NumVectors++;
+		}
+
+		iovec* Next = Vectors;
+		int Remaining = RunSize ? NumVectors : 0;
+		u64 Offset = RunOffset;
+		while (Remaining > 0)
+		{
+			ssize_t Read = preadv(Descriptor, Next, Remaining, (off_t)Offset);
+			if (Read < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (Read <= 0)
+			{
+				return false;
+			}
+
+			// short read, skip what is done and go again
+			Offset += Read;
+			while (Remaining > 0 && (u64)Read >= Next->iov_len)
+			{
+				Read -= Next->iov_len;
+				Next++;
+				Remaining--;
+			}
+			if (Remaining > 0)
+			{
+				Next->iov_base = (u8*)Next->iov_base + Read;
+				Next->iov_len -= Read;
+			}
+		}
+
+		i += NumVectors;
+	}
+	return true;
+#endif
+}
+
 void UnmapFile(FileMapping& Mapping)
 {
+#if _WIN32
 	if (Mapping.File == INVALID_HANDLE_VALUE)
 	{
 		delete[] Mapping.BasePtr;
 	}
-	else
+	else if (Mapping.BasePtr)
 	{
 		UnmapViewOfFile((const void*)Mapping.BasePtr);
 		CloseHandle(Mapping.Mapping);
 		CloseHandle(Mapping.File);
 	}
+#else
+	if (Mapping.BasePtr)
+	{
+		munmap(Mapping.BasePtr, Mapping.FileSize);
+		close((int)(intptr_t)Mapping.File);
+	}
+#endif
 
 	Mapping.BasePtr  = nullptr;
 	Mapping.Mapping  = nullptr;
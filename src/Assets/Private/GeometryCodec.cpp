@@ -0,0 +1,647 @@
+#include "Assets/GeometryCodec.generated.h"
+#include "Assets/Private/Codec.Declarations.h"
+#include "Containers/StringView.h"
+#include "Util/Debug.h"
+#include "Util/Math.h"
+#include "Util/Util.h"
+
+#include <string.h>
+#include <chrono>
+#include <emmintrin.h>
+#include <tracy/Tracy.hpp>
+
+namespace
+{
+	const u32 VertexBlockMaxBytes    = 8192; // decoded block stays in L1 and goes out with one memcpy
+	const u32 VertexBlockMaxVertices = 256;
+	const u32 VertexGroupSize        = 16;
+	const u32 VertexMaxStride        = 252;
+	const u32 IndexFifoSize          = 16;
+	const u32 IndexCodeFree          = 15; // high nibble of a triangle that doesn't share an edge
+	const u32 IndexCodeExplicit      = 15; // vertex written out as a varint
+
+	u32 GetVertexBlockSize(u32 Stride)
+	{
+		u32 Result = (VertexBlockMaxBytes / Stride) & ~(VertexGroupSize - 1);
+		return Clamp(Result, VertexGroupSize, VertexBlockMaxVertices);
+	}
+
+	u8 ZigZag8(u8 Delta)
+	{
+		return u8((Delta << 1) ^ u8(i8(Delta) >> 7));
+	}
+
+	u32 ZigZag32(u32 Delta)
+	{
+		return (Delta << 1) ^ u32(i32(Delta) >> 31);
+	}
+
+	u32 UnZigZag32(u32 Value)
+	{
+		return (Value >> 1) ^ (0 - (Value & 1));
+	}
+
+	// 0, 1, 2, 3 for 0, 2, 4, 8 bits per value
+	u32 GetGroupCode(const u8* Values)
+	{
+		u8 Bits = 0;
+		for (u32 i = 0; i < VertexGroupSize; ++i)
+		{
+			Bits |= Values[i];
+		}
+		return Bits == 0 ? 0 : Bits < 4 ? 1 : Bits < 16 ? 2 : 3;
+	}
+
+	// Values are packed most significant first, that's the order the decoder's unpacking interleaves them back in
+	void EncodeVertexStream(String& Out, const u8* Deltas, u32 GroupCount)
+	{
+		u64 HeaderOffset = Out.size();
+		Out.append(DivideRoundUp(GroupCount, 4u), '\0');
+
+		for (u32 g = 0; g < GroupCount; ++g)
+		{
+			const u8* Group = Deltas + g * VertexGroupSize;
+			u32 Code = GetGroupCode(Group);
+			Out[HeaderOffset + g / 4] |= char(Code << (g % 4 * 2));
+
+			if (Code == 3)
+			{
+				Out.append((const char*)Group, VertexGroupSize);
+			}
+			else if (Code != 0)
+			{
+				u32 Bits = 1 << Code;
+				for (u32 i = 0; i < VertexGroupSize; i += 8 / Bits)
+				{
+					u8 Byte = 0;
+					for (u32 j = 0; j < 8 / Bits; ++j)
+					{
+						Byte = u8(Byte << Bits) | Group[i + j];
+					}
+					Out.push_back(char(Byte));
+				}
+			}
+		}
+	}
+
+	__m128i UnpackGroup2(__m128i Packed)
+	{
+		__m128i Sel22 = _mm_unpacklo_epi8(_mm_srli_epi16(Packed, 4), Packed);
+		__m128i Sel2222 = _mm_unpacklo_epi8(_mm_srli_epi16(Sel22, 2), Sel22);
+		return _mm_and_si128(Sel2222, _mm_set1_epi8(3));
+	}
+
+	__m128i UnpackGroup4(__m128i Packed)
+	{
+		__m128i Sel44 = _mm_unpacklo_epi8(_mm_srli_epi16(Packed, 4), Packed);
+		return _mm_and_si128(Sel44, _mm_set1_epi8(15));
+	}
+
+	// (z >> 1) ^ -(z & 1), there are no 8 bit shifts so the bit coming from the neighbour is masked off
+	__m128i UnZigZag8(__m128i Values)
+	{
+		__m128i Half = _mm_and_si128(_mm_srli_epi16(Values, 1), _mm_set1_epi8(127));
+		__m128i Sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(Values, _mm_set1_epi8(1)));
+		return _mm_xor_si128(Half, Sign);
+	}
+
+	// Unpacks one byte stream of a block, GroupCount * 16 deltas. nullptr if the data runs out.
+	const u8* DecodeVertexStream(const u8* In, const u8* End, u32 GroupCount, u8* Deltas)
+	{
+		static const u8 GroupSizes[4] = { 0, 4, 8, 16 };
+
+		u32 HeaderSize = DivideRoundUp(GroupCount, 4u);
+		if (u64(End - In) < HeaderSize)
+		{
+			return nullptr;
+		}
+		const u8* Header = In;
+		In += HeaderSize;
+
+		// enough data left for every group to be 8 bit, no need to check each one
+		if (u64(End - In) >= GroupCount * VertexGroupSize)
+		{
+			for (u32 g = 0; g < GroupCount; ++g)
+			{
+				u32 Code = (Header[g / 4] >> (g % 4 * 2)) & 3;
+				i32 Packed;
+				__m128i Values;
+				switch (Code)
+				{
+				case 0:  Values = _mm_setzero_si128(); break;
+				case 1:  memcpy(&Packed, In, 4); Values = UnpackGroup2(_mm_cvtsi32_si128(Packed)); break;
+				case 2:  Values = UnpackGroup4(_mm_loadl_epi64((const __m128i*)In)); break;
+				default: Values = _mm_loadu_si128((const __m128i*)In); break;
+				}
+				In += GroupSizes[Code];
+				_mm_storeu_si128((__m128i*)(Deltas + g * VertexGroupSize), UnZigZag8(Values));
+			}
+			return In;
+		}
+
+		for (u32 g = 0; g < GroupCount; ++g)
+		{
+			u32 Code = (Header[g / 4] >> (g % 4 * 2)) & 3;
+			if (u64(End - In) < GroupSizes[Code])
+			{
+				return nullptr;
+			}
+
+			alignas(16) u8 Group[16] = {};
+			memcpy(Group, In, GroupSizes[Code]);
+			In += GroupSizes[Code];
+
+			__m128i Packed = _mm_load_si128((const __m128i*)Group);
+			__m128i Values = Code == 0 ? _mm_setzero_si128() : Code == 1 ? UnpackGroup2(Packed) : Code == 2 ? UnpackGroup4(Packed) : Packed;
+			_mm_storeu_si128((__m128i*)(Deltas + g * VertexGroupSize), UnZigZag8(Values));
+		}
+		return In;
+	}
+
+	// Four byte wide prefix sum of 4 vertices, Last holds the previous vertex's 4 bytes in every lane
+	__m128i PrefixSumVertices(__m128i Deltas, __m128i& Last)
+	{
+		Deltas = _mm_add_epi8(Deltas, _mm_slli_si128(Deltas, 4));
+		Deltas = _mm_add_epi8(Deltas, _mm_slli_si128(Deltas, 8));
+		Deltas = _mm_add_epi8(Deltas, Last);
+		Last = _mm_shuffle_epi32(Deltas, 0xff);
+		return Deltas;
+	}
+
+	// 4 streams of 16 deltas become 16 vertices of 4 bytes, Columns[i] holds vertices 4i to 4i + 3.
+	// Padding deltas are 0, so Last stays put past the end.
+	void DecodeColumn(const u8* Deltas, u32 BlockSize, __m128i& Last, __m128i* Columns)
+	{
+		__m128i R0 = _mm_load_si128((const __m128i*)(Deltas));
+		__m128i R1 = _mm_load_si128((const __m128i*)(Deltas + BlockSize));
+		__m128i R2 = _mm_load_si128((const __m128i*)(Deltas + BlockSize * 2));
+		__m128i R3 = _mm_load_si128((const __m128i*)(Deltas + BlockSize * 3));
+
+		__m128i T0 = _mm_unpacklo_epi8(R0, R1);
+		__m128i T1 = _mm_unpackhi_epi8(R0, R1);
+		__m128i T2 = _mm_unpacklo_epi8(R2, R3);
+		__m128i T3 = _mm_unpackhi_epi8(R2, R3);
+
+		Columns[0] = PrefixSumVertices(_mm_unpacklo_epi16(T0, T2), Last);
+		Columns[1] = PrefixSumVertices(_mm_unpackhi_epi16(T0, T2), Last);
+		Columns[2] = PrefixSumVertices(_mm_unpacklo_epi16(T1, T3), Last);
+		Columns[3] = PrefixSumVertices(_mm_unpackhi_epi16(T1, T3), Last);
+	}
+
+	bool DecodeVertexChunk(const u8* In, const u8* End, u8* Out, u32 VertexCount, u32 Stride)
+	{
+		alignas(16) u8 Block[VertexBlockMaxBytes];
+		alignas(16) u8 Deltas[VertexBlockMaxBytes]; // stream after stream, BlockSize each
+		__m128i Last[VertexMaxStride / 4];
+		for (__m128i& Column : Last)
+		{
+			Column = _mm_setzero_si128();
+		}
+
+		u32 BlockSize = GetVertexBlockSize(Stride);
+		for (u32 First = 0; First < VertexCount; First += BlockSize)
+		{
+			u32 Count = std::min(BlockSize, VertexCount - First);
+			u32 GroupCount = DivideRoundUp(Count, VertexGroupSize);
+
+			for (u32 k = 0; k < Stride; ++k)
+			{
+				In = DecodeVertexStream(In, End, GroupCount, Deltas + k * BlockSize);
+				if (!In) return false;
+			}
+
+			for (u32 g = 0; g < GroupCount; ++g)
+			{
+				u32 Offset = g * VertexGroupSize;
+				u8* Vertex = Block + Offset * Stride;
+
+				// 16 bytes of every vertex at once, 4x4 transpose turns 4 columns into whole vertex rows
+				u32 k = 0;
+				for (; k + 16 <= Stride; k += 16)
+				{
+					__m128i Columns[4][4];
+					for (u32 c = 0; c < 4; ++c)
+					{
+						DecodeColumn(Deltas + (k + c * 4) * BlockSize + Offset, BlockSize, Last[k / 4 + c], Columns[c]);
+					}
+					for (u32 q = 0; q < 4; ++q)
+					{
+						__m128i T0 = _mm_unpacklo_epi32(Columns[0][q], Columns[1][q]);
+						__m128i T1 = _mm_unpacklo_epi32(Columns[2][q], Columns[3][q]);
+						__m128i T2 = _mm_unpackhi_epi32(Columns[0][q], Columns[1][q]);
+						__m128i T3 = _mm_unpackhi_epi32(Columns[2][q], Columns[3][q]);
+
+						u8* Row = Vertex + q * 4 * Stride + k;
+						_mm_storeu_si128((__m128i*)(Row), _mm_unpacklo_epi64(T0, T1));
+						_mm_storeu_si128((__m128i*)(Row + Stride), _mm_unpackhi_epi64(T0, T1));
+						_mm_storeu_si128((__m128i*)(Row + Stride * 2), _mm_unpacklo_epi64(T2, T3));
+						_mm_storeu_si128((__m128i*)(Row + Stride * 3), _mm_unpackhi_epi64(T2, T3));
+					}
+				}
+				for (; k < Stride; k += 4)
+				{
+					__m128i Columns[4];
+					DecodeColumn(Deltas + k * BlockSize + Offset, BlockSize, Last[k / 4], Columns);
+					for (u32 i = 0; i < VertexGroupSize; ++i)
+					{
+						i32 Value = _mm_cvtsi128_si32(Columns[i / 4]);
+						memcpy(Vertex + i * Stride + k, &Value, 4);
+						Columns[i / 4] = _mm_srli_si128(Columns[i / 4], 4);
+					}
+				}
+			}
+
+			memcpy(Out + u64(First) * Stride, Block, u64(Count) * Stride);
+		}
+		return In == End;
+	}
+
+	struct IndexFifos
+	{
+		u32 Edges[IndexFifoSize][2];
+		u32 Vertices[IndexFifoSize];
+		u32 EdgeOffset;
+		u32 VertexOffset;
+		u32 Next; // every vertex below it was seen already
+		u32 Last; // last explicitly written vertex
+	};
+
+	void PushEdge(IndexFifos& Fifos, u32 A, u32 B)
+	{
+		Fifos.Edges[Fifos.EdgeOffset % IndexFifoSize][0] = A;
+		Fifos.Edges[Fifos.EdgeOffset % IndexFifoSize][1] = B;
+		Fifos.EdgeOffset++;
+	}
+
+	void PushVertex(IndexFifos& Fifos, u32 V)
+	{
+		Fifos.Vertices[Fifos.VertexOffset % IndexFifoSize] = V;
+		Fifos.VertexOffset++;
+	}
+
+	void WriteVarint(String& Out, u32 Value)
+	{
+		while (Value >= 128)
+		{
+			Out.push_back(char(Value | 128));
+			Value >>= 7;
+		}
+		Out.push_back(char(Value));
+	}
+
+	bool ReadVarint(const u8*& In, const u8* End, u32& Value)
+	{
+		Value = 0;
+		for (u32 Shift = 0; Shift < 35; Shift += 7)
+		{
+			if (In >= End) return false;
+			u8 Byte = *In++;
+			Value |= u32(Byte & 127) << Shift;
+			if (Byte < 128) return true;
+		}
+		return false;
+	}
+
+	u32 EncodeIndex(IndexFifos& Fifos, u32 V, String& Data)
+	{
+		if (V == Fifos.Next)
+		{
+			Fifos.Next++;
+			PushVertex(Fifos, V);
+			return 0;
+		}
+		for (u32 i = 0; i < IndexCodeExplicit - 1; ++i)
+		{
+			if (Fifos.Vertices[(Fifos.VertexOffset - 1 - i) % IndexFifoSize] == V)
+			{
+				return i + 1;
+			}
+		}
+		WriteVarint(Data, ZigZag32(V - Fifos.Last));
+		Fifos.Last = V;
+		PushVertex(Fifos, V);
+		return IndexCodeExplicit;
+	}
+
+	bool DecodeIndex(IndexFifos& Fifos, u32 Code, const u8*& Data, const u8* End, u32& V)
+	{
+		if (Code == 0)
+		{
+			V = Fifos.Next++;
+			PushVertex(Fifos, V);
+		}
+		else if (Code < IndexCodeExplicit)
+		{
+			V = Fifos.Vertices[(Fifos.VertexOffset - Code) % IndexFifoSize];
+		}
+		else
+		{
+			u32 Delta;
+			if (!ReadVarint(Data, End, Delta)) return false;
+			V = Fifos.Last + UnZigZag32(Delta);
+			Fifos.Last = V;
+			PushVertex(Fifos, V);
+		}
+		return true;
+	}
+
+	template<typename T>
+	void EncodeIndexChunk(String& Out, T* Indices, u64 IndexCount)
+	{
+		u64 TriangleCount = IndexCount / 3;
+		IndexFifos Fifos{};
+		String Data;
+
+		u64 CodesOffset = Out.size();
+		Out.resize(CodesOffset + TriangleCount);
+
+		for (u64 t = 0; t < TriangleCount; ++t)
+		{
+			T* Triangle = Indices + t * 3;
+			u32 Code = IndexCodeFree << 4;
+
+			// neighbours walk a shared edge the other way, so the fifo stores edges reversed
+			for (u32 i = 0; i < IndexCodeFree && Code == IndexCodeFree << 4; ++i)
+			{
+				const u32* Edge = Fifos.Edges[(Fifos.EdgeOffset - 1 - i) % IndexFifoSize];
+				for (u32 Rotation = 0; Rotation < 3; ++Rotation)
+				{
+					u32 A = Triangle[Rotation], B = Triangle[(Rotation + 1) % 3], C = Triangle[(Rotation + 2) % 3];
+					if (Edge[0] == A && Edge[1] == B)
+					{
+						Code = (i << 4) | EncodeIndex(Fifos, C, Data);
+						Triangle[0] = T(A);
+						Triangle[1] = T(B);
+						Triangle[2] = T(C);
+						PushEdge(Fifos, C, B);
+						PushEdge(Fifos, A, C);
+						break;
+					}
+				}
+			}
+
+			if (Code == IndexCodeFree << 4)
+			{
+				u32 A = Triangle[0], B = Triangle[1], C = Triangle[2];
+				Code |= EncodeIndex(Fifos, A, Data);
+				u64 CodesBC = Data.size();
+				Data.push_back('\0');
+				u32 CodeB = EncodeIndex(Fifos, B, Data);
+				u32 CodeC = EncodeIndex(Fifos, C, Data);
+				Data[CodesBC] = char((CodeB << 4) | CodeC);
+				PushEdge(Fifos, B, A);
+				PushEdge(Fifos, C, B);
+				PushEdge(Fifos, A, C);
+			}
+
+			Out[CodesOffset + t] = char(Code);
+		}
+		Out.append(Data);
+	}
+
+	template<typename T>
+	bool DecodeIndexChunk(const u8* In, const u8* End, u8* Out, u64 IndexCount)
+	{
+		u64 TriangleCount = IndexCount / 3;
+		if (u64(End - In) < TriangleCount)
+		{
+			return false;
+		}
+		const u8* Codes = In;
+		const u8* Data = In + TriangleCount;
+		IndexFifos Fifos{};
+
+		T* Triangle = (T*)Out;
+		for (u64 t = 0; t < TriangleCount; ++t, Triangle += 3)
+		{
+			u32 Code = Codes[t];
+			u32 A, B, C;
+			if ((Code >> 4) != IndexCodeFree)
+			{
+				const u32* Edge = Fifos.Edges[(Fifos.EdgeOffset - 1 - (Code >> 4)) % IndexFifoSize];
+				A = Edge[0];
+				B = Edge[1];
+				if (!DecodeIndex(Fifos, Code & 15, Data, End, C)) return false;
+				PushEdge(Fifos, C, B);
+				PushEdge(Fifos, A, C);
+			}
+			else
+			{
+				if (!DecodeIndex(Fifos, Code & 15, Data, End, A)) return false;
+				if (Data >= End) return false;
+				u32 CodesBC = *Data++;
+				if (!DecodeIndex(Fifos, CodesBC >> 4, Data, End, B)) return false;
+				if (!DecodeIndex(Fifos, CodesBC & 15, Data, End, C)) return false;
+				PushEdge(Fifos, B, A);
+				PushEdge(Fifos, C, B);
+				PushEdge(Fifos, A, C);
+			}
+			Triangle[0] = T(A);
+			Triangle[1] = T(B);
+			Triangle[2] = T(C);
+		}
+		return Data == End;
+	}
+
+	u64 BeginGeometryChunk(String& Out, u8 Kind, u32 ElementSize, u64 Count)
+	{
+		CHECK(Count <= UINT32_MAX);
+		GeometryChunkHeader Header{ Kind, u8(ElementSize), 0, u32(Count), 0 };
+		u64 HeaderOffset = Out.size();
+		Out.append((const char*)&Header, sizeof(Header));
+		return HeaderOffset;
+	}
+
+	void EndGeometryChunk(String& Out, u64 HeaderOffset)
+	{
+		u64 EncodedSize = Out.size() - HeaderOffset - sizeof(GeometryChunkHeader);
+		CHECK(EncodedSize <= UINT32_MAX);
+		u32 Size = u32(EncodedSize);
+		memcpy(Out.data() + HeaderOffset + offsetof(GeometryChunkHeader, EncodedSize), &Size, sizeof(Size));
+	}
+}
+
+// Appends a vertex chunk to Out, Stride has to be a multiple of 4
+void EncodeVertexBuffer(String& Out, const void* Vertices, u64 VertexCount, u32 Stride)
+{
+	ZoneScoped;
+	CHECK(Stride != 0 && Stride % 4 == 0 && Stride <= VertexMaxStride, "Vertex stride the geometry codec can't handle");
+
+	u64 HeaderOffset = BeginGeometryChunk(Out, GeometryChunkVertices, Stride, VertexCount);
+
+	const u8* In = (const u8*)Vertices;
+	u8 Last[VertexMaxStride] = {};
+	u8 Deltas[VertexBlockMaxVertices];
+	u32 BlockSize = GetVertexBlockSize(Stride);
+	for (u64 First = 0; First < VertexCount; First += BlockSize)
+	{
+		u32 Count = u32(std::min<u64>(BlockSize, VertexCount - First));
+		u32 GroupCount = DivideRoundUp(Count, VertexGroupSize);
+		for (u32 k = 0; k < Stride; ++k)
+		{
+			u8 Previous = Last[k];
+			for (u32 i = 0; i < Count; ++i)
+			{
+				u8 Value = In[(First + i) * Stride + k];
+				Deltas[i] = ZigZag8(u8(Value - Previous));
+				Previous = Value;
+			}
+			memset(Deltas + Count, 0, GroupCount * VertexGroupSize - Count);
+			Last[k] = Previous;
+
+			EncodeVertexStream(Out, Deltas, GroupCount);
+		}
+	}
+
+	EndGeometryChunk(Out, HeaderOffset);
+}
+
+// Appends an index chunk to Out, IndexSize is 2 or 4. Triangles are rotated in place to the order they decode in.
+void EncodeIndexBuffer(String& Out, void* Indices, u64 IndexCount, u32 IndexSize)
+{
+	ZoneScoped;
+	CHECK(IndexCount % 3 == 0 && (IndexSize == 2 || IndexSize == 4));
+
+	u64 HeaderOffset = BeginGeometryChunk(Out, GeometryChunkIndices, IndexSize, IndexCount);
+	if (IndexSize == 2)
+	{
+		EncodeIndexChunk(Out, (u16*)Indices, IndexCount);
+	}
+	else
+	{
+		EncodeIndexChunk(Out, (u32*)Indices, IndexCount);
+	}
+	EndGeometryChunk(Out, HeaderOffset);
+}
+
+void EncodeRawGeometry(String& Out, RawDataView Data)
+{
+	if (Data.empty())
+	{
+		return;
+	}
+	u64 HeaderOffset = BeginGeometryChunk(Out, GeometryChunkRaw, 1, Data.size());
+	Out.append((const char*)Data.data(), Data.size());
+	EndGeometryChunk(Out, HeaderOffset);
+}
+
+u64 GetGeometryEncodeBound(u64 Size)
+{
+	// worst case is 4 byte vertices that don't delta at all: every 16 bytes of a stream cost 16 and a quarter of a header byte
+	return sizeof(GeometryChunkHeader) + Size + Size / 16 + VertexGroupSize * 4 * 2;
+}
+
+// Pak codec entry for data that comes without a layout, it's taken as 4 byte vertices.
+// Oven encodes scene geometry mesh by mesh with the functions above instead.
+u64 EncodeGeometry(RawDataView Src, u8* Dst, u64 DstCapacity)
+{
+	if (Src.size() % 4 != 0 || Src.size() / 4 > UINT32_MAX)
+	{
+		return 0;
+	}
+
+	String Encoded;
+	EncodeVertexBuffer(Encoded, Src.data(), Src.size() / 4, 4);
+	if (Encoded.size() > DstCapacity)
+	{
+		return 0;
+	}
+	memcpy(Dst, Encoded.data(), Encoded.size());
+	return Encoded.size();
+}
+
+bool DecodeGeometry(RawDataView Src, u8* Dst, u64 DstSize)
+{
+	ZoneScoped;
+
+	const u8* In = Src.data();
+	const u8* End = In + Src.size();
+	u8* Out = Dst;
+	u8* OutEnd = Dst + DstSize;
+
+	while (In < End)
+	{
+		GeometryChunkHeader Header;
+		if (u64(End - In) < sizeof(Header))
+		{
+			return false;
+		}
+		memcpy(&Header, In, sizeof(Header));
+		In += sizeof(Header);
+
+		u64 Size = u64(Header.Count) * Header.ElementSize;
+		if (Header.EncodedSize > u64(End - In) || Size > u64(OutEnd - Out))
+		{
+			return false;
+		}
+		const u8* ChunkEnd = In + Header.EncodedSize;
+
+		bool Decoded = false;
+		switch (Header.Kind)
+		{
+		case GeometryChunkRaw:
+			Decoded = Header.ElementSize == 1 && Header.EncodedSize == Header.Count;
+			if (Decoded)
+			{
+				memcpy(Out, In, Size);
+			}
+			break;
+		case GeometryChunkVertices:
+			Decoded = Header.ElementSize != 0 && Header.ElementSize % 4 == 0 && Header.ElementSize <= VertexMaxStride
+				&& DecodeVertexChunk(In, ChunkEnd, Out, Header.Count, Header.ElementSize);
+			break;
+		case GeometryChunkIndices:
+			if (Header.Count % 3 == 0 && Header.ElementSize == 2)
+			{
+				Decoded = DecodeIndexChunk<u16>(In, ChunkEnd, Out, Header.Count);
+			}
+			else if (Header.Count % 3 == 0 && Header.ElementSize == 4)
+			{
+				Decoded = DecodeIndexChunk<u32>(In, ChunkEnd, Out, Header.Count);
+			}
+			break;
+		}
+
+		if (!Decoded)
+		{
+			return false;
+		}
+		In = ChunkEnd;
+		Out += Size;
+	}
+
+	return Out == OutEnd;
+}
+
+// Oven encoded stream next to the generic codecs on the same data, same columns as BenchmarkCodecs
+void BenchmarkGeometryCodec(RawDataView Decoded, RawDataView Encoded, double EncodeSeconds, u32 Repeats)
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	if (Decoded.empty())
+	{
+		return;
+	}
+
+	BenchmarkCodecs(Decoded, Repeats);
+
+	String Output(Decoded.size(), '\0');
+	bool Valid = true;
+	auto DecodeStart = Clock::now();
+	for (u32 i = 0; i < Repeats; ++i)
+	{
+		Valid &= DecodeGeometry(Encoded, (u8*)Output.data(), Output.size());
+	}
+	double DecodeSeconds = std::chrono::duration<double>(Clock::now() - DecodeStart).count();
+
+	Valid &= memcmp(Output.data(), Decoded.data(), Decoded.size()) == 0;
+	CHECK(Valid);
+
+	printf("%-10s %10.3f %14.1f %14.2f%s\n",
+		"per mesh",
+		double(Decoded.size()) / double(Encoded.size()),
+		double(Decoded.size()) / EncodeSeconds / 1_mb,
+		double(Decoded.size()) * Repeats / DecodeSeconds / 1_gb,
+		Valid ? "" : " MISMATCH"
+	);
+}
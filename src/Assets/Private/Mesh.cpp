@@ -1,12 +1,133 @@
 #include "Assets/Mesh.generated.h"
 
+#include <math.h>
+
 u32 GetVertexBufferSize(const MeshDescription& Description)
 {
 	return Description.VertexCount * (u32)Description.VertexSize;
 }
 
+// Oven, the index buffer size and the draw's index format all have to agree on this
+bool HasShortIndices(const MeshDescription& Description)
+{
+	return Description.VertexCount <= UINT16_MAX;
+}
+
+// Octahedral normal encoding: the unit sphere folded onto a square, x in the low 16 bits, y in the high ones.
+// Picks whichever of the four nearest grid points decodes closest to the input, not just the rounded one.
+u32 EncodeOctahedral(Vec3 Normal)
+{
+	float Sum = fabsf(Normal.x) + fabsf(Normal.y) + fabsf(Normal.z);
+	if (Sum <= 0.f)
+	{
+		return 0;
+	}
+
+	float X = Normal.x / Sum;
+	float Y = Normal.y / Sum;
+	if (Normal.z < 0.f)
+	{
+		float FoldedX = (1.f - fabsf(Y)) * (X >= 0.f ? 1.f : -1.f);
+		float FoldedY = (1.f - fabsf(X)) * (Y >= 0.f ? 1.f : -1.f);
+		X = FoldedX;
+		Y = FoldedY;
+	}
+
+	float Length = sqrtf(Dot(Normal, Normal));
+	u32 Result = 0;
+	float BestDot = -2.f;
+	for (u32 Candidate = 0; Candidate < 4; ++Candidate)
+	{
+		float QX = (Candidate & 1) ? ceilf(X * INT16_MAX) : floorf(X * INT16_MAX);
+		float QY = (Candidate & 2) ? ceilf(Y * INT16_MAX) : floorf(Y * INT16_MAX);
+		u32 Packed = u32(u16(i16(Clamp(QX, -float(INT16_MAX), float(INT16_MAX))))) |
+			(u32(u16(i16(Clamp(QY, -float(INT16_MAX), float(INT16_MAX))))) << 16);
+
+		float CandidateDot = Dot(DecodeOctahedral(Packed), Normal) / Length;
+		if (CandidateDot > BestDot)
+		{
+			BestDot = CandidateDot;
+			Result = Packed;
+		}
+	}
+	return Result;
+}
+
+// what the shader gets out of R16G16_SNORM plus the unfolding, normalized
+Vec3 DecodeOctahedral(u32 Packed)
+{
+	float X = fmaxf(float(i16(Packed & 0xFFFF)) / INT16_MAX, -1.f);
+	float Y = fmaxf(float(i16(Packed >> 16)) / INT16_MAX, -1.f);
+	float Z = 1.f - fabsf(X) - fabsf(Y);
+	float Fold = fmaxf(-Z, 0.f);
+	X += X >= 0.f ? -Fold : Fold;
+	Y += Y >= 0.f ? -Fold : Fold;
+
+	float Length = sqrtf(X * X + Y * Y + Z * Z);
+	return Vec3{ X / Length, Y / Length, Z / Length };
+}
+
+// covers every LOD, the first one is the full resolution mesh
 u32 GetIndexBufferSize(const MeshDescription& Description)
 {
-	return Description.IndexCount * (Description.VertexCount < UINT16_MAX ? 2 : 4);
+	u32 IndexCount = Description.IndexCount;
+	if (Description.LodCount > 0)
+	{
+		const MeshLod& Last = Description.Lods[Description.LodCount - 1];
+		IndexCount = Last.FirstIndex + Last.IndexCount;
+	}
+	return IndexCount * (HasShortIndices(Description) ? 2 : 4);
+}
+
+// pixels one unit covers at distance one
+float GetLodProjectionScale(float FovInRadians, float ScreenHeight)
+{
+	return ScreenHeight / (2.f * tanf(FovInRadians / 2));
+}
+
+// Coarsest LOD whose error, projected from the closest point of the mesh's bounding sphere, stays under MaxPixelError.
+// Transform is the mesh's world matrix, its largest axis scale scales the error.
+u32 SelectMeshLod(const MeshDescription& Description, const Matrix4& Transform, Vec3 CameraPosition, float ProjectionScale, float MaxPixelError)
+{
+	if (Description.LodCount < 2)
+	{
+		return 0;
+	}
+
+	Vec4 Center{
+		(Description.BoxMin.x + Description.BoxMax.x) * 0.5f,
+		(Description.BoxMin.y + Description.BoxMax.y) * 0.5f,
+		(Description.BoxMin.z + Description.BoxMax.z) * 0.5f,
+		1.f
+	};
+	Vec3 WorldCenter{ Dot(Center, Transform.Column(0)), Dot(Center, Transform.Column(1)), Dot(Center, Transform.Column(2)) };
+
+	float Scale = 0.f;
+	for (int i = 0; i < 3; ++i)
+	{
+		Vec4 Axis = Transform.Row(i);
+		Scale = fmaxf(Scale, Axis.x * Axis.x + Axis.y * Axis.y + Axis.z * Axis.z);
+	}
+	Scale = sqrtf(Scale);
+
+	Vec3 Extent = Description.BoxMax - Description.BoxMin;
+	float Radius = 0.5f * sqrtf(Dot(Extent, Extent)) * Scale;
+	Vec3 ToCamera = CameraPosition - WorldCenter;
+	float Distance = sqrtf(Dot(ToCamera, ToCamera)) - Radius;
+	if (Distance <= 0.f)
+	{
+		return 0;
+	}
+
+	u32 Result = 0;
+	for (u32 i = 1; i < Description.LodCount; ++i)
+	{
+		if (Description.Lods[i].Error * Scale * ProjectionScale / Distance > MaxPixelError)
+		{
+			break;
+		}
+		Result = i;
+	}
+	return Result;
 }
 
@@ -0,0 +1,719 @@
+#include "Assets/MeshOptimizer.generated.h"
+#include "Util/Debug.h"
+
+#include <EASTL/sort.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <tracy/Tracy.hpp>
+
+// LRU size the scoring assumes, Forsyth's suggestion, it works well for smaller real caches too
+#define VERTEX_CACHE_SCORING_SIZE 32
+// closer to what GPUs actually reuse, only used for measuring
+#define VERTEX_CACHE_SIMULATED_SIZE 16
+
+namespace
+{
+	// FIFO through timestamps: vertex that missed at Time stays cached until CacheSize misses later.
+	// Bumping Time by CacheSize + 1 empties the cache.
+	u32 CacheMissesOfTriangle(const u32* Triangle, TArray<u32>& Timestamps, u32& Time, u32 CacheSize)
+	{
+		u32 Misses = 0;
+		for (u32 k = 0; k < 3; ++k)
+		{
+			u32 Vertex = Triangle[k];
+			if (Time - Timestamps[Vertex] > CacheSize)
+			{
+				Timestamps[Vertex] = Time++;
+				Misses++;
+			}
+		}
+		return Misses;
+	}
+
+	float VertexScore(i32 CachePosition, u32 Valence, const float* CacheScores, const float* ValenceScores)
+	{
+		if (Valence == 0)
+		{
+			return 0.f; // no triangles left to pull in
+		}
+
+		float Score = CachePosition >= 0 ? CacheScores[CachePosition] : 0.f;
+		return Score + (Valence < VERTEX_CACHE_SCORING_SIZE ? ValenceScores[Valence] : 2.f * powf(float(Valence), -0.5f));
+	}
+
+	// Cross product of the edges, its length is twice the area
+	void TriangleNormal(const Vec3& A, const Vec3& B, const Vec3& C, float* Normal)
+	{
+		float E1[3] = { B.x - A.x, B.y - A.y, B.z - A.z };
+		float E2[3] = { C.x - A.x, C.y - A.y, C.z - A.z };
+		Normal[0] = E1[1] * E2[2] - E1[2] * E2[1];
+		Normal[1] = E1[2] * E2[0] - E1[0] * E2[2];
+		Normal[2] = E1[0] * E2[1] - E1[1] * E2[0];
+	}
+}
+
+VertexCacheStats AnalyzeVertexCache(const u32* Indices, u64 IndexCount, u32 VertexCount, u32 CacheSize)
+{
+	ZoneScoped;
+
+	VertexCacheStats Result{ 0.f, 0.f };
+	if (IndexCount < 3)
+	{
+		return Result;
+	}
+
+	TArray<u32> Timestamps(VertexCount, 0);
+	TArray<u8> Used(VertexCount, 0);
+	u32 Time = CacheSize + 1;
+
+	u64 Misses = 0;
+	u64 UniqueVertices = 0;
+	for (u64 i = 0; i + 3 <= IndexCount; i += 3)
+	{
+		Misses += CacheMissesOfTriangle(Indices + i, Timestamps, Time, CacheSize);
+		for (u32 k = 0; k < 3; ++k)
+		{
+			UniqueVertices += Used[Indices[i + k]] == 0;
+			Used[Indices[i + k]] = 1;
+		}
+	}
+
+	Result.ACMR = float(Misses) / float(IndexCount / 3);
+	Result.ATVR = float(Misses) / float(UniqueVertices);
+	return Result;
+}
+
+// Tom Forsyth's "Linear-Speed Vertex Cache Optimisation": greedily emits the best scoring triangle,
+// scores favour vertices that are in the cache and vertices with few triangles left.
+void OptimizeVertexCache(u32* Indices, u64 IndexCount, u32 VertexCount)
+{
+	ZoneScoped;
+
+	u64 TriangleCount = IndexCount / 3;
+	if (TriangleCount < 2)
+	{
+		return;
+	}
+
+	float CacheScores[VERTEX_CACHE_SCORING_SIZE];
+	for (i32 i = 0; i < VERTEX_CACHE_SCORING_SIZE; ++i)
+	{
+		// last triangle's vertices get a fixed score, so it doesn't matter in which order they went in
+		CacheScores[i] = i < 3 ? 0.75f : powf(1.f - float(i - 3) / float(VERTEX_CACHE_SCORING_SIZE - 3), 1.5f);
+	}
+	float ValenceScores[VERTEX_CACHE_SCORING_SIZE];
+	ValenceScores[0] = 0.f;
+	for (u32 i = 1; i < VERTEX_CACHE_SCORING_SIZE; ++i)
+	{
+		ValenceScores[i] = 2.f * powf(float(i), -0.5f);
+	}
+
+	// triangles of every vertex, the ones still to be emitted are kept in front
+	TArray<u32> Valence(VertexCount, 0);
+	for (u64 i = 0; i < IndexCount; ++i)
+	{
+		Valence[Indices[i]]++;
+	}
+	TArray<u32> AdjacencyOffsets(VertexCount + 1, 0);
+	for (u32 v = 0; v < VertexCount; ++v)
+	{
+		AdjacencyOffsets[v + 1] = AdjacencyOffsets[v] + Valence[v];
+	}
+	TArray<u32> Adjacency(IndexCount);
+	{
+		TArray<u32> Cursor(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+		for (u64 i = 0; i < IndexCount; ++i)
+		{
+			Adjacency[Cursor[Indices[i]]++] = u32(i / 3);
+		}
+	}
+
+	TArray<i32> CachePositions(VertexCount, -1);
+	TArray<float> VertexScores(VertexCount);
+	for (u32 v = 0; v < VertexCount; ++v)
+	{
+		VertexScores[v] = VertexScore(-1, Valence[v], CacheScores, ValenceScores);
+	}
+
+	TArray<float> TriangleScores(TriangleCount);
+	for (u64 t = 0; t < TriangleCount; ++t)
+	{
+		const u32* Triangle = Indices + t * 3;
+		TriangleScores[t] = VertexScores[Triangle[0]] + VertexScores[Triangle[1]] + VertexScores[Triangle[2]];
+	}
+
+	TArray<u8> Emitted(TriangleCount, 0);
+	TArray<u32> Output;
+	Output.reserve(TriangleCount * 3);
+
+	u32 Cache[VERTEX_CACHE_SCORING_SIZE + 3];
+	u32 CacheCount = 0;
+	u64 DeadEndCursor = 0;
+	u64 BestTriangle = UINT64_MAX;
+	while (Output.size() < TriangleCount * 3)
+	{
+		if (BestTriangle == UINT64_MAX)
+		{
+			// nothing in the cache leads anywhere, continue in input order
+			while (Emitted[DeadEndCursor])
+			{
+				DeadEndCursor++;
+			}
+			BestTriangle = DeadEndCursor;
+		}
+
+		const u32* Triangle = Indices + BestTriangle * 3;
+		Output.insert(Output.end(), Triangle, Triangle + 3);
+		Emitted[BestTriangle] = 1;
+
+		for (u32 k = 0; k < 3; ++k)
+		{
+			u32 Vertex = Triangle[k];
+			u32* Begin = Adjacency.data() + AdjacencyOffsets[Vertex];
+			u32* End = Begin + Valence[Vertex];
+			u32* It = eastl::find(Begin, End, u32(BestTriangle));
+			CHECK(It != End);
+			*It = End[-1];
+			Valence[Vertex]--;
+		}
+
+		// triangle's vertices go to the front, everything else moves back
+		u32 NewCache[VERTEX_CACHE_SCORING_SIZE + 3];
+		u32 NewCacheCount = 0;
+		for (u32 k = 0; k < 3; ++k)
+		{
+			if (eastl::find(NewCache, NewCache + NewCacheCount, Triangle[k]) == NewCache + NewCacheCount)
+			{
+				NewCache[NewCacheCount++] = Triangle[k];
+			}
+		}
+		for (u32 i = 0; i < CacheCount; ++i)
+		{
+			if (Cache[i] != Triangle[0] && Cache[i] != Triangle[1] && Cache[i] != Triangle[2])
+			{
+				NewCache[NewCacheCount++] = Cache[i];
+			}
+		}
+
+		// evicted vertices are rescored too, their triangles lose the cache bonus
+		for (u32 i = 0; i < NewCacheCount; ++i)
+		{
+			u32 Vertex = NewCache[i];
+			CachePositions[Vertex] = i < VERTEX_CACHE_SCORING_SIZE ? i32(i) : -1;
+
+			float Score = VertexScore(CachePositions[Vertex], Valence[Vertex], CacheScores, ValenceScores);
+			float Delta = Score - VertexScores[Vertex];
+			VertexScores[Vertex] = Score;
+
+			const u32* Triangles = Adjacency.data() + AdjacencyOffsets[Vertex];
+			for (u32 j = 0; j < Valence[Vertex]; ++j)
+			{
+				TriangleScores[Triangles[j]] += Delta;
+			}
+		}
+
+		CacheCount = eastl::min<u32>(NewCacheCount, VERTEX_CACHE_SCORING_SIZE);
+		memcpy(Cache, NewCache, CacheCount * sizeof(u32));
+
+		BestTriangle = UINT64_MAX;
+		float BestScore = -1.f;
+		for (u32 i = 0; i < CacheCount; ++i)
+		{
+			const u32* Triangles = Adjacency.data() + AdjacencyOffsets[Cache[i]];
+			for (u32 j = 0; j < Valence[Cache[i]]; ++j)
+			{
+				if (TriangleScores[Triangles[j]] > BestScore)
+				{
+					BestScore = TriangleScores[Triangles[j]];
+					BestTriangle = Triangles[j];
+				}
+			}
+		}
+	}
+
+	memcpy(Indices, Output.data(), Output.size() * sizeof(u32));
+}
+
+// Sander, Nehab, Barczak "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+// Expects a cache optimized index buffer, cuts it into clusters that don't depend on the cache state
+// before them and sorts those so triangles facing out of the mesh go first and occlude the rest.
+// Threshold is how much worse than the input the ACMR of a cluster is allowed to get.
+void OptimizeOverdraw(u32* Indices, u64 IndexCount, const Vec3* Positions, u32 VertexCount, float Threshold)
+{
+	ZoneScoped;
+
+	u64 TriangleCount = IndexCount / 3;
+	if (TriangleCount < 2)
+	{
+		return;
+	}
+
+	const u32 CacheSize = VERTEX_CACHE_SIMULATED_SIZE;
+	TArray<u32> Timestamps(VertexCount, 0);
+	u32 Time = CacheSize + 1;
+
+	// triangle that misses on all three vertices starts from a cold cache anyway
+	TArray<u64> HardClusters;
+	for (u64 t = 0; t < TriangleCount; ++t)
+	{
+		if (CacheMissesOfTriangle(Indices + t * 3, Timestamps, Time, CacheSize) == 3 || t == 0)
+		{
+			HardClusters.push_back(t);
+		}
+	}
+	HardClusters.push_back(TriangleCount);
+
+	// hard cluster is cut further wherever the triangles so far are about as cache efficient as the whole of it
+	TArray<u64> Clusters;
+	for (u64 h = 0; h + 1 < HardClusters.size(); ++h)
+	{
+		u64 Begin = HardClusters[h];
+		u64 End = HardClusters[h + 1];
+
+		Time += CacheSize + 1;
+		u64 Misses = 0;
+		for (u64 t = Begin; t < End; ++t)
+		{
+			Misses += CacheMissesOfTriangle(Indices + t * 3, Timestamps, Time, CacheSize);
+		}
+		float Target = Threshold * float(Misses) / float(End - Begin);
+
+		Time += CacheSize + 1;
+		Clusters.push_back(Begin);
+		u64 ClusterBegin = Begin;
+		Misses = 0;
+		for (u64 t = Begin; t < End; ++t)
+		{
+			Misses += CacheMissesOfTriangle(Indices + t * 3, Timestamps, Time, CacheSize);
+			if (t + 1 < End && float(Misses) <= Target * float(t + 1 - ClusterBegin))
+			{
+				Clusters.push_back(t + 1);
+				ClusterBegin = t + 1;
+				Misses = 0;
+				Time += CacheSize + 1;
+			}
+		}
+	}
+	Clusters.push_back(TriangleCount);
+
+	u64 ClusterCount = Clusters.size() - 1;
+	TArray<float> ClusterData(ClusterCount * 6, 0.f); // area weighted centroid and normal
+	TArray<float> ClusterArea(ClusterCount, 0.f);
+	float MeshCentroid[3] = {};
+	float MeshArea = 0.f;
+	for (u64 c = 0; c < ClusterCount; ++c)
+	{
+		float* Data = &ClusterData[c * 6];
+		for (u64 t = Clusters[c]; t < Clusters[c + 1]; ++t)
+		{
+			const Vec3& A = Positions[Indices[t * 3 + 0]];
+			const Vec3& B = Positions[Indices[t * 3 + 1]];
+			const Vec3& C = Positions[Indices[t * 3 + 2]];
+
+			float Normal[3];
+			TriangleNormal(A, B, C, Normal);
+			float Area = sqrtf(Normal[0] * Normal[0] + Normal[1] * Normal[1] + Normal[2] * Normal[2]);
+
+			Data[0] += (A.x + B.x + C.x) / 3.f * Area;
+			Data[1] += (A.y + B.y + C.y) / 3.f * Area;
+			Data[2] += (A.z + B.z + C.z) / 3.f * Area;
+			Data[3] += Normal[0];
+			Data[4] += Normal[1];
+			Data[5] += Normal[2];
+			ClusterArea[c] += Area;
+		}
+
+		MeshCentroid[0] += Data[0];
+		MeshCentroid[1] += Data[1];
+		MeshCentroid[2] += Data[2];
+		MeshArea += ClusterArea[c];
+	}
+
+	if (MeshArea <= 0.f)
+	{
+		return;
+	}
+	for (float& Value : MeshCentroid)
+	{
+		Value /= MeshArea;
+	}
+
+	// how far out of the mesh the cluster sits along its own normal
+	TArray<float> SortKeys(ClusterCount, -FLT_MAX);
+	for (u64 c = 0; c < ClusterCount; ++c)
+	{
+		const float* Data = &ClusterData[c * 6];
+		float NormalLength = sqrtf(Data[3] * Data[3] + Data[4] * Data[4] + Data[5] * Data[5]);
+		if (ClusterArea[c] <= 0.f || NormalLength <= 0.f)
+		{
+			continue;
+		}
+
+		float Key = 0.f;
+		for (u32 k = 0; k < 3; ++k)
+		{
+			Key += (Data[k] / ClusterArea[c] - MeshCentroid[k]) * Data[3 + k] / NormalLength;
+		}
+		SortKeys[c] = Key;
+	}
+
+	TArray<u32> Order(ClusterCount);
+	for (u32 c = 0; c < ClusterCount; ++c)
+	{
+		Order[c] = c;
+	}
+	eastl::stable_sort(Order.begin(), Order.end(), [&SortKeys](u32 A, u32 B) { return SortKeys[A] > SortKeys[B]; });
+
+	TArray<u32> Output;
+	Output.reserve(TriangleCount * 3);
+	for (u32 c : Order)
+	{
+		Output.insert(Output.end(), Indices + Clusters[c] * 3, Indices + Clusters[c + 1] * 3);
+	}
+	memcpy(Indices, Output.data(), Output.size() * sizeof(u32));
+}
+
+// Renumbers vertices in order of first use, VertexOrder gets the old index of every new vertex.
+// Returns the new vertex count, vertices no triangle uses are gone.
+u32 OptimizeVertexFetch(u32* Indices, u64 IndexCount, u32 VertexCount, TArray<u32>& VertexOrder)
+{
+	ZoneScoped;
+
+	TArray<u32> Remap(VertexCount, UINT32_MAX);
+	VertexOrder.clear();
+	for (u64 i = 0; i < IndexCount; ++i)
+	{
+		u32 Vertex = Indices[i];
+		if (Remap[Vertex] == UINT32_MAX)
+		{
+			Remap[Vertex] = u32(VertexOrder.size());
+			VertexOrder.push_back(Vertex);
+		}
+		Indices[i] = Remap[Vertex];
+	}
+	return u32(VertexOrder.size());
+}
+
+namespace
+{
+	// Garland-Heckbert error quadric, area weighted sum of squared distances to planes
+	struct Quadric
+	{
+		double A00, A11, A22, A01, A02, A12;
+		double B0, B1, B2;
+		double C;
+		double Weight;
+	};
+
+	void AddQuadric(Quadric& Q, const Quadric& Other)
+	{
+		double* Dst = &Q.A00;
+		const double* Src = &Other.A00;
+		for (u32 i = 0; i < sizeof(Quadric) / sizeof(double); ++i)
+		{
+			Dst[i] += Src[i];
+		}
+	}
+
+	void AddTriangleQuadric(Quadric& Q, const Vec3& A, const Vec3& B, const Vec3& C)
+	{
+		float Normal[3];
+		TriangleNormal(A, B, C, Normal);
+		double Length = sqrt(double(Normal[0]) * Normal[0] + double(Normal[1]) * Normal[1] + double(Normal[2]) * Normal[2]);
+		if (Length <= 0.0)
+		{
+			return;
+		}
+
+		double X = Normal[0] / Length, Y = Normal[1] / Length, Z = Normal[2] / Length;
+		double D = -(X * A.x + Y * A.y + Z * A.z);
+		double W = Length * 0.5;
+
+		Q.A00 += W * X * X; Q.A11 += W * Y * Y; Q.A22 += W * Z * Z;
+		Q.A01 += W * X * Y; Q.A02 += W * X * Z; Q.A12 += W * Y * Z;
+		Q.B0 += W * X * D; Q.B1 += W * Y * D; Q.B2 += W * Z * D;
+		Q.C += W * D * D;
+		Q.Weight += W;
+	}
+
+	// average squared distance from P to the planes Q was built from
+	double QuadricError(const Quadric& Q, const Vec3& P)
+	{
+		double X = P.x, Y = P.y, Z = P.z;
+		double Error =
+			Q.A00 * X * X + Q.A11 * Y * Y + Q.A22 * Z * Z +
+			2.0 * (Q.A01 * X * Y + Q.A02 * X * Z + Q.A12 * Y * Z) +
+			2.0 * (Q.B0 * X + Q.B1 * Y + Q.B2 * Z) +
+			Q.C;
+		return Q.Weight > 0.0 ? fabs(Error) / Q.Weight : 0.0;
+	}
+
+	// Vertices on open borders, non manifold edges or attribute seams (same position, different vertex) can't move,
+	// collapsing them would tear holes into the mesh.
+	TArray<u8> FindLockedVertices(const u32* Indices, u64 IndexCount, const Vec3* Positions, u32 VertexCount)
+	{
+		TArray<u32> ByPosition(VertexCount);
+		for (u32 v = 0; v < VertexCount; ++v)
+		{
+			ByPosition[v] = v;
+		}
+		auto PositionLess = [Positions](u32 A, u32 B) {
+			const Vec3& PA = Positions[A];
+			const Vec3& PB = Positions[B];
+			if (PA.x != PB.x) return PA.x < PB.x;
+			if (PA.y != PB.y) return PA.y < PB.y;
+			return PA.z < PB.z;
+		};
+		eastl::sort(ByPosition.begin(), ByPosition.end(), PositionLess);
+
+		TArray<u8> Locked(VertexCount, 0);
+		TArray<u32> Wedge(VertexCount);
+		for (u32 i = 0; i < VertexCount;)
+		{
+			u32 End = i + 1;
+			while (End < VertexCount && !PositionLess(ByPosition[i], ByPosition[End]))
+			{
+				End++;
+			}
+			for (u32 j = i; j < End; ++j)
+			{
+				Wedge[ByPosition[j]] = ByPosition[i];
+				Locked[ByPosition[j]] = End - i > 1;
+			}
+			i = End;
+		}
+
+		// every edge of a closed manifold surface is shared by exactly two triangles
+		TArray<u64> Edges;
+		Edges.reserve(IndexCount);
+		for (u64 i = 0; i + 3 <= IndexCount; i += 3)
+		{
+			for (u32 k = 0; k < 3; ++k)
+			{
+				u32 A = Wedge[Indices[i + k]];
+				u32 B = Wedge[Indices[i + (k + 1) % 3]];
+				if (A != B)
+				{
+					Edges.push_back(A < B ? (u64(A) << 32) | B : (u64(B) << 32) | A);
+				}
+			}
+		}
+		eastl::sort(Edges.begin(), Edges.end());
+
+		for (u64 i = 0; i < Edges.size();)
+		{
+			u64 End = i + 1;
+			while (End < Edges.size() && Edges[End] == Edges[i])
+			{
+				End++;
+			}
+			if (End - i != 2)
+			{
+				Locked[u32(Edges[i] >> 32)] = 1;
+				Locked[u32(Edges[i])] = 1;
+			}
+			i = End;
+		}
+
+		// wedges share the lock of their position
+		for (u32 v = 0; v < VertexCount; ++v)
+		{
+			Locked[v] |= Locked[Wedge[v]];
+		}
+		return Locked;
+	}
+
+	struct Collapse
+	{
+		u32   From;
+		u32   To;
+		float Cost;
+	};
+
+	// moving From onto To mustn't turn any of From's other triangles over
+	bool FlipsTriangles(const u32* Indices, const u32* Triangles, u32 TriangleCount, u32 From, u32 To, const Vec3* Positions)
+	{
+		for (u32 t = 0; t < TriangleCount; ++t)
+		{
+			const u32* Triangle = Indices + Triangles[t] * 3;
+			if (Triangle[0] == To || Triangle[1] == To || Triangle[2] == To)
+			{
+				continue; // degenerates and goes away
+			}
+
+			Vec3 Before[3] = { Positions[Triangle[0]], Positions[Triangle[1]], Positions[Triangle[2]] };
+			Vec3 After[3] = { Before[0], Before[1], Before[2] };
+			for (u32 k = 0; k < 3; ++k)
+			{
+				if (Triangle[k] == From)
+				{
+					After[k] = Positions[To];
+				}
+			}
+
+			float NormalBefore[3];
+			float NormalAfter[3];
+			TriangleNormal(Before[0], Before[1], Before[2], NormalBefore);
+			TriangleNormal(After[0], After[1], After[2], NormalAfter);
+			float Dot = NormalBefore[0] * NormalAfter[0] + NormalBefore[1] * NormalAfter[1] + NormalBefore[2] * NormalAfter[2];
+			if (Dot <= 0.f)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+// Edge collapse simplification onto existing vertices, so the result indexes the same vertex buffer.
+// Works in passes: every pass collapses the cheapest edges by quadric error, each vertex at most once,
+// until there are at most TargetIndexCount indices or nothing can collapse anymore.
+// Destination has room for IndexCount indices, returns how many were written.
+// ResultError is the largest error of a collapse, in the units of Positions.
+u64 SimplifyMesh(u32* Destination, const u32* Indices, u64 IndexCount, const Vec3* Positions, u32 VertexCount, u64 TargetIndexCount, float& ResultError)
+{
+	ZoneScoped;
+
+	ResultError = 0.f;
+	IndexCount -= IndexCount % 3;
+	memcpy(Destination, Indices, IndexCount * sizeof(u32));
+	if (IndexCount <= TargetIndexCount)
+	{
+		return IndexCount;
+	}
+
+	TArray<u8> Locked = FindLockedVertices(Indices, IndexCount, Positions, VertexCount);
+
+	TArray<Quadric> Quadrics(VertexCount, Quadric{});
+	for (u64 i = 0; i < IndexCount; i += 3)
+	{
+		Quadric TriangleQuadric{};
+		AddTriangleQuadric(TriangleQuadric, Positions[Indices[i]], Positions[Indices[i + 1]], Positions[Indices[i + 2]]);
+		for (u32 k = 0; k < 3; ++k)
+		{
+			AddQuadric(Quadrics[Indices[i + k]], TriangleQuadric);
+		}
+	}
+
+	TArray<Collapse> Collapses;
+	TArray<u32> Valence(VertexCount);
+	TArray<u32> AdjacencyOffsets(VertexCount + 1);
+	TArray<u32> Adjacency;
+	TArray<u32> Remap(VertexCount);
+	TArray<u8> Touched(VertexCount);
+	double MaxCost = 0.0;
+	while (IndexCount > TargetIndexCount)
+	{
+		Collapses.clear();
+		for (u64 i = 0; i < IndexCount; i += 3)
+		{
+			for (u32 k = 0; k < 3; ++k)
+			{
+				u32 A = Destination[i + k];
+				u32 B = Destination[i + (k + 1) % 3];
+				if (A > B)
+				{
+					continue; // same edge comes again from the triangle on the other side, borders are locked anyway
+				}
+				Quadric Combined = Quadrics[A];
+				AddQuadric(Combined, Quadrics[B]);
+				if (!Locked[A])
+				{
+					Collapses.push_back() = { A, B, float(QuadricError(Combined, Positions[B])) };
+				}
+				if (!Locked[B])
+				{
+					Collapses.push_back() = { B, A, float(QuadricError(Combined, Positions[A])) };
+				}
+			}
+		}
+		if (Collapses.empty())
+		{
+			break;
+		}
+
+		// roughly two triangles go per collapse, the limit keeps a pass from grabbing much worse edges
+		// only because the cheap ones around them are already taken
+		u64 TrianglesToRemove = (IndexCount - TargetIndexCount + 2) / 3;
+		auto CostLess = [](const Collapse& A, const Collapse& B) { return A.Cost < B.Cost; };
+		auto Nth = Collapses.begin() + eastl::min<u64>(Collapses.size() - 1, TrianglesToRemove);
+		eastl::nth_element(Collapses.begin(), Nth, Collapses.end(), CostLess);
+		float PassLimit = Nth->Cost * 1.5f;
+		auto Candidates = eastl::partition(Collapses.begin(), Collapses.end(), [PassLimit](const Collapse& C) { return C.Cost <= PassLimit; });
+		eastl::sort(Collapses.begin(), Candidates, CostLess);
+
+		eastl::fill(Valence.begin(), Valence.end(), 0);
+		for (u64 i = 0; i < IndexCount; ++i)
+		{
+			Valence[Destination[i]]++;
+		}
+		AdjacencyOffsets[0] = 0;
+		for (u32 v = 0; v < VertexCount; ++v)
+		{
+			AdjacencyOffsets[v + 1] = AdjacencyOffsets[v] + Valence[v];
+		}
+		Adjacency.resize(IndexCount);
+		for (u64 i = 0; i < IndexCount; ++i)
+		{
+			Adjacency[AdjacencyOffsets[Destination[i]] + --Valence[Destination[i]]] = u32(i / 3);
+		}
+
+		for (u32 v = 0; v < VertexCount; ++v)
+		{
+			Remap[v] = v;
+		}
+		eastl::fill(Touched.begin(), Touched.end(), u8(0));
+
+		u64 Removed = 0;
+		for (auto It = Collapses.begin(); It != Candidates && Removed < TrianglesToRemove; ++It)
+		{
+			const Collapse& C = *It;
+			if (Touched[C.From] || Touched[C.To])
+			{
+				continue;
+			}
+
+			const u32* Triangles = Adjacency.data() + AdjacencyOffsets[C.From];
+			u32 TriangleCount = AdjacencyOffsets[C.From + 1] - AdjacencyOffsets[C.From];
+			if (FlipsTriangles(Destination, Triangles, TriangleCount, C.From, C.To, Positions))
+			{
+				continue;
+			}
+
+			Remap[C.From] = C.To;
+			AddQuadric(Quadrics[C.To], Quadrics[C.From]);
+			MaxCost = eastl::max(MaxCost, double(C.Cost));
+
+			// neighbours' triangles changed shape, their flip checks would be stale
+			for (u32 t = 0; t < TriangleCount; ++t)
+			{
+				const u32* Triangle = Destination + Triangles[t] * 3;
+				Touched[Triangle[0]] = Touched[Triangle[1]] = Touched[Triangle[2]] = 1;
+				Removed += Triangle[0] == C.To || Triangle[1] == C.To || Triangle[2] == C.To;
+			}
+		}
+		if (Removed == 0)
+		{
+			break;
+		}
+
+		u64 Written = 0;
+		for (u64 i = 0; i < IndexCount; i += 3)
+		{
+			u32 A = Remap[Destination[i]];
+			u32 B = Remap[Destination[i + 1]];
+			u32 C = Remap[Destination[i + 2]];
+			if (A != B && B != C && A != C)
+			{
+				Destination[Written++] = A;
+				Destination[Written++] = B;
+				Destination[Written++] = C;
+			}
+		}
+		IndexCount = Written;
+	}
+
+	ResultError = float(sqrt(MaxCost));
+	return IndexCount;
+}
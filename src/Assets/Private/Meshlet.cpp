@@ -0,0 +1,330 @@
+#include "Assets/Meshlet.generated.h"
+#include "Util/Math.generated.h"
+#include "Util/Private/Math.Declarations.h"
+#include "Util/Debug.h"
+
+#include <chrono>
+#include <math.h>
+#include <tracy/Tracy.hpp>
+
+namespace
+{
+	float Length(const Vec3& V)
+	{
+		return sqrtf(Dot(V, V));
+	}
+
+	Vec3 Scale(const Vec3& V, float S)
+	{
+		return Vec3{ V.x * S, V.y * S, V.z * S };
+	}
+
+	// Ritter's sphere: two far apart points give the first guess, it grows for every point left outside.
+	// Within a few percent of the minimal one, which is plenty for culling.
+	void ComputeBoundingSphere(const Vec3* Positions, const u32* Vertices, u32 VertexCount, MeshletBounds& Bounds)
+	{
+		auto Farthest = [&](const Vec3& From) {
+			Vec3 Result = Positions[Vertices[0]];
+			float ResultDistance = -1.f;
+			for (u32 i = 0; i < VertexCount; ++i)
+			{
+				const Vec3& P = Positions[Vertices[i]];
+				float Distance = Dot(P - From, P - From);
+				if (Distance > ResultDistance)
+				{
+					ResultDistance = Distance;
+					Result = P;
+				}
+			}
+			return Result;
+		};
+
+		Vec3 A = Farthest(Positions[Vertices[0]]);
+		Vec3 B = Farthest(A);
+		Vec3 Center = Scale(A + B, 0.5f);
+		float Radius = Length(B - A) * 0.5f;
+
+		for (u32 i = 0; i < VertexCount; ++i)
+		{
+			const Vec3& P = Positions[Vertices[i]];
+			float Distance = Length(P - Center);
+			if (Distance > Radius)
+			{
+				float NewRadius = (Radius + Distance) * 0.5f;
+				Center = Center + Scale(P - Center, (NewRadius - Radius) / Distance);
+				Radius = NewRadius;
+			}
+		}
+
+		Bounds.Center = Center;
+		Bounds.Radius = Radius;
+	}
+
+	void ComputeNormalCone(const Vec3* Positions, const Meshlet& Cluster, const u32* Vertices, const u8* Triangles, MeshletBounds& Bounds)
+	{
+		Vec3 Normals[MESHLET_MAX_TRIANGLES];
+		u32 NormalCount = 0;
+		Vec3 Sum{ 0.f };
+		for (u32 t = 0; t < Cluster.TriangleCount; ++t)
+		{
+			const Vec3& A = Positions[Vertices[Triangles[t * 3 + 0]]];
+			const Vec3& B = Positions[Vertices[Triangles[t * 3 + 1]]];
+			const Vec3& C = Positions[Vertices[Triangles[t * 3 + 2]]];
+			Vec3 E1 = B - A;
+			Vec3 E2 = C - A;
+			Vec3 Normal{ E1.y * E2.z - E1.z * E2.y, E1.z * E2.x - E1.x * E2.z, E1.x * E2.y - E1.y * E2.x };
+
+			float NormalLength = Length(Normal);
+			if (NormalLength > 0.f)
+			{
+				Normals[NormalCount] = Scale(Normal, 1.f / NormalLength);
+				Sum = Sum + Normals[NormalCount];
+				NormalCount++;
+			}
+		}
+
+		// can't be culled by its cone, only by the frustum
+		Bounds.ConeAxis = Vec3{ 0.f, 0.f, 0.f };
+		Bounds.ConeCutoff = 1.f;
+
+		float SumLength = Length(Sum);
+		if (NormalCount == 0 || SumLength <= 0.f)
+		{
+			return;
+		}
+
+		Vec3 Axis = Scale(Sum, 1.f / SumLength);
+		float MinDot = 1.f;
+		for (u32 i = 0; i < NormalCount; ++i)
+		{
+			MinDot = fminf(MinDot, Dot(Normals[i], Axis));
+		}
+
+		Bounds.ConeAxis = Axis;
+		if (MinDot > 0.f)
+		{
+			Bounds.ConeCutoff = sqrtf(1.f - MinDot * MinDot);
+		}
+	}
+
+	void FinishMeshlet(SceneMeshlets& Scene, Meshlet& Current, const Vec3* Positions, TArray<u8>& LocalIndices)
+	{
+		if (Current.TriangleCount == 0)
+		{
+			return;
+		}
+
+		const u32* Vertices = &Scene.Vertices[Current.VertexOffset];
+		const u8* Triangles = &Scene.Triangles[Current.TriangleOffset];
+
+		MeshletBounds& Bounds = Scene.Bounds.push_back();
+		ComputeBoundingSphere(Positions, Vertices, Current.VertexCount, Bounds);
+		ComputeNormalCone(Positions, Current, Vertices, Triangles, Bounds);
+
+		for (u32 i = 0; i < Current.VertexCount; ++i)
+		{
+			LocalIndices[Vertices[i]] = 0xFF;
+		}
+
+		Scene.Meshlets.push_back(Current);
+		Scene.Triangles.resize(AlignUp(Scene.Triangles.size(), 4), 0);
+		Current = Meshlet{ u32(Scene.Vertices.size()), u32(Scene.Triangles.size()), 0, 0 };
+	}
+}
+
+// Greedy, triangles are taken in index buffer order and a meshlet is closed once the next one doesn't fit.
+// Expects cache optimized indices, their locality is what keeps the meshlets compact.
+void BuildMeshlets(SceneMeshlets& Scene, const u32* Indices, u64 IndexCount, const Vec3* Positions, u32 VertexCount)
+{
+	ZoneScoped;
+	static_assert(MESHLET_MAX_VERTICES < 0xFF, "0xFF marks a vertex that isn't in the current meshlet");
+
+	MeshletRange& Range = Scene.Ranges.push_back();
+	Range.First = u32(Scene.Meshlets.size());
+
+	TArray<u8> LocalIndices(VertexCount, 0xFF);
+	Meshlet Current{ u32(Scene.Vertices.size()), u32(Scene.Triangles.size()), 0, 0 };
+	for (u64 i = 0; i + 3 <= IndexCount; i += 3)
+	{
+		const u32* Triangle = Indices + i;
+
+		u32 NewVertices = 0;
+		for (u32 k = 0; k < 3; ++k)
+		{
+			bool SeenInTriangle = (k > 0 && Triangle[k] == Triangle[0]) || (k > 1 && Triangle[k] == Triangle[1]);
+			NewVertices += LocalIndices[Triangle[k]] == 0xFF && !SeenInTriangle;
+		}
+
+		if (Current.VertexCount + NewVertices > MESHLET_MAX_VERTICES || Current.TriangleCount + 1 > MESHLET_MAX_TRIANGLES)
+		{
+			FinishMeshlet(Scene, Current, Positions, LocalIndices);
+		}
+
+		for (u32 k = 0; k < 3; ++k)
+		{
+			u32 Vertex = Triangle[k];
+			if (LocalIndices[Vertex] == 0xFF)
+			{
+				LocalIndices[Vertex] = u8(Current.VertexCount++);
+				Scene.Vertices.push_back(Vertex);
+			}
+			Scene.Triangles.push_back(LocalIndices[Vertex]);
+		}
+		Current.TriangleCount++;
+	}
+	FinishMeshlet(Scene, Current, Positions, LocalIndices);
+
+	Range.Count = u32(Scene.Meshlets.size()) - Range.First;
+}
+
+// For meshes split on their own, appended in mesh order the result is what one BuildMeshlets call per mesh gives
+void AppendMeshlets(SceneMeshlets& Scene, const SceneMeshlets& Mesh)
+{
+	u32 FirstMeshlet = u32(Scene.Meshlets.size());
+	u32 FirstVertex = u32(Scene.Vertices.size());
+	u32 FirstTriangle = u32(Scene.Triangles.size());
+	CHECK(FirstTriangle % 4 == 0);
+
+	for (MeshletRange Range : Mesh.Ranges)
+	{
+		Range.First += FirstMeshlet;
+		Scene.Ranges.push_back(Range);
+	}
+	for (Meshlet Current : Mesh.Meshlets)
+	{
+		Current.VertexOffset += FirstVertex;
+		Current.TriangleOffset += FirstTriangle;
+		Scene.Meshlets.push_back(Current);
+	}
+	Scene.Bounds.insert(Scene.Bounds.end(), Mesh.Bounds.begin(), Mesh.Bounds.end());
+	Scene.Vertices.insert(Scene.Vertices.end(), Mesh.Vertices.begin(), Mesh.Vertices.end());
+	Scene.Triangles.insert(Scene.Triangles.end(), Mesh.Triangles.begin(), Mesh.Triangles.end());
+}
+
+// Same convention as the shaders get it, clip position is the row vector P * ViewProjection, D3D depth range 0 <= z <= w.
+// A plane that degenerates (the far plane of an infinite projection) never culls anything.
+MeshletCullView MakeMeshletCullView(const Matrix4& ViewProjection, Vec3 CameraPosition)
+{
+	Vec4 Columns[4] = { ViewProjection.Column(0), ViewProjection.Column(1), ViewProjection.Column(2), ViewProjection.Column(3) };
+	auto Combine = [](const Vec4& A, const Vec4& B, float Sign) {
+		return Vec4{ A.x + B.x * Sign, A.y + B.y * Sign, A.z + B.z * Sign, A.w + B.w * Sign };
+	};
+	Vec4 Planes[6] = {
+		Combine(Columns[3], Columns[0], 1.f),
+		Combine(Columns[3], Columns[0], -1.f),
+		Combine(Columns[3], Columns[1], 1.f),
+		Combine(Columns[3], Columns[1], -1.f),
+		Columns[2],
+		Combine(Columns[3], Columns[2], -1.f),
+	};
+
+	MeshletCullView Result;
+	for (u32 i = 0; i < 6; ++i)
+	{
+		Vec4 Plane = Planes[i];
+		float NormalLength = sqrtf(Plane.x * Plane.x + Plane.y * Plane.y + Plane.z * Plane.z);
+		Result.Planes[i] = NormalLength > 0.f
+			? Vec4{ Plane.x / NormalLength, Plane.y / NormalLength, Plane.z / NormalLength, Plane.w / NormalLength }
+			: Vec4{ 0.f, 0.f, 0.f, 1.f };
+	}
+	Result.CameraPosition = CameraPosition;
+	return Result;
+}
+
+// Reference for the GPU version, writes indices of the meshlets that survive frustum and cone culling.
+// View has to be in the bounds' space, returns how many were written.
+u64 CullMeshlets(const MeshletBounds* Bounds, u64 Count, const MeshletCullView& View, u32* Visible)
+{
+	ZoneScoped;
+
+	u64 VisibleCount = 0;
+	for (u64 i = 0; i < Count; ++i)
+	{
+		const MeshletBounds& B = Bounds[i];
+
+		bool Inside = true;
+		for (u32 p = 0; p < 6 && Inside; ++p)
+		{
+			const Vec4& Plane = View.Planes[p];
+			Inside = Plane.x * B.Center.x + Plane.y * B.Center.y + Plane.z * B.Center.z + Plane.w >= -B.Radius;
+		}
+
+		// every direction from the camera into the sphere sees all the normals from behind
+		Vec3 ToCenter = B.Center - View.CameraPosition;
+		bool BackFacing = Dot(ToCenter, B.ConeAxis) > B.ConeCutoff * Length(ToCenter) + B.Radius;
+
+		Visible[VisibleCount] = u32(i);
+		VisibleCount += Inside && !BackFacing;
+	}
+	return VisibleCount;
+}
+
+// Throughput of CullMeshlets for cameras scattered around the meshlets and looking in random directions.
+// Bounds of different meshes are treated as if they shared a space, good enough for timing.
+void BenchmarkMeshletCulling(const MeshletBounds* Bounds, u64 Count, u32 Views)
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	if (Count == 0 || Views == 0)
+	{
+		return;
+	}
+
+	Vec3 Min = Bounds[0].Center;
+	Vec3 Max = Bounds[0].Center;
+	for (u64 i = 0; i < Count; ++i)
+	{
+		const Vec3& C = Bounds[i].Center;
+		Min = Vec3{ fminf(Min.x, C.x), fminf(Min.y, C.y), fminf(Min.z, C.z) };
+		Max = Vec3{ fmaxf(Max.x, C.x), fmaxf(Max.y, C.y), fmaxf(Max.z, C.z) };
+	}
+
+	u32 Seed = 0x9E3779B9;
+	auto Random = [&Seed]() {
+		Seed = Seed * 1664525u + 1013904223u;
+		return float(Seed >> 8) / float(1u << 24);
+	};
+	auto RandomPosition = [&]() {
+		// a quarter of the extent outside the box on every side
+		Vec3 Extent = Max - Min;
+		return Vec3{
+			Min.x + Extent.x * (Random() * 1.5f - 0.25f),
+			Min.y + Extent.y * (Random() * 1.5f - 0.25f),
+			Min.z + Extent.z * (Random() * 1.5f - 0.25f),
+		};
+	};
+
+	Matrix4 Projection = CreatePerspectiveMatrixReverseZ(1.2f, 16.f / 9.f, 1.f);
+	MeshletCullView NoFrustum;
+	for (Vec4& Plane : NoFrustum.Planes)
+	{
+		Plane = Vec4{ 0.f, 0.f, 0.f, 1.f };
+	}
+
+	TArray<u32> Visible(Count);
+	u64 VisibleTotal = 0;
+	u64 ConeVisibleTotal = 0;
+	double Seconds = 0;
+	for (u32 i = 0; i < Views; ++i)
+	{
+		Vec3 Position = RandomPosition();
+		float Yaw = (Random() * 2.f - 1.f) * 3.14159265f;
+		float Pitch = (Random() - 0.5f) * 3.14159265f;
+
+		MeshletCullView View = MakeMeshletCullView(CreateViewMatrix(Position, Vec2{ Yaw, Pitch }) * Projection, Position);
+		NoFrustum.CameraPosition = Position;
+
+		auto Start = Clock::now();
+		VisibleTotal += CullMeshlets(Bounds, Count, View, Visible.data());
+		Seconds += std::chrono::duration<double>(Clock::now() - Start).count();
+
+		ConeVisibleTotal += CullMeshlets(Bounds, Count, NoFrustum, Visible.data());
+	}
+
+	double Tested = double(Count) * Views;
+	printf("%llu meshlets, %u views: %.1f M meshlets/s, %.1f%% visible, %.1f%% back facing by cone alone\n",
+		Count, Views,
+		Tested / Seconds / 1e6,
+		100.0 * VisibleTotal / Tested,
+		100.0 * (Tested - ConeVisibleTotal) / Tested);
+}
@@ -1,18 +1,28 @@
 #include <numeric>
+
+#if _WIN32
 #include <dstorage.h>
+#endif
 
 #include "Assets/Pak.generated.h"
+#include "Assets/Private/Codec.Declarations.h"
+#include "Assets/CookCache.generated.h"
+#include "Assets/Private/CookCache.Declarations.h"
 #include "Render/RenderDX12.generated.h"
-#include "Threading/Mutex.generated.h"
 
 #include "Util/Debug.generated.h"
-#include "Util/Semaphore.generated.h"
 #include "Util/Math.h"
 #include "Util/Util.generated.h"
+#include "Threading/Worker.generated.h"
+#include "Threading/Private/Worker.Declarations.h"
+#include "Threading/Private/DedicatedThread.Declarations.h"
 
 #include <EASTL/sort.h>
+#include <chrono>
+#include <filesystem>
+#include <tracy/Tracy.hpp>
 
-#define PAK_MAGIC (*(u64*)"OVENPKV2")
+#define PAK_MAGIC (*(u64*)"OVENPKV6")
 
 namespace {
 	u32 PackName(u32 Offset, u32 Size)
@@ -29,9 +39,6 @@ namespace {
 	}
 }
 
-static IDStorageCompressionCodec* gDirectStorageCompressionCodecs[8];
-static Semaphore gDirectStorageSemaphore{8};
-
 u32 PushExtraData(PakFileWriter& Pak, RawDataView Data)
 {
 	u64 Result = Pak.ExtraData.size();
@@ -45,22 +52,24 @@ u32 PushExtraData(PakFileWriter& Pak, RawDataView Data)
 
 void InitDirectStorage()
 {
+#if _WIN32
 	InitDirectStorageFactory();
-	for (int i = 0; i < ArrayCount(gDirectStorageCompressionCodecs); ++i)
-	{
-		DStorageCreateCompressionCodec(DSTORAGE_COMPRESSION_FORMAT_GDEFLATE, 0, IID_PPV_ARGS(&gDirectStorageCompressionCodecs[i]));
-	}
+#endif
+	InitCodecs();
 }
 
-PakFileWriter CreatePak(StringView FilePath)
+PakFileWriter CreatePak(StringView FilePath, bool Pipelined)
 {
-	PakFileWriter Result;
+	PakFileWriter Result{};
 	Result.File = fopen(FilePath.data(), "wb");
 
 	String FileDSName = String(FilePath) + "ds";
 	Result.FileDS = fopen(FileDSName.c_str(), "wb");
 	CHECK(Result.File, "Couldn't open file");
 
+	// without workers there is nobody to hand the compression to
+	Result.Pipelined = Pipelined && NumberOfWorkers() > 0;
+
 	PakHeader Header{ 0 };
 	size_t Written = fwrite(&Header, sizeof(Header), 1, Result.File);
 	CHECK(Written == 1, "Failed to write header");
@@ -68,165 +77,485 @@ PakFileWriter CreatePak(StringView FilePath)
 	return Result;
 }
 
-void InsertIntoPak(PakFileWriter& Pak, StringView FileName, RawDataView Data, u32 PrivateFlags, bool UseDirectStorage, bool bCompress)
+struct PakPendingItem
 {
-	ZoneScoped;
+	String    Data;
+	u64       ReservedBytes;
+	u64       ItemIndex;
+	TicketCPU Ticket;
+	bool      HasTicket;
+	bool      UseDirectStorage;
+	u8        Codec; // codec to try, PakCodecNone after the job if it didn't pay off
+	u16       BlockSizeLog2;
+};
+
+#define PAK_MAX_PENDING_BYTES 512_mb
+
+// Items bigger than PAK_BLOCK_THRESHOLD are compressed as independent blocks,
+// so they can be decoded in parallel or partially. DirectStorage items stay a single stream.
+#define PAK_BLOCK_SIZE_LOG2 18
+#define PAK_BLOCK_THRESHOLD (2ull << PAK_BLOCK_SIZE_LOG2)
 
-	u32 FileNameHash = HashString32(FileName);
-	i32 UncompressedDataSize = i32(Data.size());
-	auto It = Pak.HashToItem.find(FileNameHash);
-	if (It != Pak.HashToItem.end())
+namespace
+{
+	// Block table is NumberOfBlocks u32 ends of the compressed blocks, relative to the end of the table.
+	// Block that didn't get any smaller is stored as is, its compressed size equals its uncompressed size.
+	u64 CompressPakBlocks(RawDataView Data, u8 Codec, u32 BlockSizeLog2, String& Out)
 	{
-		CHECK(Pak.Items[It->second].first == FileNameHash);
+		u64 BlockSize = 1ull << BlockSizeLog2;
+		u64 NumberOfBlocks = DivideRoundUp(Data.size(), BlockSize);
+		u64 TableSize = NumberOfBlocks * sizeof(u32);
+
+		Out.resize(TableSize + NumberOfBlocks * CompressBound(Codec, BlockSize));
+
+		u64 Written = 0;
+		for (u64 i = 0; i < NumberOfBlocks; ++i)
 		{
-			u32 NameOffset, NameSize;
-			UnpackName(Pak.Items[It->second].second.FileNameOffsetAndSize, NameOffset, NameSize);
-			if (NameSize == FileName.size())
+			RawDataView Block(Data.data() + i * BlockSize, std::min(BlockSize, Data.size() - i * BlockSize));
+			u8* Dst = (u8*)Out.data() + TableSize + Written;
+
+			u64 BlockCompressedSize = CompressBuffer(Codec, Block, Dst, Out.size() - TableSize - Written);
+			if (BlockCompressedSize == 0 || BlockCompressedSize >= Block.size())
 			{
-				if(strncmp(Pak.ExtraData.data() + NameOffset, FileName.data(), NameSize) != 0)
-				{
-					printf("File duplicate: %.*s", NameSize, FileName.data());
-					return;
-				}
+				memcpy(Dst, Block.data(), Block.size());
+				BlockCompressedSize = Block.size();
 			}
-			//if (FileName == Name2)
-			//{
-				//Debug::Print("File duplicate: ", FileName.data());
-				//return;
-			//}
+			Written += BlockCompressedSize;
+
+			CHECK(Written < UINT32_MAX);
+			u32 BlockEnd = u32(Written);
+			memcpy(Out.data() + i * sizeof(u32), &BlockEnd, sizeof(u32));
 		}
+		return TableSize + Written;
 	}
-	else
+
+	// returns false if the data doesn't get any smaller, Out is left empty then
+	bool CompressPakData(RawDataView Data, u8 Codec, bool UseDirectStorage, String& Out, u16& BlockSizeLog2)
 	{
-		Pak.HashToItem.emplace(FileNameHash, Pak.Items.size());
+		ZoneScoped;
+
+		BlockSizeLog2 = 0;
+		if (Codec == PakCodecNone || Data.empty())
+		{
+			return false;
+		}
+
+		// Oven reuses payloads from the previous cook, blob is the u32 block size log2 followed by the data,
+		// UINT32_MAX marks data that didn't compress.
+		u64 CacheKey = 0;
+		if (IsCookCacheEnabled())
+		{
+			u64 Salt[] = { PAK_MAGIC, Codec, UseDirectStorage, PAK_BLOCK_SIZE_LOG2 };
+			CacheKey = HashData64(Data.data(), Data.size(), HashData64(Salt, sizeof(Salt), 0));
+
+			String Cached;
+			u32 CachedBlockSizeLog2 = 0;
+			if (LoadCookBlob(CacheKey, Cached) && Cached.size() >= sizeof(u32))
+			{
+				memcpy(&CachedBlockSizeLog2, Cached.data(), sizeof(u32));
+				if (CachedBlockSizeLog2 == UINT32_MAX)
+				{
+					Out.clear();
+					return false;
+				}
+				BlockSizeLog2 = u16(CachedBlockSizeLog2);
+				Out.assign(Cached.data() + sizeof(u32), Cached.size() - sizeof(u32));
+				return true;
+			}
+		}
+
+		u64 DstLen = 0;
+		if (!UseDirectStorage && Data.size() > PAK_BLOCK_THRESHOLD)
+		{
+			BlockSizeLog2 = PAK_BLOCK_SIZE_LOG2;
+			DstLen = CompressPakBlocks(Data, Codec, BlockSizeLog2, Out);
+		}
+		else
+		{
+			Out.resize(CompressBound(Codec, Data.size()));
+			DstLen = CompressBuffer(Codec, Data, (u8*)Out.data(), Out.size());
+		}
+
+		bool Compressed = DstLen != 0 && DstLen < Data.size();
+		if (Compressed)
+		{
+			Out.resize(DstLen);
+		}
+		else
+		{
+			BlockSizeLog2 = 0;
+			//Debug::Print("Bad for compression : ", FileName.data(), " Size:", Data.size());
+			Out.clear();
+		}
+
+		if (CacheKey)
+		{
+			u32 CachedBlockSizeLog2 = Compressed ? BlockSizeLog2 : UINT32_MAX;
+			String Blob((const char*)&CachedBlockSizeLog2, sizeof(u32));
+			Blob.append(Out);
+			StoreCookBlob(CacheKey, Blob);
+		}
+		return Compressed;
 	}
 
-	auto NewItemPair = Pak.Items.push_back();
-	PakItem& Item = NewItemPair.second;
-	NewItemPair.first = FileNameHash;
-	u32 ExtraDataOffset = PushExtraData(Pak, RawDataView((const u8*)FileName.data(), FileName.size()));
-	Item.FileNameOffsetAndSize = PackName(ExtraDataOffset, u32(FileName.size()));
-	if (UseDirectStorage)
+	void WritePakItemData(PakFileWriter& Pak, u64 ItemIndex, RawDataView Data, u8 Codec, u16 BlockSizeLog2, bool UseDirectStorage)
 	{
-		Item.UncompressedDataSize = -i32(UncompressedDataSize);
+		PakItem& Item = Pak.Items[ItemIndex].second;
+		Item.Codec = Codec;
+		Item.BlockSizeLog2 = Codec != PakCodecNone ? BlockSizeLog2 : 0;
+		Item.CompressedDataSize = Codec != PakCodecNone ? u32(Data.size()) : 0;
+		Item.Checksum = Crc32C(Data.data(), Data.size(), 0);
+		if (UseDirectStorage)
+		{
+			Item.DataOffset = ftell(Pak.FileDS);
+			size_t Written = fwrite(Data.data(), 1, Data.size(), Pak.FileDS);
+			CHECK(Written == Data.size(), "Failed to write data to direct storage file");
+		}
+		else
+		{
+			Item.DataOffset = ftell(Pak.File);
+			size_t Written = fwrite(Data.data(), 1, Data.size(), Pak.File);
+			CHECK(Written == Data.size(), "Failed to write data to base file");
+		}
 	}
-	else
+
+	// Writes out finished items strictly in insertion order, so the file is the same
+	// no matter how many workers there are or in which order they finish.
+	void CommitPendingPakItems(PakFileWriter& Pak, bool WaitForAll)
 	{
-		Item.UncompressedDataSize = i32(UncompressedDataSize);
+		ZoneScoped;
+		while (!Pak.Pending.empty())
+		{
+			PakPendingItem* Pending = Pak.Pending.front();
+			if (Pending->HasTicket && !WorkIsDone(Pending->Ticket))
+			{
+				if (!WaitForAll && Pak.PendingBytes <= PAK_MAX_PENDING_BYTES)
+				{
+					break;
+				}
+				WaitForCompletion(Pending->Ticket);
+			}
+
+			WritePakItemData(Pak, Pending->ItemIndex, Pending->Data, Pending->Codec, Pending->BlockSizeLog2, Pending->UseDirectStorage);
+
+			Pak.PendingBytes -= Pending->ReservedBytes;
+			Pak.Pending.pop_front();
+			delete Pending;
+		}
 	}
-	Item.CompressedDataSize = 0;
-	Item.PrivateFlags = PrivateFlags;
-	if (UseDirectStorage)
+}
+
+namespace
+{
+	// Adds the item's record, data is written separately. Returns UINT64_MAX for a duplicate name.
+	u64 AddPakItem(PakFileWriter& Pak, StringView FileName, i32 UncompressedDataSize, u32 PrivateFlags)
 	{
-		Item.DataOffset = ftell(Pak.FileDS);
-	}
-	else
-	{ 
-		Item.DataOffset = ftell(Pak.File);
+		u32 FileNameHash = HashString32(FileName);
+		auto It = Pak.HashToItem.find(FileNameHash);
+		if (It != Pak.HashToItem.end())
+		{
+			CHECK(Pak.Items[It->second].first == FileNameHash);
+			{
+				u32 NameOffset, NameSize;
+				UnpackName(Pak.Items[It->second].second.FileNameOffsetAndSize, NameOffset, NameSize);
+				if (NameSize == FileName.size())
+				{
+					if(strncmp(Pak.ExtraData.data() + NameOffset, FileName.data(), NameSize) != 0)
+					{
+						printf("File duplicate: %.*s", NameSize, FileName.data());
+						return UINT64_MAX;
+					}
+				}
+				//if (FileName == Name2)
+				//{
+					//Debug::Print("File duplicate: ", FileName.data());
+					//return;
+				//}
+			}
+		}
+		else
+		{
+			Pak.HashToItem.emplace(FileNameHash, Pak.Items.size());
+		}
+
+		u64 ItemIndex = Pak.Items.size();
+		auto NewItemPair = Pak.Items.push_back();
+		PakItem& Item = NewItemPair.second;
+		NewItemPair.first = FileNameHash;
+		u32 ExtraDataOffset = PushExtraData(Pak, RawDataView((const u8*)FileName.data(), FileName.size()));
+		Item.FileNameOffsetAndSize = PackName(ExtraDataOffset, u32(FileName.size()));
+		Item.UncompressedDataSize = UncompressedDataSize;
+		Item.CompressedDataSize = 0;
+		Item.PrivateFlags = PrivateFlags;
+		Item.DataOffset = 0;
+		Item.Codec = PakCodecNone;
+		Item.BlockSizeLog2 = 0;
+		Item.PakFlags = 0;
+		Item.Checksum = Crc32C(nullptr, 0, 0);
+		Item.Unused = 0;
+		return ItemIndex;
 	}
+}
 
-	const u8 *Src = (const u8*)Data.data();
-	size_t DstLen = Data.size();
-	if (bCompress)
+void InsertIntoPak(PakFileWriter& Pak, StringView FileName, RawDataView Data, u32 PrivateFlags, bool UseDirectStorage, u8 Codec)
+{
+	ZoneScoped;
+
+	i32 UncompressedDataSize = UseDirectStorage ? -i32(Data.size()) : i32(Data.size());
+	u64 ItemIndex = AddPakItem(Pak, FileName, UncompressedDataSize, PrivateFlags);
+	if (ItemIndex == UINT64_MAX)
 	{
-		auto* Codec = gDirectStorageCompressionCodecs[gDirectStorageSemaphore.Aquire()];
-		u64 CompressedSize = Codec->CompressBufferBound(UncompressedDataSize);
-		u8 *Buffer = new u8[CompressedSize];
+		return;
+	}
 
-		Codec->CompressBuffer(
-			(const void*) Data.data(),
-			Data.size(),
-			DSTORAGE_COMPRESSION_BEST_RATIO,
-			Buffer,
-			CompressedSize,
-			&DstLen
-		);
-		gDirectStorageSemaphore.Release();
+	Codec = ResolveCodec(Codec, UseDirectStorage);
 
-		if (DstLen < Data.size())
+	if (!Pak.Pipelined)
+	{
+		String Compressed;
+		u16 BlockSizeLog2 = 0;
+		if (CompressPakData(Data, Codec, UseDirectStorage, Compressed, BlockSizeLog2))
 		{
-			Src = Buffer;
-			Item.CompressedDataSize = u32(DstLen);
+			WritePakItemData(Pak, ItemIndex, Compressed, Codec, BlockSizeLog2, UseDirectStorage);
 		}
 		else
 		{
-			//Debug::Print("Bad for compression : ", FileName.data(), " Size:", Data.size());
-			DstLen = Data.size();
-			bCompress = false;
-			delete[] Buffer;
+			WritePakItemData(Pak, ItemIndex, Data, PakCodecNone, 0, UseDirectStorage);
 		}
+		return;
 	}
-	if (UseDirectStorage)
+
+	// caller's memory is only valid for the duration of the call, so the job works on a copy
+	PakPendingItem* Pending = new PakPendingItem();
+	Pending->Data.assign((const char*)Data.data(), Data.size());
+	Pending->ReservedBytes = Data.size();
+	Pending->ItemIndex = ItemIndex;
+	Pending->HasTicket = Codec != PakCodecNone;
+	Pending->UseDirectStorage = UseDirectStorage;
+	Pending->Codec = Codec;
+	Pending->BlockSizeLog2 = 0;
+
+	if (Pending->HasTicket)
 	{
-		size_t Written = fwrite(Src, 1, DstLen, Pak.FileDS);
-		CHECK(Written == DstLen, "Failed to write data to direct storage file");
+		Pending->Ticket = EnqueueToWorkerWithTicket([Pending]() {
+			String Compressed;
+			if (CompressPakData(Pending->Data, Pending->Codec, Pending->UseDirectStorage, Compressed, Pending->BlockSizeLog2))
+			{
+				Pending->Data = MOVE(Compressed);
+			}
+			else
+			{
+				Pending->Codec = PakCodecNone;
+			}
+		});
 	}
-	else
+
+	Pak.PendingBytes += Pending->ReservedBytes;
+	Pak.Pending.push_back(Pending);
+
+	CommitPendingPakItems(Pak, false);
+}
+
+// For data the caller already encoded with a codec that needs more than the bytes, like PakCodecGeometry.
+// Data is what the item decodes to, it's stored as is when Encoded isn't any smaller.
+void InsertEncodedIntoPak(PakFileWriter& Pak, StringView FileName, RawDataView Data, RawDataView Encoded, u8 Codec, u32 PrivateFlags)
+{
+	ZoneScoped;
+	CHECK(IsCodecAvailable(Codec));
+
+	u64 ItemIndex = AddPakItem(Pak, FileName, i32(Data.size()), PrivateFlags);
+	if (ItemIndex == UINT64_MAX)
 	{
-		size_t Written = fwrite(Src, 1, DstLen, Pak.File);
-		CHECK(Written == DstLen, "Failed to write data to base file");
+		return;
 	}
-	if (bCompress)
+
+	bool Compressed = Codec != PakCodecNone && Encoded.size() < Data.size();
+	RawDataView Stored = Compressed ? Encoded : Data;
+	if (!Pak.Pipelined)
 	{
-		delete[] Src;
+		WritePakItemData(Pak, ItemIndex, Stored, Compressed ? Codec : PakCodecNone, 0, false);
+		return;
 	}
+
+	// nothing left to do on a worker, it only has to wait for the items inserted before it
+	PakPendingItem* Pending = new PakPendingItem();
+	Pending->Data.assign((const char*)Stored.data(), Stored.size());
+	Pending->ReservedBytes = Stored.size();
+	Pending->ItemIndex = ItemIndex;
+	Pending->HasTicket = false;
+	Pending->UseDirectStorage = false;
+	Pending->Codec = Compressed ? Codec : PakCodecNone;
+	Pending->BlockSizeLog2 = 0;
+
+	Pak.PendingBytes += Pending->ReservedBytes;
+	Pak.Pending.push_back(Pending);
+
+	CommitPendingPakItems(Pak, false);
 }
 
-void FinalizePak(PakFileWriter& Pak)
+// Lookup is a minimal perfect hash (hash and displace): name hash picks a bucket,
+// bucket's seed picks the slot. Items and hashes are stored in slot order,
+// so a lookup touches the seed, the hash and the item and never searches.
+namespace
 {
-	PakHeader Header;
-	Header.Magic = PAK_MAGIC;
+	u32 MixHash(u32 Hash)
+	{
+		Hash ^= Hash >> 16;
+		Hash *= 0x85ebca6b;
+		Hash ^= Hash >> 13;
+		Hash *= 0xc2b2ae35;
+		Hash ^= Hash >> 16;
+		return Hash;
+	}
 
-	eastl::sort(
-		Pak.Items.begin(),
-		Pak.Items.end(),
-		[](const std::pair<u64, PakItem>& a, const std::pair<u64, PakItem>& b) {
-			return a.first < b.first;
-		});
+	u32 PakBucket(u32 Hash, u64 NumberOfBuckets)
+	{
+		return u32((u64(MixHash(Hash)) * NumberOfBuckets) >> 32);
+	}
 
-	CHECK(eastl::is_sorted(Pak.Items.begin(), Pak.Items.end(), [](const std::pair<u64, PakItem>& a, const std::pair<u64, PakItem>& b) { return a.first < b.first; }));
+	u32 PakSlot(u32 Hash, u32 Seed, u64 NumberOfItems)
+	{
+		return u32((u64(MixHash(Hash ^ (Seed * 0x9e3779b9))) * NumberOfItems) >> 32);
+	}
 
-	for (int i = 0; i < Pak.Items.size() - 1; ++i)
+	// returns slot for every item in Unique, Seeds gets one seed per bucket
+	TArray<u32> BuildPerfectHash(const TArray<u32>& AllHashes, const TArray<u32>& Unique, TArray<u32>& Seeds)
 	{
-		if (Pak.Items[i].first == Pak.Items[i + 1].first)
+		ZoneScoped;
+
+		u64 NumberOfItems = Unique.size();
+		Seeds.clear();
+		Seeds.resize(DivideRoundUp(NumberOfItems, 4), 0);
+
+		TArray<TArray<u32>> Buckets(Seeds.size());
+		for (u32 i = 0; i < NumberOfItems; ++i)
 		{
-			u32 Offset1, Size1, Offset2, Size2;
-			UnpackName(Pak.Items[i].second.FileNameOffsetAndSize, Offset1, Size1);
-			UnpackName(Pak.Items[i + 1].second.FileNameOffsetAndSize, Offset2, Size2);
-			CHECK(Size1 == Size2 && memcmp(&Pak.ExtraData[Offset1], &Pak.ExtraData[Offset2], Size1) == 0);
+			Buckets[PakBucket(AllHashes[Unique[i]], Seeds.size())].push_back(i);
 		}
+
+		// biggest buckets first while there is still plenty of free slots
+		TArray<u32> Order(Buckets.size());
+		std::iota(Order.begin(), Order.end(), 0);
+		eastl::stable_sort(Order.begin(), Order.end(), [&](u32 A, u32 B) { return Buckets[A].size() > Buckets[B].size(); });
+
+		TArray<u32> Slots(NumberOfItems, ~0U);
+		TArray<u8> Taken(NumberOfItems, 0);
+		TArray<u32> Candidate;
+		for (u32 BucketIndex : Order)
+		{
+			const TArray<u32>& Bucket = Buckets[BucketIndex];
+			if (Bucket.empty())
+			{
+				break;
+			}
+
+			for (u32 Seed = 0; ; ++Seed)
+			{
+				CHECK(Seed != ~0U, "Couldn't build pak lookup");
+
+				Candidate.clear();
+				bool Fits = true;
+				for (u32 Item : Bucket)
+				{
+					u32 Slot = PakSlot(AllHashes[Unique[Item]], Seed, NumberOfItems);
+					if (Taken[Slot] || eastl::find(Candidate.begin(), Candidate.end(), Slot) != Candidate.end())
+					{
+						Fits = false;
+						break;
+					}
+					Candidate.push_back(Slot);
+				}
+
+				if (Fits)
+				{
+					for (u64 i = 0; i < Bucket.size(); ++i)
+					{
+						Slots[Bucket[i]] = Candidate[i];
+						Taken[Candidate[i]] = 1;
+					}
+					Seeds[BucketIndex] = Seed;
+					break;
+				}
+			}
+		}
+		return Slots;
+	}
+}
+
+void FinalizePak(PakFileWriter& Pak)
+{
+	CommitPendingPakItems(Pak, true);
+
+	PakHeader Header{};
+	Header.Magic = PAK_MAGIC;
+
+	// same name inserted twice, first one wins, like in HashToItem
+	TArray<u32> Unique;
+	Unique.reserve(Pak.Items.size());
+	for (u32 i = 0; i < Pak.Items.size(); ++i)
+	{
+		u64 First = Pak.HashToItem[Pak.Items.V1[i]];
+		if (First == i)
+		{
+			Unique.push_back(i);
+			continue;
+		}
+
+		u32 Offset1, Size1, Offset2, Size2;
+		UnpackName(Pak.Items.V2[First].FileNameOffsetAndSize, Offset1, Size1);
+		UnpackName(Pak.Items.V2[i].FileNameOffsetAndSize, Offset2, Size2);
+		CHECK(Size1 == Size2 && memcmp(&Pak.ExtraData[Offset1], &Pak.ExtraData[Offset2], Size1) == 0, "Name hash collision");
 	}
 
-	while (Pak.Items.size() % 16 != 0)
+	TArray<u32> Seeds;
+	TArray<u32> Slots = BuildPerfectHash(Pak.Items.V1, Unique, Seeds);
+
+	TArray<u32> Hashes(Unique.size());
+	TArray<PakItem> Items(Unique.size());
+	for (u64 i = 0; i < Unique.size(); ++i)
 	{
-		Pak.Items.push_back() = std::pair<u32,PakItem>(0, {0});
+		Hashes[Slots[i]] = Pak.Items.V1[Unique[i]];
+		Items[Slots[i]] = Pak.Items.V2[Unique[i]];
 	}
 
-	Header.NumberOfItems = Pak.Items.size();
+	Header.NumberOfItems = Unique.size();
+	Header.NumberOfBuckets = Seeds.size();
+
 	u64 HashesOld = ftell(Pak.File);
-	u64 HashesAligned = AlignUp(HashesOld, 32);
-	u8 Zeros[32] = {0};
+	u64 HashesAligned = AlignUp(HashesOld, 64);
+	u8 Zeros[64] = {0};
 
 	Header.HashesOffset = HashesAligned;
 	fwrite(Zeros, 1, HashesAligned - HashesOld, Pak.File);
 
-	CHECK(ftell(Pak.File) % 32 == 0);
+	CHECK(ftell(Pak.File) % 64 == 0);
 
-	fwrite(Pak.Items.V1.data(), sizeof(u32), Header.NumberOfItems, Pak.File);
+	fwrite(Hashes.data(), sizeof(u32), Hashes.size(), Pak.File);
 
 	Header.ItemsOffset = ftell(Pak.File);
-	fwrite(Pak.Items.V2.data(), sizeof(PakItem), Header.NumberOfItems, Pak.File);
+	fwrite(Items.data(), sizeof(PakItem), Items.size(), Pak.File);
+
+	Header.SeedsOffset = ftell(Pak.File);
+	fwrite(Seeds.data(), sizeof(u32), Seeds.size(), Pak.File);
 
 	Header.ExtraDataOffset = ftell(Pak.File);
 
 	fwrite(Pak.ExtraData.data(), 1, Pak.ExtraData.size(), Pak.File);
 
+	// sections are back to back, so this is the same as a checksum of the file from HashesOffset to the end
+	u32 MetadataChecksum = Crc32C(Hashes.data(), Hashes.size() * sizeof(u32), 0);
+	MetadataChecksum = Crc32C(Items.data(), Items.size() * sizeof(PakItem), MetadataChecksum);
+	MetadataChecksum = Crc32C(Seeds.data(), Seeds.size() * sizeof(u32), MetadataChecksum);
+	MetadataChecksum = Crc32C(Pak.ExtraData.data(), Pak.ExtraData.size(), MetadataChecksum);
+	Header.MetadataChecksum = MetadataChecksum;
+
 	fseek(Pak.File, 0, SEEK_SET);
 	fwrite(&Header, sizeof(Header), 1, Pak.File);
 	fclose(Pak.File);
 	fclose(Pak.FileDS);
 	Pak.File = nullptr;
 	Pak.Items.clear();
+	Pak.HashToItem.clear();
 	Pak.ExtraData.clear();
 }
 
@@ -235,17 +564,82 @@ PakHeader* GetHeader(const PakFileReader& Pak)
 	return (PakHeader*)Pak.Mapping.BasePtr;
 }
 
-PakFileReader OpenPak(StringView FilePath)
+static std::atomic<bool> gPakVerifyReads;
+
+// Every read checks the item's stored bytes against its checksum before decoding, OpenPak checks the metadata.
+// Costs an extra pass over the data, for hunting down bad files on disk. DirectStorage reads aren't covered.
+void SetPakReadVerification(bool Enabled)
 {
-	PakFileReader Result;
-	Result.Mapping = MapFile(FilePath);
+	gPakVerifyReads.store(Enabled, std::memory_order_relaxed);
+}
 
-	String DSPath = String(FilePath) + "ds";
-	Result.FileDS = CreateDSFile(DSPath);
+namespace
+{
+	// Sections described by the header are where they should be and fit in the file, contents aren't looked at.
+	bool IsPakLayoutValid(const FileMapping& File)
+	{
+		if (File.FileSize < sizeof(PakHeader))
+		{
+			return false;
+		}
 
-	PakHeader* Header = GetHeader(Result);
-	CHECK(Header->Magic == PAK_MAGIC, "Wrong file?");
+		const PakHeader* Header = (const PakHeader*)File.BasePtr;
+		if (Header->Magic != PAK_MAGIC
+			|| Header->HashesOffset < sizeof(PakHeader)
+			|| Header->HashesOffset > Header->ItemsOffset
+			|| Header->ItemsOffset > Header->SeedsOffset
+			|| Header->SeedsOffset > Header->ExtraDataOffset
+			|| Header->ExtraDataOffset > File.FileSize)
+		{
+			return false;
+		}
+
+		return Header->ItemsOffset - Header->HashesOffset == Header->NumberOfItems * sizeof(u32)
+			&& Header->SeedsOffset - Header->ItemsOffset == Header->NumberOfItems * sizeof(PakItem)
+			&& Header->ExtraDataOffset - Header->SeedsOffset == Header->NumberOfBuckets * sizeof(u32);
+	}
+
+	bool IsPakMetadataValid(const FileMapping& File)
+	{
+		const PakHeader* Header = (const PakHeader*)File.BasePtr;
+		return Crc32C((const u8*)File.BasePtr + Header->HashesOffset, File.FileSize - Header->HashesOffset, 0) == Header->MetadataChecksum;
+	}
+
+	PakFileReader OpenPakLayer(StringView FilePath, u32 MapFlags)
+	{
+		PakFileReader Result{};
+		Result.Mapping = MapFile(FilePath, MapFlags);
+		CHECK(IsValid(Result.Mapping), "Couldn't map pak");
 
+#if _WIN32
+		String DSPath = String(FilePath) + "ds";
+		Result.FileDS = CreateDSFile(DSPath);
+#endif
+
+		CHECK(Result.Mapping.FileSize >= sizeof(PakHeader) && GetHeader(Result)->Magic == PAK_MAGIC, "Wrong file?");
+		CHECK(IsPakLayoutValid(Result.Mapping), "Truncated or corrupted pak");
+
+		if (gPakVerifyReads.load(std::memory_order_relaxed) && !IsPakMetadataValid(Result.Mapping))
+		{
+			printf("%.*s: pak metadata doesn't match its checksum\n", VIEW_PRINT(FilePath));
+			DEBUG_BREAK();
+		}
+
+		return Result;
+	}
+}
+
+// Mounts "<pak>delta" on top if a delta for this exact base was deployed next to it.
+PakFileReader OpenPak(StringView FilePath, u32 MapFlags)
+{
+	PakFileReader Result = OpenPakLayer(FilePath, MapFlags);
+
+	String DeltaPath = String(FilePath) + "delta";
+	std::error_code Error;
+	if (std::filesystem::exists(DeltaPath, Error))
+	{
+		MountPakDelta(Result, DeltaPath, MapFlags);
+	}
 	return Result;
 }
 
@@ -257,6 +651,7 @@ TArrayView<u32> GetItemHashes(const PakFileReader& Pak)
 	return TArrayView<u32>(Ptr, Header->NumberOfItems);
 }
 
+// Items of this layer only, mounted deltas are not included.
 TArrayView<PakItem> GetItems(const PakFileReader& Pak)
 {
 	PakHeader* Header = GetHeader(Pak);
@@ -265,76 +660,172 @@ TArrayView<PakItem> GetItems(const PakFileReader& Pak)
 	return TArrayView<PakItem>(Ptr, Header->NumberOfItems);
 }
 
+// Pak or mounted delta the item came from, its data offset is relative to that file.
+const PakFileReader& GetPakLayer(const PakFileReader& Pak, const PakItem& Item)
+{
+	for (const PakFileReader* Layer = Pak.Overlay; Layer; Layer = Layer->Overlay)
+	{
+		TArrayView<PakItem> Items = GetItems(*Layer);
+		if (&Item >= Items.data() && &Item < Items.data() + Items.size())
+		{
+			return *Layer;
+		}
+	}
+	return Pak;
+}
+
 StringView GetFileName(const PakFileReader& Pak, const PakItem& Item)
 {
-	PakHeader* Header = GetHeader(Pak);
+	const PakFileReader& Layer = GetPakLayer(Pak, Item);
+	PakHeader* Header = GetHeader(Layer);
 	u32 NameOffset, NameSize;
 	UnpackName(Item.FileNameOffsetAndSize, NameOffset, NameSize);
-	return StringView((char*)Pak.Mapping.BasePtr + Header->ExtraDataOffset + NameOffset, NameSize);
+	return StringView((char*)Layer.Mapping.BasePtr + Header->ExtraDataOffset + NameOffset, NameSize);
 }
 
-TracyLockable(Mutex, k);
-const PakItem* FindItem(const PakFileReader& Pak, StringView FileName)
+TArrayView<u32> GetBucketSeeds(const PakFileReader& Pak)
 {
-	ScopedLock kek(k);
-
-	auto Hashes = GetItemHashes(Pak);
-	CHECK(Hashes.size());
-
-	u32 FileNameHash = HashString32(FileName);
+	PakHeader* Header = GetHeader(Pak);
 
-	CHECK(uintptr_t(Hashes.data()) % 32 == 0);
-	__m256i Comparator = _mm256_set1_epi32(FileNameHash);
+	u32* Ptr = (u32*)((uintptr_t)Pak.Mapping.BasePtr + Header->SeedsOffset);
+	return TArrayView<u32>(Ptr, Header->NumberOfBuckets);
+}
 
-	u32 Start = 0, End = (u32)(Hashes.size() - 1);
-	while (Start <= End)
+namespace
+{
+	const PakItem* FindItemInLayer(const PakFileReader& Pak, u32 FileNameHash)
 	{
-		u32 Index = (Start + End) / 2;
-		Index = AlignDown(Index, 16u);
+		PakHeader* Header = GetHeader(Pak);
+		if (Header->NumberOfItems == 0)
+		{
+			return nullptr;
+		}
 
-		__m256i HashLine1 = _mm256_load_si256((const __m256i*)&Hashes[Index]);
-		__m256i HashLine2 = _mm256_load_si256((const __m256i*)&Hashes[Index + 8]);
-		__m256i ComparisonResult1 = _mm256_cmpeq_epi32(HashLine1, Comparator);
-		__m256i ComparisonResult2 = _mm256_cmpeq_epi32(HashLine2, Comparator);
-		u32 Mask1 = _mm256_movemask_epi8(ComparisonResult1);
-		u32 Mask2 = _mm256_movemask_epi8(ComparisonResult2);
+		u32 Seed = GetBucketSeeds(Pak)[PakBucket(FileNameHash, Header->NumberOfBuckets)];
+		u32 Slot = PakSlot(FileNameHash, Seed, Header->NumberOfItems);
 
-		u64 Mask = u64(Mask1) | (u64(Mask2) << 32);
+		if (GetItemHashes(Pak)[Slot] != FileNameHash)
+		{
+			return nullptr;
+		}
+		return &GetItems(Pak)[Slot];
+	}
 
-		if (Mask != 0)
+	// newest layer wins, tombstones included so they can hide the item underneath
+	const PakItem* FindItemInLayers(const PakFileReader& Pak, u32 FileNameHash)
+	{
+		if (Pak.Overlay)
 		{
-			CHECK(__popcnt64(Mask) == 4);
-			u32 BitIndex = _tzcnt_u64(Mask);
-			Index += BitIndex / 4;
-			const PakItem* Result = &(GetItems(Pak))[Index];
-			StringView Found = GetFileName(Pak, *Result);
-			CHECK(Found.size() == FileName.size() && strncmp(Found.data(), FileName.data(), Found.size()) == 0);
-			return Result;
+			if (const PakItem* Result = FindItemInLayers(*Pak.Overlay, FileNameHash))
+			{
+				return Result;
+			}
 		}
+		return FindItemInLayer(Pak, FileNameHash);
+	}
+}
 
-		if (Hashes[Index] < FileNameHash)
+// For hot paths that keep the hash around instead of formatting and hashing the name every time.
+// Doesn't check the name, two names with the same hash can't end up in the same pak though.
+const PakItem* FindItem(const PakFileReader& Pak, u32 FileNameHash)
+{
+	const PakItem* Result = FindItemInLayers(Pak, FileNameHash);
+	if (Result == nullptr || (Result->PakFlags & PakItemTombstone))
+	{
+		return nullptr;
+	}
+	return Result;
+}
+
+const PakItem* FindItem(const PakFileReader& Pak, StringView FileName)
+{
+	const PakItem* Result = FindItem(Pak, HashString32(FileName));
+	if (Result == nullptr)
+	{
+		return nullptr;
+	}
+
+	StringView Found = GetFileName(Pak, *Result);
+	if (Found.size() != FileName.size() || strncmp(Found.data(), FileName.data(), Found.size()) != 0)
+	{
+		return nullptr;
+	}
+	return Result;
+}
+
+u64 GetNumberOfBlocks(const PakItem& Item)
+{
+	if (Item.CompressedDataSize == 0 || Item.BlockSizeLog2 == 0)
+	{
+		return 1;
+	}
+	return DivideRoundUp(u64(Item.UncompressedDataSize), 1ull << Item.BlockSizeLog2);
+}
+
+namespace
+{
+	u64 GetStoredSize(const PakItem& Item)
+	{
+		return Item.CompressedDataSize ? Item.CompressedDataSize : u64(std::abs(Item.UncompressedDataSize));
+	}
+
+	// Stops right at the read, corrupted data would otherwise come out as garbage or crash a decoder.
+	void VerifyPakItemOnRead(const PakFileReader& Layer, const PakItem& Item, const u8* Stored)
+	{
+		if (!gPakVerifyReads.load(std::memory_order_relaxed))
 		{
-			Start = Index + 16;
+			return;
 		}
-		else
+
+		ZoneScoped;
+		if (Crc32C(Stored, GetStoredSize(Item), 0) != Item.Checksum)
 		{
-			End = Index - 1;
+			StringView Name = GetFileName(Layer, Item);
+			printf("Pak item '%.*s' doesn't match its checksum\n", VIEW_PRINT(Name));
+			DEBUG_BREAK();
 		}
 	}
-	
-	return nullptr;
+
+	void DecodePakBlock(const PakItem& Item, const u8* Data, u64 BlockIndex, u8* Address)
+	{
+		u64 NumberOfBlocks = GetNumberOfBlocks(Item);
+		const u32* BlockEnds = (const u32*)Data;
+		const u8* Blocks = Data + NumberOfBlocks * sizeof(u32);
+
+		u64 BlockSize = 1ull << Item.BlockSizeLog2;
+		u64 UncompressedBlockSize = std::min(BlockSize, u64(Item.UncompressedDataSize) - BlockIndex * BlockSize);
+		u64 BlockBegin = BlockIndex ? BlockEnds[BlockIndex - 1] : 0;
+		u64 CompressedBlockSize = BlockEnds[BlockIndex] - BlockBegin;
+
+		CHECK(BlockEnds[BlockIndex] >= BlockBegin && NumberOfBlocks * sizeof(u32) + BlockEnds[BlockIndex] <= Item.CompressedDataSize, "Corrupted pak block table");
+
+		u8 Codec = CompressedBlockSize == UncompressedBlockSize ? PakCodecNone : u8(Item.Codec);
+		bool Decoded = DecompressBuffer(Codec, RawDataView(Blocks + BlockBegin, CompressedBlockSize), Address, UncompressedBlockSize);
+		CHECK(Decoded, "Corrupted pak block");
+	}
 }
 
 void FillBuffer(const PakFileReader& Pak, const PakItem& Item, void* Address)
 {
-	auto* Data = (const u8*)Pak.Mapping.BasePtr + Item.DataOffset;
-	if (Item.CompressedDataSize != 0)
+	const PakFileReader& Layer = GetPakLayer(Pak, Item);
+	auto* Data = (const u8*)Layer.Mapping.BasePtr + Item.DataOffset;
+	VerifyPakItemOnRead(Layer, Item, Data);
+
+	if (Item.CompressedDataSize != 0 && Item.BlockSizeLog2 != 0)
+	{
+		ZoneScopedN("FillBuffer blocks");
+		u64 BlockSize = 1ull << Item.BlockSizeLog2;
+		ParallelFor([&](u64 Begin, u64 End) {
+			for (u64 i = Begin; i < End; ++i)
+			{
+				DecodePakBlock(Item, Data, i, (u8*)Address + i * BlockSize);
+			}
+		}, GetNumberOfBlocks(Item), 1);
+	}
+	else if (Item.CompressedDataSize != 0)
 	{
-		size_t UncompressedOut;
-		gDirectStorageCompressionCodecs[gDirectStorageSemaphore.Aquire()]->DecompressBuffer(Data, Item.CompressedDataSize, Address, Item.UncompressedDataSize, &UncompressedOut);
-		gDirectStorageSemaphore.Release();
-		CHECK(UncompressedOut == Item.UncompressedDataSize);
-		//Decompress(Data, Item.CompressedDataSize, (u8*)Address, Item.UncompressedDataSize);
+		bool Decoded = DecompressBuffer(Item.Codec, RawDataView(Data, Item.CompressedDataSize), (u8*)Address, Item.UncompressedDataSize);
+		CHECK(Decoded, "Corrupted pak item");
 	}
 	else
 	{
@@ -342,6 +833,253 @@ void FillBuffer(const PakFileReader& Pak, const PakItem& Item, void* Address)
 	}
 }
 
+// Fills Address with bytes [Offset, Offset + Size) of the item, only the blocks covering the range are decoded.
+void FillBufferRange(const PakFileReader& Pak, const PakItem& Item, u64 Offset, u64 Size, void* Address)
+{
+	ZoneScoped;
+	CHECK(Offset + Size <= u64(Item.UncompressedDataSize), "Range is out of the item bounds");
+
+	if (Item.CompressedDataSize != 0 && Item.BlockSizeLog2 == 0)
+	{
+		String Whole;
+		Whole.resize(Item.UncompressedDataSize);
+		FillBuffer(Pak, Item, Whole.data());
+		memcpy(Address, Whole.data() + Offset, Size);
+		return;
+	}
+
+	// the checksum covers the whole item, so verification reads all of it even for a small range
+	const PakFileReader& Layer = GetPakLayer(Pak, Item);
+	auto* Data = (const u8*)Layer.Mapping.BasePtr + Item.DataOffset;
+	VerifyPakItemOnRead(Layer, Item, Data);
+
+	if (Item.CompressedDataSize == 0)
+	{
+		memcpy(Address, Data + Offset, Size);
+		return;
+	}
+
+	if (Size == 0)
+	{
+		return;
+	}
+
+	u64 BlockSize = 1ull << Item.BlockSizeLog2;
+	u64 FirstBlock = Offset >> Item.BlockSizeLog2;
+	u64 LastBlock = (Offset + Size - 1) >> Item.BlockSizeLog2;
+
+	ParallelFor([&](u64 Begin, u64 End) {
+		String Scratch;
+		for (u64 i = FirstBlock + Begin; i < FirstBlock + End; ++i)
+		{
+			u64 BlockBegin = i * BlockSize;
+			u64 BlockEnd = std::min(BlockBegin + BlockSize, u64(Item.UncompressedDataSize));
+			u64 CopyBegin = std::max(BlockBegin, Offset);
+			u64 CopyEnd = std::min(BlockEnd, Offset + Size);
+			u8* Dst = (u8*)Address + (CopyBegin - Offset);
+
+			if (CopyBegin == BlockBegin && CopyEnd == BlockEnd)
+			{
+				DecodePakBlock(Item, Data, i, Dst);
+				continue;
+			}
+
+			// edge block, only part of it was asked for
+			Scratch.resize(BlockEnd - BlockBegin);
+			DecodePakBlock(Item, Data, i, (u8*)Scratch.data());
+			memcpy(Dst, Scratch.data() + (CopyBegin - BlockBegin), CopyEnd - CopyBegin);
+		}
+	}, LastBlock - FirstBlock + 1, 1);
+}
+
+// Async reads: the pak read thread does positional reads straight into the destination
+// (or into staging for compressed items) and hands decompression to the workers,
+// so the next read is already in flight while the previous item decodes.
+static DedicatedThreadData gPakReadThread;
+
+void StartPakReadThread()
+{
+	gPakReadThread.ThreadShouldStealWork = false;
+	StartDedicatedThread(&gPakReadThread, String("PakReadThread"), 0x1);
+}
+
+void StopPakReadThread()
+{
+	StopDedicatedThread(&gPakReadThread);
+}
+
+struct PakReadBatch
+{
+	PakFileReader          Pak;
+	TArray<PakReadRequest> Requests;
+	TArray<const PakFileReader*> Layers; // file every request is read from, resolved against Pak when empty
+	TArray<String>         Staging; // compressed bytes, empty for items read straight into Dest
+	std::atomic<u64>       PendingJobs;
+	TicketCPU              Ticket;
+};
+
+namespace
+{
+	void FinishPakReadJob(PakReadBatch* Batch)
+	{
+		if (Batch->PendingJobs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			SignalTicket(Batch->Ticket);
+			delete Batch;
+		}
+	}
+
+	void EnqueuePakDecode(PakReadBatch* Batch, u64 RequestIndex)
+	{
+		const PakItem& Item = *Batch->Requests[RequestIndex].Item;
+		u8* Dest = (u8*)Batch->Requests[RequestIndex].Dest;
+		const u8* Data = (const u8*)Batch->Staging[RequestIndex].data();
+
+		// blocks are independent, so they go to workers one by one
+		u64 NumberOfBlocks = Item.BlockSizeLog2 ? GetNumberOfBlocks(Item) : 1;
+		Batch->PendingJobs.fetch_add(NumberOfBlocks, std::memory_order_relaxed);
+		for (u64 i = 0; i < NumberOfBlocks; ++i)
+		{
+			EnqueueToWorker([Batch, &Item, Dest, Data, i]() {
+				ZoneScopedN("Pak decode");
+				if (Item.BlockSizeLog2)
+				{
+					DecodePakBlock(Item, Data, i, Dest + (i << Item.BlockSizeLog2));
+				}
+				else
+				{
+					bool Decoded = DecompressBuffer(Item.Codec, RawDataView(Data, Item.CompressedDataSize), Dest, Item.UncompressedDataSize);
+					CHECK(Decoded, "Corrupted pak item");
+				}
+				FinishPakReadJob(Batch);
+			});
+		}
+	}
+
+	void ExecutePakReads(PakReadBatch* Batch)
+	{
+		ZoneScopedN("Pak reads");
+
+		u64 Count = Batch->Requests.size();
+		if (Batch->Layers.empty())
+		{
+			Batch->Layers.resize(Count);
+			for (u64 i = 0; i < Count; ++i)
+			{
+				Batch->Layers[i] = &GetPakLayer(Batch->Pak, *Batch->Requests[i].Item);
+			}
+		}
+
+		// grouped by file and in file order, so neighbouring items become a single read
+		TArray<u64> Order(Count);
+		std::iota(Order.begin(), Order.end(), 0);
+		eastl::sort(Order.begin(), Order.end(), [Batch](u64 A, u64 B) {
+			const PakFileReader* LayerA = Batch->Layers[A];
+			const PakFileReader* LayerB = Batch->Layers[B];
+			if (LayerA != LayerB)
+			{
+				return LayerA->Mapping.BasePtr < LayerB->Mapping.BasePtr;
+			}
+			return Batch->Requests[A].Item->DataOffset < Batch->Requests[B].Item->DataOffset;
+		});
+
+		TArray<PakReadRequest> Requests(Count);
+		TArray<const PakFileReader*> Layers(Count);
+		for (u64 i = 0; i < Count; ++i)
+		{
+			Requests[i] = Batch->Requests[Order[i]];
+			Layers[i] = Batch->Layers[Order[i]];
+		}
+		Batch->Requests = MOVE(Requests);
+
+		Batch->Staging.resize(Count);
+		TArray<FileReadRange> Ranges(Count);
+		for (u64 i = 0; i < Count; ++i)
+		{
+			const PakItem& Item = *Batch->Requests[i].Item;
+			CHECK(Item.UncompressedDataSize >= 0, "DirectStorage items are read with DirectStorage");
+
+			Ranges[i].Offset = Item.DataOffset;
+			Ranges[i].Size = Item.CompressedDataSize ? Item.CompressedDataSize : Item.UncompressedDataSize;
+			Ranges[i].Dest = Batch->Requests[i].Dest;
+			if (Item.CompressedDataSize)
+			{
+				Batch->Staging[i].resize(Item.CompressedDataSize);
+				Ranges[i].Dest = Batch->Staging[i].data();
+			}
+		}
+
+		// read a run of back to back items, then let workers decode it while the next run is read
+		u64 RunBegin = 0;
+		while (RunBegin < Ranges.size())
+		{
+			u64 RunEnd = RunBegin + 1;
+			while (RunEnd < Ranges.size() && Layers[RunEnd] == Layers[RunBegin] && Ranges[RunEnd].Offset == Ranges[RunEnd - 1].Offset + Ranges[RunEnd - 1].Size)
+			{
+				RunEnd++;
+			}
+
+			bool Read = ReadFileRanges(Layers[RunBegin]->Mapping, &Ranges[RunBegin], RunEnd - RunBegin);
+			CHECK(Read, "Failed to read pak");
+
+			for (u64 i = RunBegin; i < RunEnd; ++i)
+			{
+				VerifyPakItemOnRead(*Layers[i], *Batch->Requests[i].Item, (const u8*)Ranges[i].Dest);
+				if (Batch->Requests[i].Item->CompressedDataSize)
+				{
+					EnqueuePakDecode(Batch, i);
+				}
+			}
+			RunBegin = RunEnd;
+		}
+
+		FinishPakReadJob(Batch);
+	}
+}
+
+// Ticket is done once every item of the batch is in its destination, works with WaitForCompletion.
+TicketCPU EnqueuePakReads(const PakFileReader& Pak, const PakReadRequest* Requests, u64 Count)
+{
+	ZoneScoped;
+
+	PakReadBatch* Batch = new PakReadBatch();
+	Batch->Pak = Pak;
+	Batch->Requests.assign(Requests, Requests + Count);
+	Batch->PendingJobs.store(1, std::memory_order_relaxed); // the read job itself
+	Batch->Ticket = CreateTicket();
+
+	TicketCPU Result = Batch->Ticket;
+	EnqueueWork(&gPakReadThread, [Batch]() {
+		ExecutePakReads(Batch);
+	});
+	return Result;
+}
+
+// For callers that already know which file every request goes to, like the VFS.
+// Layers have to stay alive until the ticket is done.
+TicketCPU EnqueueLayeredPakReads(const PakFileReader* const* Layers, const PakReadRequest* Requests, u64 Count)
+{
+	ZoneScoped;
+
+	PakReadBatch* Batch = new PakReadBatch();
+	Batch->Requests.assign(Requests, Requests + Count);
+	Batch->Layers.assign(Layers, Layers + Count);
+	Batch->PendingJobs.store(1, std::memory_order_relaxed);
+	Batch->Ticket = CreateTicket();
+
+	TicketCPU Result = Batch->Ticket;
+	EnqueueWork(&gPakReadThread, [Batch]() {
+		ExecutePakReads(Batch);
+	});
+	return Result;
+}
+
+TicketCPU EnqueuePakRead(const PakFileReader& Pak, const PakItem& Item, void* Dest)
+{
+	PakReadRequest Request{ &Item, Dest };
+	return EnqueuePakReads(Pak, &Request, 1);
+}
+
 String GetFileData(const PakFileReader& Pak, const PakItem& Item)
 {
 	String Result;
@@ -353,7 +1091,357 @@ String GetFileData(const PakFileReader& Pak, const PakItem& Item)
 
 void ClosePak(PakFileReader& Pak)
 {
+	if (Pak.Overlay)
+	{
+		ClosePak(*Pak.Overlay);
+		delete Pak.Overlay;
+		Pak.Overlay = nullptr;
+	}
+
 	UnmapFile(Pak.Mapping);
-	Pak.FileDS->Release();
+#if _WIN32
+	if (Pak.FileDS)
+	{
+		Pak.FileDS->Release();
+	}
+#endif
 	Pak.FileDS = nullptr;
 }
+
+// Delta paks: regular paks with only what changed since the base, mounted on top of it.
+#define PAK_DELTA_INFO_NAME "___PakDelta"
+
+struct PakDeltaInfo
+{
+	u64 BaseIdentity;   // layout of the pak the delta was made against
+	u64 ResultIdentity; // layout of the full pak that base + delta stand for
+};
+
+namespace
+{
+	// Hashes, items, seeds and names, everything after the item data.
+	// Cheap enough to check on every mount, data itself isn't looked at.
+	u64 HashPakLayout(const PakFileReader& Pak)
+	{
+		PakHeader* Header = GetHeader(Pak);
+		const u8* Begin = (const u8*)Pak.Mapping.BasePtr + Header->HashesOffset;
+		return HashData64(Begin, Pak.Mapping.FileSize - Header->HashesOffset, PAK_MAGIC);
+	}
+
+	const PakItem* FindDeltaInfo(const PakFileReader& Layer)
+	{
+		const PakItem* Item = FindItemInLayer(Layer, HashString32(PAK_DELTA_INFO_NAME));
+		return Item && Item->UncompressedDataSize == sizeof(PakDeltaInfo) ? Item : nullptr;
+	}
+
+	// what the stack of layers up to and including this one is equivalent to
+	u64 GetLayerIdentity(const PakFileReader& Layer)
+	{
+		if (const PakItem* InfoItem = FindDeltaInfo(Layer))
+		{
+			return GetFileDataTyped<PakDeltaInfo>(Layer, *InfoItem).ResultIdentity;
+		}
+		return HashPakLayout(Layer);
+	}
+
+	RawDataView GetStoredData(const FileMapping& File, const FileMapping& FileDS, const PakItem& Item)
+	{
+		const FileMapping& Source = Item.UncompressedDataSize < 0 ? FileDS : File;
+		u64 Size = GetStoredSize(Item);
+		if (Size == 0)
+		{
+			return RawDataView(nullptr, 0);
+		}
+		CHECK(IsValid(Source) && Item.DataOffset + Size <= Source.FileSize, "Pak item is out of the file bounds");
+		return RawDataView((const u8*)Source.BasePtr + Item.DataOffset, Size);
+	}
+
+	bool DecodeStoredData(const PakItem& Item, RawDataView Stored, String& Out)
+	{
+		u64 Size = u64(std::abs(Item.UncompressedDataSize));
+		Out.resize(Size);
+		if (Item.CompressedDataSize == 0)
+		{
+			memcpy(Out.data(), Stored.data(), Size);
+			return true;
+		}
+		if (Item.BlockSizeLog2)
+		{
+			for (u64 i = 0; i < GetNumberOfBlocks(Item); ++i)
+			{
+				DecodePakBlock(Item, Stored.data(), i, (u8*)Out.data() + (i << Item.BlockSizeLog2));
+			}
+			return true;
+		}
+		return DecompressBuffer(Item.Codec, Stored, (u8*)Out.data(), Size);
+	}
+
+	bool IsSameItem(const PakItem& A, RawDataView StoredA, const PakItem& B, RawDataView StoredB)
+	{
+		if (A.UncompressedDataSize != B.UncompressedDataSize || A.PrivateFlags != B.PrivateFlags)
+		{
+			return false;
+		}
+
+		// codecs are deterministic, same codec means same bytes for the same content
+		if (A.Codec == B.Codec && A.BlockSizeLog2 == B.BlockSizeLog2 && A.CompressedDataSize == B.CompressedDataSize)
+		{
+			return A.Checksum == B.Checksum && StoredA.size() == StoredB.size() && memcmp(StoredA.data(), StoredB.data(), StoredA.size()) == 0;
+		}
+
+		// stored differently, compare what it decodes to
+		String DataA, DataB;
+		return DecodeStoredData(A, StoredA, DataA) && DecodeStoredData(B, StoredB, DataB) && DataA == DataB;
+	}
+
+	// copies an item from another pak as is, without recompressing it
+	void InsertStoredIntoPak(PakFileWriter& Pak, StringView FileName, const PakItem& Source, RawDataView Stored)
+	{
+		CommitPendingPakItems(Pak, true);
+
+		u64 ItemIndex = AddPakItem(Pak, FileName, Source.UncompressedDataSize, Source.PrivateFlags);
+		if (ItemIndex == UINT64_MAX)
+		{
+			return;
+		}
+
+		u8 Codec = Source.CompressedDataSize ? u8(Source.Codec) : PakCodecNone;
+		WritePakItemData(Pak, ItemIndex, Stored, Codec, Source.BlockSizeLog2, Source.UncompressedDataSize < 0);
+	}
+
+	void InsertTombstoneIntoPak(PakFileWriter& Pak, StringView FileName)
+	{
+		u64 ItemIndex = AddPakItem(Pak, FileName, 0, 0);
+		if (ItemIndex != UINT64_MAX)
+		{
+			Pak.Items[ItemIndex].second.PakFlags |= PakItemTombstone;
+		}
+	}
+
+	FileMapping MapPakDS(StringView PakPath)
+	{
+		String DSPath = String(PakPath) + "ds";
+		std::error_code Error;
+		if (std::filesystem::file_size(DSPath, Error) == 0 || Error)
+		{
+			return FileMapping{};
+		}
+		return MapFile(DSPath, MapFileSequential);
+	}
+}
+
+// Stacks the delta on top of the newest layer, only if it was made against what that stack currently is.
+bool MountPakDelta(PakFileReader& Pak, StringView DeltaPath, u32 MapFlags)
+{
+	ZoneScoped;
+
+	PakFileReader* Top = &Pak;
+	while (Top->Overlay)
+	{
+		Top = Top->Overlay;
+	}
+
+	PakFileReader Delta = OpenPakLayer(DeltaPath, MapFlags);
+	const PakItem* InfoItem = FindDeltaInfo(Delta);
+	if (InfoItem == nullptr)
+	{
+		printf("%.*s is not a pak delta\n", VIEW_PRINT(DeltaPath));
+		ClosePak(Delta);
+		return false;
+	}
+
+	PakDeltaInfo Info = GetFileDataTyped<PakDeltaInfo>(Delta, *InfoItem);
+	if (Info.BaseIdentity != GetLayerIdentity(*Top))
+	{
+		printf("%.*s was made for a different version of the pak, ignoring it\n", VIEW_PRINT(DeltaPath));
+		ClosePak(Delta);
+		return false;
+	}
+
+	Top->Overlay = new PakFileReader(Delta);
+	return true;
+}
+
+// Writes DeltaPath (and its "ds" file) with the items of NewPath that aren't identical in BasePath,
+// plus tombstones for the items NewPath doesn't have anymore. Unchanged items cost nothing.
+void WritePakDelta(StringView BasePath, StringView NewPath, StringView DeltaPath)
+{
+	ZoneScoped;
+
+	PakFileReader Base = OpenPakLayer(BasePath, MapFileSequential);
+	PakFileReader New = OpenPakLayer(NewPath, MapFileSequential);
+	CHECK(!FindDeltaInfo(Base) && !FindDeltaInfo(New), "Deltas are made between full paks");
+
+	FileMapping BaseDS = MapPakDS(BasePath);
+	FileMapping NewDS = MapPakDS(NewPath);
+
+	// delta keeps the new pak's data order, items that are read together stay together
+	TArray<const PakItem*> NewItems;
+	for (const PakItem& Item : GetItems(New))
+	{
+		NewItems.push_back(&Item);
+	}
+	eastl::sort(NewItems.begin(), NewItems.end(), [](const PakItem* A, const PakItem* B) {
+		bool DirectStorageA = A->UncompressedDataSize < 0;
+		bool DirectStorageB = B->UncompressedDataSize < 0;
+		if (DirectStorageA != DirectStorageB)
+		{
+			return DirectStorageB;
+		}
+		return A->DataOffset < B->DataOffset;
+	});
+
+	u64 Unchanged = 0, Changed = 0, Added = 0, Removed = 0, BytesWritten = 0;
+
+	PakFileWriter Delta = CreatePak(DeltaPath);
+	for (const PakItem* Item : NewItems)
+	{
+		StringView Name = GetFileName(New, *Item);
+		RawDataView Stored = GetStoredData(New.Mapping, NewDS, *Item);
+
+		const PakItem* BaseItem = FindItem(Base, Name);
+		if (BaseItem && IsSameItem(*BaseItem, GetStoredData(Base.Mapping, BaseDS, *BaseItem), *Item, Stored))
+		{
+			Unchanged++;
+			continue;
+		}
+
+		(BaseItem ? Changed : Added)++;
+		BytesWritten += Stored.size();
+		InsertStoredIntoPak(Delta, Name, *Item, Stored);
+	}
+
+	for (const PakItem& Item : GetItems(Base))
+	{
+		StringView Name = GetFileName(Base, Item);
+		if (FindItem(New, Name) == nullptr)
+		{
+			Removed++;
+			InsertTombstoneIntoPak(Delta, Name);
+		}
+	}
+
+	PakDeltaInfo Info{ HashPakLayout(Base), HashPakLayout(New) };
+	InsertIntoPak(Delta, PAK_DELTA_INFO_NAME, RawDataView((const u8*)&Info, sizeof(Info)), 0, false, PakCodecNone);
+	FinalizePak(Delta);
+
+	printf(
+		"%.*s: %llu unchanged, %llu changed, %llu added, %llu removed, %llu bytes of item data\n",
+		VIEW_PRINT(DeltaPath), Unchanged, Changed, Added, Removed, BytesWritten
+	);
+
+	UnmapFile(BaseDS);
+	UnmapFile(NewDS);
+	ClosePak(Base);
+	ClosePak(New);
+}
+
+// Copies the named items of the pak at SourcePath the way they're stored, nothing is decoded or compressed again.
+// Names the source doesn't have are skipped, returns how many were copied.
+u64 CopyPakItems(PakFileWriter& Pak, StringView SourcePath, const TArray<String>& Names)
+{
+	ZoneScoped;
+	PakFileReader Source = OpenPakLayer(SourcePath, MapFileSequential);
+	FileMapping SourceDS = MapPakDS(SourcePath);
+
+	u64 Copied = 0;
+	for (const String& Name : Names)
+	{
+		if (const PakItem* Item = FindItem(Source, StringView(Name)))
+		{
+			InsertStoredIntoPak(Pak, Name, *Item, GetStoredData(Source.Mapping, SourceDS, *Item));
+			Copied++;
+		}
+	}
+
+	UnmapFile(SourceDS);
+	ClosePak(Source);
+	return Copied;
+}
+
+// Checks layout, metadata and every item of one pak file against their checksums, a delta is verified on its own.
+// Items go to the workers biggest first so one large item doesn't end up last. Returns false if anything is corrupted.
+bool VerifyPak(StringView FilePath)
+{
+	ZoneScoped;
+	using Clock = std::chrono::high_resolution_clock;
+	auto Start = Clock::now();
+
+	FileMapping File = MapFile(FilePath, MapFileSequential);
+	if (!IsValid(File))
+	{
+		return false;
+	}
+
+	if (!IsPakLayoutValid(File))
+	{
+		printf("%.*s: not a pak, or truncated\n", VIEW_PRINT(FilePath));
+		UnmapFile(File);
+		return false;
+	}
+
+	// names are in the metadata, they are only printed when it can be trusted
+	bool MetadataValid = IsPakMetadataValid(File);
+	if (!MetadataValid)
+	{
+		printf("%.*s: metadata doesn't match its checksum\n", VIEW_PRINT(FilePath));
+	}
+
+	PakFileReader Pak{};
+	Pak.Mapping = File;
+	FileMapping FileDS = MapPakDS(FilePath);
+
+	TArrayView<PakItem> Items = GetItems(Pak);
+	TArray<u32> Order(Items.size());
+	std::iota(Order.begin(), Order.end(), 0);
+	eastl::sort(Order.begin(), Order.end(), [&Items](u32 A, u32 B) {
+		return GetStoredSize(Items[A]) > GetStoredSize(Items[B]);
+	});
+
+	std::atomic<u64> Corrupted = 0;
+	std::atomic<u64> BytesChecked = 0;
+	ParallelFor([&](u64 Begin, u64 End) {
+		for (u64 i = Begin; i < End; ++i)
+		{
+			const PakItem& Item = Items[Order[i]];
+			const FileMapping& Source = Item.UncompressedDataSize < 0 ? FileDS : File;
+			u64 Size = GetStoredSize(Item);
+
+			bool Fits = Size == 0 || (IsValid(Source) && Item.DataOffset <= Source.FileSize && Size <= Source.FileSize - Item.DataOffset);
+			if (Fits)
+			{
+				BytesChecked += Size;
+				const u8* Stored = Size ? (const u8*)Source.BasePtr + Item.DataOffset : nullptr;
+				if (Crc32C(Stored, Size, 0) == Item.Checksum)
+				{
+					continue;
+				}
+			}
+
+			Corrupted++;
+			if (MetadataValid)
+			{
+				StringView Name = GetFileName(Pak, Item);
+				printf("%.*s: '%.*s' %s\n", VIEW_PRINT(FilePath), VIEW_PRINT(Name), Fits ? "doesn't match its checksum" : "is out of the file bounds");
+			}
+			else
+			{
+				printf("%.*s: item %u %s\n", VIEW_PRINT(FilePath), Order[i], Fits ? "doesn't match its checksum" : "is out of the file bounds");
+			}
+		}
+	}, Order.size(), 1);
+
+	double Seconds = std::chrono::duration<double>(Clock::now() - Start).count();
+	printf("%.*s: %llu items, %.1f MB in %.3f s (%.2f GB/s), %llu corrupted\n",
+		VIEW_PRINT(FilePath),
+		u64(Items.size()),
+		BytesChecked / 1e6,
+		Seconds,
+		BytesChecked / Seconds / 1e9,
+		Corrupted.load()
+	);
+
+	UnmapFile(File);
+	UnmapFile(FileDS);
+	return MetadataValid && Corrupted == 0;
+}
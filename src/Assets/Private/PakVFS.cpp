@@ -0,0 +1,312 @@
+#include "Assets/PakVFS.generated.h"
+#include "Assets/Private/Pak.Declarations.h"
+#include "Containers/String.generated.h"
+#include "Containers/Private/String.Declarations.h"
+#include "Threading/Private/DedicatedThread.Declarations.h"
+#include "Util/Debug.h"
+
+#include <EASTL/algorithm.h>
+#include <EASTL/sort.h>
+#include <tracy/Tracy.hpp>
+
+struct PakVFSMount
+{
+	String            Path;
+	PakFileReader     Reader;
+	i32               Priority;
+	u32               Id;
+
+	TracyLockable(Mutex, ReadsLock);
+	TArray<TicketCPU> Reads; // async reads that may still touch the mapping
+};
+
+namespace
+{
+	u64 VFSIndexSlot(u32 Hash, u64 Mask)
+	{
+		return ((u64(Hash) * 0x9E3779B97F4A7C15ull) >> 32) & Mask;
+	}
+
+	bool IsItemOfLayer(const PakFileReader& Layer, const PakItem& Item)
+	{
+		TArrayView<PakItem> Items = GetItems(Layer);
+		return &Item >= Items.data() && &Item < Items.data() + Items.size();
+	}
+
+	bool NameEquals(StringView A, StringView B)
+	{
+		return A.size() == B.size() && strncmp(A.data(), B.data(), A.size()) == 0;
+	}
+
+	// Every name of every layer of the mount, each resolves to its newest version.
+	// Names already in the index came from a higher priority mount (or an older layer visited earlier) and stay.
+	void AddMountToIndex(TArray<PakVFSEntry>& Index, const TArray<PakVFSMount*>& Mounts, u32 MountIndex)
+	{
+		const PakFileReader& Reader = Mounts[MountIndex]->Reader;
+		u64 Mask = Index.size() - 1;
+
+		for (const PakFileReader* Layer = &Reader; Layer; Layer = Layer->Overlay)
+		{
+			TArrayView<u32> Hashes = GetItemHashes(*Layer);
+			for (u64 i = 0; i < Hashes.size(); ++i)
+			{
+				u32 Hash = Hashes[i];
+				const PakItem* Item = FindItem(Reader, Hash);
+				if (Item == nullptr)
+				{
+					continue; // removed by a delta
+				}
+
+				StringView Name = GetFileName(Reader, *Item);
+				u64 Slot = VFSIndexSlot(Hash, Mask);
+				bool Present = false;
+				while (Index[Slot].Item)
+				{
+					const PakVFSEntry& Entry = Index[Slot];
+					if (Entry.Hash == Hash && NameEquals(GetFileName(Mounts[Entry.Mount]->Reader, *Entry.Item), Name))
+					{
+						Present = true;
+						break;
+					}
+					Slot = (Slot + 1) & Mask;
+				}
+
+				if (!Present)
+				{
+					Index[Slot] = PakVFSEntry{ Item, Hash, MountIndex };
+				}
+			}
+		}
+	}
+
+	// Called with MountLock held, so nobody else changes the mounts while the new index is built.
+	// Lookups keep going on the old index until the swap.
+	void RebuildVFSIndex(PakVFS& VFS, TArray<PakVFSMount*> Mounts)
+	{
+		ZoneScoped;
+
+		eastl::stable_sort(Mounts.begin(), Mounts.end(), [](const PakVFSMount* A, const PakVFSMount* B) {
+			if (A->Priority != B->Priority)
+			{
+				return A->Priority > B->Priority;
+			}
+			return A->Id > B->Id;
+		});
+
+		u64 NumberOfItems = 0;
+		for (PakVFSMount* Mount : Mounts)
+		{
+			for (const PakFileReader* Layer = &Mount->Reader; Layer; Layer = Layer->Overlay)
+			{
+				NumberOfItems += GetItems(*Layer).size();
+			}
+		}
+
+		// at most half full
+		u64 IndexSize = 16;
+		while (IndexSize < NumberOfItems * 2)
+		{
+			IndexSize *= 2;
+		}
+
+		TArray<PakVFSEntry> Index(IndexSize, PakVFSEntry{ nullptr, 0, 0 });
+		for (u32 i = 0; i < Mounts.size(); ++i)
+		{
+			AddMountToIndex(Index, Mounts, i);
+		}
+
+		WriteLock AutoLock(VFS.IndexLock);
+		VFS.Mounts = MOVE(Mounts);
+		VFS.Index = MOVE(Index);
+	}
+
+	void WaitForMountReads(PakVFSMount* Mount)
+	{
+		ScopedLock AutoLock(Mount->ReadsLock);
+		for (TicketCPU Ticket : Mount->Reads)
+		{
+			WaitForCompletion(Ticket);
+		}
+		Mount->Reads.clear();
+	}
+
+	PakVFSMount* FindMountOfItem(PakVFS& VFS, const PakItem& Item)
+	{
+		for (PakVFSMount* Mount : VFS.Mounts)
+		{
+			for (const PakFileReader* Layer = &Mount->Reader; Layer; Layer = Layer->Overlay)
+			{
+				if (IsItemOfLayer(*Layer, Item))
+				{
+					return Mount;
+				}
+			}
+		}
+		return nullptr;
+	}
+}
+
+// Returns mount id for UnmountPak, deltas next to the pak are mounted with it.
+u32 MountPak(PakVFS& VFS, StringView FilePath, i32 Priority, u32 MapFlags)
+{
+	ZoneScoped;
+	ScopedLock AutoLock(VFS.MountLock);
+
+	PakVFSMount* Mount = new PakVFSMount();
+	Mount->Path = String(FilePath);
+	Mount->Reader = OpenPak(FilePath, MapFlags);
+	Mount->Priority = Priority;
+	Mount->Id = ++VFS.NextMountId;
+
+	TArray<PakVFSMount*> Mounts = VFS.Mounts;
+	Mounts.push_back(Mount);
+	RebuildVFSIndex(VFS, MOVE(Mounts));
+
+	return Mount->Id;
+}
+
+bool UnmountPak(PakVFS& VFS, u32 MountId)
+{
+	ZoneScoped;
+	ScopedLock AutoLock(VFS.MountLock);
+
+	TArray<PakVFSMount*> Mounts = VFS.Mounts;
+	auto It = eastl::find_if(Mounts.begin(), Mounts.end(), [MountId](const PakVFSMount* Mount) { return Mount->Id == MountId; });
+	if (It == Mounts.end())
+	{
+		return false;
+	}
+
+	PakVFSMount* Mount = *It;
+	Mounts.erase(It);
+	RebuildVFSIndex(VFS, MOVE(Mounts));
+
+	// not reachable through the index anymore, reads that already started finish first
+	WaitForMountReads(Mount);
+	ClosePak(Mount->Reader);
+	delete Mount;
+	return true;
+}
+
+void UnmountAllPaks(PakVFS& VFS)
+{
+	ZoneScoped;
+	ScopedLock AutoLock(VFS.MountLock);
+
+	TArray<PakVFSMount*> Mounts = VFS.Mounts;
+	RebuildVFSIndex(VFS, TArray<PakVFSMount*>());
+
+	for (PakVFSMount* Mount : Mounts)
+	{
+		WaitForMountReads(Mount);
+		ClosePak(Mount->Reader);
+		delete Mount;
+	}
+}
+
+const PakItem* FindItem(PakVFS& VFS, u32 FileNameHash)
+{
+	ReadLock AutoLock(VFS.IndexLock);
+	if (VFS.Index.empty())
+	{
+		return nullptr;
+	}
+
+	u64 Mask = VFS.Index.size() - 1;
+	for (u64 Slot = VFSIndexSlot(FileNameHash, Mask); VFS.Index[Slot].Item; Slot = (Slot + 1) & Mask)
+	{
+		if (VFS.Index[Slot].Hash == FileNameHash)
+		{
+			return VFS.Index[Slot].Item;
+		}
+	}
+	return nullptr;
+}
+
+// Unlike a single pak, different mounts can have different names with the same hash, all of them are checked.
+const PakItem* FindItem(PakVFS& VFS, StringView FileName)
+{
+	u32 FileNameHash = HashString32(FileName);
+
+	ReadLock AutoLock(VFS.IndexLock);
+	if (VFS.Index.empty())
+	{
+		return nullptr;
+	}
+
+	u64 Mask = VFS.Index.size() - 1;
+	for (u64 Slot = VFSIndexSlot(FileNameHash, Mask); VFS.Index[Slot].Item; Slot = (Slot + 1) & Mask)
+	{
+		const PakVFSEntry& Entry = VFS.Index[Slot];
+		if (Entry.Hash == FileNameHash && NameEquals(GetFileName(VFS.Mounts[Entry.Mount]->Reader, *Entry.Item), FileName))
+		{
+			return Entry.Item;
+		}
+	}
+	return nullptr;
+}
+
+// Pak (or delta of a pak) the item lives in, for DirectStorage requests and raw access.
+const PakFileReader& GetItemPak(PakVFS& VFS, const PakItem& Item)
+{
+	ReadLock AutoLock(VFS.IndexLock);
+	PakVFSMount* Mount = FindMountOfItem(VFS, Item);
+	CHECK(Mount, "Item isn't from a mounted pak");
+	return GetPakLayer(Mount->Reader, Item);
+}
+
+StringView GetFileName(PakVFS& VFS, const PakItem& Item)
+{
+	return GetFileName(GetItemPak(VFS, Item), Item);
+}
+
+void FillBuffer(PakVFS& VFS, const PakItem& Item, void* Address)
+{
+	FillBuffer(GetItemPak(VFS, Item), Item, Address);
+}
+
+void FillBufferRange(PakVFS& VFS, const PakItem& Item, u64 Offset, u64 Size, void* Address)
+{
+	FillBufferRange(GetItemPak(VFS, Item), Item, Offset, Size, Address);
+}
+
+String GetFileData(PakVFS& VFS, const PakItem& Item)
+{
+	return GetFileData(GetItemPak(VFS, Item), Item);
+}
+
+// Requests can come from any mounts, they all share one ticket.
+TicketCPU EnqueuePakReads(PakVFS& VFS, const PakReadRequest* Requests, u64 Count)
+{
+	ZoneScoped;
+	ReadLock AutoLock(VFS.IndexLock);
+
+	TArray<const PakFileReader*> Layers(Count);
+	TArray<PakVFSMount*> Touched;
+	for (u64 i = 0; i < Count; ++i)
+	{
+		PakVFSMount* Mount = FindMountOfItem(VFS, *Requests[i].Item);
+		CHECK(Mount, "Item isn't from a mounted pak");
+		Layers[i] = &GetPakLayer(Mount->Reader, *Requests[i].Item);
+		if (eastl::find(Touched.begin(), Touched.end(), Mount) == Touched.end())
+		{
+			Touched.push_back(Mount);
+		}
+	}
+
+	TicketCPU Result = EnqueueLayeredPakReads(Layers.data(), Requests, Count);
+
+	for (PakVFSMount* Mount : Touched)
+	{
+		ScopedLock ReadsAutoLock(Mount->ReadsLock);
+		Mount->Reads.erase(eastl::remove_if(Mount->Reads.begin(), Mount->Reads.end(), [](TicketCPU Ticket) { return WorkIsDone(Ticket); }), Mount->Reads.end());
+		Mount->Reads.push_back(Result);
+	}
+	return Result;
+}
+
+TicketCPU EnqueuePakRead(PakVFS& VFS, const PakItem& Item, void* Dest)
+{
+	PakReadRequest Request{ &Item, Dest };
+	return EnqueuePakReads(VFS, &Request, 1);
+}
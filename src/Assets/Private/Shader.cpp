@@ -4,9 +4,10 @@
 #include <dxcapi.h>
 #include <d3d12shader.h>
 
-static TComPtr<IDxcUtils>    gDxcUtils;
-static TComPtr<IDxcCompiler3> gDxcCompiler;
-static TComPtr<IDxcIncludeHandler> gIncludeHandler;
+// DXC objects aren't meant to be shared between threads, every thread that compiles gets its own
+static thread_local TComPtr<IDxcUtils>    gDxcUtils;
+static thread_local TComPtr<IDxcCompiler3> gDxcCompiler;
+static thread_local TComPtr<IDxcIncludeHandler> gIncludeHandler;
 
 namespace
 {
@@ -21,6 +22,10 @@ namespace
 
 void InitShaderCompiler()
 {
+	if (gDxcCompiler)
+	{
+		return;
+	}
 	DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(gDxcUtils.GetAddressOf()));
 	DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(gDxcCompiler.GetAddressOf()));
 	gDxcUtils->CreateDefaultIncludeHandler(gIncludeHandler.GetAddressOf());
@@ -67,6 +72,8 @@ ShaderType GetShaderTypeFromEntryPoint(StringView EntryPoint)
 
 TComPtr<IDxcBlob> CompileShader(StringView FileName, StringView EntryPoint, ID3D12ShaderReflection** Reflection)
 {
+	InitShaderCompiler();
+
 	ShaderType Type = GetShaderTypeFromEntryPoint(EntryPoint);
 	StringView TargetType = GetTargetVersionFromType(Type);
 
@@ -1,4 +1,5 @@
 #include "Assets/TextureDescription.generated.h"
+#include "Containers/Private/String.Declarations.h"
 
 u8 GetTextureFormat(TextureDescription Desc)
 {
@@ -9,6 +10,7 @@ u8 GetTextureFormat(TextureDescription Desc)
 	case 2: return DXGI_FORMAT_BC3_UNORM;
 	case 3: return DXGI_FORMAT_BC4_UNORM;
 	case 4: return DXGI_FORMAT_BC5_UNORM;
+	case 5: return DXGI_FORMAT_BC7_UNORM;
 	}
 	return 0;
 }
@@ -21,4 +23,14 @@ u16 GetTextureSize(TextureDescription Desc)
 u16 GetMipCount(TextureDescription Desc)
 {
 	return (Desc.Value >> 8) & 0xf;
-}
\ No newline at end of file
+}
+// Item with the description and every mip too small to stream on its own
+String GetTextureItemName(u64 ContentHash)
+{
+	return StringFromFormat("___Texture_%016llx", ContentHash);
+}
+
+String GetTextureMipItemName(u64 ContentHash, u32 Mip)
+{
+	return StringFromFormat("___Texture_%016llx_%u", ContentHash, Mip);
+}
@@ -0,0 +1,1412 @@
+#include "Assets/TextureEncoder.generated.h"
+#include "Assets/Private/TextureMips.Declarations.h"
+#include "Containers/String.h"
+#include "Threading/Worker.generated.h"
+#include "Threading/Private/Worker.Declarations.h"
+#include "Threading/Private/DedicatedThread.Declarations.h"
+#include "Util/Debug.h"
+#include "Util/Math.h"
+#include "Util/Private/Math.Declarations.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include <immintrin.h>
+#include <tracy/Tracy.hpp>
+
+namespace
+{
+	const u32 TextureTileBlocks = 8; // ParallelFor hands out tiles of 8x8 blocks
+	const u32 TextureAllPixels  = 0xffff;
+
+	// BC7 two subset partitions, bit i is set when pixel i belongs to the second subset
+	const u16 BC7Partitions2[64] = {
+		0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+		0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+		0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+		0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+		0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+		0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+		0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+		0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+	};
+
+	// Pixel of the second subset whose index has its top bit left out, pixel 0 is the first subset's
+	const u8 BC7Anchors2[64] = {
+		15, 15, 15, 15, 15, 15, 15, 15,
+		15, 15, 15, 15, 15, 15, 15, 15,
+		15,  2,  8,  2,  2,  8,  8, 15,
+		 2,  8,  2,  2,  8,  8,  2,  2,
+		15, 15,  6,  8,  2,  8, 15, 15,
+		 2,  8,  2,  2,  2, 15, 15,  6,
+		 6,  2,  6,  8, 15, 15,  2,  2,
+		15, 15, 15, 15, 15,  2,  2, 15,
+	};
+
+	const u8 BC7Weights3[8]  = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const u8 BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// How far along from the first endpoint to the second every index is
+	const float BC1Weights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+	const float BC4Weights[8] = { 0.f, 1.f, 1.f / 7.f, 2.f / 7.f, 3.f / 7.f, 4.f / 7.f, 5.f / 7.f, 6.f / 7.f };
+
+	// 16 pixels channel by channel, eight of them fill an AVX register
+	struct alignas(32) TexelBlock
+	{
+		float Channels[4][16];
+	};
+
+	struct BlockBitWriter
+	{
+		u64 Bits[2] = {};
+		u32 Position = 0;
+
+		void Write(u64 Value, u32 Count)
+		{
+			u32 Shift = Position & 63;
+			Bits[Position >> 6] |= Value << Shift;
+			if (Shift + Count > 64)
+			{
+				Bits[1] |= Value >> (64 - Shift);
+			}
+			Position += Count;
+		}
+	};
+
+	struct BlockBitReader
+	{
+		u64 Bits[2];
+		u32 Position = 0;
+
+		u32 Read(u32 Count)
+		{
+			u32 Shift = Position & 63;
+			u64 Value = Bits[Position >> 6] >> Shift;
+			if (Shift + Count > 64)
+			{
+				Value |= Bits[1] << (64 - Shift);
+			}
+			Position += Count;
+			return u32(Value & ((1ull << Count) - 1));
+		}
+	};
+
+	u32 GetEncodedChannelCount(u8 Format)
+	{
+		switch (Format)
+		{
+		case TextureEncodeBC1: return 3;
+		case TextureEncodeBC4: return 1;
+		case TextureEncodeBC5: return 2;
+		}
+		return 4;
+	}
+
+	const char* GetTextureEncodeFormatName(u8 Format)
+	{
+		switch (Format)
+		{
+		case TextureEncodeBC1: return "BC1";
+		case TextureEncodeBC3: return "BC3";
+		case TextureEncodeBC4: return "BC4";
+		case TextureEncodeBC5: return "BC5";
+		case TextureEncodeBC7: return "BC7";
+		}
+		return "unknown";
+	}
+
+	const char* GetTextureEncodeQualityName(u8 Quality)
+	{
+		const char* Names[TextureQualityCount] = { "fast", "normal", "best" };
+		return Names[Quality];
+	}
+
+	// Blocks past the edges of the image repeat its last row and column
+	void LoadTexelBlock(TexelBlock& Block, const u8* RGBA, u32 Width, u32 Height, u32 X, u32 Y)
+	{
+		for (u32 i = 0; i < 16; ++i)
+		{
+			u32 PixelX = Clamp(X + (i & 3), 0u, Width - 1);
+			u32 PixelY = Clamp(Y + (i >> 2), 0u, Height - 1);
+			const u8* Pixel = RGBA + (u64(PixelY) * Width + PixelX) * 4;
+			for (u32 c = 0; c < 4; ++c)
+			{
+				Block.Channels[c][i] = Pixel[c];
+			}
+		}
+	}
+
+	bool IsBlockOpaque(const TexelBlock& Block)
+	{
+		for (u32 i = 0; i < 16; ++i)
+		{
+			if (Block.Channels[3][i] != 255.f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Eight pixels per iteration, only called when CpuSupportsAVX2()
+	TARGET_AVX2 float FindClosestIndicesAVX2(const TexelBlock& Block, const float (*Palette)[4], u32 PaletteSize, u32 First, u32 Channels, u32 Mask, u8* Indices)
+	{
+		const __m256i PixelBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+
+		__m256 Total = _mm256_setzero_ps();
+		alignas(32) i32 Closest[16];
+		for (u32 Half = 0; Half < 2; ++Half)
+		{
+			__m256 Pixels[4];
+			for (u32 c = 0; c < Channels; ++c)
+			{
+				Pixels[c] = _mm256_load_ps(&Block.Channels[First + c][Half * 8]);
+			}
+
+			__m256 BestError = _mm256_set1_ps(FLT_MAX);
+			__m256 BestIndex = _mm256_setzero_ps();
+			for (u32 Entry = 0; Entry < PaletteSize; ++Entry)
+			{
+				__m256 Error = _mm256_setzero_ps();
+				for (u32 c = 0; c < Channels; ++c)
+				{
+					__m256 Delta = _mm256_sub_ps(Pixels[c], _mm256_set1_ps(Palette[Entry][c]));
+					Error = _mm256_add_ps(Error, _mm256_mul_ps(Delta, Delta));
+				}
+				__m256 Closer = _mm256_cmp_ps(Error, BestError, _CMP_LT_OQ);
+				BestError = _mm256_min_ps(Error, BestError);
+				BestIndex = _mm256_blendv_ps(BestIndex, _mm256_set1_ps(float(Entry)), Closer);
+			}
+
+			__m256i HalfMask = _mm256_and_si256(_mm256_set1_epi32(Mask >> (Half * 8)), PixelBits);
+			__m256 Selected = _mm256_castsi256_ps(_mm256_cmpeq_epi32(HalfMask, PixelBits));
+			Total = _mm256_add_ps(Total, _mm256_and_ps(BestError, Selected));
+			_mm256_store_si256((__m256i*)&Closest[Half * 8], _mm256_cvtps_epi32(BestIndex));
+		}
+
+		for (u32 i = 0; i < 16; ++i)
+		{
+			if (Mask & (1u << i))
+			{
+				Indices[i] = u8(Closest[i]);
+			}
+		}
+
+		__m128 Sum = _mm_add_ps(_mm256_castps256_ps128(Total), _mm256_extractf128_ps(Total, 1));
+		Sum = _mm_add_ps(Sum, _mm_movehl_ps(Sum, Sum));
+		Sum = _mm_add_ss(Sum, _mm_shuffle_ps(Sum, Sum, 1));
+		return _mm_cvtss_f32(Sum);
+	}
+
+	// Same search four pixels at a time, for CPUs without AVX2
+	float FindClosestIndicesSSE2(const TexelBlock& Block, const float (*Palette)[4], u32 PaletteSize, u32 First, u32 Channels, u32 Mask, u8* Indices)
+	{
+		const __m128i PixelBits = _mm_setr_epi32(1, 2, 4, 8);
+
+		__m128 Total = _mm_setzero_ps();
+		alignas(16) i32 Closest[16];
+		for (u32 Quarter = 0; Quarter < 4; ++Quarter)
+		{
+			__m128 Pixels[4];
+			for (u32 c = 0; c < Channels; ++c)
+			{
+				Pixels[c] = _mm_load_ps(&Block.Channels[First + c][Quarter * 4]);
+			}
+
+			__m128 BestError = _mm_set1_ps(FLT_MAX);
+			__m128 BestIndex = _mm_setzero_ps();
+			for (u32 Entry = 0; Entry < PaletteSize; ++Entry)
+			{
+				__m128 Error = _mm_setzero_ps();
+				for (u32 c = 0; c < Channels; ++c)
+				{
+					__m128 Delta = _mm_sub_ps(Pixels[c], _mm_set1_ps(Palette[Entry][c]));
+					Error = _mm_add_ps(Error, _mm_mul_ps(Delta, Delta));
+				}
+				__m128 Closer = _mm_cmplt_ps(Error, BestError);
+				BestError = _mm_min_ps(Error, BestError);
+				BestIndex = _mm_or_ps(_mm_and_ps(Closer, _mm_set1_ps(float(Entry))), _mm_andnot_ps(Closer, BestIndex));
+			}
+
+			__m128i QuarterMask = _mm_and_si128(_mm_set1_epi32(Mask >> (Quarter * 4)), PixelBits);
+			__m128 Selected = _mm_castsi128_ps(_mm_cmpeq_epi32(QuarterMask, PixelBits));
+			Total = _mm_add_ps(Total, _mm_and_ps(BestError, Selected));
+			_mm_store_si128((__m128i*)&Closest[Quarter * 4], _mm_cvtps_epi32(BestIndex));
+		}
+
+		for (u32 i = 0; i < 16; ++i)
+		{
+			if (Mask & (1u << i))
+			{
+				Indices[i] = u8(Closest[i]);
+			}
+		}
+
+		__m128 Sum = _mm_add_ps(Total, _mm_movehl_ps(Total, Total));
+		Sum = _mm_add_ss(Sum, _mm_shuffle_ps(Sum, Sum, 1));
+		return _mm_cvtss_f32(Sum);
+	}
+
+	// Closest palette entry for every pixel in Mask, returns the squared error summed over those pixels.
+	// Palettes hold Channels values per entry, compared against the block's channels starting at First.
+	float FindClosestIndices(const TexelBlock& Block, const float (*Palette)[4], u32 PaletteSize, u32 First, u32 Channels, u32 Mask, u8* Indices)
+	{
+		if (CpuSupportsAVX2())
+		{
+			return FindClosestIndicesAVX2(Block, Palette, PaletteSize, First, Channels, Mask, Indices);
+		}
+		return FindClosestIndicesSSE2(Block, Palette, PaletteSize, First, Channels, Mask, Indices);
+	}
+
+	// Endpoints at the extremes of the pixels projected on their principal axis.
+	// The fast preset takes the bounding box diagonal instead, flipped on channels that go against the dominant one.
+	void FitEndpoints(const TexelBlock& Block, u32 First, u32 Channels, u32 Mask, u8 Quality, float* E0, float* E1)
+	{
+		float Mean[4] = {};
+		float Min[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+		float Max[4] = { 0.f, 0.f, 0.f, 0.f };
+		u32 Count = 0;
+		for (u32 i = 0; i < 16; ++i)
+		{
+			if (Mask & (1u << i))
+			{
+				for (u32 c = 0; c < Channels; ++c)
+				{
+					float Value = Block.Channels[First + c][i];
+					Mean[c] += Value;
+					Min[c] = Value < Min[c] ? Value : Min[c];
+					Max[c] = Value > Max[c] ? Value : Max[c];
+				}
+				Count++;
+			}
+		}
+		CHECK(Count != 0);
+
+		float Covariance[4][4] = {};
+		for (u32 c = 0; c < Channels; ++c)
+		{
+			Mean[c] /= float(Count);
+		}
+		for (u32 i = 0; i < 16; ++i)
+		{
+			if (Mask & (1u << i))
+			{
+				for (u32 a = 0; a < Channels; ++a)
+				for (u32 b = 0; b < Channels; ++b)
+				{
+					Covariance[a][b] += (Block.Channels[First + a][i] - Mean[a]) * (Block.Channels[First + b][i] - Mean[b]);
+				}
+			}
+		}
+
+		u32 Dominant = 0;
+		for (u32 c = 1; c < Channels; ++c)
+		{
+			Dominant = Covariance[c][c] > Covariance[Dominant][Dominant] ? c : Dominant;
+		}
+
+		float Axis[4];
+		for (u32 c = 0; c < Channels; ++c)
+		{
+			E0[c] = Min[c];
+			E1[c] = Max[c];
+			if (Covariance[Dominant][c] < 0.f)
+			{
+				E0[c] = Max[c];
+				E1[c] = Min[c];
+			}
+			Axis[c] = E1[c] - E0[c];
+		}
+
+		if (Quality == TextureQualityFast || Channels == 1)
+		{
+			return;
+		}
+
+		u32 Iterations = Quality == TextureQualityBest ? 8 : 4;
+		for (u32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			float Next[4] = {};
+			float Largest = 0.f;
+			for (u32 a = 0; a < Channels; ++a)
+			{
+				for (u32 b = 0; b < Channels; ++b)
+				{
+					Next[a] += Covariance[a][b] * Axis[b];
+				}
+				Largest = fabsf(Next[a]) > Largest ? fabsf(Next[a]) : Largest;
+			}
+			if (Largest == 0.f)
+			{
+				break;
+			}
+			for (u32 c = 0; c < Channels; ++c)
+			{
+				Axis[c] = Next[c] / Largest;
+			}
+		}
+
+		float LengthSquared = 0.f;
+		for (u32 c = 0; c < Channels; ++c)
+		{
+			LengthSquared += Axis[c] * Axis[c];
+		}
+		if (LengthSquared == 0.f)
+		{
+			return;
+		}
+
+		float MinT = FLT_MAX;
+		float MaxT = -FLT_MAX;
+		for (u32 i = 0; i < 16; ++i)
+		{
+			if (Mask & (1u << i))
+			{
+				float T = 0.f;
+				for (u32 c = 0; c < Channels; ++c)
+				{
+					T += (Block.Channels[First + c][i] - Mean[c]) * Axis[c];
+				}
+				MinT = T < MinT ? T : MinT;
+				MaxT = T > MaxT ? T : MaxT;
+			}
+		}
+
+		for (u32 c = 0; c < Channels; ++c)
+		{
+			E0[c] = Clamp(Mean[c] + Axis[c] * MinT / LengthSquared, 0.f, 255.f);
+			E1[c] = Clamp(Mean[c] + Axis[c] * MaxT / LengthSquared, 0.f, 255.f);
+		}
+	}
+
+	// Least squares endpoints for the indices that were picked, false when all pixels landed on one weight
+	bool RefineEndpoints(const TexelBlock& Block, u32 First, u32 Channels, u32 Mask, const u8* Indices, const float* Weights, float* E0, float* E1)
+	{
+		float AA = 0.f, AB = 0.f, BB = 0.f;
+		float AX[4] = {}, BX[4] = {};
+		for (u32 i = 0; i < 16; ++i)
+		{
+			if (Mask & (1u << i))
+			{
+				float B = Weights[Indices[i]];
+				float A = 1.f - B;
+				AA += A * A;
+				AB += A * B;
+				BB += B * B;
+				for (u32 c = 0; c < Channels; ++c)
+				{
+					AX[c] += A * Block.Channels[First + c][i];
+					BX[c] += B * Block.Channels[First + c][i];
+				}
+			}
+		}
+
+		float Determinant = AA * BB - AB * AB;
+		if (fabsf(Determinant) < 1e-4f)
+		{
+			return false;
+		}
+
+		float InverseDeterminant = 1.f / Determinant;
+		for (u32 c = 0; c < Channels; ++c)
+		{
+			E0[c] = Clamp((AX[c] * BB - BX[c] * AB) * InverseDeterminant, 0.f, 255.f);
+			E1[c] = Clamp((BX[c] * AA - AX[c] * AB) * InverseDeterminant, 0.f, 255.f);
+		}
+		return true;
+	}
+
+	// BC1
+
+	u16 PackColor565(const float* Color)
+	{
+		u32 R = (u32)Clamp(lroundf(Color[0] * 31.f / 255.f), 0l, 31l);
+		u32 G = (u32)Clamp(lroundf(Color[1] * 63.f / 255.f), 0l, 63l);
+		u32 B = (u32)Clamp(lroundf(Color[2] * 31.f / 255.f), 0l, 31l);
+		return u16((R << 11) | (G << 5) | B);
+	}
+
+	void UnpackColor565(u16 Color, u8* Out)
+	{
+		u32 R = (Color >> 11) & 31;
+		u32 G = (Color >> 5) & 63;
+		u32 B = Color & 31;
+		Out[0] = u8((R << 3) | (R >> 2));
+		Out[1] = u8((G << 2) | (G >> 4));
+		Out[2] = u8((B << 3) | (B >> 2));
+	}
+
+	float EvaluateBC1(const TexelBlock& Block, u16 Color0, u16 Color1, u8* Indices)
+	{
+		u8 Endpoints[2][3];
+		UnpackColor565(Color0, Endpoints[0]);
+		UnpackColor565(Color1, Endpoints[1]);
+
+		float Palette[4][4];
+		for (u32 c = 0; c < 3; ++c)
+		{
+			Palette[0][c] = Endpoints[0][c];
+			Palette[1][c] = Endpoints[1][c];
+			Palette[2][c] = (2.f * Endpoints[0][c] + Endpoints[1][c]) / 3.f;
+			Palette[3][c] = (Endpoints[0][c] + 2.f * Endpoints[1][c]) / 3.f;
+		}
+		return FindClosestIndices(Block, Palette, 4, 0, 3, TextureAllPixels, Indices);
+	}
+
+	// Steps every 565 component of both endpoints by one while that keeps lowering the error
+	float SearchBC1Neighbourhood(const TexelBlock& Block, u16* Colors, u8* Indices, float Error)
+	{
+		const u16 Steps[3]  = { 1 << 11, 1 << 5, 1 };
+		const u16 Fields[3] = { 31 << 11, 63 << 5, 31 };
+		for (u32 Pass = 0; Pass < 8 && Error > 0.f; ++Pass)
+		{
+			bool Improved = false;
+			for (u32 Endpoint = 0; Endpoint < 2; ++Endpoint)
+			for (u32 c = 0; c < 3; ++c)
+			for (u32 Up = 0; Up < 2; ++Up)
+			{
+				u16 Field = Colors[Endpoint] & Fields[c];
+				if (Up ? Field == Fields[c] : Field == 0)
+				{
+					continue;
+				}
+
+				u16 Candidate[2] = { Colors[0], Colors[1] };
+				Candidate[Endpoint] = u16(Up ? Candidate[Endpoint] + Steps[c] : Candidate[Endpoint] - Steps[c]);
+
+				u8 CandidateIndices[16];
+				float CandidateError = EvaluateBC1(Block, Candidate[0], Candidate[1], CandidateIndices);
+				if (CandidateError < Error)
+				{
+					Error = CandidateError;
+					Colors[0] = Candidate[0];
+					Colors[1] = Candidate[1];
+					memcpy(Indices, CandidateIndices, 16);
+					Improved = true;
+				}
+			}
+			if (!Improved)
+			{
+				break;
+			}
+		}
+		return Error;
+	}
+
+	// Always 4 color mode, the color half of BC3 has no other
+	void EncodeBC1Block(u8* Out, const TexelBlock& Block, u8 Quality)
+	{
+		float E0[4], E1[4];
+		FitEndpoints(Block, 0, 3, TextureAllPixels, Quality, E0, E1);
+
+		u16 Colors[2] = { PackColor565(E0), PackColor565(E1) };
+		u8 Indices[16];
+		float Error = EvaluateBC1(Block, Colors[0], Colors[1], Indices);
+
+		// the principal axis loses to the box diagonal on blocks with several clusters of colors
+		if (Quality != TextureQualityFast && Error > 0.f)
+		{
+			float Box0[4], Box1[4];
+			FitEndpoints(Block, 0, 3, TextureAllPixels, TextureQualityFast, Box0, Box1);
+
+			u16 BoxColors[2] = { PackColor565(Box0), PackColor565(Box1) };
+			u8 BoxIndices[16];
+			float BoxError = EvaluateBC1(Block, BoxColors[0], BoxColors[1], BoxIndices);
+			if (BoxError < Error)
+			{
+				Error = BoxError;
+				Colors[0] = BoxColors[0];
+				Colors[1] = BoxColors[1];
+				memcpy(E0, Box0, sizeof(E0));
+				memcpy(E1, Box1, sizeof(E1));
+				memcpy(Indices, BoxIndices, 16);
+			}
+		}
+
+		u32 Iterations = Quality == TextureQualityFast ? 0 : Quality == TextureQualityNormal ? 1 : 3;
+		for (u32 Iteration = 0; Iteration < Iterations && Error > 0.f; ++Iteration)
+		{
+			if (!RefineEndpoints(Block, 0, 3, TextureAllPixels, Indices, BC1Weights, E0, E1))
+			{
+				break;
+			}
+
+			u16 Refined[2] = { PackColor565(E0), PackColor565(E1) };
+			u8 RefinedIndices[16];
+			float RefinedError = EvaluateBC1(Block, Refined[0], Refined[1], RefinedIndices);
+			if (RefinedError >= Error)
+			{
+				break;
+			}
+			Error = RefinedError;
+			Colors[0] = Refined[0];
+			Colors[1] = Refined[1];
+			memcpy(Indices, RefinedIndices, 16);
+		}
+
+		if (Quality == TextureQualityBest)
+		{
+			SearchBC1Neighbourhood(Block, Colors, Indices, Error);
+		}
+
+		// 4 color mode is Color0 > Color1, equal colors decode the same from index 0 in either mode
+		if (Colors[0] < Colors[1])
+		{
+			eastl::swap(Colors[0], Colors[1]);
+			for (u32 i = 0; i < 16; ++i)
+			{
+				Indices[i] ^= 1;
+			}
+		}
+		else if (Colors[0] == Colors[1])
+		{
+			memset(Indices, 0, 16);
+		}
+
+		u32 IndexBits = 0;
+		for (u32 i = 0; i < 16; ++i)
+		{
+			IndexBits |= u32(Indices[i]) << (i * 2);
+		}
+		memcpy(Out, Colors, 4);
+		memcpy(Out + 4, &IndexBits, 4);
+	}
+
+	void DecodeBC1Block(const u8* In, u8 (*Pixels)[4], bool AlwaysFourColors)
+	{
+		u16 Colors[2];
+		u32 IndexBits;
+		memcpy(Colors, In, 4);
+		memcpy(&IndexBits, In + 4, 4);
+
+		u8 Palette[4][4];
+		UnpackColor565(Colors[0], Palette[0]);
+		UnpackColor565(Colors[1], Palette[1]);
+		for (u32 c = 0; c < 3; ++c)
+		{
+			if (AlwaysFourColors || Colors[0] > Colors[1])
+			{
+				Palette[2][c] = u8((2 * Palette[0][c] + Palette[1][c] + 1) / 3);
+				Palette[3][c] = u8((Palette[0][c] + 2 * Palette[1][c] + 1) / 3);
+			}
+			else
+			{
+				Palette[2][c] = u8((Palette[0][c] + Palette[1][c] + 1) / 2);
+				Palette[3][c] = 0;
+			}
+		}
+		Palette[0][3] = Palette[1][3] = Palette[2][3] = 255;
+		Palette[3][3] = AlwaysFourColors || Colors[0] > Colors[1] ? 255 : 0;
+
+		for (u32 i = 0; i < 16; ++i)
+		{
+			memcpy(Pixels[i], Palette[(IndexBits >> (i * 2)) & 3], 4);
+		}
+	}
+
+	// BC4
+
+	// Red0 > Red1 interpolates 6 values in between, otherwise 4 plus 0 and 255
+	float EvaluateBC4(const TexelBlock& Block, u32 Channel, u32 Red0, u32 Red1, u8* Indices)
+	{
+		float Palette[8][4];
+		Palette[0][0] = float(Red0);
+		Palette[1][0] = float(Red1);
+		if (Red0 > Red1)
+		{
+			for (u32 i = 1; i < 7; ++i)
+			{
+				Palette[i + 1][0] = float((7 - i) * Red0 + i * Red1) / 7.f;
+			}
+		}
+		else
+		{
+			for (u32 i = 1; i < 5; ++i)
+			{
+				Palette[i + 1][0] = float((5 - i) * Red0 + i * Red1) / 5.f;
+			}
+			Palette[6][0] = 0.f;
+			Palette[7][0] = 255.f;
+		}
+		return FindClosestIndices(Block, Palette, 8, Channel, 1, TextureAllPixels, Indices);
+	}
+
+	void EncodeBC4Block(u8* Out, const TexelBlock& Block, u32 Channel, u8 Quality)
+	{
+		const float* Values = Block.Channels[Channel];
+
+		float Min = 255.f, Max = 0.f;
+		float InnerMin = 255.f, InnerMax = 0.f;
+		bool HasExtremes = false;
+		for (u32 i = 0; i < 16; ++i)
+		{
+			Min = Values[i] < Min ? Values[i] : Min;
+			Max = Values[i] > Max ? Values[i] : Max;
+			if (Values[i] == 0.f || Values[i] == 255.f)
+			{
+				HasExtremes = true;
+				continue;
+			}
+			InnerMin = Values[i] < InnerMin ? Values[i] : InnerMin;
+			InnerMax = Values[i] > InnerMax ? Values[i] : InnerMax;
+		}
+
+		u32 Reds[2] = { u32(Max), u32(Min) };
+		u8 Indices[16];
+		float Error = EvaluateBC4(Block, Channel, Reds[0], Reds[1], Indices);
+
+		if (Quality != TextureQualityFast && Error > 0.f)
+		{
+			float E0 = float(Reds[0]), E1 = float(Reds[1]);
+			u32 Iterations = Quality == TextureQualityNormal ? 1 : 3;
+			for (u32 Iteration = 0; Iteration < Iterations && Reds[0] > Reds[1]; ++Iteration)
+			{
+				if (!RefineEndpoints(Block, Channel, 1, TextureAllPixels, Indices, BC4Weights, &E0, &E1))
+				{
+					break;
+				}
+
+				u32 Refined[2] = { (u32)lroundf(E0), (u32)lroundf(E1) };
+				if (Refined[0] <= Refined[1])
+				{
+					break;
+				}
+				u8 RefinedIndices[16];
+				float RefinedError = EvaluateBC4(Block, Channel, Refined[0], Refined[1], RefinedIndices);
+				if (RefinedError >= Error)
+				{
+					break;
+				}
+				Error = RefinedError;
+				Reds[0] = Refined[0];
+				Reds[1] = Refined[1];
+				memcpy(Indices, RefinedIndices, 16);
+			}
+
+			// blocks with fully black or white pixels can spend the whole range on the rest
+			if (HasExtremes && InnerMin <= InnerMax)
+			{
+				u8 SixValueIndices[16];
+				float SixValueError = EvaluateBC4(Block, Channel, u32(InnerMin), u32(InnerMax), SixValueIndices);
+				if (SixValueError < Error)
+				{
+					Error = SixValueError;
+					Reds[0] = u32(InnerMin);
+					Reds[1] = u32(InnerMax);
+					memcpy(Indices, SixValueIndices, 16);
+				}
+			}
+		}
+
+		if (Quality == TextureQualityBest)
+		{
+			for (u32 Pass = 0; Pass < 8 && Error > 0.f; ++Pass)
+			{
+				bool Improved = false;
+				for (u32 Endpoint = 0; Endpoint < 2; ++Endpoint)
+				for (u32 Up = 0; Up < 2; ++Up)
+				{
+					if (Up ? Reds[Endpoint] == 255 : Reds[Endpoint] == 0)
+					{
+						continue;
+					}
+					u32 Candidate[2] = { Reds[0], Reds[1] };
+					Candidate[Endpoint] = Up ? Candidate[Endpoint] + 1 : Candidate[Endpoint] - 1;
+
+					u8 CandidateIndices[16];
+					float CandidateError = EvaluateBC4(Block, Channel, Candidate[0], Candidate[1], CandidateIndices);
+					if (CandidateError < Error)
+					{
+						Error = CandidateError;
+						Reds[0] = Candidate[0];
+						Reds[1] = Candidate[1];
+						memcpy(Indices, CandidateIndices, 16);
+						Improved = true;
+					}
+				}
+				if (!Improved)
+				{
+					break;
+				}
+			}
+		}
+
+		u64 IndexBits = 0;
+		for (u32 i = 0; i < 16; ++i)
+		{
+			IndexBits |= u64(Indices[i]) << (i * 3);
+		}
+		Out[0] = u8(Reds[0]);
+		Out[1] = u8(Reds[1]);
+		memcpy(Out + 2, &IndexBits, 6);
+	}
+
+	void DecodeBC4Block(const u8* In, u8 (*Pixels)[4], u32 Channel)
+	{
+		u32 Red0 = In[0], Red1 = In[1];
+		u64 IndexBits = 0;
+		memcpy(&IndexBits, In + 2, 6);
+
+		u8 Palette[8] = { u8(Red0), u8(Red1) };
+		if (Red0 > Red1)
+		{
+			for (u32 i = 1; i < 7; ++i)
+			{
+				Palette[i + 1] = u8(((7 - i) * Red0 + i * Red1 + 3) / 7);
+			}
+		}
+		else
+		{
+			for (u32 i = 1; i < 5; ++i)
+			{
+				Palette[i + 1] = u8(((5 - i) * Red0 + i * Red1 + 2) / 5);
+			}
+			Palette[6] = 0;
+			Palette[7] = 255;
+		}
+
+		for (u32 i = 0; i < 16; ++i)
+		{
+			Pixels[i][Channel] = Palette[(IndexBits >> (i * 3)) & 7];
+		}
+	}
+
+	// BC7
+
+	// Components are stored with Bits bits plus a p-bit, the hardware expands them to 8 bits by repeating the top ones
+	u8 ExpandBC7Component(u32 Quantized, u32 PBit, u32 Bits)
+	{
+		u32 Value = (Quantized << 1) | PBit;
+		Bits += 1;
+		return u8((Value << (8 - Bits)) | (Value >> (2 * Bits - 8)));
+	}
+
+	void QuantizeBC7Endpoint(const float* Endpoint, u32 Channels, u32 PBit, u32 Bits, u8* Quantized)
+	{
+		float Scale = float((1 << (Bits + 1)) - 1) / 255.f;
+		for (u32 c = 0; c < Channels; ++c)
+		{
+			Quantized[c] = (u8)Clamp(lroundf((Endpoint[c] * Scale - float(PBit)) * 0.5f), 0l, long((1 << Bits) - 1));
+		}
+	}
+
+	float EvaluateBC7Subset(const TexelBlock& Block, const u8 (*Quantized)[4], const u8* PBits, u32 Channels, u32 Bits, u32 Mask, u8* Indices)
+	{
+		u8 Endpoints[2][4];
+		for (u32 e = 0; e < 2; ++e)
+		for (u32 c = 0; c < Channels; ++c)
+		{
+			Endpoints[e][c] = ExpandBC7Component(Quantized[e][c], PBits[e], Bits);
+		}
+
+		u32 PaletteSize = Channels == 4 ? 16 : 8;
+		const u8* Weights = PaletteSize == 16 ? BC7Weights4 : BC7Weights3;
+		float Palette[16][4];
+		for (u32 i = 0; i < PaletteSize; ++i)
+		for (u32 c = 0; c < Channels; ++c)
+		{
+			Palette[i][c] = float(((64 - Weights[i]) * Endpoints[0][c] + Weights[i] * Endpoints[1][c] + 32) >> 6);
+		}
+		return FindClosestIndices(Block, Palette, PaletteSize, 0, Channels, Mask, Indices);
+	}
+
+	// Mode 6 has a p-bit per endpoint, mode 1 one per subset. The fast preset picks p-bits per endpoint by how close
+	// they get it, otherwise every combination goes through the palette.
+	float QuantizeBC7Subset(const TexelBlock& Block, const float* E0, const float* E1, u32 Channels, u32 Bits, bool SharedPBit, u32 Mask, u8 Quality, u8 (*Quantized)[4], u8* PBits, u8* Indices)
+	{
+		u32 FastCombination = 0;
+		if (Quality == TextureQualityFast)
+		{
+			const float* Endpoints[2] = { E0, E1 };
+			float Errors[2][2] = {};
+			for (u32 e = 0; e < 2; ++e)
+			for (u32 PBit = 0; PBit < 2; ++PBit)
+			{
+				u8 Candidate[4];
+				QuantizeBC7Endpoint(Endpoints[e], Channels, PBit, Bits, Candidate);
+				for (u32 c = 0; c < Channels; ++c)
+				{
+					float Delta = float(ExpandBC7Component(Candidate[c], PBit, Bits)) - Endpoints[e][c];
+					Errors[e][PBit] += Delta * Delta;
+				}
+			}
+			if (SharedPBit)
+			{
+				FastCombination = Errors[0][1] + Errors[1][1] < Errors[0][0] + Errors[1][0] ? 3 : 0;
+			}
+			else
+			{
+				FastCombination = (Errors[0][1] < Errors[0][0] ? 1 : 0) | (Errors[1][1] < Errors[1][0] ? 2 : 0);
+			}
+		}
+
+		float Error = FLT_MAX;
+		for (u32 Combination = 0; Combination < 4; ++Combination)
+		{
+			bool Valid = Quality == TextureQualityFast ? Combination == FastCombination : !SharedPBit || Combination == 0 || Combination == 3;
+			if (!Valid)
+			{
+				continue;
+			}
+
+			u8 CandidatePBits[2] = { u8(Combination & 1), u8(Combination >> 1) };
+			u8 Candidate[2][4];
+			QuantizeBC7Endpoint(E0, Channels, CandidatePBits[0], Bits, Candidate[0]);
+			QuantizeBC7Endpoint(E1, Channels, CandidatePBits[1], Bits, Candidate[1]);
+
+			u8 CandidateIndices[16];
+			float CandidateError = EvaluateBC7Subset(Block, Candidate, CandidatePBits, Channels, Bits, Mask, CandidateIndices);
+			if (CandidateError < Error)
+			{
+				Error = CandidateError;
+				memcpy(Quantized, Candidate, sizeof(Candidate));
+				PBits[0] = CandidatePBits[0];
+				PBits[1] = CandidatePBits[1];
+				for (u32 i = 0; i < 16; ++i)
+				{
+					Indices[i] = Mask & (1u << i) ? CandidateIndices[i] : Indices[i];
+				}
+			}
+		}
+		return Error;
+	}
+
+	// Endpoints for one subset of the block, Channels is 4 for mode 6 and 3 for mode 1
+	float EncodeBC7Subset(const TexelBlock& Block, u32 Channels, u32 Bits, bool SharedPBit, u32 Mask, u8 Quality, u8 (*Quantized)[4], u8* PBits, u8* Indices)
+	{
+		float E0[4], E1[4];
+		FitEndpoints(Block, 0, Channels, Mask, Quality, E0, E1);
+		float Error = QuantizeBC7Subset(Block, E0, E1, Channels, Bits, SharedPBit, Mask, Quality, Quantized, PBits, Indices);
+
+		u32 PaletteSize = Channels == 4 ? 16 : 8;
+		float Weights[16];
+		for (u32 i = 0; i < PaletteSize; ++i)
+		{
+			Weights[i] = float(PaletteSize == 16 ? BC7Weights4[i] : BC7Weights3[i]) / 64.f;
+		}
+
+		u32 Iterations = Quality == TextureQualityFast ? 0 : Quality == TextureQualityNormal ? 1 : 3;
+		for (u32 Iteration = 0; Iteration < Iterations && Error > 0.f; ++Iteration)
+		{
+			if (!RefineEndpoints(Block, 0, Channels, Mask, Indices, Weights, E0, E1))
+			{
+				break;
+			}
+
+			u8 Refined[2][4], RefinedPBits[2], RefinedIndices[16] = {};
+			float RefinedError = QuantizeBC7Subset(Block, E0, E1, Channels, Bits, SharedPBit, Mask, Quality, Refined, RefinedPBits, RefinedIndices);
+			if (RefinedError >= Error)
+			{
+				break;
+			}
+			Error = RefinedError;
+			memcpy(Quantized, Refined, sizeof(Refined));
+			PBits[0] = RefinedPBits[0];
+			PBits[1] = RefinedPBits[1];
+			for (u32 i = 0; i < 16; ++i)
+			{
+				Indices[i] = Mask & (1u << i) ? RefinedIndices[i] : Indices[i];
+			}
+		}
+
+		if (Quality != TextureQualityBest)
+		{
+			return Error;
+		}
+
+		u32 Limit = (1u << Bits) - 1;
+		for (u32 Pass = 0; Pass < 8 && Error > 0.f; ++Pass)
+		{
+			bool Improved = false;
+			for (u32 e = 0; e < 2; ++e)
+			for (u32 c = 0; c < Channels; ++c)
+			for (u32 Up = 0; Up < 2; ++Up)
+			{
+				if (Up ? Quantized[e][c] == Limit : Quantized[e][c] == 0)
+				{
+					continue;
+				}
+
+				u8 Candidate[2][4];
+				memcpy(Candidate, Quantized, sizeof(Candidate));
+				Candidate[e][c] = u8(Up ? Candidate[e][c] + 1 : Candidate[e][c] - 1);
+
+				u8 CandidateIndices[16];
+				float CandidateError = EvaluateBC7Subset(Block, Candidate, PBits, Channels, Bits, Mask, CandidateIndices);
+				if (CandidateError < Error)
+				{
+					Error = CandidateError;
+					memcpy(Quantized, Candidate, sizeof(Candidate));
+					for (u32 i = 0; i < 16; ++i)
+					{
+						Indices[i] = Mask & (1u << i) ? CandidateIndices[i] : Indices[i];
+					}
+					Improved = true;
+				}
+			}
+			if (!Improved)
+			{
+				break;
+			}
+		}
+		return Error;
+	}
+
+	// The anchor pixel's index is written without its top bit, so it has to be in the lower half of the palette
+	void FixBC7Anchor(u8 (*Quantized)[4], u8* PBits, u8* Indices, u32 Mask, u32 Anchor, u32 PaletteSize)
+	{
+		if (Indices[Anchor] < PaletteSize / 2)
+		{
+			return;
+		}
+		for (u32 c = 0; c < 4; ++c)
+		{
+			eastl::swap(Quantized[0][c], Quantized[1][c]);
+		}
+		eastl::swap(PBits[0], PBits[1]);
+		for (u32 i = 0; i < 16; ++i)
+		{
+			if (Mask & (1u << i))
+			{
+				Indices[i] = u8(PaletteSize - 1 - Indices[i]);
+			}
+		}
+	}
+
+	float EncodeBC7Mode6(u8* Out, const TexelBlock& Block, u8 Quality)
+	{
+		u8 Quantized[2][4], PBits[2], Indices[16] = {};
+		float Error = EncodeBC7Subset(Block, 4, 7, false, TextureAllPixels, Quality, Quantized, PBits, Indices);
+		FixBC7Anchor(Quantized, PBits, Indices, TextureAllPixels, 0, 16);
+
+		BlockBitWriter Writer;
+		Writer.Write(1 << 6, 7);
+		for (u32 c = 0; c < 4; ++c)
+		for (u32 e = 0; e < 2; ++e)
+		{
+			Writer.Write(Quantized[e][c], 7);
+		}
+		Writer.Write(PBits[0], 1);
+		Writer.Write(PBits[1], 1);
+		for (u32 i = 0; i < 16; ++i)
+		{
+			Writer.Write(Indices[i], i == 0 ? 3 : 4);
+		}
+		CHECK(Writer.Position == 128);
+		memcpy(Out, Writer.Bits, 16);
+		return Error;
+	}
+
+	// Every partition gets a quick estimate from its unquantized endpoints, the most promising few are encoded for real.
+	// Out is only written when mode 1 beats ErrorToBeat.
+	void EncodeBC7Mode1(u8* Out, const TexelBlock& Block, u8 Quality, float ErrorToBeat)
+	{
+		const u32 Candidates = 4;
+		u32 BestPartitions[Candidates];
+		float BestEstimates[Candidates];
+		for (u32 i = 0; i < Candidates; ++i)
+		{
+			BestPartitions[i] = 0;
+			BestEstimates[i] = FLT_MAX;
+		}
+
+		for (u32 Partition = 0; Partition < 64; ++Partition)
+		{
+			float Estimate = 0.f;
+			for (u32 Subset = 0; Subset < 2; ++Subset)
+			{
+				u32 Mask = Subset ? BC7Partitions2[Partition] : ~BC7Partitions2[Partition] & TextureAllPixels;
+				float E0[4], E1[4];
+				FitEndpoints(Block, 0, 3, Mask, TextureQualityFast, E0, E1);
+
+				float Palette[8][4];
+				for (u32 i = 0; i < 8; ++i)
+				for (u32 c = 0; c < 3; ++c)
+				{
+					Palette[i][c] = E0[c] + (E1[c] - E0[c]) * float(BC7Weights3[i]) / 64.f;
+				}
+				u8 Indices[16];
+				Estimate += FindClosestIndices(Block, Palette, 8, 0, 3, Mask, Indices);
+			}
+
+			for (u32 i = 0; i < Candidates; ++i)
+			{
+				if (Estimate < BestEstimates[i])
+				{
+					for (u32 j = Candidates - 1; j > i; --j)
+					{
+						BestEstimates[j] = BestEstimates[j - 1];
+						BestPartitions[j] = BestPartitions[j - 1];
+					}
+					BestEstimates[i] = Estimate;
+					BestPartitions[i] = Partition;
+					break;
+				}
+			}
+		}
+
+		// the candidates are told apart with normal quality endpoints, only the winner gets the full search
+		u32 Partition = BestPartitions[0];
+		float PartitionError = FLT_MAX;
+		for (u32 Candidate = 0; Candidate < Candidates && Quality == TextureQualityBest; ++Candidate)
+		{
+			u8 CandidateQuantized[2][4], CandidatePBits[2], CandidateIndices[16] = {};
+			float CandidateError = 0.f;
+			for (u32 Subset = 0; Subset < 2 && CandidateError < PartitionError; ++Subset)
+			{
+				u32 Mask = Subset ? BC7Partitions2[BestPartitions[Candidate]] : ~BC7Partitions2[BestPartitions[Candidate]] & TextureAllPixels;
+				CandidateError += EncodeBC7Subset(Block, 3, 6, true, Mask, TextureQualityNormal, CandidateQuantized, CandidatePBits, CandidateIndices);
+			}
+			if (CandidateError < PartitionError)
+			{
+				PartitionError = CandidateError;
+				Partition = BestPartitions[Candidate];
+			}
+		}
+
+		u8 Quantized[2][2][4], PBits[2][2], Indices[16] = {};
+		float Error = 0.f;
+		for (u32 Subset = 0; Subset < 2; ++Subset)
+		{
+			u32 Mask = Subset ? BC7Partitions2[Partition] : ~BC7Partitions2[Partition] & TextureAllPixels;
+			Error += EncodeBC7Subset(Block, 3, 6, true, Mask, Quality, Quantized[Subset], PBits[Subset], Indices);
+		}
+		if (Error >= ErrorToBeat)
+		{
+			return;
+		}
+
+		u32 SecondMask = BC7Partitions2[Partition];
+		u32 Anchor = BC7Anchors2[Partition];
+		FixBC7Anchor(Quantized[0], PBits[0], Indices, ~SecondMask & TextureAllPixels, 0, 8);
+		FixBC7Anchor(Quantized[1], PBits[1], Indices, SecondMask, Anchor, 8);
+
+		BlockBitWriter Writer;
+		Writer.Write(1 << 1, 2);
+		Writer.Write(Partition, 6);
+		for (u32 c = 0; c < 3; ++c)
+		for (u32 Subset = 0; Subset < 2; ++Subset)
+		for (u32 e = 0; e < 2; ++e)
+		{
+			Writer.Write(Quantized[Subset][e][c], 6);
+		}
+		Writer.Write(PBits[0][0], 1);
+		Writer.Write(PBits[1][0], 1);
+		for (u32 i = 0; i < 16; ++i)
+		{
+			Writer.Write(Indices[i], i == 0 || i == Anchor ? 2 : 3);
+		}
+		CHECK(Writer.Position == 128);
+		memcpy(Out, Writer.Bits, 16);
+	}
+
+	void EncodeBC7Block(u8* Out, const TexelBlock& Block, u8 Quality)
+	{
+		float Error = EncodeBC7Mode6(Out, Block, Quality);
+		if (Quality == TextureQualityBest && Error > 0.f && IsBlockOpaque(Block))
+		{
+			EncodeBC7Mode1(Out, Block, Quality, Error);
+		}
+	}
+
+	// Only the modes EncodeBC7Block writes
+	void DecodeBC7Block(const u8* In, u8 (*Pixels)[4])
+	{
+		BlockBitReader Reader;
+		memcpy(Reader.Bits, In, 16);
+
+		if ((In[0] & 3) == (1 << 1))
+		{
+			Reader.Read(2);
+			u32 Partition = Reader.Read(6);
+			u8 Quantized[2][2][4];
+			u8 PBits[2];
+			for (u32 c = 0; c < 3; ++c)
+			for (u32 Subset = 0; Subset < 2; ++Subset)
+			for (u32 e = 0; e < 2; ++e)
+			{
+				Quantized[Subset][e][c] = (u8)Reader.Read(6);
+			}
+			PBits[0] = (u8)Reader.Read(1);
+			PBits[1] = (u8)Reader.Read(1);
+
+			u32 Anchor = BC7Anchors2[Partition];
+			for (u32 i = 0; i < 16; ++i)
+			{
+				u32 Subset = (BC7Partitions2[Partition] >> i) & 1;
+				u32 Weight = BC7Weights3[Reader.Read(i == 0 || i == Anchor ? 2 : 3)];
+				for (u32 c = 0; c < 3; ++c)
+				{
+					u32 E0 = ExpandBC7Component(Quantized[Subset][0][c], PBits[Subset], 6);
+					u32 E1 = ExpandBC7Component(Quantized[Subset][1][c], PBits[Subset], 6);
+					Pixels[i][c] = u8(((64 - Weight) * E0 + Weight * E1 + 32) >> 6);
+				}
+				Pixels[i][3] = 255;
+			}
+			return;
+		}
+
+		CHECK((In[0] & 0x7f) == (1 << 6), "Only BC7 modes 1 and 6 are decoded");
+		Reader.Read(7);
+		u8 Quantized[2][4];
+		for (u32 c = 0; c < 4; ++c)
+		for (u32 e = 0; e < 2; ++e)
+		{
+			Quantized[e][c] = (u8)Reader.Read(7);
+		}
+		u32 PBits[2];
+		PBits[0] = Reader.Read(1);
+		PBits[1] = Reader.Read(1);
+		for (u32 i = 0; i < 16; ++i)
+		{
+			u32 Weight = BC7Weights4[Reader.Read(i == 0 ? 3 : 4)];
+			for (u32 c = 0; c < 4; ++c)
+			{
+				u32 E0 = ExpandBC7Component(Quantized[0][c], PBits[0], 7);
+				u32 E1 = ExpandBC7Component(Quantized[1][c], PBits[1], 7);
+				Pixels[i][c] = u8(((64 - Weight) * E0 + Weight * E1 + 32) >> 6);
+			}
+		}
+	}
+
+	void EncodeBlock(u8* Out, const TexelBlock& Block, u8 Format, u8 Quality)
+	{
+		switch (Format)
+		{
+		case TextureEncodeBC1:
+			EncodeBC1Block(Out, Block, Quality);
+			break;
+		case TextureEncodeBC3:
+			EncodeBC4Block(Out, Block, 3, Quality);
+			EncodeBC1Block(Out + 8, Block, Quality);
+			break;
+		case TextureEncodeBC4:
+			EncodeBC4Block(Out, Block, 0, Quality);
+			break;
+		case TextureEncodeBC5:
+			EncodeBC4Block(Out, Block, 0, Quality);
+			EncodeBC4Block(Out + 8, Block, 1, Quality);
+			break;
+		case TextureEncodeBC7:
+			EncodeBC7Block(Out, Block, Quality);
+			break;
+		default:
+			CHECK(false, "Unknown texture encode format");
+		}
+	}
+
+	void DecodeBlock(const u8* In, u8 (*Pixels)[4], u8 Format)
+	{
+		switch (Format)
+		{
+		case TextureEncodeBC1:
+			DecodeBC1Block(In, Pixels, false);
+			break;
+		case TextureEncodeBC3:
+			DecodeBC1Block(In + 8, Pixels, true);
+			DecodeBC4Block(In, Pixels, 3);
+			break;
+		case TextureEncodeBC4:
+			DecodeBC4Block(In, Pixels, 0);
+			break;
+		case TextureEncodeBC5:
+			DecodeBC4Block(In, Pixels, 0);
+			DecodeBC4Block(In + 8, Pixels, 1);
+			break;
+		case TextureEncodeBC7:
+			DecodeBC7Block(In, Pixels);
+			break;
+		default:
+			CHECK(false, "Unknown texture encode format");
+		}
+	}
+
+	// Over the channels the format keeps
+	double ComputePSNR(const u8* A, const u8* B, u64 PixelCount, u32 Channels)
+	{
+		double SquaredError = 0.0;
+		for (u64 i = 0; i < PixelCount; ++i)
+		{
+			for (u32 c = 0; c < Channels; ++c)
+			{
+				double Delta = double(A[i * 4 + c]) - double(B[i * 4 + c]);
+				SquaredError += Delta * Delta;
+			}
+		}
+		if (SquaredError == 0.0)
+		{
+			return 99.99;
+		}
+		double MeanSquaredError = SquaredError / double(PixelCount * Channels);
+		return 10.0 * log10(255.0 * 255.0 / MeanSquaredError);
+	}
+}
+
+u32 GetEncodedBlockSize(u8 Format)
+{
+	return Format == TextureEncodeBC1 || Format == TextureEncodeBC4 ? 8 : 16;
+}
+
+u64 GetEncodedTextureSize(u8 Format, u32 Width, u32 Height)
+{
+	return u64(DivideRoundUp(Width, 4u)) * DivideRoundUp(Height, 4u) * GetEncodedBlockSize(Format);
+}
+
+bool IsImageOpaque(const u8* RGBA, u64 PixelCount)
+{
+	for (u64 i = 0; i < PixelCount; ++i)
+	{
+		if (RGBA[i * 4 + 3] != 255)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+u64 GetEncodedMipChainSize(u8 Format, u32 Width, u32 Height, u32 MipCount)
+{
+	u64 Result = 0;
+	for (u32 Mip = 0; Mip < MipCount; ++Mip)
+	{
+		Result += GetEncodedTextureSize(Format, GetMipSize(Width, Mip), GetMipSize(Height, Mip));
+	}
+	return Result;
+}
+
+// Mips come in and go out back to back, the way GenerateMipChain lays them out.
+// Tiles of every level go into one ParallelFor, so the small levels don't leave workers idle.
+void EncodeMipChain(u8* Out, const u8* RGBA, u32 Width, u32 Height, u32 MipCount, u8 Format, u8 Quality)
+{
+	ZoneScoped;
+	CHECK(Width != 0 && Height != 0);
+	CHECK(MipCount != 0 && MipCount <= 16);
+	CHECK(Quality < TextureQualityCount);
+
+	struct MipTiles
+	{
+		u32 Width, Height;
+		u32 BlocksX, BlocksY;
+		u32 TilesX;
+		u64 FirstTile;
+		const u8* Source;
+		u8* Dest;
+	};
+
+	MipTiles Mips[16];
+	u64 TileCount = 0;
+	for (u32 Mip = 0; Mip < MipCount; ++Mip)
+	{
+		MipTiles& Level = Mips[Mip];
+		Level.Width = GetMipSize(Width, Mip);
+		Level.Height = GetMipSize(Height, Mip);
+		Level.BlocksX = DivideRoundUp(Level.Width, 4u);
+		Level.BlocksY = DivideRoundUp(Level.Height, 4u);
+		Level.TilesX = DivideRoundUp(Level.BlocksX, TextureTileBlocks);
+		Level.FirstTile = TileCount;
+		Level.Source = Mip == 0 ? RGBA : Mips[Mip - 1].Source + u64(Mips[Mip - 1].Width) * Mips[Mip - 1].Height * 4;
+		Level.Dest = Mip == 0 ? Out : Mips[Mip - 1].Dest + GetEncodedTextureSize(Format, Mips[Mip - 1].Width, Mips[Mip - 1].Height);
+		TileCount += u64(Level.TilesX) * DivideRoundUp(Level.BlocksY, TextureTileBlocks);
+	}
+
+	u32 BlockSize = GetEncodedBlockSize(Format);
+	ParallelFor([&](u64 Begin, u64 End) {
+		ZoneScopedN("Encode texture tiles");
+		TexelBlock Block;
+		u32 Mip = 0;
+		for (u64 Tile = Begin; Tile < End; ++Tile)
+		{
+			while (Mip + 1 < MipCount && Tile >= Mips[Mip + 1].FirstTile)
+			{
+				Mip++;
+			}
+
+			const MipTiles& Level = Mips[Mip];
+			u64 LevelTile = Tile - Level.FirstTile;
+			u32 FirstX = u32(LevelTile % Level.TilesX) * TextureTileBlocks;
+			u32 FirstY = u32(LevelTile / Level.TilesX) * TextureTileBlocks;
+			u32 LastX = eastl::min(FirstX + TextureTileBlocks, Level.BlocksX);
+			u32 LastY = eastl::min(FirstY + TextureTileBlocks, Level.BlocksY);
+			for (u32 y = FirstY; y < LastY; ++y)
+			{
+				for (u32 x = FirstX; x < LastX; ++x)
+				{
+					LoadTexelBlock(Block, Level.Source, Level.Width, Level.Height, x * 4, y * 4);
+					EncodeBlock(Level.Dest + (u64(y) * Level.BlocksX + x) * BlockSize, Block, Format, Quality);
+				}
+			}
+		}
+	}, TileCount);
+}
+
+// Out takes GetEncodedTextureSize bytes, blocks row by row
+void EncodeTexture(u8* Out, const u8* RGBA, u32 Width, u32 Height, u8 Format, u8 Quality)
+{
+	EncodeMipChain(Out, RGBA, Width, Height, 1, Format, Quality);
+}
+
+// Back to RGBA8, channels the format doesn't have come out as 0, alpha as 255
+void DecodeTexture(u8* RGBA, const u8* In, u32 Width, u32 Height, u8 Format)
+{
+	u32 BlocksX = DivideRoundUp(Width, 4u);
+	u32 BlocksY = DivideRoundUp(Height, 4u);
+	u32 BlockSize = GetEncodedBlockSize(Format);
+
+	u8 Pixels[16][4];
+	for (u32 y = 0; y < BlocksY; ++y)
+	{
+		for (u32 x = 0; x < BlocksX; ++x)
+		{
+			for (u32 i = 0; i < 16; ++i)
+			{
+				Pixels[i][0] = Pixels[i][1] = Pixels[i][2] = 0;
+				Pixels[i][3] = 255;
+			}
+			DecodeBlock(In + (u64(y) * BlocksX + x) * BlockSize, Pixels, Format);
+
+			for (u32 i = 0; i < 16; ++i)
+			{
+				u32 PixelX = x * 4 + (i & 3);
+				u32 PixelY = y * 4 + (i >> 2);
+				if (PixelX < Width && PixelY < Height)
+				{
+					memcpy(RGBA + (u64(PixelY) * Width + PixelX) * 4, Pixels[i], 4);
+				}
+			}
+		}
+	}
+}
+
+void BenchmarkTextureEncoders(const u8* RGBA, u32 Width, u32 Height, u32 Repeats)
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	const u8 Formats[] = { TextureEncodeBC1, TextureEncodeBC3, TextureEncodeBC4, TextureEncodeBC5, TextureEncodeBC7 };
+	u64 PixelCount = u64(Width) * Height;
+	String Decoded(PixelCount * 4, '\0');
+
+	printf("%ux%u, %llu workers\n", Width, Height, NumberOfWorkers());
+	printf("%-10s %-10s %14s %14s\n", "format", "quality", "encode MPix/s", "PSNR dB");
+	for (u8 Format : Formats)
+	{
+		String Encoded(GetEncodedTextureSize(Format, Width, Height), '\0');
+		for (u8 Quality = TextureQualityFast; Quality < TextureQualityCount; ++Quality)
+		{
+			auto EncodeStart = Clock::now();
+			for (u32 i = 0; i < Repeats; ++i)
+			{
+				EncodeTexture((u8*)Encoded.data(), RGBA, Width, Height, Format, Quality);
+			}
+			double EncodeSeconds = std::chrono::duration<double>(Clock::now() - EncodeStart).count();
+
+			DecodeTexture((u8*)Decoded.data(), (const u8*)Encoded.data(), Width, Height, Format);
+			printf("%-10s %-10s %14.2f %14.2f\n",
+				GetTextureEncodeFormatName(Format),
+				GetTextureEncodeQualityName(Quality),
+				double(PixelCount) * Repeats / EncodeSeconds / 1e6,
+				ComputePSNR(RGBA, (const u8*)Decoded.data(), PixelCount, GetEncodedChannelCount(Format))
+			);
+		}
+	}
+}
@@ -0,0 +1,321 @@
+#include "Assets/TextureMips.generated.h"
+#include "Containers/Array.h"
+#include "Threading/Worker.generated.h"
+#include "Threading/Private/Worker.Declarations.h"
+#include "Threading/Private/DedicatedThread.Declarations.h"
+#include "Util/Debug.h"
+#include "Util/Math.h"
+#include "Util/Private/Math.Declarations.h"
+
+#include <math.h>
+#include <string.h>
+#include <immintrin.h>
+#include <tracy/Tracy.hpp>
+
+namespace
+{
+	const float MipFilterPi = 3.14159265f;
+
+	// Source pixel and weight of every tap, TapCount per destination pixel
+	struct MipFilterTaps
+	{
+		TArray<u32>   Sources;
+		TArray<float> Weights;
+		u32           TapCount;
+	};
+
+	float Sinc(float X)
+	{
+		X *= MipFilterPi;
+		return fabsf(X) < 1e-5f ? 1.f : sinf(X) / X;
+	}
+
+	float BesselI0(float X)
+	{
+		float Sum = 1.f, Term = 1.f;
+		for (u32 k = 1; k < 32 && Term > Sum * 1e-8f; ++k)
+		{
+			float Half = X / (2.f * k);
+			Term *= Half * Half;
+			Sum += Term;
+		}
+		return Sum;
+	}
+
+	float GetMipFilterRadius(u8 Filter)
+	{
+		return Filter == MipFilterBox ? 0.5f : 3.f;
+	}
+
+	// T is the distance in destination texels
+	float EvaluateMipFilter(u8 Filter, float T)
+	{
+		T = fabsf(T);
+		switch (Filter)
+		{
+		case MipFilterBox:
+			return T <= 0.5f ? 1.f : 0.f;
+		case MipFilterKaiser:
+		{
+			const float Alpha = 4.f;
+			if (T >= 3.f)
+			{
+				return 0.f;
+			}
+			float Window = T / 3.f;
+			return Sinc(T) * BesselI0(Alpha * sqrtf(1.f - Window * Window)) / BesselI0(Alpha);
+		}
+		case MipFilterLanczos:
+			return T < 3.f ? Sinc(T) * Sinc(T / 3.f) : 0.f;
+		}
+		CHECK(false, "Unknown mip filter");
+		return 0.f;
+	}
+
+	void BuildMipFilterTaps(MipFilterTaps& Taps, u32 SourceSize, u32 DestSize, u8 Filter, bool Wrap)
+	{
+		float Scale = float(SourceSize) / float(DestSize);
+		float Radius = GetMipFilterRadius(Filter) * Scale;
+		Taps.TapCount = u32(ceilf(Radius * 2.f)) + 1;
+		Taps.Sources.resize(u64(DestSize) * Taps.TapCount);
+		Taps.Weights.resize(u64(DestSize) * Taps.TapCount);
+
+		for (u32 x = 0; x < DestSize; ++x)
+		{
+			float Center = (float(x) + 0.5f) * Scale;
+			i32 First = i32(floorf(Center - Radius));
+			u32* Sources = &Taps.Sources[u64(x) * Taps.TapCount];
+			float* Weights = &Taps.Weights[u64(x) * Taps.TapCount];
+
+			float Sum = 0.f;
+			for (u32 k = 0; k < Taps.TapCount; ++k)
+			{
+				i32 Source = First + i32(k);
+				Weights[k] = EvaluateMipFilter(Filter, (float(Source) + 0.5f - Center) / Scale);
+				Sum += Weights[k];
+
+				if (Wrap)
+				{
+					Source %= i32(SourceSize);
+					Source += Source < 0 ? i32(SourceSize) : 0;
+				}
+				else
+				{
+					Source = Clamp(Source, 0, i32(SourceSize) - 1);
+				}
+				Sources[k] = u32(Source);
+			}
+
+			CHECK(Sum > 0.f);
+			for (u32 k = 0; k < Taps.TapCount; ++k)
+			{
+				Weights[k] /= Sum;
+			}
+		}
+	}
+
+	const float* GetSRGBToLinearTable()
+	{
+		static float Table[256] = {};
+		static bool Initialized = [] {
+			for (u32 i = 0; i < 256; ++i)
+			{
+				float Value = float(i) / 255.f;
+				Table[i] = Value <= 0.04045f ? Value / 12.92f : powf((Value + 0.055f) / 1.055f, 2.4f);
+			}
+			return true;
+		}();
+		(void)Initialized;
+		return Table;
+	}
+
+	u8 LinearToSRGB8(float Value)
+	{
+		Value = Clamp(Value, 0.f, 1.f);
+		Value = Value <= 0.0031308f ? Value * 12.92f : 1.055f * powf(Value, 1.f / 2.4f) - 0.055f;
+		return u8(Value * 255.f + 0.5f);
+	}
+
+	u8 LinearToUnorm8(float Value)
+	{
+		return u8(Clamp(Value, 0.f, 1.f) * 255.f + 0.5f);
+	}
+
+	// Width pixels of RGBA8 to linear floats
+	void LoadLinearRow(float* Out, const u8* Row, u32 Width, bool SRGB)
+	{
+		const float* ToLinear = GetSRGBToLinearTable();
+		for (u32 x = 0; x < Width; ++x)
+		{
+			for (u32 c = 0; c < 3; ++c)
+			{
+				Out[x * 4 + c] = SRGB ? ToLinear[Row[x * 4 + c]] : float(Row[x * 4 + c]) / 255.f;
+			}
+			Out[x * 4 + 3] = float(Row[x * 4 + 3]) / 255.f;
+		}
+	}
+
+	// One RGBA pixel per SSE register
+	void FilterRowHorizontal(float* Out, const float* Row, const MipFilterTaps& Taps, u32 DestWidth)
+	{
+		for (u32 x = 0; x < DestWidth; ++x)
+		{
+			const u32* Sources = &Taps.Sources[u64(x) * Taps.TapCount];
+			const float* Weights = &Taps.Weights[u64(x) * Taps.TapCount];
+
+			__m128 Sum = _mm_setzero_ps();
+			for (u32 k = 0; k < Taps.TapCount; ++k)
+			{
+				Sum = _mm_add_ps(Sum, _mm_mul_ps(_mm_loadu_ps(Row + u64(Sources[k]) * 4), _mm_set1_ps(Weights[k])));
+			}
+			_mm_storeu_ps(Out + u64(x) * 4, Sum);
+		}
+	}
+
+	// Two RGBA pixels per AVX register, returns where the SSE loop picks up the odd pixel left over
+	TARGET_AVX2 u64 FilterRowVerticalAVX2(float* Out, const float* Columns, u64 Floats, const u32* Sources, const float* Weights, u32 TapCount)
+	{
+		u64 Pitch = Floats;
+		u64 x = 0;
+		for (; x + 8 <= Floats; x += 8)
+		{
+			__m256 Sum = _mm256_setzero_ps();
+			for (u32 k = 0; k < TapCount; ++k)
+			{
+				Sum = _mm256_add_ps(Sum, _mm256_mul_ps(_mm256_loadu_ps(Columns + Sources[k] * Pitch + x), _mm256_set1_ps(Weights[k])));
+			}
+			Sum = _mm256_min_ps(_mm256_max_ps(Sum, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+			_mm256_storeu_ps(Out + x, Sum);
+		}
+		return x;
+	}
+
+	void FilterRowVerticalSSE(float* Out, const float* Columns, u64 Floats, const u32* Sources, const float* Weights, u32 TapCount, u64 x)
+	{
+		u64 Pitch = Floats;
+		for (; x < Floats; x += 4)
+		{
+			__m128 Sum = _mm_setzero_ps();
+			for (u32 k = 0; k < TapCount; ++k)
+			{
+				Sum = _mm_add_ps(Sum, _mm_mul_ps(_mm_loadu_ps(Columns + Sources[k] * Pitch + x), _mm_set1_ps(Weights[k])));
+			}
+			Sum = _mm_min_ps(_mm_max_ps(Sum, _mm_setzero_ps()), _mm_set1_ps(1.f));
+			_mm_storeu_ps(Out + x, Sum);
+		}
+	}
+
+	// Rows are read straight down so every tap is a contiguous stream, a pixel at a time without AVX2.
+	// Negative lobes can push values out of range, those are clamped before the next level sees them.
+	void FilterRowVertical(float* Out, const float* Columns, u32 Width, const MipFilterTaps& Taps, u32 y)
+	{
+		const u32* Sources = &Taps.Sources[u64(y) * Taps.TapCount];
+		const float* Weights = &Taps.Weights[u64(y) * Taps.TapCount];
+		u64 Floats = u64(Width) * 4;
+
+		u64 x = 0;
+		if (CpuSupportsAVX2())
+		{
+			x = FilterRowVerticalAVX2(Out, Columns, Floats, Sources, Weights, Taps.TapCount);
+		}
+		FilterRowVerticalSSE(Out, Columns, Floats, Sources, Weights, Taps.TapCount, x);
+	}
+}
+
+u32 GetMipSize(u32 Size, u32 Mip)
+{
+	return eastl::max(Size >> Mip, 1u);
+}
+
+u32 GetFullMipCount(u32 Width, u32 Height)
+{
+	u32 Largest = eastl::max(Width, Height);
+	u32 Count = 1;
+	while (Largest >>= 1)
+	{
+		++Count;
+	}
+	return Count;
+}
+
+// RGBA8 bytes of the chain, levels back to back
+u64 GetMipChainSize(u32 Width, u32 Height, u32 MipCount)
+{
+	u64 Result = 0;
+	for (u32 Mip = 0; Mip < MipCount; ++Mip)
+	{
+		Result += u64(GetMipSize(Width, Mip)) * GetMipSize(Height, Mip) * 4;
+	}
+	return Result;
+}
+
+// Out takes GetMipChainSize bytes, level 0 is a copy of the source.
+// Wrap samples across the edges the way a repeating texture is sampled, otherwise edges are clamped.
+void GenerateMipChain(u8* Out, const u8* RGBA, u32 Width, u32 Height, u32 MipCount, u8 Filter, bool SRGB, bool Wrap)
+{
+	ZoneScoped;
+	CHECK(Width != 0 && Height != 0);
+	CHECK(MipCount != 0 && MipCount <= GetFullMipCount(Width, Height));
+	CHECK(Filter < MipFilterCount);
+
+	memcpy(Out, RGBA, u64(Width) * Height * 4);
+
+	// Linear levels, the one being read and the one being written
+	TArray<float> Source;
+	TArray<float> Dest;
+	TArray<float> Horizontal;
+	MipFilterTaps TapsX;
+	MipFilterTaps TapsY;
+
+	const u8* Level0 = RGBA;
+	u8* LevelOut = Out + u64(Width) * Height * 4;
+	for (u32 Mip = 1; Mip < MipCount; ++Mip)
+	{
+		ZoneScopedN("Mip level");
+		u32 SourceWidth = GetMipSize(Width, Mip - 1);
+		u32 SourceHeight = GetMipSize(Height, Mip - 1);
+		u32 DestWidth = GetMipSize(Width, Mip);
+		u32 DestHeight = GetMipSize(Height, Mip);
+
+		BuildMipFilterTaps(TapsX, SourceWidth, DestWidth, Filter, Wrap);
+		BuildMipFilterTaps(TapsY, SourceHeight, DestHeight, Filter, Wrap);
+		Horizontal.resize(u64(SourceHeight) * DestWidth * 4);
+		Dest.resize(u64(DestHeight) * DestWidth * 4);
+
+		// the first level is read straight from the 8 bit source, a row at a time
+		ParallelFor([&](u64 Begin, u64 End) {
+			TArray<float> Row(Mip == 1 ? u64(SourceWidth) * 4 : 0);
+			for (u64 y = Begin; y < End; ++y)
+			{
+				const float* SourceRow = nullptr;
+				if (Mip == 1)
+				{
+					LoadLinearRow(Row.data(), Level0 + y * SourceWidth * 4, SourceWidth, SRGB);
+					SourceRow = Row.data();
+				}
+				else
+				{
+					SourceRow = &Source[y * SourceWidth * 4];
+				}
+				FilterRowHorizontal(&Horizontal[y * DestWidth * 4], SourceRow, TapsX, DestWidth);
+			}
+		}, SourceHeight);
+
+		ParallelFor([&](u64 Begin, u64 End) {
+			for (u64 y = Begin; y < End; ++y)
+			{
+				float* Row = &Dest[y * DestWidth * 4];
+				FilterRowVertical(Row, Horizontal.data(), DestWidth, TapsY, u32(y));
+
+				u8* RowOut = LevelOut + y * DestWidth * 4;
+				for (u64 x = 0; x < u64(DestWidth) * 4; ++x)
+				{
+					RowOut[x] = SRGB && (x & 3) != 3 ? LinearToSRGB8(Row[x]) : LinearToUnorm8(Row[x]);
+				}
+			}
+		}, DestHeight);
+
+		eastl::swap(Source, Dest);
+		LevelOut += u64(DestWidth) * DestHeight * 4;
+	}
+}
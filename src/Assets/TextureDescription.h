@@ -1,8 +1,12 @@
 #pragma once
 
 #include "Common.h"
+#include "Containers/String.h"
 
 struct TextureDescription { u32 Value = 0; };
 // MSB      ::::  |  ::::    ::::  | LSB
 //           mip     log2   format
 //          count   of size
+
+// Textures live in "cooked/textures.pak", shared by every scene and named after a hash of what they were cooked from.
+// Scene paks list the hashes of their textures in "___SceneTextures", in the order materials index them.
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Common.h"
+
+/*
+	TEXTURE ENCODER
+
+	RGBA8 images to block compressed formats, any width and height. Blocks past the right and bottom edges
+	repeat the last column and row, the image is cut into tiles of blocks that go through ParallelFor.
+	-- BC1: color endpoints along the principal axis of the block, 4 color mode only
+	-- BC3: BC1 color plus a BC4 block for alpha
+	-- BC4, BC5: one and two channel blocks, both 8 and 6 value modes are tried
+	-- BC7: mode 6 (one subset, RGBA, 4 bit indices), the best preset also tries mode 1 (two subsets, RGB) on opaque blocks
+
+	Indices are picked by testing every palette entry against 16 pixels at once with AVX2, palettes are what the hardware
+	decodes to, so every endpoint candidate is measured by its real error.
+*/
+
+// Same values as the format nibble of TextureDescription
+enum TextureEncodeFormat : u8
+{
+	TextureEncodeBC1 = 0, // RGB, 4 bits per pixel
+	TextureEncodeBC3 = 2, // RGBA, 8 bits per pixel
+	TextureEncodeBC4 = 3, // R, 4 bits per pixel
+	TextureEncodeBC5 = 4, // RG, 8 bits per pixel
+	TextureEncodeBC7 = 5, // RGBA, 8 bits per pixel
+};
+
+enum TextureEncodeQuality : u8
+{
+	TextureQualityFast,   // bounding box endpoints
+	TextureQualityNormal, // principal axis endpoints, refined by least squares on the chosen indices
+	TextureQualityBest,   // refined further by nudging quantized endpoints while the error goes down
+	TextureQualityCount,
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Common.h"
+
+/*
+	TEXTURE MIPS
+
+	Mip chains for RGBA8 images, every level is filtered down from the one above it in linear float.
+	Color channels of sRGB images go through linear space and back, alpha is always linear.
+	Filters are separable and evaluated in destination texels, so odd sizes get the right footprint too:
+	-- Box: 2x2 average for power of two sizes
+	-- Kaiser: windowed sinc, 3 texels wide, sharper than box without Lanczos' ringing
+	-- Lanczos: 3 lobe sinc, the sharpest, rings around hard edges
+	Each level runs as a horizontal and a vertical pass over bands of rows with ParallelFor.
+*/
+
+enum MipFilter : u8
+{
+	MipFilterBox,
+	MipFilterKaiser,
+	MipFilterLanczos,
+	MipFilterCount,
+};
@@ -8,6 +8,7 @@
 
 #include <tracy/Tracy.hpp>
 #include <nmmintrin.h>
+#include <string.h>
 
 WString StringFromFormat(const wchar_t* Format, ...)
 {
@@ -64,6 +65,166 @@ u32 HashString32(StringView In)
 	return HashString32(In.data(), In.size());
 }
 
+namespace {
+// CRC32C (Castagnoli) polynomial, bit reflected like the SSE4.2 crc32 instruction
+const u32 Crc32CPolynomial = 0x82F63B78;
+const u64 Crc32CLaneSize = 8192;
+
+// a * b mod P in the reflected representation, bit 31 is x^0
+u32 Crc32CMultiply(u32 A, u32 B)
+{
+	u32 Result = 0;
+	for (u32 Mask = 1u << 31; Mask; Mask >>= 1)
+	{
+		if (A & Mask)
+		{
+			Result ^= B;
+		}
+		B = (B & 1) ? (B >> 1) ^ Crc32CPolynomial : B >> 1;
+	}
+	return Result;
+}
+
+// x^(8 * Bytes) mod P, multiplying a crc by it is the same as running it over Bytes zeroes
+u32 Crc32CShiftConstant(u64 Bytes)
+{
+	u32 Result = 1u << 31;
+	u32 Power = 1u << 23; // x^8
+	while (Bytes)
+	{
+		if (Bytes & 1)
+		{
+			Result = Crc32CMultiply(Result, Power);
+		}
+		Power = Crc32CMultiply(Power, Power);
+		Bytes >>= 1;
+	}
+	return Result;
+}
+
+u32 Crc32CSerial(u32 Crc, const u8* In, u64 Size)
+{
+	u64 Crc64 = Crc;
+	while (Size >= 8)
+	{
+		u64 Word;
+		memcpy(&Word, In, 8);
+		Crc64 = _mm_crc32_u64(Crc64, Word);
+		In += 8;
+		Size -= 8;
+	}
+	Crc = u32(Crc64);
+	while (Size >= 1)
+	{
+		Crc = _mm_crc32_u8(Crc, *In);
+		In += 1;
+		Size -= 1;
+	}
+	return Crc;
+}
+}
+
+// Checksum of arbitrary sized data. Chains, Crc32C(B, Crc32C(A, 0)) == Crc32C(AB, 0).
+// crc32 has 3 cycle latency and 1 cycle throughput, so big inputs run three independent lanes
+// and merge them with a multiplication instead of waiting on one dependency chain.
+u32 Crc32C(const void* Data, u64 Size, u32 Crc)
+{
+	ZoneScoped;
+
+	static const u32 ShiftOneLane = Crc32CShiftConstant(Crc32CLaneSize);
+	static const u32 ShiftTwoLanes = Crc32CShiftConstant(Crc32CLaneSize * 2);
+
+	const u8* In = (const u8*)Data;
+	Crc = ~Crc;
+	while (Size >= Crc32CLaneSize * 3)
+	{
+		u64 Lane0 = Crc;
+		u64 Lane1 = 0;
+		u64 Lane2 = 0;
+		for (u64 i = 0; i < Crc32CLaneSize; i += 8)
+		{
+			u64 Word0, Word1, Word2;
+			memcpy(&Word0, In + i, 8);
+			memcpy(&Word1, In + Crc32CLaneSize + i, 8);
+			memcpy(&Word2, In + Crc32CLaneSize * 2 + i, 8);
+			Lane0 = _mm_crc32_u64(Lane0, Word0);
+			Lane1 = _mm_crc32_u64(Lane1, Word1);
+			Lane2 = _mm_crc32_u64(Lane2, Word2);
+		}
+		Crc = Crc32CMultiply(u32(Lane0), ShiftTwoLanes) ^ Crc32CMultiply(u32(Lane1), ShiftOneLane) ^ u32(Lane2);
+		In += Crc32CLaneSize * 3;
+		Size -= Crc32CLaneSize * 3;
+	}
+	return ~Crc32CSerial(Crc, In, Size);
+}
+
+namespace {
+const u64 Hash64Prime1 = 0x9E3779B185EBCA87ull;
+const u64 Hash64Prime2 = 0xC2B2AE3D27D4EB4Full;
+const u64 Hash64Prime3 = 0x165667B19E3779F9ull;
+
+u64 Hash64Round(u64 Acc, u64 Input)
+{
+	Acc += Input * Hash64Prime2;
+	Acc = (Acc << 31) | (Acc >> 33);
+	return Acc * Hash64Prime1;
+}
+}
+
+// Four independent lanes so the multiplies pipeline, content hashes of whole files go through this
+u64 HashData64(const void* Data, u64 Size, u64 Seed)
+{
+	ZoneScoped;
+
+	const u8* In = (const u8*)Data;
+	u64 Lanes[4] = {
+		Seed + Hash64Prime1 + Hash64Prime2,
+		Seed + Hash64Prime2,
+		Seed,
+		Seed - Hash64Prime1,
+	};
+
+	u64 Remaining = Size;
+	while (Remaining >= 32)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			u64 Word;
+			memcpy(&Word, In + i * 8, 8);
+			Lanes[i] = Hash64Round(Lanes[i], Word);
+		}
+		In += 32;
+		Remaining -= 32;
+	}
+
+	u64 Result = Hash64Prime3 + Size;
+	for (int i = 0; i < 4; ++i)
+	{
+		Result = (Result ^ Hash64Round(0, Lanes[i])) * Hash64Prime1 + Hash64Prime3;
+	}
+	while (Remaining >= 8)
+	{
+		u64 Word;
+		memcpy(&Word, In, 8);
+		Result = Hash64Round(Result, Word);
+		In += 8;
+		Remaining -= 8;
+	}
+	while (Remaining >= 1)
+	{
+		Result = Hash64Round(Result, *In);
+		In += 1;
+		Remaining -= 1;
+	}
+
+	Result ^= Result >> 33;
+	Result *= Hash64Prime2;
+	Result ^= Result >> 29;
+	Result *= Hash64Prime3;
+	Result ^= Result >> 32;
+	return Result;
+}
+
 String StringFromFormat(const char* Format, ...)
 {
 	String FormatPadded(Format);
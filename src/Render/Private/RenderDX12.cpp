@@ -604,7 +604,7 @@ void InitRender(System::Window& Window)
 		Params[1].InitAsUnorderedAccessView(0);
 		Params[2].InitAsUnorderedAccessView(1);
 
-		Params[3].InitAsConstants(20, 0);
+		Params[3].InitAsConstants(24, 0);
 
 		CD3DX12_STATIC_SAMPLER_DESC Samplers[2] = {};
 		Samplers[0].Init(0, D3D12_FILTER_MIN_MAG_MIP_POINT);
@@ -798,24 +798,27 @@ Shader CreateShaderCombinationGraphics(
 	}
 	else
 	{
-		DXGI_FORMAT PositionFormat = DXGI_FORMAT_R32G32B32_FLOAT;
-
+		// has to match the layout Oven writes, see Assets/Mesh.h
 		bool bPositionPacked = MeshDescFlags & MeshFlags::PositionPacked;
-		if (bPositionPacked)
-		{
-			PositionFormat = DXGI_FORMAT_R10G10B10A2_UNORM;
-		}
+		DXGI_FORMAT PositionFormat = bPositionPacked ? DXGI_FORMAT_R16G16B16A16_UNORM : DXGI_FORMAT_R32G32B32_FLOAT;
 		Elements[Count++] = D3D12_INPUT_ELEMENT_DESC{ "POSITION", 0, PositionFormat, 0, 0 };
-		u8 Offset = bPositionPacked ? sizeof(Vec4PackShorts) : sizeof(Vec3);
+		u8 Offset = bPositionPacked ? sizeof(u16) * 4 : sizeof(Vec3);
 
 		if (MeshDescFlags & MeshFlags::HasNormals)
 		{
-			Elements[Count++] = D3D12_INPUT_ELEMENT_DESC{ "NORMAL", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, Offset };
-			Offset += sizeof(Vec4PackUnorm);
+			DXGI_FORMAT NormalFormat = bPositionPacked ? DXGI_FORMAT_R16G16_SNORM : DXGI_FORMAT_R10G10B10A2_UNORM;
+			Elements[Count++] = D3D12_INPUT_ELEMENT_DESC{ "NORMAL", 0, NormalFormat, 0, Offset };
+			Offset += sizeof(u32);
+		}
+		if (MeshDescFlags & MeshFlags::HasTangents)
+		{
+			Elements[Count++] = D3D12_INPUT_ELEMENT_DESC{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, Offset };
+			Offset += sizeof(u32);
 		}
 		if (MeshDescFlags & MeshFlags::HasUV0)
 		{
-			Elements[Count++] = D3D12_INPUT_ELEMENT_DESC{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, Offset };
+			DXGI_FORMAT UVFormat = (MeshDescFlags & MeshFlags::UVPacked) ? DXGI_FORMAT_R16G16_UNORM : DXGI_FORMAT_R16G16_FLOAT;
+			Elements[Count++] = D3D12_INPUT_ELEMENT_DESC{ "TEXCOORD", 0, UVFormat, 0, Offset };
 			Offset += sizeof(Vec2h);
 		}
 		else
@@ -38,13 +38,14 @@ struct Scene
 	TArray<APIMesh>             MeshDatas;
 	TArray<VirtualTexture>      Textures;
 	TArray<MaterialDescription> Materials;
+	TArray<u32>                 StreamedMipHashes; // hashes of GetTextureMipItemName(ContentHash, Mip), 8 mips per texture
 
 	TComPtr<ID3D12Resource>     WantedMips;
 	TComPtr<ID3D12Resource>     PickingBuffer;
 	TComPtr<ID3D12Resource>     VertexBuffer;
 	TComPtr<ID3D12Resource>     IndexBuffer;
 
-	PakFileReader FileReader;
+	u32 PakMount; // mount id in the asset VFS
 
 	u16 PickedSRV = ~0;
 	u16 DesiredMips[GENERAL_HEAP_SIZE];
@@ -1,16 +1,16 @@
 #pragma once
 
 #include "Common.h"
+#include "Containers/Array.h"
 #include "Containers/Function.h"
 #include "Containers/String.h"
 #include "Containers/Queue.h"
 #include "Containers/UniquePtr.h"
-#include "Containers/RingBuffer.h"
 #include "Threading/Mutex.h"
 #include "Util/Util.h"
 
+#include <atomic>
 #include <thread>
-#include <condition_variable>
 #include <array>
 
 #define NO_WORKERS 0
@@ -18,120 +18,177 @@
 using Thread = std::thread;
 using ThreadID = std::thread::id;
 
-struct TicketCPU { u16 Value; };
+// Slot and the generation it had when the ticket was made, generation 0 is never pending so TicketCPU() is done
+struct TicketCPU
+{
+	u32 Index = 0;
+	u32 Generation = 0;
+};
 
-struct WorkPreamble
+struct DedicatedThreadData;
+struct WorkPage;
+
+// Callables start right after the preamble, aligned like anything malloc returns
+struct alignas(16) WorkPreamble
 {
 	void (*Executer)(void*);
 	void (*Deleter)(void*);
+	TicketCPU WorkDoneTicket;
+	bool      TicketValid;
+	u32       Bytes;         // preamble and callable
+	WorkPreamble* Next;      // continuations waiting on the same ticket
+	WorkPage* Page;          // nullptr for work too big for a page
 };
 
-struct WorkWrapper
-{
-	WorkWrapper() : Data(nullptr) {}
-	WorkWrapper(WorkPreamble* InData) : Data(InData) {}
-	WorkWrapper(WorkWrapper& InData) = delete;
-	WorkWrapper(WorkWrapper&& Other)
-	{
-		*this = MOVE(Other);
-	}
+/*
+	WORK ARENA
 
-	void operator=(WorkWrapper&& Other)
-	{
-		//CHECK(Data == nullptr);
+	Work items are bump allocated from pages that belong to the thread making them, one after another.
+	A page counts the work items on it that haven't run yet and goes back to a free list when the count
+	drops to zero, whatever thread runs the last item. While its thread still allocates from it the count
+	is biased up by WORK_PAGE_OWNED instead, so allocating costs no atomics: the thread counts on its own
+	and takes off the bias less what it allocated when it moves on to the next page.
+	Work items that would take more than a quarter of a page are malloc'd on their own.
+	A work item that sits in a queue for long keeps its whole page alive, not the pages after it.
+*/
 
-		Data = Other.Data;
-		Other.Data = nullptr;
-	}
+#define WORK_PAGE_SIZE  (64 * 1024)
+#define WORK_LARGE_SIZE (WORK_PAGE_SIZE / 4)
+#define WORK_PAGE_OWNED (1ull << 32)
 
-	~WorkWrapper()
-	{
-		if (Data)
-		{
-			void* Callable = (void*)(uintptr_t(Data) + sizeof(WorkPreamble));
-			Data->Deleter(Callable);
-		}
-	}
+struct alignas(64) WorkPage
+{
+	std::atomic<u64> Live;
+	u64              Used;      // by the owning thread, from the start of the page
+	u64              Allocated; // by the owning thread
+};
 
-	void operator()()
-	{
-		CHECK(Data);
+struct WorkArenaStats
+{
+	u64 BytesInFlight;      // pages that aren't free plus big work items
+	u64 PeakBytesInFlight;
+	u64 Pages;              // allocated from the system, never given back
+	u64 FreePages;
+	u64 LargeItems;         // malloc'd so far
+};
 
-		void* Callable = (void*)(uintptr_t(Data) + sizeof(WorkPreamble));
-		Data->Executer(Callable);
-	}
+WorkPreamble* AllocateWork(u64 CallableSize);
+void FreeWork(WorkPreamble* Work);
+WorkArenaStats GetWorkArenaStats();
+
+/*
+	WORK QUEUES
+
+	Every dedicated thread owns a work stealing deque (Chase-Lev) and an injection queue.
+	The owner pushes and pops its deque at the bottom, newest first, while it's still in cache.
+	Other threads steal from the top, oldest first, which tends to be the biggest piece of a split.
+	Work enqueued to a thread from anywhere else goes through its injection queue: a bounded ring,
+	any number of producers, one consumer at a time. Whoever takes the consumer flag can drain it,
+	so work injected into a busy worker doesn't have to wait for that worker. A full ring never
+	blocks the producer, work goes to a locked overflow list instead and everything injected after
+	it follows it there until the consumer caught up, so work from one producer stays in order.
+	Items are WorkPreamble pointers with the callable right after the preamble, allocated from the
+	work arena (see WORK ARENA above) and given back to it once they ran, in whatever order that is.
+*/
+
+struct WorkDequeArray
+{
+	u64 Mask;
+	std::atomic<WorkPreamble*>* Slots;
 
-	WorkPreamble* Data;
+	explicit WorkDequeArray(u64 Capacity) : Mask(Capacity - 1), Slots(new std::atomic<WorkPreamble*>[Capacity]) {}
+	~WorkDequeArray() { delete[] Slots; }
 };
 
-struct WorkItem
+struct WorkStealingDeque
 {
-	WorkItem() : WorkDoneTicket(TicketCPU()), TicketValid(false) {}
-	WorkItem(WorkWrapper&& InWork, TicketCPU InWorkTicket = TicketCPU(), bool InTicketValid = false)
-		: Work(MOVE(InWork))
-		, WorkDoneTicket(InWorkTicket)
-		, TicketValid(InTicketValid)
-	{
-	}
+	alignas(64) std::atomic<i64>     Top{ 0 };
+	alignas(64) std::atomic<i64>     Bottom{ 0 };
+	std::atomic<WorkDequeArray*>     Array;
+	TArray<WorkDequeArray*>          Retired; // thieves can still be reading the arrays it outgrew, freed with the deque
+
+	WorkStealingDeque();
+	~WorkStealingDeque();
 
-	WorkWrapper Work;
-	TicketCPU   WorkDoneTicket;
-	bool        TicketValid;
+	void Push(WorkPreamble* Work);  // owner
+	WorkPreamble* Pop();            // owner
+	WorkPreamble* Steal();          // anyone, nullptr when empty or another thread was faster
+	bool Empty();
 };
 
-struct ExchangeQueue
+struct InjectionQueue
 {
-	TUniquePtr<std::atomic<TQueue<WorkItem>*>> Queue;
-	
-	ExchangeQueue() : Queue(new std::atomic<TQueue<WorkItem>*>(new TQueue<WorkItem>())) {}
-	ExchangeQueue(ExchangeQueue& Other) = delete;
-	ExchangeQueue(ExchangeQueue&& Other)
-	{
-		*this = MOVE(Other);
-	}
-	void operator=(ExchangeQueue&& Other)
-	{
-		Queue = MOVE(Other.Queue);
-	}
-	~ExchangeQueue()
+	static const u64 Capacity = 1024;
+
+	struct Slot
 	{
-		auto* Ptr = Queue->exchange(nullptr);
-		delete Ptr;
-	}
+		std::atomic<u64> Sequence;
+		WorkPreamble*    Work;
+	};
+
+	alignas(64) std::atomic<u64>  Tail{ 0 };
+	alignas(64) std::atomic<u64>  Head{ 0 };
+	std::atomic<bool>             Consuming{ false };
+	Slot                          Slots[Capacity];
 
-	TQueue<WorkItem>* Aquire();
-	void Release(TQueue<WorkItem>* Ptr);
+	alignas(64) std::atomic<u64>  OverflowCount{ 0 };
+	TracyLockable(Mutex, OverflowLock);
+	TDeque<WorkPreamble*>         Overflow;  // under OverflowLock
 
-	void Emplace(WorkWrapper&& Item, TicketCPU Ticket, bool TicketValid);
-	bool Pop(WorkItem& Result);
+	InjectionQueue();
+
+	void Push(WorkPreamble* Work);
+	bool PushToRing(WorkPreamble* Work);  // false when full
+	WorkPreamble* TryPop();               // nullptr when empty or someone else is consuming
 	bool Empty();
 };
 
-void ExecuteItem(WorkItem& Item);
+void ExecuteWork(WorkPreamble* Work);
+void PushWork(DedicatedThreadData* DedicatedThread, WorkPreamble* Work);
+
+/*
+	PARKING
+
+	Threads with nothing to do sleep on an EventCount until someone has something for them.
+	A thread about to sleep registers with PrepareWait, checks once more whatever it waits for
+	and only then Waits, so nothing that happens after the check is missed. Notify is a fence
+	and a load while nobody waits, cheap enough for every enqueue.
+	Workers all park on one EventCount, work for any of them can be stolen by any of them.
+	Threads waiting for a ticket park on the ticket's slot instead, see TICKETS.
+*/
+
+struct EventCount
+{
+	static const u64 WaiterMask = 0xffffffffull;
+	static const u64 EpochOne = 1ull << 32;
+
+	std::atomic<u64> State{ 0 }; // waiters in the low 32 bits, the epoch Notify bumps in the high ones
+
+	u64  PrepareWait();
+	void CancelWait();
+	void Wait(u64 Key);
+	bool Notify(bool All); // false when nobody was waiting
+};
 
 struct DedicatedThreadData
 {
-	bool ThreadShouldStop = false;
+	std::atomic<bool> ThreadShouldStop{ false };
 	bool ThreadShouldStealWork = true;
-	MovableMutex WakeUpLock;
-	TUniquePtr<std::condition_variable_any> WakeUp;
-	TUniquePtr<RingBufferGeneric>  CallableScratch;
-	ExchangeQueue WorkItems;
+	TUniquePtr<EventCount>         WakeUp;
+	TUniquePtr<WorkStealingDeque>  WorkItems;
+	TUniquePtr<InjectionQueue>     InjectedWork;
 	String ThreadName;
 	Thread ActualThread;
-	u64 SleepMicrosecondsWhenIdle;
 	ThreadID ThreadID;
 
 	DedicatedThreadData(DedicatedThreadData&& Other)
-		: ThreadShouldStop(Other.ThreadShouldStop)
+		: ThreadShouldStop(Other.ThreadShouldStop.load())
 		, ThreadShouldStealWork(Other.ThreadShouldStealWork)
-		, WakeUpLock(MOVE(Other.WakeUpLock))
 		, WakeUp(MOVE(Other.WakeUp))
-		, CallableScratch(MOVE(Other.CallableScratch))
 		, WorkItems(MOVE(Other.WorkItems))
+		, InjectedWork(MOVE(Other.InjectedWork))
 		, ThreadName(MOVE(Other.ThreadName))
 		, ActualThread(MOVE(Other.ActualThread))
-		, SleepMicrosecondsWhenIdle(Other.SleepMicrosecondsWhenIdle)
 		, ThreadID(Other.ThreadID)
 	{
 
@@ -140,19 +197,19 @@ struct DedicatedThreadData
 	DedicatedThreadData(DedicatedThreadData& Other) = delete;
 
 	DedicatedThreadData()
-		: WakeUp(new std::condition_variable_any())
-		, CallableScratch(new RingBufferGeneric(128_kb))
+		: WakeUp(new EventCount())
+		, WorkItems(new WorkStealingDeque())
+		, InjectedWork(new InjectionQueue())
 	{
-		SleepMicrosecondsWhenIdle = 80 + rand() % 40;
 	}
 };
 
+// Callable and preamble in one allocation, freed by ExecuteWork
 template <typename T>
-void EnqueueWork(DedicatedThreadData* DedicatedThread, T&& Work, TicketCPU Ticket = TicketCPU(), bool TicketValid = false)
+WorkPreamble* MakeWork(T&& Work, TicketCPU Ticket = TicketCPU(), bool TicketValid = false)
 {
-	void* Scratch = DedicatedThread->CallableScratch->Aquire(sizeof(WorkPreamble) + sizeof(T));
-
-	WorkPreamble* Preamble = (WorkPreamble*)Scratch;
+	static_assert(alignof(T) <= alignof(WorkPreamble), "Work items are only aligned to 16 bytes");
+	WorkPreamble* Preamble = AllocateWork(sizeof(T));
 	Preamble->Executer = [](void* Data) {
 		T& Callable = *(T*)Data;
 		Callable();
@@ -162,35 +219,70 @@ void EnqueueWork(DedicatedThreadData* DedicatedThread, T&& Work, TicketCPU Ticke
 		Callable->~T();
 	};
 
+	Preamble->WorkDoneTicket = Ticket;
+	Preamble->TicketValid = TicketValid;
+	Preamble->Next = nullptr;
+
 	T* Callable = (T*)(Preamble + 1);
 	new (Callable) T(MOVE(Work));
+	return Preamble;
+}
 
-	DedicatedThread->WorkItems.Emplace(WorkWrapper( Preamble ), Ticket, TicketValid);
-
-	DedicatedThread->WakeUp->notify_one();
+template <typename T>
+void EnqueueWork(DedicatedThreadData* DedicatedThread, T&& Work, TicketCPU Ticket = TicketCPU(), bool TicketValid = false)
+{
+	PushWork(DedicatedThread, MakeWork(MOVE(Work), Ticket, TicketValid));
 }
 
-using TicketType = decltype(TicketCPU().Value);
-const u64 NumBitsForTickets = std::numeric_limits<TicketType>::max() + 1;
-const u64 NumBitsInShared = 64;
+/*
+	TICKETS
 
-extern std::atomic<TicketType> gCurrentTicketId;
-extern std::array<std::atomic<u64>, NumBitsForTickets / NumBitsInShared> gSharedTickets;
+	A ticket is a completion slot and the generation the slot had when the ticket was made.
+	The slot counts down from however many things the ticket waits for, so one ticket joins any number
+	of work items. The last SignalTicket completes it: the generation moves on and every handle to it
+	reads as done, continuations go to the workers and the slot is reused.
+	Slots come in chunks that are never freed, so a handle can be checked however old it is.
+	Every slot is a cache line of its own, waiters on different tickets don't poll the same line.
+	Waiters park on the slot's WakeUps, the same PrepareWait, check, Wait pattern as an EventCount.
+	Only the last SignalTicket of a ticket with parked waiters notifies, and only them. Enqueues
+	that find no idle worker wake a single parked waiter instead, so there's a thread to run them.
+*/
+
+#define TICKET_CHUNK_SLOTS 4096
+#define TICKET_MAX_CHUNKS  4096
+
+struct alignas(64) TicketSlot
+{
+	std::atomic<u32>  Generation;
+	std::atomic<u32>  Pending;
+	std::atomic<u32>  NextFree;         // index + 1 of the next free slot, 0 ends the list
+	std::atomic<u32>  Waiters;          // parked on WakeUps
+	std::atomic<u32>  WakeUps;
+	std::atomic<bool> ContinuationLock;
+	WorkPreamble*     Continuations;    // under ContinuationLock
+};
+
+// Ticket that is pending until SignalTicket was called Count times, for work that completes
+// somewhere else than in a single work item (I/O, fan out to several workers)
+TicketCPU CreateTicket(u32 Count = 1);
+void SignalTicket(TicketCPU Ticket);
+bool WorkIsDone(TicketCPU WorkDoneTicket);
+void AttachContinuation(TicketCPU Ticket, WorkPreamble* Continuation);
 
 template <typename T>
 TicketCPU EnqueueWorkWithTicket(DedicatedThreadData* DedicatedThread, T&& Work)
 {
 	ZoneScoped;
-	TicketCPU Result { gCurrentTicketId.fetch_add(NumBitsInShared * 8 + 1, std::memory_order_relaxed)};
-
-	u64 Shift = Result.Value % NumBitsInShared;
-	u64 Mask = (1ULL << Shift);
-	u64 Test = gSharedTickets[Result.Value / NumBitsInShared].load(std::memory_order_acquire) & Mask;
-	CHECK(Test == 0, "Ticket bit already set");
-	gSharedTickets[Result.Value / NumBitsInShared].fetch_or(Mask, std::memory_order_release);
+	TicketCPU Result = CreateTicket();
 
 	EnqueueWork(DedicatedThread, MOVE(Work), Result, true);
 
 	return Result;
 }
 
+// Work goes to the workers once the ticket is done, right away when it's done already
+template <typename T>
+void EnqueueContinuation(TicketCPU Ticket, T&& Work)
+{
+	AttachContinuation(Ticket, MakeWork(MOVE(Work)));
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Common.h"
+#include "Containers/Array.h"
+#include "Containers/String.h"
+#include "Containers/StringView.h"
+#include "Containers/UniquePtr.h"
+#include "Threading/DedicatedThread.h"
+#include "Threading/Mutex.h"
+
+#include <atomic>
+#include <chrono>
+
+/*
+	JOB GRAPH
+
+	Jobs with explicit dependencies, a job goes to a worker as soon as every job it depends on has finished.
+	Jobs can add more jobs while they run, so a job that only finds out what there is to do (an import)
+	fans out into work items plus a job that depends on all of them and puts the results together.
+
+	Every job is timed. Following each job back to whatever held it up last, the dependency that finished
+	last or the job that added it, gives the critical path: the chain of jobs that decided the wall time.
+	A job that waits on something inside (ParallelFor) steals work meanwhile, stolen jobs count towards both.
+
+	Jobs can also wait for memory. A job with a MemoryCost only goes to a worker once the cost fits in the
+	graph's MemoryBudget next to everything reserved so far, in the order jobs became ready. The reservation
+	outlives the job, it's given back with ReleaseJobMemory by whatever is done with what the job made.
+	Nothing ever waits on an empty budget, so a job bigger than the whole budget still runs, on its own.
+	Jobs that hold memory mustn't depend on jobs that wait for it, or the graph can't make progress.
+*/
+
+using JobID = u32;
+
+const JobID InvalidJob = ~0u;
+
+struct Job
+{
+	String            Name;
+	WorkPreamble*     Work;         // from the work arena, freed once the job ran
+	TArray<JobID>     Dependencies;
+	TArray<Job*>      Dependents;   // waiting on this one, under the graph's lock
+	std::atomic<u32>  PendingCount; // unfinished dependencies, plus one while the job is being added
+	bool              Finished;
+	JobID             ID;
+	JobID             Spawner;      // job that was running when this one was added
+	u64               WorkerIndex;  // NumberOfWorkers() for threads that aren't workers
+	u64               MemoryCost;   // reserved when the job is sent to a worker
+	u64               AddedMicroseconds;
+	u64               StartMicroseconds;
+	u64               EndMicroseconds;
+};
+
+struct JobGraph
+{
+	MovableMutex                       Lock;
+	TArray<TUniquePtr<Job>>            Jobs;
+	std::atomic<u64>                   Unfinished{ 0 };
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+	// under Lock
+	u64                                MemoryBudget = UINT64_MAX;
+	u64                                MemoryInUse = 0;
+	u64                                MemoryPeak = 0;
+	TDeque<Job*>                       WaitingForMemory;
+};
+
+JobID AddJobWork(JobGraph& Graph, StringView Name, WorkPreamble* Work, const TArray<JobID>& Dependencies, u64 MemoryCost);
+
+template <typename T>
+JobID AddJob(JobGraph& Graph, StringView Name, T&& Work, const TArray<JobID>& Dependencies = {}, u64 MemoryCost = 0)
+{
+	return AddJobWork(Graph, Name, MakeWork(MOVE(Work)), Dependencies, MemoryCost);
+}
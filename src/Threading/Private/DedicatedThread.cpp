@@ -1,79 +1,447 @@
 #include "Threading/DedicatedThread.h"
 #include "Containers/Map.h"
 #include "Util/Util.h"
+#include "Util/Math.h"
 #include <unordered_set>
 #include <Util/Debug.h>
 #include <limits>
 
 #include <Threading/Private/Worker.Declarations.h>
 
-std::atomic<TicketType> gCurrentTicketId;
-std::array<std::atomic<u64>, NumBitsForTickets / NumBitsInShared> gSharedTickets;
+#include <immintrin.h>
+
+#define IDLE_SPIN_COUNT 64
+#define WAIT_SPIN_MIN 64
+#define WAIT_SPIN_MAX 8192
+
+
+static std::atomic<TicketSlot*> gTicketChunks[TICKET_MAX_CHUNKS];
+static u32 gTicketChunkCount;
+static TracyLockable(Mutex, gTicketChunkLock);
+// top of the free slot list, index + 1 in the low 32 bits, a tag against ABA in the high ones
+static std::atomic<u64> gFreeTicketSlots;
+// slots someone is parked on, one entry per waiter
+static TracyLockable(Mutex, gParkedTicketsLock);
+static TArray<u32> gParkedTickets;
+static std::atomic<u32> gParkedTicketCount;
+
+static TracyLockable(Mutex, gWorkPageLock);
+static TArray<WorkPage*> gFreeWorkPages; // under gWorkPageLock
+static u64 gWorkPages;                   // under gWorkPageLock
+static std::atomic<u64> gWorkPagesInUse;
+static std::atomic<u64> gLargeWorkBytes;
+static std::atomic<u64> gLargeWorkItems;
+static std::atomic<u64> gPeakWorkBytes;
 
 namespace {
+	// Page the thread allocates work from, given up when the thread exits
+	struct WorkPageOwner
+	{
+		WorkPage* Current = nullptr;
+		~WorkPageOwner();
+	};
+	thread_local WorkPageOwner tWorkPage;
+
+	void NoteWorkBytesInFlight()
+	{
+		u64 Bytes = gWorkPagesInUse.load(std::memory_order_relaxed) * WORK_PAGE_SIZE + gLargeWorkBytes.load(std::memory_order_relaxed);
+		u64 Peak = gPeakWorkBytes.load(std::memory_order_relaxed);
+		while (Bytes > Peak && !gPeakWorkBytes.compare_exchange_weak(Peak, Bytes, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	void ReleaseWorkPage(WorkPage* Page, u64 Count)
+	{
+		// acq_rel, whoever reuses the page writes over work items others just finished with
+		if (Page->Live.fetch_sub(Count, std::memory_order_acq_rel) != Count)
+		{
+			return;
+		}
+		ScopedLock AutoLock(gWorkPageLock);
+		gFreeWorkPages.push_back(Page);
+		gWorkPagesInUse.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	WorkPage* TakeWorkPage()
+	{
+		WorkPage* Page = nullptr;
+		{
+			ScopedLock AutoLock(gWorkPageLock);
+			if (!gFreeWorkPages.empty())
+			{
+				Page = gFreeWorkPages.back();
+				gFreeWorkPages.pop_back();
+			}
+			else
+			{
+				gWorkPages += 1;
+			}
+		}
+		if (Page == nullptr)
+		{
+			Page = (WorkPage*)::operator new(WORK_PAGE_SIZE, std::align_val_t(alignof(WorkPage)));
+			new (Page) WorkPage();
+		}
+		Page->Live.store(WORK_PAGE_OWNED, std::memory_order_relaxed);
+		Page->Used = AlignUp(sizeof(WorkPage), alignof(WorkPreamble));
+		Page->Allocated = 0;
+		gWorkPagesInUse.fetch_add(1, std::memory_order_relaxed);
+		NoteWorkBytesInFlight();
+		return Page;
+	}
+
+	// Done allocating from the page, the work items on it can still be pending
+	void RetireWorkPage(WorkPage* Page)
+	{
+		ReleaseWorkPage(Page, WORK_PAGE_OWNED - Page->Allocated);
+	}
+
+	WorkPageOwner::~WorkPageOwner()
+	{
+		if (Current)
+		{
+			RetireWorkPage(Current);
+		}
+	}
+
+	// DedicatedThreadData of the running thread, nullptr for threads that don't have one
+	thread_local DedicatedThreadData* tCurrentThread = nullptr;
+
+	// Own deque first, newest work first, then whatever was injected
+	WorkPreamble* PopWork(DedicatedThreadData* DedicatedThread)
+	{
+		if (tCurrentThread == DedicatedThread)
+		{
+			if (WorkPreamble* Work = DedicatedThread->WorkItems->Pop())
+			{
+				return Work;
+			}
+		}
+		return DedicatedThread->InjectedWork->TryPop();
+	}
+
+	bool HasWorkToTake(DedicatedThreadData* DedicatedThread)
+	{
+		return HasWork(DedicatedThread) || (DedicatedThread->ThreadShouldStealWork && AnyWorkerHasWork());
+	}
+
+	// Runs one item, its own or stolen. With nothing around the thread spins for a moment,
+	// work often comes right behind the last item, then parks until there's some
 	void PopAndExecute(DedicatedThreadData *DedicatedThread)
 	{
+		if (WorkPreamble* Work = PopWork(DedicatedThread))
+		{
+			ExecuteWork(Work);
+			return;
+		}
+		if (DedicatedThread->ThreadShouldStealWork && StealWork())
+		{
+			return;
+		}
+
+		for (u32 i = 0; i < IDLE_SPIN_COUNT; ++i)
+		{
+			_mm_pause();
+			if (HasWorkToTake(DedicatedThread))
+			{
+				return;
+			}
+		}
+
+		EventCount& WakeUp = GetWakeUpEvent(DedicatedThread);
+		u64 Key = WakeUp.PrepareWait();
+		if (DedicatedThread->ThreadShouldStop.load(std::memory_order_relaxed) || HasWorkToTake(DedicatedThread))
+		{
+			WakeUp.CancelWait();
+			return;
+		}
+
+		ZoneScopedN("Parked");
+		WakeUp.Wait(Key);
+	}
+
+	TicketSlot& GetTicketSlot(u32 Index)
+	{
+		return gTicketChunks[Index / TICKET_CHUNK_SLOTS].load(std::memory_order_acquire)[Index % TICKET_CHUNK_SLOTS];
+	}
+
+	// Slots First to Last are linked already
+	void PushFreeTicketSlots(u32 First, u32 Last)
+	{
+		u64 Top = gFreeTicketSlots.load(std::memory_order_relaxed);
 		while (true)
 		{
-			UniqueMovableLock Lock(DedicatedThread->WakeUpLock);
-			bool HasWork = DedicatedThread->WakeUp->wait_for(Lock, std::chrono::microseconds(DedicatedThread->SleepMicrosecondsWhenIdle),
-				[DedicatedThread]() {
-					return DedicatedThread->ThreadShouldStop || !DedicatedThread->WorkItems.Empty();
-				}
-			);
+			GetTicketSlot(Last).NextFree.store(u32(Top), std::memory_order_relaxed);
+			u64 NewTop = ((Top >> 32) + 1) << 32 | (First + 1);
+			if (gFreeTicketSlots.compare_exchange_weak(Top, NewTop, std::memory_order_release, std::memory_order_relaxed))
+			{
+				return;
+			}
+		}
+	}
+
+	void AddTicketChunk()
+	{
+		ScopedLock AutoLock(gTicketChunkLock);
+		if (u32(gFreeTicketSlots.load(std::memory_order_acquire)) != 0)
+		{
+			return;
+		}
+		CHECK(gTicketChunkCount < TICKET_MAX_CHUNKS, "Too many tickets pending at once");
+
+		u32 First = gTicketChunkCount * TICKET_CHUNK_SLOTS;
+		TicketSlot* Chunk = new TicketSlot[TICKET_CHUNK_SLOTS];
+		for (u32 i = 0; i < TICKET_CHUNK_SLOTS; ++i)
+		{
+			Chunk[i].Generation.store(1, std::memory_order_relaxed);
+			Chunk[i].Pending.store(0, std::memory_order_relaxed);
+			Chunk[i].NextFree.store(i + 1 < TICKET_CHUNK_SLOTS ? First + i + 2 : 0, std::memory_order_relaxed);
+			Chunk[i].Waiters.store(0, std::memory_order_relaxed);
+			Chunk[i].WakeUps.store(0, std::memory_order_relaxed);
+			Chunk[i].ContinuationLock.store(false, std::memory_order_relaxed);
+			Chunk[i].Continuations = nullptr;
+		}
+		gTicketChunks[gTicketChunkCount].store(Chunk, std::memory_order_release);
+		gTicketChunkCount += 1;
 
-			if (DedicatedThread->ThreadShouldStop || HasWork)
+		PushFreeTicketSlots(First, First + TICKET_CHUNK_SLOTS - 1);
+	}
+
+	u32 PopFreeTicketSlot()
+	{
+		u64 Top = gFreeTicketSlots.load(std::memory_order_acquire);
+		while (true)
+		{
+			if (u32(Top) == 0)
+			{
+				AddTicketChunk();
+				Top = gFreeTicketSlots.load(std::memory_order_acquire);
+				continue;
+			}
+			// can be stale when someone else pops first, the tag makes the exchange fail then
+			u32 Next = GetTicketSlot(u32(Top) - 1).NextFree.load(std::memory_order_relaxed);
+			u64 NewTop = ((Top >> 32) + 1) << 32 | Next;
+			if (gFreeTicketSlots.compare_exchange_weak(Top, NewTop, std::memory_order_acquire, std::memory_order_acquire))
 			{
-				break;
+				return u32(Top) - 1;
 			}
+		}
+	}
+
+	void LockContinuations(TicketSlot& Slot)
+	{
+		while (Slot.ContinuationLock.exchange(true, std::memory_order_acquire))
+		{
+			_mm_pause();
+		}
+	}
+
+	void UnlockContinuations(TicketSlot& Slot)
+	{
+		Slot.ContinuationLock.store(false, std::memory_order_release);
+	}
+
+	// Same as EventCount::PrepareWait, either the waiter sees the ticket done or whoever completes it sees the waiter
+	void ParkOnTicket(TicketSlot& Slot, u32 Index)
+	{
+		{
+			ScopedLock AutoLock(gParkedTicketsLock);
+			gParkedTickets.push_back(Index);
+		}
+		Slot.Waiters.fetch_add(1, std::memory_order_seq_cst);
+		gParkedTicketCount.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	void UnparkFromTicket(TicketSlot& Slot, u32 Index)
+	{
+		gParkedTicketCount.fetch_sub(1, std::memory_order_relaxed);
+		Slot.Waiters.fetch_sub(1, std::memory_order_relaxed);
+		ScopedLock AutoLock(gParkedTicketsLock);
+		gParkedTickets.erase_unsorted(eastl::find(gParkedTickets.begin(), gParkedTickets.end(), Index));
+	}
 
-			if (DedicatedThread->ThreadShouldStealWork)
+	void WakeTicketWaiters(TicketSlot& Slot, bool All)
+	{
+		Slot.WakeUps.fetch_add(1, std::memory_order_release);
+		if (All)
+		{
+			Slot.WakeUps.notify_all();
+		}
+		else
+		{
+			Slot.WakeUps.notify_one();
+		}
+	}
+
+	// Work went to the workers and none of them was idle, a thread parked on a ticket comes to help.
+	// Otherwise the work could sit there while every worker waits for something that needs it.
+	void WakeTicketWaiterToHelp()
+	{
+		// the caller's Notify fenced already, pairs with ParkOnTicket
+		if (gParkedTicketCount.load(std::memory_order_relaxed) == 0)
+		{
+			return;
+		}
+		u32 Index = 0;
+		{
+			ScopedLock AutoLock(gParkedTicketsLock);
+			if (gParkedTickets.empty())
 			{
-				StealWork();
+				return;
 			}
+			Index = gParkedTickets.back();
 		}
+		WakeTicketWaiters(GetTicketSlot(Index), false);
+	}
 
-		WorkItem Item;
-		bool HasWork = DedicatedThread->WorkItems.Pop(Item);
-		if (HasWork)
+	void EnqueueContinuationWork(WorkPreamble* Work)
+	{
+		if (NumberOfWorkers() == 0)
 		{
-			ExecuteItem(Item);
+			ExecuteWork(Work);
+			return;
 		}
+		PushWork(GetWorkerForNewWork(), Work);
 	}
 
 	void DedicatedThreadProc(DedicatedThreadData* DedicatedThread)
 	{
 		tracy::SetThreadName(DedicatedThread->ThreadName.c_str());
+		tCurrentThread = DedicatedThread;
 		while (!DedicatedThread->ThreadShouldStop)
 		{
 			PopAndExecute(DedicatedThread);
 		}
+		tCurrentThread = nullptr;
+	}
+}
+
+bool HasWork(DedicatedThreadData* DedicatedThread)
+{
+	return !DedicatedThread->WorkItems->Empty() || !DedicatedThread->InjectedWork->Empty();
+}
+
+DedicatedThreadData* GetCurrentDedicatedThread()
+{
+	return tCurrentThread;
+}
+
+// Room for a preamble and CallableSize bytes after it, Page and Bytes are filled in
+WorkPreamble* AllocateWork(u64 CallableSize)
+{
+	u64 Bytes = AlignUp(sizeof(WorkPreamble) + CallableSize, alignof(WorkPreamble));
+	WorkPreamble* Work = nullptr;
+	if (Bytes > WORK_LARGE_SIZE)
+	{
+		CHECK(Bytes <= UINT32_MAX, "Work item is too big");
+		Work = (WorkPreamble*)malloc(Bytes);
+		Work->Page = nullptr;
+		gLargeWorkBytes.fetch_add(Bytes, std::memory_order_relaxed);
+		gLargeWorkItems.fetch_add(1, std::memory_order_relaxed);
+		NoteWorkBytesInFlight();
+	}
+	else
+	{
+		WorkPage*& Page = tWorkPage.Current;
+		if (Page == nullptr || Page->Used + Bytes > WORK_PAGE_SIZE)
+		{
+			if (Page)
+			{
+				RetireWorkPage(Page);
+			}
+			Page = TakeWorkPage();
+		}
+		Work = (WorkPreamble*)((u8*)Page + Page->Used);
+		Work->Page = Page;
+		Page->Used += Bytes;
+		Page->Allocated += 1;
+	}
+	Work->Bytes = u32(Bytes);
+	return Work;
+}
+
+// Whatever thread finishes the work item, the callable is destroyed already
+void FreeWork(WorkPreamble* Work)
+{
+	if (Work->Page)
+	{
+		ReleaseWorkPage(Work->Page, 1);
+		return;
 	}
+	gLargeWorkBytes.fetch_sub(Work->Bytes, std::memory_order_relaxed);
+	free(Work);
 }
-void ExecuteItem(WorkItem& Item)
+
+WorkArenaStats GetWorkArenaStats()
 {
+	WorkArenaStats Result = {};
+	{
+		ScopedLock AutoLock(gWorkPageLock);
+		Result.Pages = gWorkPages;
+		Result.FreePages = gFreeWorkPages.size();
+	}
+	Result.BytesInFlight = gWorkPagesInUse.load(std::memory_order_relaxed) * WORK_PAGE_SIZE + gLargeWorkBytes.load(std::memory_order_relaxed);
+	Result.PeakBytesInFlight = gPeakWorkBytes.load(std::memory_order_relaxed);
+	Result.LargeItems = gLargeWorkItems.load(std::memory_order_relaxed);
+	return Result;
+}
+
+void ExecuteWork(WorkPreamble* Work)
+{
+	void* Callable = Work + 1;
+	TicketCPU WorkDoneTicket = Work->WorkDoneTicket;
+	bool TicketValid = Work->TicketValid;
 	{
 		ZoneScopedN("Threaded work item");
-		Item.Work();
+		Work->Executer(Callable);
+		Work->Deleter(Callable);
 	}
+	FreeWork(Work);
 
-	if (Item.TicketValid)
+	if (TicketValid)
 	{
-		u64 TicketID = Item.WorkDoneTicket.Value;
-		u64 Shift = TicketID % NumBitsInShared;
-		u64 Mask = (1ULL << Shift);
+		SignalTicket(WorkDoneTicket);
+	}
+}
 
-		u64 Test = (gSharedTickets[TicketID / NumBitsInShared].load(std::memory_order_acquire) & Mask);
-		CHECK(Test == Mask, "Ticket already cleared?!");
+// The owner pushes to its own deque, everyone else injects. A full injection queue is drained by
+// the producer itself when it's a worker, otherwise it waits for the consumer to catch up.
+// When no idle worker is there to take it, threads waiting on tickets wake up to help.
+void PushWork(DedicatedThreadData* DedicatedThread, WorkPreamble* Work)
+{
+	if (tCurrentThread == DedicatedThread)
+	{
+		DedicatedThread->WorkItems->Push(Work);
+	}
+	else
+	{
+		DedicatedThread->InjectedWork->Push(Work);
+	}
+	if (!GetWakeUpEvent(DedicatedThread).Notify(false) && IsWorker(DedicatedThread))
+	{
+		WakeTicketWaiterToHelp();
+	}
+}
 
-		gSharedTickets[TicketID / NumBitsInShared].fetch_and(~(Mask), std::memory_order_release);
+// Work the thread took from its own queues or stole, nullptr when there was nothing to take
+WorkPreamble* TakeWork(DedicatedThreadData* DedicatedThread)
+{
+	if (tCurrentThread == DedicatedThread)
+	{
+		return PopWork(DedicatedThread);
 	}
+	if (WorkPreamble* Work = DedicatedThread->WorkItems->Steal())
+	{
+		return Work;
+	}
+	return DedicatedThread->InjectedWork->TryPop();
 }
 
 void StartDedicatedThread(DedicatedThreadData* DedicatedThread, const String& ThreadName, u64 AffinityMask)
 {
 	DedicatedThread->ThreadName = ThreadName;
-	LockableName(DedicatedThread->WakeUpLock.Ptr->Lock, ThreadName.c_str(), ThreadName.size());
 
 	DedicatedThread->ActualThread = Thread(DedicatedThreadProc, DedicatedThread);
 	DedicatedThread->ThreadID = DedicatedThread->ActualThread.get_id();
@@ -85,87 +453,348 @@ void StartDedicatedThread(DedicatedThreadData* DedicatedThread, const String& Th
 void StopDedicatedThread(DedicatedThreadData* DedicatedThread)
 {
 	DedicatedThread->ThreadShouldStop = true;
-	DedicatedThread->WakeUp->notify_one();
+	GetWakeUpEvent(DedicatedThread).Notify(true);
 	if (DedicatedThread->ActualThread.joinable())
 		DedicatedThread->ActualThread.join();
 }
 
+TicketCPU CreateTicket(u32 Count)
+{
+	CHECK(Count != 0, "Tickets wait for at least one thing");
+	u32 Index = PopFreeTicketSlot();
+	TicketSlot& Slot = GetTicketSlot(Index);
+	// release, whoever sees the count also sees the generation that came with it
+	Slot.Pending.store(Count, std::memory_order_release);
+	return TicketCPU{ Index, Slot.Generation.load(std::memory_order_relaxed) };
+}
+
+void SignalTicket(TicketCPU Ticket)
+{
+	TicketSlot& Slot = GetTicketSlot(Ticket.Index);
+	CHECK(Slot.Generation.load(std::memory_order_relaxed) == Ticket.Generation, "Ticket is done already");
+
+	u32 Before = Slot.Pending.fetch_sub(1, std::memory_order_acq_rel);
+	CHECK(Before != 0, "Ticket signaled more times than it waits for");
+	if (Before != 1)
+	{
+		return;
+	}
+
+	LockContinuations(Slot);
+	WorkPreamble* Continuations = Slot.Continuations;
+	Slot.Continuations = nullptr;
+	u32 NextGeneration = Ticket.Generation + 1;
+	Slot.Generation.store(NextGeneration ? NextGeneration : 1, std::memory_order_release);
+	UnlockContinuations(Slot);
+
+	// pairs with ParkOnTicket
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (Slot.Waiters.load(std::memory_order_relaxed) != 0)
+	{
+		WakeTicketWaiters(Slot, true);
+	}
+	PushFreeTicketSlots(Ticket.Index, Ticket.Index);
+
+	while (Continuations)
+	{
+		WorkPreamble* Next = Continuations->Next;
+		EnqueueContinuationWork(Continuations);
+		Continuations = Next;
+	}
+}
+
 bool WorkIsDone(TicketCPU WorkDoneTicket)
 {
-	u64 Shift = WorkDoneTicket.Value % NumBitsInShared;
-	u64 Mask = (1ULL << Shift);
-	return (gSharedTickets[WorkDoneTicket.Value / NumBitsInShared].load(std::memory_order_relaxed) & Mask) == 0;
+	if (WorkDoneTicket.Generation == 0)
+	{
+		return true;
+	}
+	TicketSlot& Slot = GetTicketSlot(WorkDoneTicket.Index);
+	if (Slot.Generation.load(std::memory_order_acquire) != WorkDoneTicket.Generation)
+	{
+		return true;
+	}
+	// a count that belongs to the slot's next ticket comes with a new generation
+	u32 Pending = Slot.Pending.load(std::memory_order_acquire);
+	return Pending == 0 || Slot.Generation.load(std::memory_order_acquire) != WorkDoneTicket.Generation;
 }
 
+void AttachContinuation(TicketCPU Ticket, WorkPreamble* Continuation)
+{
+	if (Ticket.Generation != 0)
+	{
+		TicketSlot& Slot = GetTicketSlot(Ticket.Index);
+		LockContinuations(Slot);
+		if (Slot.Generation.load(std::memory_order_relaxed) == Ticket.Generation)
+		{
+			Continuation->Next = Slot.Continuations;
+			Slot.Continuations = Continuation;
+			UnlockContinuations(Slot);
+			return;
+		}
+		UnlockContinuations(Slot);
+	}
+	EnqueueContinuationWork(Continuation);
+}
+
+// Helps with whatever work there is while the ticket is pending. With nothing to help with it spins,
+// then parks until a ticket is signaled or work shows up. Spins get longer while they pay off.
 void WaitForCompletion(TicketCPU WorkDoneTicket)
 {
+	thread_local u32 tSpinCount = WAIT_SPIN_MIN;
 	while (!WorkIsDone(WorkDoneTicket))
 	{
-		if (!StealWork())
+		if (StealWork())
+		{
+			continue;
+		}
+
+		bool Done = false;
+		for (u32 i = 0; i < tSpinCount && !Done; ++i)
+		{
+			_mm_pause();
+			Done = WorkIsDone(WorkDoneTicket);
+		}
+		if (Done)
+		{
+			tSpinCount = eastl::min<u32>(tSpinCount * 2, WAIT_SPIN_MAX);
+			break;
+		}
+
+		TicketSlot& Slot = GetTicketSlot(WorkDoneTicket.Index);
+		u32 Key = Slot.WakeUps.load(std::memory_order_acquire);
+		ParkOnTicket(Slot, WorkDoneTicket.Index);
+		if (!WorkIsDone(WorkDoneTicket) && !AnyWorkerHasWork())
 		{
-			//std::this_thread::sleep_for(std::chrono::microseconds(10));
+			ZoneScopedN("Parked on ticket");
+			Slot.WakeUps.wait(Key, std::memory_order_acquire);
 		}
+		UnparkFromTicket(Slot, WorkDoneTicket.Index);
+		tSpinCount = eastl::max<u32>(tSpinCount / 2, WAIT_SPIN_MIN);
 	}
 }
 
 void   ExecutePendingWork(DedicatedThreadData* DedicatedThread)
 {
-	WorkItem Item;
-	while(DedicatedThread->WorkItems.Pop(Item))
+	while (WorkPreamble* Work = PopWork(DedicatedThread))
 	{
-		ExecuteItem(Item);
+		ExecuteWork(Work);
 	}
 }
 
-TQueue<WorkItem>* ExchangeQueue::Aquire()
+WorkStealingDeque::WorkStealingDeque()
+	: Array(new WorkDequeArray(256))
+{
+}
+
+WorkStealingDeque::~WorkStealingDeque()
 {
-	TQueue<WorkItem>* Q = nullptr;
-	while (Q == nullptr)
+	delete Array.load(std::memory_order_relaxed);
+	for (WorkDequeArray* Old : Retired)
 	{
-		Q = Queue->exchange(nullptr, std::memory_order_acquire);
+		delete Old;
 	}
-	return Q;
 }
 
-void ExchangeQueue::Release(TQueue<WorkItem>* Q)
+// Based on "Correct and Efficient Work-Stealing for Weak Memory Models", Le et al. 2013
+void WorkStealingDeque::Push(WorkPreamble* Work)
 {
-	Queue->store(Q, std::memory_order_release);
+	i64 B = Bottom.load(std::memory_order_relaxed);
+	i64 T = Top.load(std::memory_order_acquire);
+	WorkDequeArray* A = Array.load(std::memory_order_relaxed);
+	if (B - T > i64(A->Mask))
+	{
+		WorkDequeArray* Bigger = new WorkDequeArray((A->Mask + 1) * 2);
+		for (i64 i = T; i < B; ++i)
+		{
+			Bigger->Slots[i & Bigger->Mask].store(A->Slots[i & A->Mask].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+		Retired.push_back(A);
+		Array.store(Bigger, std::memory_order_release);
+		A = Bigger;
+	}
+	A->Slots[B & A->Mask].store(Work, std::memory_order_relaxed);
+	Bottom.store(B + 1, std::memory_order_release);
 }
 
-void ExchangeQueue::Emplace(WorkWrapper&& Item, TicketCPU Ticket, bool TicketValid)
+WorkPreamble* WorkStealingDeque::Pop()
 {
-	auto* Q = Aquire();
-	Q->emplace(MOVE(Item), Ticket, TicketValid);
-	Release(Q);
+	i64 B = Bottom.load(std::memory_order_relaxed) - 1;
+	WorkDequeArray* A = Array.load(std::memory_order_relaxed);
+	Bottom.store(B, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	i64 T = Top.load(std::memory_order_relaxed);
+
+	if (T > B)
+	{
+		Bottom.store(B + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	WorkPreamble* Result = A->Slots[B & A->Mask].load(std::memory_order_relaxed);
+	if (T == B)
+	{
+		// last one, thieves might be after it too
+		if (!Top.compare_exchange_strong(T, T + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			Result = nullptr;
+		}
+		Bottom.store(B + 1, std::memory_order_relaxed);
+	}
+	return Result;
 }
 
-bool ExchangeQueue::Pop(WorkItem& Result)
+WorkPreamble* WorkStealingDeque::Steal()
 {
-	if (auto* Q = Queue->exchange(nullptr, std::memory_order_relaxed))
+	i64 T = Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	i64 B = Bottom.load(std::memory_order_acquire);
+	if (T >= B)
+	{
+		return nullptr;
+	}
+
+	WorkDequeArray* A = Array.load(std::memory_order_acquire);
+	WorkPreamble* Result = A->Slots[T & A->Mask].load(std::memory_order_relaxed);
+	if (!Top.compare_exchange_strong(T, T + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
 	{
-		if (Q->empty())
+		return nullptr;
+	}
+	return Result;
+}
+
+bool WorkStealingDeque::Empty()
+{
+	return Top.load(std::memory_order_relaxed) >= Bottom.load(std::memory_order_relaxed);
+}
+
+// Bounded queue from Dmitry Vyukov, every slot knows which lap of the ring it's ready for
+InjectionQueue::InjectionQueue()
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity has to be a power of two");
+	for (u64 i = 0; i < Capacity; ++i)
+	{
+		Slots[i].Sequence.store(i, std::memory_order_relaxed);
+		Slots[i].Work = nullptr;
+	}
+}
+
+// Never waits for the consumer, the thread it injects into may well be waiting for this one
+void InjectionQueue::Push(WorkPreamble* Work)
+{
+	// once something overflowed, whatever comes after it goes after it
+	if (OverflowCount.load(std::memory_order_acquire) == 0 && PushToRing(Work))
+	{
+		return;
+	}
+	ZoneScopedN("Injection queue overflow");
+	ScopedLock AutoLock(OverflowLock);
+	Overflow.push_back(Work);
+	OverflowCount.fetch_add(1, std::memory_order_release);
+}
+
+bool InjectionQueue::PushToRing(WorkPreamble* Work)
+{
+	u64 Position = Tail.load(std::memory_order_relaxed);
+	while (true)
+	{
+		Slot& Target = Slots[Position & (Capacity - 1)];
+		i64 Difference = i64(Target.Sequence.load(std::memory_order_acquire)) - i64(Position);
+		if (Difference == 0)
+		{
+			if (Tail.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed))
+			{
+				Target.Work = Work;
+				Target.Sequence.store(Position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (Difference < 0)
 		{
-			Release(Q);
 			return false;
 		}
-		Result = MOVE(Q->front());
-		Q->pop();
-		Release(Q);
-		return true;
+		else
+		{
+			Position = Tail.load(std::memory_order_relaxed);
+		}
 	}
-	return false;
 }
 
-bool ExchangeQueue::Empty()
+WorkPreamble* InjectionQueue::TryPop()
 {
-	if (TQueue<WorkItem>* Q = Queue->load(std::memory_order_relaxed))
+	if (Empty() || Consuming.exchange(true, std::memory_order_acquire))
 	{
-		return Q->empty();
+		return nullptr;
 	}
 
-	TQueue<WorkItem>* Q = Aquire();
-	bool Result = Q->empty();
-	Release(Q);
+	WorkPreamble* Result = nullptr;
+	u64 Position = Head.load(std::memory_order_relaxed);
+	Slot& Source = Slots[Position & (Capacity - 1)];
+	if (Source.Sequence.load(std::memory_order_acquire) == Position + 1)
+	{
+		Result = Source.Work;
+		Source.Sequence.store(Position + Capacity, std::memory_order_release);
+		Head.store(Position + 1, std::memory_order_relaxed);
+	}
+	// the ring goes first, everything in it was pushed before the overflow started
+	else if (OverflowCount.load(std::memory_order_acquire) != 0)
+	{
+		ScopedLock AutoLock(OverflowLock);
+		Result = Overflow.front();
+		Overflow.pop_front();
+		OverflowCount.fetch_sub(1, std::memory_order_release);
+	}
+
+	Consuming.store(false, std::memory_order_release);
 	return Result;
 }
 
+// Racy by nature, good enough to decide whether to look closer
+bool InjectionQueue::Empty()
+{
+	u64 Position = Head.load(std::memory_order_relaxed);
+	return Slots[Position & (Capacity - 1)].Sequence.load(std::memory_order_relaxed) != Position + 1
+		&& OverflowCount.load(std::memory_order_relaxed) == 0;
+}
+
+u64 EventCount::PrepareWait()
+{
+	return State.fetch_add(1, std::memory_order_seq_cst);
+}
+
+void EventCount::CancelWait()
+{
+	State.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+// Returns once anyone notified after the PrepareWait that gave the key, maybe right away
+void EventCount::Wait(u64 Key)
+{
+	u64 Current = State.load(std::memory_order_acquire);
+	while ((Current & ~WaiterMask) == (Key & ~WaiterMask))
+	{
+		State.wait(Current, std::memory_order_acquire);
+		Current = State.load(std::memory_order_acquire);
+	}
+	State.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+bool EventCount::Notify(bool All)
+{
+	// pairs with PrepareWait, either the waiter sees what changed before this or this sees the waiter
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if ((State.load(std::memory_order_relaxed) & WaiterMask) == 0)
+	{
+		return false;
+	}
+	State.fetch_add(EpochOne, std::memory_order_seq_cst);
+	if (All)
+	{
+		State.notify_all();
+	}
+	else
+	{
+		State.notify_one();
+	}
+	return true;
+}
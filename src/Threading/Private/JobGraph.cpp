@@ -0,0 +1,302 @@
+#include "Threading/JobGraph.generated.h"
+#include "Threading/Worker.h"
+#include "Threading/Private/Worker.Declarations.h"
+#include "Util/Debug.h"
+#include "Util/Util.h"
+
+#include <EASTL/algorithm.h>
+#include <EASTL/sort.h>
+#include <stdio.h>
+#include <thread>
+#include <tracy/Tracy.hpp>
+
+static EventCount gJobGraphFinished; // threads in WaitForJobGraph park here
+
+namespace
+{
+	thread_local JobGraph* tCurrentGraph = nullptr;
+	thread_local Job*      tCurrentJob = nullptr;
+
+	u64 GetJobGraphMicroseconds(const JobGraph& Graph)
+	{
+		return (u64)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Graph.Start).count();
+	}
+
+	void ExecuteJob(JobGraph& Graph, Job* Current);
+
+	void StartJob(JobGraph& Graph, Job* Ready)
+	{
+		EnqueueToWorker([&Graph, Ready]() { ExecuteJob(Graph, Ready); });
+	}
+
+	// Under the graph's lock. Jobs that waited longer go first, an empty budget takes anything.
+	bool TryReserveJobMemory(JobGraph& Graph, u64 Bytes)
+	{
+		if (Graph.MemoryInUse != 0 && Bytes > Graph.MemoryBudget - eastl::min(Graph.MemoryInUse, Graph.MemoryBudget))
+		{
+			return false;
+		}
+		Graph.MemoryInUse += Bytes;
+		Graph.MemoryPeak = eastl::max(Graph.MemoryPeak, Graph.MemoryInUse);
+		return true;
+	}
+
+	// Drops one of the things the job waits on, the last one sends it to a worker or in line for memory
+	void ReleaseJob(JobGraph& Graph, Job* Waiting)
+	{
+		if (Waiting->PendingCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		{
+			return;
+		}
+
+		if (Waiting->MemoryCost != 0)
+		{
+			ScopedMovableLock AutoLock(Graph.Lock);
+			if (!Graph.WaitingForMemory.empty() || !TryReserveJobMemory(Graph, Waiting->MemoryCost))
+			{
+				Graph.WaitingForMemory.push_back(Waiting);
+				return;
+			}
+		}
+		StartJob(Graph, Waiting);
+	}
+
+	void ExecuteJob(JobGraph& Graph, Job* Current)
+	{
+		ZoneScopedN("Job");
+		ZoneText(Current->Name.c_str(), Current->Name.size());
+
+		JobGraph* OuterGraph = tCurrentGraph;
+		Job* OuterJob = tCurrentJob;
+		tCurrentGraph = &Graph;
+		tCurrentJob = Current;
+
+		Current->WorkerIndex = GetCurrentWorkerIndex();
+		Current->StartMicroseconds = GetJobGraphMicroseconds(Graph);
+		// whatever the job captured can be big, it doesn't have to live as long as the graph
+		ExecuteWork(Current->Work);
+		Current->Work = nullptr;
+		Current->EndMicroseconds = GetJobGraphMicroseconds(Graph);
+
+		tCurrentGraph = OuterGraph;
+		tCurrentJob = OuterJob;
+
+		TArray<Job*> Dependents;
+		{
+			ScopedMovableLock AutoLock(Graph.Lock);
+			Current->Finished = true;
+			Dependents = MOVE(Current->Dependents);
+		}
+		for (Job* Dependent : Dependents)
+		{
+			ReleaseJob(Graph, Dependent);
+		}
+
+		// dependents are counted already, so the graph can't look finished before they run
+		if (Graph.Unfinished.fetch_sub(1, std::memory_order_release) == 1)
+		{
+			gJobGraphFinished.Notify(true);
+		}
+	}
+
+	// Whatever the job had to wait for last: the dependency that finished last,
+	// or the job that added it when that happened later
+	JobID FindCriticalPredecessor(const JobGraph& Graph, const Job& Current)
+	{
+		JobID Result = InvalidJob;
+		u64 Latest = 0;
+		for (JobID Dependency : Current.Dependencies)
+		{
+			const Job& Before = *Graph.Jobs[Dependency];
+			if (Result == InvalidJob || Before.EndMicroseconds > Latest)
+			{
+				Result = Dependency;
+				Latest = Before.EndMicroseconds;
+			}
+		}
+		if (Current.Spawner != InvalidJob && (Result == InvalidJob || Current.AddedMicroseconds > Latest))
+		{
+			Result = Current.Spawner;
+		}
+		return Result;
+	}
+
+	void PrintJobLine(const Job& Current, u64 ReadyMicroseconds)
+	{
+		String Worker = Current.WorkerIndex < NumberOfWorkers() ? StringFromFormat("%llu", Current.WorkerIndex) : String("main");
+		printf("    %10.2f %10.2f %10.2f %6s  %s\n",
+			Current.StartMicroseconds / 1000.0,
+			(Current.EndMicroseconds - Current.StartMicroseconds) / 1000.0,
+			(Current.StartMicroseconds - eastl::min(ReadyMicroseconds, Current.StartMicroseconds)) / 1000.0,
+			Worker.c_str(), Current.Name.c_str());
+	}
+
+	// When the last thing the job waited on was done, the job could have started from then on
+	u64 GetJobReadyMicroseconds(const JobGraph& Graph, const Job& Current)
+	{
+		u64 Result = Current.AddedMicroseconds;
+		for (JobID Dependency : Current.Dependencies)
+		{
+			Result = eastl::max(Result, Graph.Jobs[Dependency]->EndMicroseconds);
+		}
+		return Result;
+	}
+}
+
+// Jobs start right away, once their dependencies are done. Dependencies can be finished already.
+// Called from inside a job, the new job can't finish before the running one, WaitForJobGraph keeps waiting for it.
+JobID AddJobWork(JobGraph& Graph, StringView Name, WorkPreamble* Work, const TArray<JobID>& Dependencies, u64 MemoryCost)
+{
+	Job* New = new Job();
+	New->Name = String(Name);
+	New->Work = Work;
+	New->Dependencies = Dependencies;
+	New->PendingCount.store(1, std::memory_order_relaxed);
+	New->Finished = false;
+	New->Spawner = tCurrentGraph == &Graph && tCurrentJob ? tCurrentJob->ID : InvalidJob;
+	New->WorkerIndex = 0;
+	New->MemoryCost = MemoryCost;
+	New->AddedMicroseconds = GetJobGraphMicroseconds(Graph);
+	New->StartMicroseconds = 0;
+	New->EndMicroseconds = 0;
+
+	Graph.Unfinished.fetch_add(1, std::memory_order_relaxed);
+	{
+		ScopedMovableLock AutoLock(Graph.Lock);
+		New->ID = JobID(Graph.Jobs.size());
+		for (JobID Dependency : Dependencies)
+		{
+			CHECK(Dependency < New->ID, "Jobs can only depend on jobs added before them");
+			Job* Before = Graph.Jobs[Dependency];
+			if (!Before->Finished)
+			{
+				New->PendingCount.fetch_add(1, std::memory_order_relaxed);
+				Before->Dependents.push_back(New);
+			}
+		}
+		Graph.Jobs.push_back(TUniquePtr<Job>(New));
+	}
+
+	ReleaseJob(Graph, New);
+	return New->ID;
+}
+
+// Gives back memory jobs reserved, as much of it as what they made is written out or freed.
+// Jobs that waited for it start in the order they got in line, as many as fit.
+void ReleaseJobMemory(JobGraph& Graph, u64 Bytes)
+{
+	TArray<Job*> Started;
+	{
+		ScopedMovableLock AutoLock(Graph.Lock);
+		CHECK(Bytes <= Graph.MemoryInUse, "Released more memory than jobs reserved");
+		Graph.MemoryInUse -= Bytes;
+		while (!Graph.WaitingForMemory.empty() && TryReserveJobMemory(Graph, Graph.WaitingForMemory.front()->MemoryCost))
+		{
+			Started.push_back(Graph.WaitingForMemory.front());
+			Graph.WaitingForMemory.pop_front();
+		}
+	}
+	for (Job* Ready : Started)
+	{
+		StartJob(Graph, Ready);
+	}
+}
+
+// For memory a running job only finds out about, taken right away even when it goes over the budget
+void ClaimJobMemory(JobGraph& Graph, u64 Bytes)
+{
+	ScopedMovableLock AutoLock(Graph.Lock);
+	Graph.MemoryInUse += Bytes;
+	Graph.MemoryPeak = eastl::max(Graph.MemoryPeak, Graph.MemoryInUse);
+}
+
+// The calling thread helps with the work until every job is done, including the ones added on the way.
+// With nothing to help with it sleeps.
+void WaitForJobGraph(JobGraph& Graph)
+{
+	ZoneScoped;
+	CHECK(NumberOfWorkers() > 0, "Job graphs run on the workers");
+	while (Graph.Unfinished.load(std::memory_order_acquire) != 0)
+	{
+		if (StealWork())
+		{
+			continue;
+		}
+
+		// the last job of any graph wakes the threads parked here
+		u64 Key = gJobGraphFinished.PrepareWait();
+		if (Graph.Unfinished.load(std::memory_order_acquire) == 0 || AnyWorkerHasWork())
+		{
+			gJobGraphFinished.CancelWait();
+			continue;
+		}
+		gJobGraphFinished.Wait(Key);
+	}
+}
+
+// Summary of a finished graph, the critical path and with PrintEveryJob all the jobs in start order.
+// Wait is how long a job sat in the queues after the last thing it depended on was done.
+void PrintJobGraphTimings(const JobGraph& Graph, bool PrintEveryJob)
+{
+	if (Graph.Jobs.empty())
+	{
+		return;
+	}
+
+	u64 WallMicroseconds = 0;
+	u64 BusyMicroseconds = 0;
+	JobID Last = 0;
+	for (u64 i = 0; i < Graph.Jobs.size(); ++i)
+	{
+		const Job& Current = *Graph.Jobs[i];
+		CHECK(Current.Finished, "Timings are for finished graphs");
+		BusyMicroseconds += Current.EndMicroseconds - Current.StartMicroseconds;
+		if (Current.EndMicroseconds > WallMicroseconds)
+		{
+			WallMicroseconds = Current.EndMicroseconds;
+			Last = JobID(i);
+		}
+	}
+
+	TArray<JobID> CriticalPath;
+	u64 CriticalMicroseconds = 0;
+	for (JobID Current = Last; Current != InvalidJob; Current = FindCriticalPredecessor(Graph, *Graph.Jobs[Current]))
+	{
+		CriticalPath.push_back(Current);
+		CriticalMicroseconds += Graph.Jobs[Current]->EndMicroseconds - Graph.Jobs[Current]->StartMicroseconds;
+	}
+	eastl::reverse(CriticalPath.begin(), CriticalPath.end());
+
+	printf("Job graph: %llu jobs on %llu workers, %.2f ms wall, %.2f ms busy (%.1fx), critical path %.2f ms of work\n",
+		(u64)Graph.Jobs.size(), NumberOfWorkers(),
+		WallMicroseconds / 1000.0, BusyMicroseconds / 1000.0,
+		WallMicroseconds ? double(BusyMicroseconds) / WallMicroseconds : 0.0,
+		CriticalMicroseconds / 1000.0);
+	if (Graph.MemoryBudget != UINT64_MAX)
+	{
+		printf("    memory: peak %.1f MB reserved of a %.1f MB budget\n", Graph.MemoryPeak / (1024.0 * 1024.0), Graph.MemoryBudget / (1024.0 * 1024.0));
+	}
+
+	printf("    %10s %10s %10s %6s  %s\n", "start ms", "time ms", "wait ms", "worker", "critical path");
+	for (JobID Current : CriticalPath)
+	{
+		PrintJobLine(*Graph.Jobs[Current], GetJobReadyMicroseconds(Graph, *Graph.Jobs[Current]));
+	}
+
+	if (PrintEveryJob)
+	{
+		TArray<const Job*> Sorted;
+		Sorted.reserve(Graph.Jobs.size());
+		for (const TUniquePtr<Job>& Current : Graph.Jobs)
+		{
+			Sorted.push_back(Current.Ptr);
+		}
+		eastl::sort(Sorted.begin(), Sorted.end(), [](const Job* A, const Job* B) { return A->StartMicroseconds < B->StartMicroseconds; });
+
+		printf("    %10s %10s %10s %6s  %s\n", "start ms", "time ms", "wait ms", "worker", "job");
+		for (const Job* Current : Sorted)
+		{
+			PrintJobLine(*Current, GetJobReadyMicroseconds(Graph, *Current));
+		}
+	}
+}
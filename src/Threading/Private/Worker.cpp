@@ -4,38 +4,138 @@
 #include "Util/Math.h"
 #include "Util/Debug.h"
 #include "Containers/Array.h"
+#include "Threading/Private/DedicatedThread.Declarations.h"
+
+#include <chrono>
+#include <stdio.h>
+
+#if _WIN32
+#include "System/Win32.generated.h"
+#else
+#include <time.h>
+#endif
 
 static TArray<DedicatedThreadData> gWorkers;
+static std::atomic<u64> gNextWorker;
+static EventCount gWorkerWakeUp;
 
 u64 NumberOfWorkers()
 {
 	return gWorkers.size();
 }
 
+bool IsWorker(DedicatedThreadData* DedicatedThread)
+{
+	return DedicatedThread >= gWorkers.begin() && DedicatedThread < gWorkers.end();
+}
+
+// NumberOfWorkers() on threads that aren't workers
+u64 GetCurrentWorkerIndex()
+{
+	DedicatedThreadData* Current = GetCurrentDedicatedThread();
+	if (Current && IsWorker(Current))
+	{
+		return u64(Current - gWorkers.begin());
+	}
+	return gWorkers.size();
+}
+
+// Workers park together, anything else that parks does it on its own
+EventCount& GetWakeUpEvent(DedicatedThreadData* DedicatedThread)
+{
+	return IsWorker(DedicatedThread) ? gWorkerWakeUp : *DedicatedThread->WakeUp;
+}
+
+// Items per leaf of a ParallelFor, a few leaves per worker unless the caller knows better
+u64 GetParallelForGrain(u64 Size, u64 Grain)
+{
+	if (Grain != 0)
+	{
+		return Grain;
+	}
+	u64 Leaves = (NumberOfWorkers() + 1) * 4;
+	return std::max<u64>((Size + Leaves - 1) / Leaves, 1);
+}
+
+bool AnyWorkerHasWork()
+{
+	for (DedicatedThreadData& Worker : gWorkers)
+	{
+		if (HasWork(&Worker))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Workers keep what they make on their own deque, everyone else spreads work round robin
+DedicatedThreadData* GetWorkerForNewWork()
+{
+	u64 Index = GetCurrentWorkerIndex();
+	if (Index == gWorkers.size())
+	{
+		Index = gNextWorker.fetch_add(1, std::memory_order_relaxed) % gWorkers.size();
+	}
+	return &gWorkers[Index];
+}
+
+// A worker takes its own work first, then everyone is tried once starting from a random worker.
+// Steals come from the top of the deques, the oldest and usually the biggest pieces of work.
 bool StealWork()
 {
-	for (int i = 0; i < gWorkers.size() * 2; ++i)
+	u64 Count = gWorkers.size();
+	if (Count == 0)
+	{
+		return false;
+	}
+
+	u64 Current = GetCurrentWorkerIndex();
+	if (Current != Count)
 	{
-		int Index = rand() % gWorkers.size();
-		DedicatedThreadData& ThreadData = gWorkers[Index];
-		WorkItem Item;
-		if (ThreadData.WorkItems.Empty() || !ThreadData.WorkItems.Pop(Item))
+		if (WorkPreamble* Work = TakeWork(&gWorkers[Current]))
+		{
+			ExecuteWork(Work);
+			return true;
+		}
+	}
+
+	// xorshift, each thread with its own sequence
+	thread_local u32 tSeed = u32(std::hash<ThreadID>()(std::this_thread::get_id())) | 1;
+	tSeed ^= tSeed << 13;
+	tSeed ^= tSeed >> 17;
+	tSeed ^= tSeed << 5;
+
+	u64 First = tSeed % Count;
+	for (u64 i = 0; i < Count; ++i)
+	{
+		u64 Victim = (First + i) % Count;
+		if (Victim == Current)
 		{
 			continue;
 		}
-		ExecuteItem(Item);
-		return true;
+		if (WorkPreamble* Work = TakeWork(&gWorkers[Victim]))
+		{
+			ExecuteWork(Work);
+			return true;
+		}
 	}
 	return false;
 }
 
-void StartWorkerThreads()
+// Count of 0 leaves two cores for the main and render threads
+void StartWorkerThreads(u64 Count)
 {
 #if NO_WORKERS
 	return;
 #endif
+	CHECK(gWorkers.empty(), "Workers are running already");
 	u32 CoreCount = std::thread::hardware_concurrency();
-	gWorkers.resize(std::max(1, (i32)CoreCount - 2));
+	if (Count == 0)
+	{
+		Count = std::max(1, (i32)CoreCount - 2);
+	}
+	gWorkers.resize(Count);
 
 	for (int i = 0; i < gWorkers.size(); ++i)
 	{
@@ -44,8 +144,206 @@ void StartWorkerThreads()
 	}
 }
 
+// Queues have to be empty by now, whatever is left in them is dropped
 void StopWorkerThreads()
 {
 	for (int i = 0; i < gWorkers.size(); ++i)
 		StopDedicatedThread(&gWorkers[i]);
+	gWorkers.clear();
+}
+
+namespace
+{
+	// user and kernel time of every thread of the process
+	double GetProcessCPUSeconds()
+	{
+#if _WIN32
+		FILETIME Creation, Exit, Kernel, User;
+		GetProcessTimes(GetCurrentProcess(), &Creation, &Exit, &Kernel, &User);
+		u64 Ticks = (u64(Kernel.dwHighDateTime) << 32 | Kernel.dwLowDateTime) + (u64(User.dwHighDateTime) << 32 | User.dwLowDateTime);
+		return Ticks / 1e7;
+#else
+		timespec Time;
+		clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &Time);
+		return Time.tv_sec + Time.tv_nsec / 1e9;
+#endif
+	}
+
+	void SpawnBenchmarkTasks(std::atomic<u64>& Done, u64 Count)
+	{
+		// halves go to the own deque for whoever is idle to steal, the rest is done inline
+		while (Count > 1)
+		{
+			u64 Half = Count / 2;
+			EnqueueToWorker([&Done, Half]() { SpawnBenchmarkTasks(Done, Half); });
+			Count -= Half;
+		}
+		Done.fetch_add(Count, std::memory_order_relaxed);
+	}
+
+	// Iterations of something the compiler can't throw away
+	u64 BenchmarkItem(u64 Seed, u64 Iterations)
+	{
+		for (u64 i = 0; i < Iterations; ++i)
+		{
+			Seed ^= Seed << 13;
+			Seed ^= Seed >> 7;
+			Seed ^= Seed << 17;
+		}
+		return Seed;
+	}
+
+	double TimeBenchmarkTasks(std::atomic<u64>& Done, u64 Tasks, std::chrono::high_resolution_clock::time_point Start)
+	{
+		while (Done.load(std::memory_order_relaxed) != Tasks)
+		{
+			if (!StealWork())
+			{
+				std::this_thread::yield();
+			}
+		}
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - Start).count();
+	}
+}
+
+// Tasks per second of empty work with 1, 2, 4... workers up to what StartWorkerThreads picks by default.
+// Injected: the calling thread enqueues every task. Spawned: tasks split themselves on the workers' deques.
+// Then what the default pool costs while idle, and how long a task enqueued to the idle pool takes to start,
+// and what the work arena holds afterwards.
+// Restarts the workers, nothing else can be running.
+void BenchmarkWorkers(u64 Tasks)
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	u64 MaxWorkers = std::max(1, (i32)std::thread::hardware_concurrency() - 2);
+	printf("%8s %16s %16s\n", "workers", "injected M/s", "spawned M/s");
+	for (u64 Count = 1; ; Count = std::min(Count * 2, MaxWorkers))
+	{
+		StopWorkerThreads();
+		StartWorkerThreads(Count);
+
+		std::atomic<u64> Done{ 0 };
+		Clock::time_point Start = Clock::now();
+		for (u64 i = 0; i < Tasks; ++i)
+		{
+			EnqueueToWorker([&Done]() { Done.fetch_add(1, std::memory_order_relaxed); });
+		}
+		double InjectedSeconds = TimeBenchmarkTasks(Done, Tasks, Start);
+
+		Done.store(0, std::memory_order_relaxed);
+		Start = Clock::now();
+		EnqueueToWorker([&Done, Tasks]() { SpawnBenchmarkTasks(Done, Tasks); });
+		double SpawnedSeconds = TimeBenchmarkTasks(Done, Tasks, Start);
+
+		printf("%8llu %16.2f %16.2f\n", Count, Tasks / InjectedSeconds / 1e6, Tasks / SpawnedSeconds / 1e6);
+		if (Count == MaxWorkers)
+		{
+			break;
+		}
+	}
+
+	StopWorkerThreads();
+	StartWorkerThreads();
+
+	double IdleSeconds = 0.5;
+	double CPUBefore = GetProcessCPUSeconds();
+	std::this_thread::sleep_for(std::chrono::duration<double>(IdleSeconds));
+	double IdleCPU = (GetProcessCPUSeconds() - CPUBefore) / IdleSeconds;
+
+	// the calling thread sleeps instead of helping, otherwise it would pick up the task itself
+	const u32 Wakes = 200;
+	double LatencyTotal = 0, LatencyMax = 0;
+	for (u32 i = 0; i < Wakes; ++i)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		std::atomic<i64> Started{ 0 };
+		Clock::time_point Enqueued = Clock::now();
+		EnqueueToWorker([&Started]() { Started.store(Clock::now().time_since_epoch().count(), std::memory_order_release); });
+		while (Started.load(std::memory_order_acquire) == 0)
+		{
+			std::this_thread::yield();
+		}
+		double Latency = std::chrono::duration<double>(Clock::duration(Started.load(std::memory_order_relaxed)) - Enqueued.time_since_epoch()).count();
+		LatencyTotal += Latency;
+		LatencyMax = std::max(LatencyMax, Latency);
+	}
+	printf("idle: %.1f%% of a core for %llu workers, wake up latency %.1f us average, %.1f us max\n",
+		IdleCPU * 100.0, NumberOfWorkers(), LatencyTotal / Wakes * 1e6, LatencyMax * 1e6);
+
+	WorkArenaStats Arena = GetWorkArenaStats();
+	printf("work arena: %llu pages of %u KB, %llu free, %.1f KB in flight, peak %.1f KB, %llu work items too big for a page\n",
+		Arena.Pages, WORK_PAGE_SIZE / 1024, Arena.FreePages, Arena.BytesInFlight / 1024.0, Arena.PeakBytesInFlight / 1024.0, Arena.LargeItems);
+}
+
+// Static slices against adaptive splitting on the default pool, the same total work spread differently over the range.
+// Front: the first eighth of the items costs 15 times more. Ramp: cost grows with the index. Spikes: a few items cost 500 times more.
+void BenchmarkParallelFor(u64 Items)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	CHECK(NumberOfWorkers() > 0, "Needs the workers");
+
+	struct Workload
+	{
+		const char* Name;
+		u64 (*Cost)(u64 Index, u64 Items);
+	};
+	const Workload Workloads[] = {
+		{ "uniform", [](u64, u64) -> u64 { return 1000; } },
+		{ "front",   [](u64 Index, u64 Items) -> u64 { return Index < Items / 8 ? 15000 : 1000; } },
+		{ "ramp",    [](u64 Index, u64 Items) -> u64 { return 2000 * Index / Items; } },
+		{ "spikes",  [](u64 Index, u64) -> u64 { return Index % 997 == 0 ? 500000 : 1000; } },
+	};
+
+	printf("%d workers, %llu items\n", (int)NumberOfWorkers(), Items);
+	printf("%10s %12s %12s %10s\n", "workload", "static ms", "adaptive ms", "speedup");
+	for (const Workload& Load : Workloads)
+	{
+		std::atomic<u64> Sink{ 0 };
+		auto Body = [&](u64 Begin, u64 End) {
+			u64 Sum = 0;
+			for (u64 i = Begin; i < End; ++i)
+			{
+				Sum += BenchmarkItem(i + 1, Load.Cost(i, Items));
+			}
+			Sink.fetch_add(Sum, std::memory_order_relaxed);
+		};
+
+		Clock::time_point Start = Clock::now();
+		ParallelForSlices([&](u64, u64 Begin, u64 End) { Body(Begin, End); }, Items);
+		double StaticSeconds = std::chrono::duration<double>(Clock::now() - Start).count();
+		u64 StaticSum = Sink.exchange(0);
+
+		Start = Clock::now();
+		ParallelFor(Body, Items);
+		double AdaptiveSeconds = std::chrono::duration<double>(Clock::now() - Start).count();
+		CHECK(Sink.load() == StaticSum, "Adaptive ParallelFor skipped or repeated items");
+
+		printf("%10s %12.2f %12.2f %9.2fx\n", Load.Name, StaticSeconds * 1e3, AdaptiveSeconds * 1e3, StaticSeconds / AdaptiveSeconds);
+	}
+
+	// both helpers against a plain loop
+	TArray<u64> Values(Items);
+	for (u64 i = 0; i < Items; ++i)
+	{
+		Values[i] = BenchmarkItem(i + 1, 1) & 0xffff;
+	}
+	u64 Expected = 0;
+	for (u64 Value : Values)
+	{
+		Expected += Value;
+	}
+	u64 Sum = ParallelReduce(Items, u64(0), [&](u64 Begin, u64 End) {
+		u64 Result = 0;
+		for (u64 i = Begin; i < End; ++i)
+		{
+			Result += Values[i];
+		}
+		return Result;
+	}, [](u64 A, u64 B) { return A + B; });
+	CHECK(Sum == Expected, "ParallelReduce");
+
+	TArray<u64> Prefix(Items);
+	ParallelScan(Values.data(), Prefix.data(), Items, u64(0), [](u64 A, u64 B) { return A + B; });
+	CHECK(Items == 0 || Prefix.back() == Expected, "ParallelScan");
+	printf("reduce and scan ok\n");
 }
@@ -7,6 +7,8 @@
 
 extern TArray<DedicatedThreadData> gWorkers;
 
+void StartWorkerThreads(u64 Count = 0);
+
 template <typename T>
 void EnqueueToWorker(T&& Work)
 {
@@ -14,7 +16,7 @@ void EnqueueToWorker(T&& Work)
 	Work();
 	return;
 #endif
-	EnqueueWork(&gWorkers[rand() % gWorkers.size()], MOVE(Work));
+	EnqueueWork(GetWorkerForNewWork(), MOVE(Work));
 }
 
 template <typename T>
@@ -25,11 +27,125 @@ TicketCPU EnqueueToWorkerWithTicket(T&& Work)
 	return TicketCPU{ 0 };
 #endif
 
-	return EnqueueWorkWithTicket(&gWorkers[rand()%gWorkers.size()], MOVE(Work));
+	return EnqueueWorkWithTicket(GetWorkerForNewWork(), MOVE(Work));
+}
+
+/*
+	PARALLEL FOR
+
+	ParallelFor cuts the range into leaves of Grain items and hands them out by splitting in halves:
+	the upper half of a range goes to the deque of whoever splits it, the lower half is split again
+	right away. Idle workers steal the oldest, biggest halves, so uneven items even out on their own
+	and a range a worker never got to costs no dispatch at all. Grain 0 picks a few leaves per worker,
+	ranges of cheap items want a bigger grain so a leaf is worth a work item.
+
+	ParallelForSlices splits statically into one slice per worker, Index being the slice.
+	For work that keeps something per slice, like a command list.
+*/
+
+template <typename T>
+void SplitParallelFor(T& Work, u64 Size, u64 Grain, u64 FirstLeaf, u64 EndLeaf, TicketCPU Done)
+{
+	while (EndLeaf - FirstLeaf > 1)
+	{
+		u64 Middle = FirstLeaf + (EndLeaf - FirstLeaf) / 2;
+		EnqueueWork(GetWorkerForNewWork(), [&Work, Size, Grain, Middle, EndLeaf, Done]()
+		{
+			SplitParallelFor(Work, Size, Grain, Middle, EndLeaf, Done);
+		});
+		EndLeaf = Middle;
+	}
+	{
+		ZoneScopedN("Parallel for work item");
+		u64 Begin = FirstLeaf * Grain;
+		Work(Begin, std::min(Begin + Grain, Size));
+	}
+	SignalTicket(Done);
 }
 
+// Work(Begin, End) over [0, Size), the calling thread takes part and helps with other work until it's all done
 template <typename T>
-void ParallelFor(T&& Work, u64 Size, u64 MaxWorkers = NumberOfWorkers())
+void ParallelFor(T&& Work, u64 Size, u64 Grain = 0)
+{
+	Grain = GetParallelForGrain(Size, Grain);
+	u64 Leaves = (Size + Grain - 1) / Grain;
+	if (Leaves <= 1 || NumberOfWorkers() == 0)
+	{
+		Work(0, Size);
+		return;
+	}
+	CHECK(Leaves <= UINT32_MAX, "Grain is too small for the range");
+
+	TicketCPU Done = CreateTicket(u32(Leaves));
+	SplitParallelFor(Work, Size, Grain, 0, Leaves, Done);
+	WaitForCompletion(Done);
+}
+
+// Map(Begin, End) of every leaf, folded with Combine in range order so the result doesn't depend on the split
+template <typename R, typename M, typename C>
+R ParallelReduce(u64 Size, R Identity, M&& Map, C&& Combine, u64 Grain = 0)
+{
+	Grain = GetParallelForGrain(Size, Grain);
+	u64 Leaves = (Size + Grain - 1) / Grain;
+	TArray<R> Partials(Leaves, Identity);
+	ParallelFor([&](u64 Begin, u64 End) {
+		for (u64 Leaf = Begin; Leaf < End; ++Leaf)
+		{
+			Partials[Leaf] = Map(Leaf * Grain, std::min(Leaf * Grain + Grain, Size));
+		}
+	}, Leaves, 1);
+
+	R Result = Identity;
+	for (const R& Partial : Partials)
+	{
+		Result = Combine(Result, Partial);
+	}
+	return Result;
+}
+
+// Inclusive scan, Out can be In. Every leaf is folded once for its total,
+// then scanned again from the totals of the leaves before it.
+template <typename V, typename C>
+void ParallelScan(const V* In, V* Out, u64 Size, V Identity, C&& Combine, u64 Grain = 0)
+{
+	Grain = GetParallelForGrain(Size, Grain);
+	u64 Leaves = (Size + Grain - 1) / Grain;
+	TArray<V> Offsets(Leaves, Identity);
+	ParallelFor([&](u64 Begin, u64 End) {
+		for (u64 Leaf = Begin; Leaf < End; ++Leaf)
+		{
+			V Total = Identity;
+			for (u64 i = Leaf * Grain; i < std::min(Leaf * Grain + Grain, Size); ++i)
+			{
+				Total = Combine(Total, In[i]);
+			}
+			Offsets[Leaf] = Total;
+		}
+	}, Leaves, 1);
+
+	V Running = Identity;
+	for (V& Offset : Offsets)
+	{
+		V Total = Offset;
+		Offset = Running;
+		Running = Combine(Running, Total);
+	}
+
+	ParallelFor([&](u64 Begin, u64 End) {
+		for (u64 Leaf = Begin; Leaf < End; ++Leaf)
+		{
+			V Total = Offsets[Leaf];
+			for (u64 i = Leaf * Grain; i < std::min(Leaf * Grain + Grain, Size); ++i)
+			{
+				Total = Combine(Total, In[i]);
+				Out[i] = Total;
+			}
+		}
+	}, Leaves, 1);
+}
+
+template <typename T>
+void ParallelForSlices(T&& Work, u64 Size, u64 MaxWorkers = NumberOfWorkers())
 {
 	MaxWorkers = std::min(NumberOfWorkers(), MaxWorkers);
 
@@ -41,18 +157,20 @@ void ParallelFor(T&& Work, u64 Size, u64 MaxWorkers = NumberOfWorkers())
 	u64 WorkDivisor = Size / (MaxWorkers);
 	u64 Begin = 0;
 	u64 End = WorkDivisor;
-	TArray<TicketCPU> Tickets;
-	if (Begin != End)
+	// one ticket for all the work items, each of them signals it once
+	TicketCPU Done;
+	if (Begin != End && MaxWorkers > 1)
 	{
-		Tickets.resize(MaxWorkers - 1);
+		Done = CreateTicket(u32(MaxWorkers - 1));
 		for (u64 i = 0; i < MaxWorkers - 1; ++i)
 		{
-			Tickets[i] = EnqueueWorkWithTicket(&gWorkers[i],
+			EnqueueWork(&gWorkers[i],
 				[i, Begin, End, &Work]()
 				{
 					ZoneScopedN("Parallel for work item");
 					Work(i, Begin, End);
-				}
+				},
+				Done, true
 			);
 			Begin += WorkDivisor;
 			End += WorkDivisor;
@@ -64,9 +182,5 @@ void ParallelFor(T&& Work, u64 Size, u64 MaxWorkers = NumberOfWorkers())
 		ZoneScopedN("Inline parallel for");
 		Work(MaxWorkers - 1, Begin, Size);
 	}
-	for (auto It : Tickets)
-	{
-		WaitForCompletion(It);
-	}
+	WaitForCompletion(Done);
 }
-
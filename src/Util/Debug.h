@@ -1,6 +1,10 @@
 #pragma once
 
+#if _MSC_VER
 #define DEBUG_BREAK() __debugbreak()
+#else
+#define DEBUG_BREAK() __builtin_trap()
+#endif
 
 #if !defined(RELEASE) && !defined(PROFILE)
 # define CHECK(x, ...) \
@@ -2,6 +2,14 @@
 #include "Common.h"
 #include "Util/Debug.h"
 
+// Marks functions using AVX2 intrinsics that are only called after CpuSupportsAVX2().
+// MSVC takes the intrinsics without /arch:AVX2, gcc and clang need them enabled per function.
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
 static const uint32_t Max10bit = 0x3ff;
 static const uint32_t Max6bit = 0x3f;
 static const uint32_t Max5bit = 0x1f;
@@ -24,6 +32,12 @@ T AlignDown(T In, TT Alignment)
 	return AlignUp<T>(In + 1 - (T)Alignment, Alignment);
 }
 
+template<typename T, typename TT>
+T DivideRoundUp(T In, TT Divisor)
+{
+	return (In + (T)Divisor - 1) / (T)Divisor;
+}
+
 template<typename T>
 T Clamp(T In, T Min, T Max)
 {
@@ -3,6 +3,11 @@
 
 #include <smmintrin.h>
 #include <math.h>
+#if _WIN32
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
 
 namespace {
 	uint32_t AsUint(float x) {
@@ -365,4 +370,44 @@ u16 RGBto565(float r, float g, float b)
 	Result |= (u16(Clamp<float>(g * (float)Max5bit, 0, Max6bit)) & Max6bit) << 5;
 	Result |= (u16(Clamp<float>(b * (float)Max5bit, 0, Max5bit)) & Max5bit) << 11;
 	return Result;
-}
\ No newline at end of file
+}
+
+// AVX2 needs the instructions and an OS that saves the ymm registers, checked once
+bool CpuSupportsAVX2()
+{
+	static const bool Supported = []
+	{
+		u32 Leaf0[4], Leaf1[4], Leaf7[4] = {}; // eax, ebx, ecx, edx
+#if _WIN32
+		__cpuidex((int*)Leaf0, 0, 0);
+		__cpuidex((int*)Leaf1, 1, 0);
+		if (Leaf0[0] >= 7)
+		{
+			__cpuidex((int*)Leaf7, 7, 0);
+		}
+#else
+		__cpuid_count(0, 0, Leaf0[0], Leaf0[1], Leaf0[2], Leaf0[3]);
+		__cpuid_count(1, 0, Leaf1[0], Leaf1[1], Leaf1[2], Leaf1[3]);
+		if (Leaf0[0] >= 7)
+		{
+			__cpuid_count(7, 0, Leaf7[0], Leaf7[1], Leaf7[2], Leaf7[3]);
+		}
+#endif
+		bool OSXSave = Leaf1[2] & (1u << 27);
+		bool AVX     = Leaf1[2] & (1u << 28);
+		bool AVX2    = Leaf7[1] & (1u << 5);
+		if (!OSXSave || !AVX || !AVX2)
+		{
+			return false;
+		}
+#if _WIN32
+		u64 XCR0 = _xgetbv(0);
+#else
+		u32 Low, High;
+		__asm__("xgetbv" : "=a"(Low), "=d"(High) : "c"(0));
+		u64 XCR0 = (u64(High) << 32) | Low;
+#endif
+		return (XCR0 & 6) == 6; // xmm and ymm state
+	}();
+	return Supported;
+}